@@ -10,24 +10,101 @@
 /*==============================================================================
  * CONSTANTS
  *============================================================================*/
+#define OT_ADC_MAX    0x03FF // 10-bit
+#if defined(LIGHTNING_MODE)
+  // A burst is a rise of LIGHTNING_SLOPE over the level at the last tick
+  #define OT_ADC_FLASH_MARGIN   LIGHTNING_SLOPE
+#elif defined(ADC_FLASH_DETECT)
+  #define OT_ADC_FLASH_MARGIN   ADC_FLASH_MARGIN
+#endif // LIGHTNING_MODE
 /*==============================================================================
  * MACROS
  *============================================================================*/
 /*==============================================================================
  * TYPEDEFs and STRUCTs
  *============================================================================*/
+#if defined(ADC_FLASH_DETECT)
+typedef struct OT_ADC_FLASH_S {
+  OT_ADC_CB_T *cb;
+  void        *cbarg;
+  uint16_t     baseline_acc; // OT_ADC_flash_baseline << ADC_FLASH_TRACK_SHIFT
+  uint8_t      high;         // Above the threshold, i.e. within a flash burst
+} OT_ADC_FLASH_T;
+#endif // ADC_FLASH_DETECT
 /*==============================================================================
  * LOCAL FUNCTION PROTOTYPES
  *============================================================================*/
+static uint16_t ot_adc_read(ADC1_Channel_TypeDef channel);
+#if defined(ADC_FLASH_DETECT)
+static void ot_adc_flash_thresholds(void);
+#endif // ADC_FLASH_DETECT
 /*==============================================================================
  * LOCAL VARIABLES
  *============================================================================*/
+#if defined(ADC_FLASH_DETECT)
+static OT_ADC_FLASH_T ot_adc_flash = {
+  .cb           = (void*)0,
+  .cbarg        = (void*)0,
+  .baseline_acc = 0,
+  .high         = 0
+};
+#endif // ADC_FLASH_DETECT
 /*==============================================================================
  * GLOBAL (extern) VARIABLES
  *============================================================================*/
+#if defined(ADC_FLASH_DETECT)
+volatile uint16_t OT_ADC_flash_baseline = 0;
+#endif // ADC_FLASH_DETECT
 /*==============================================================================
  * LOCAL FUNCTIONS
  *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION: Single (blocking) 10-bit conversion of the given channel
+ * @param
+ * @return
+ * @precondition Flash detection (ADC_FLASH_DETECT) is disarmed
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static uint16_t ot_adc_read(ADC1_Channel_TypeDef channel) {
+  uint16_t retval = 0;
+  ADC1_ConversionConfig(ADC1_CONVERSIONMODE_SINGLE, channel, ADC1_ALIGN_RIGHT);
+  ADC1_Cmd(ENABLE);
+  ADC1_StartConversion();
+  while (RESET == ADC1_GetFlagStatus(ADC1_FLAG_EOC));
+  retval = ADC1_GetConversionValue();
+  ADC1_Cmd(DISABLE);
+  return retval;
+}
+/*==============================================================================
+ * DESCRIPTION: Set the analog watchdog for the next crossing of FLASH_SENSE:
+ * rising above OT_ADC_flash_baseline + OT_ADC_FLASH_MARGIN, or (within a
+ * burst) falling back below OT_ADC_flash_baseline + OT_ADC_FLASH_MARGIN / 2
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution An ambient level within OT_ADC_FLASH_MARGIN of full-scale can't be
+ *          told from a flash; the watchdog is then left idle
+ * @notes The watchdog fires on a conversion above the high threshold or
+ *        below the low one; OT_ADC_MAX and 0 can't be crossed
+ *============================================================================*/
+#if defined(ADC_FLASH_DETECT)
+static void ot_adc_flash_thresholds(void) {
+  uint16_t threshold = OT_ADC_flash_baseline + OT_ADC_FLASH_MARGIN;
+  if (threshold > OT_ADC_MAX) threshold = OT_ADC_MAX;
+  if (ot_adc_flash.high) {
+    ADC1_SetHighThreshold(OT_ADC_MAX);
+    ADC1_SetLowThreshold(OT_ADC_flash_baseline + (OT_ADC_FLASH_MARGIN / 2));
+  }
+  else {
+    ADC1_SetLowThreshold(0);
+    ADC1_SetHighThreshold(threshold);
+  }
+  return;
+}
+#endif // ADC_FLASH_DETECT
 /*==============================================================================
  * EXPORTED (GLOBAL) FUNCTIONS
  *============================================================================*/
@@ -48,6 +125,14 @@ void OT_ADC_init(void) {
   ADC1_Init(ADC1_CONVERSIONMODE_SINGLE, DELAY_SENSE_ADC_CHANNEL,
             ADC1_PRESSEL_FCPU_D18, ADC1_EXTTRIG_TIM, DISABLE, ADC1_ALIGN_RIGHT,
             DELAY_SENSE_SCHMTRIG_CHANNEL, DISABLE);
+#if defined(BATTERY_MONITOR)
+  GPIO_Init(VREF_SENSE_PORT, VREF_SENSE_PIN, VREF_SENSE_MODE);
+  ADC1_SchmittTriggerConfig(VREF_SENSE_SCHMTRIG_CHANNEL, DISABLE);
+#endif // BATTERY_MONITOR
+#if defined(ADC_FLASH_DETECT) || defined(BURST_CAPTURE)
+  GPIO_Init(FLASH_SENSE_PORT, FLASH_SENSE_PIN, FLASH_SENSE_MODE);
+  ADC1_SchmittTriggerConfig(FLASH_SENSE_SCHMTRIG_CHANNEL, DISABLE);
+#endif // ADC_FLASH_DETECT || BURST_CAPTURE
   ADC1_Cmd(DISABLE);
   return;
 }
@@ -61,13 +146,213 @@ void OT_ADC_init(void) {
  * @notes
  *============================================================================*/
 uint8_t OT_ADC_read_delay_sense(void) {
-  uint16_t retval = 0;
+  uint16_t retval = ot_adc_read(DELAY_SENSE_ADC_CHANNEL);
+  // The ADC1 sampling resolution is 10-bit and we want to return 8-bit values
+  return (retval >> 2);
+}
+/*==============================================================================
+ * DESCRIPTION: Measure Vdd (in mV) using the fixed VREF_SENSE reference.
+ * @param
+ * @return Vdd in mV (0 if the reference could not be measured)
+ * @precondition - The reference is powered (i.e. the sensor is ON)
+ * @postcondition
+ * @caution
+ * @notes - The ADC uses Vdd as its own reference, hence a fixed voltage
+ *          reads as VREF_SENSE_MV * 1023 / Vdd.
+ *============================================================================*/
+#if defined(BATTERY_MONITOR)
+uint16_t OT_ADC_read_vdd_mv(void) {
+  uint16_t counts = ot_adc_read(VREF_SENSE_ADC_CHANNEL);
+  if (0 == counts) return 0;
+  return (uint16_t)(((uint32_t)VREF_SENSE_MV * 1023) / counts);
+}
+#endif // BATTERY_MONITOR
+/*==============================================================================
+ * DESCRIPTION:
+ * @param cb - called (from the ADC1 interrupt) on every flash burst
+ * @param cbarg - passed to cb
+ * @return
+ * @precondition OT_ADC_init()
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+#if defined(ADC_FLASH_DETECT)
+void OT_ADC_flash_init(OT_ADC_CB_T *cb, void *cbarg) {
+  ot_adc_flash.cb    = cb;
+  ot_adc_flash.cbarg = cbarg;
+  return;
+}
+#endif // ADC_FLASH_DETECT
+/*==============================================================================
+ * DESCRIPTION: Convert FLASH_SENSE continuously and raise a flash burst when it
+ * rises OT_ADC_FLASH_MARGIN above the ambient level (replaces
+ * TRIGGER_IN_ENABLE)
+ * @param
+ * @return
+ * @precondition The ADC1 clock is enabled
+ * @postcondition
+ * @caution
+ * @notes Between bursts, the ambient level is (re)measured first; within a
+ *        burst (e.g. re-armed by a state change on the burst itself) the
+ *        watchdog waits for its end instead.
+ *        fADC = fMASTER/2: a conversion every 14usec at 2MHz, i.e. bursts
+ *        shorter than that may be missed.
+ *============================================================================*/
+#if defined(ADC_FLASH_DETECT)
+void OT_ADC_flash_arm(void) {
+  ADC1_PrescalerConfig(ADC1_PRESSEL_FCPU_D2);
+  ADC1_ConversionConfig(ADC1_CONVERSIONMODE_CONTINUOUS,
+                        FLASH_SENSE_ADC_CHANNEL, ADC1_ALIGN_RIGHT);
+  ADC1_Cmd(ENABLE);
+  ADC1_StartConversion();
+#if defined(LIGHTNING_MODE)
+  // Start from the current level, even within a stroke: the next stroke of
+  // the flash is a fast rise from there
+  ot_adc_flash.high = 0;
+#endif // LIGHTNING_MODE
+  if (0 == ot_adc_flash.high) {
+    while (RESET == ADC1_GetFlagStatus(ADC1_FLAG_EOC));
+    OT_ADC_flash_baseline = ADC1_GetConversionValue();
+    ot_adc_flash.baseline_acc = OT_ADC_flash_baseline << ADC_FLASH_TRACK_SHIFT;
+  }
+  ot_adc_flash_thresholds();
+  ADC1_ClearITPendingBit(ADC1_IT_AWD);
+  ADC1_ITConfig(ADC1_IT_AWDIE, ENABLE);
+  return;
+}
+#endif // ADC_FLASH_DETECT
+/*==============================================================================
+ * DESCRIPTION: Stop flash detection (replaces TRIGGER_IN_DISABLE)
+ * @param
+ * @return
+ * @precondition
+ * @postcondition The ADC is off and set up for ot_adc_read() again
+ * @caution
+ * @notes
+ *============================================================================*/
+#if defined(ADC_FLASH_DETECT)
+void OT_ADC_flash_disarm(void) {
+  ADC1_ITConfig(ADC1_IT_AWDIE, DISABLE);
+  ADC1_Cmd(DISABLE);
+  ADC1_PrescalerConfig(ADC1_PRESSEL_FCPU_D18);
+  return;
+}
+#endif // ADC_FLASH_DETECT
+/*==============================================================================
+ * DESCRIPTION: Follow the ambient level with the latest conversion
+ * @param
+ * @return
+ * @precondition Armed, and not called concurrently with the ADC1 interrupt
+ * @postcondition
+ * @caution
+ * @notes Call periodically (READY calls it every 1msec tick): the ambient
+ *        level is a running average with a time constant of
+ *        2^ADC_FLASH_TRACK_SHIFT calls.
+ *        With LIGHTNING_MODE it is the latest conversion instead, so a burst
+ *        is a rise faster than LIGHTNING_SLOPE per call (a derivative).
+ *============================================================================*/
+#if defined(ADC_FLASH_DETECT)
+void OT_ADC_flash_track(void) {
+  if (0 == ot_adc_flash.high) {
+#if defined(LIGHTNING_MODE)
+    OT_ADC_flash_baseline = ADC1_GetConversionValue();
+#else
+    ot_adc_flash.baseline_acc += ADC1_GetConversionValue();
+    ot_adc_flash.baseline_acc -= OT_ADC_flash_baseline;
+    OT_ADC_flash_baseline = ot_adc_flash.baseline_acc >> ADC_FLASH_TRACK_SHIFT;
+#endif // LIGHTNING_MODE
+    ot_adc_flash_thresholds();
+  }
+  return;
+}
+#endif // ADC_FLASH_DETECT
+/*==============================================================================
+ * DESCRIPTION: Sample FLASH_SENSE through a burst and extract its features
+ * @param burstp - where to store the features
+ * @return
+ * @precondition The ADC1 clock is enabled. Called on the TRIGGER_IN edge.
+ * @postcondition The ADC is off and set up for ot_adc_read() again
+ * @caution Blocks for the whole capture (10 conversions)
+ * @notes The ADC is stopped as soon as the buffer is full, so the samples
+ *        aren't overwritten while they are read
+ *============================================================================*/
+#if defined(BURST_CAPTURE)
+void OT_ADC_capture_burst(OT_ADC_BURST_T *burstp) {
+  uint16_t samples[OT_ADC_BURST_SAMPLES];
+  uint16_t lowest = OT_ADC_MAX;
+  uint16_t highest = 0;
+  uint16_t level;
+  uint8_t i;
+
+  ADC1_PrescalerConfig(BURST_CAPTURE_PRESCALER);
+  ADC1_ConversionConfig(ADC1_CONVERSIONMODE_CONTINUOUS,
+                        FLASH_SENSE_ADC_CHANNEL, ADC1_ALIGN_RIGHT);
+  ADC1_DataBufferCmd(ENABLE);
+  ADC1_ClearFlag(ADC1_FLAG_EOC);
   ADC1_Cmd(ENABLE);
   ADC1_StartConversion();
+  // With the data buffer enabled, EOC is set once the buffer is full
   while (RESET == ADC1_GetFlagStatus(ADC1_FLAG_EOC));
-  retval = ADC1_GetConversionValue();
   ADC1_Cmd(DISABLE);
-  // The ADC1 sampling resolution is 10-bit and we want to return 8-bit values
-  return (retval >> 2);
+  ADC1_DataBufferCmd(DISABLE);
+  ADC1_PrescalerConfig(ADC1_PRESSEL_FCPU_D18);
+
+  for (i = 0; i < OT_ADC_BURST_SAMPLES; ++i) {
+    samples[i] = ADC1_GetBufferValue(i);
+    if (samples[i] < lowest) lowest = samples[i];
+    if (samples[i] > highest) highest = samples[i];
+  }
+
+  burstp->peak     = highest - lowest;
+  burstp->highest  = highest;
+  burstp->energy   = 0;
+  burstp->rise     = OT_ADC_BURST_SAMPLES;
+  burstp->duration = 0;
+  burstp->ended    = 0;
+  level = lowest + (burstp->peak >> 1); // Half the peak
+  for (i = 0; i < OT_ADC_BURST_SAMPLES; ++i) {
+    burstp->energy += samples[i] - lowest;
+    if ((OT_ADC_BURST_SAMPLES == burstp->rise) &&
+        ((samples[i] - lowest) >= (burstp->peak - (burstp->peak >> 3)))) {
+      burstp->rise = i;
+    }
+    if (samples[i] >= level) {
+      ++burstp->duration;
+    }
+    else if (0 != burstp->duration) {
+      level = OT_ADC_MAX + 1; // Fell below: the burst is over
+      burstp->ended = 1;
+    }
+  }
+  return;
+}
+#endif // BURST_CAPTURE
+/*==============================================================================
+ * DESCRIPTION: The analog watchdog saw FLASH_SENSE cross its threshold
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes Only the rising crossing is reported.
+ *        With LIGHTNING_MODE, TRIGGER_OUT is turned on first thing: every
+ *        burst is confirmed (see ot_sm_first_burst) and CONFIRMED then only
+ *        completes the pulse. The fire is then at most a conversion (14usec)
+ *        plus the interrupt entry after the sample that crossed.
+ *============================================================================*/
+#if defined(ADC_FLASH_DETECT)
+INTERRUPT_HANDLER(ot_adc_isr, ITC_IRQ_ADC1) {
+#if defined(LIGHTNING_MODE)
+  if (0 == ot_adc_flash.high) TRIGGER_OUT_ON();
+#endif // LIGHTNING_MODE
+  ADC1_ClearITPendingBit(ADC1_IT_AWD);
+  ot_adc_flash.high = !ot_adc_flash.high;
+  ot_adc_flash_thresholds();
+  if (ot_adc_flash.high && (void*)0 != ot_adc_flash.cb) {
+    (*ot_adc_flash.cb)(ot_adc_flash.cbarg);
+  }
+  return;
 }
+#endif // ADC_FLASH_DETECT
 /*============================================================================*/
@@ -2,25 +2,87 @@
  * MODULE: ADC
  * DESCRIPTION: Prototypes exported by the ADC module
  *============================================================================*/
+#ifndef _OT_ADC_H_
+#define _OT_ADC_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
 /*==============================================================================
  * INCLUDES
  *============================================================================*/
+#include <stm8s.h>
 /*==============================================================================
  * CONSTANTS
  *============================================================================*/
+#if defined(ADC_FLASH_DETECT) && defined(BURST_CAPTURE)
+  #error "ADC_FLASH_DETECT and BURST_CAPTURE both need ADC1"
+#endif
+#if defined(LIGHTNING_MODE) && !defined(ADC_FLASH_DETECT)
+  #error "LIGHTNING_MODE needs ADC_FLASH_DETECT"
+#endif
+#if defined(BURST_CAPTURE)
+  #define OT_ADC_BURST_SAMPLES    10 // The size of the ADC1 data buffer
+#endif // BURST_CAPTURE
 /*==============================================================================
  * MACROS
  *============================================================================*/
 /*==============================================================================
  * TYPEDEFs and STRUCTs
  *============================================================================*/
+#if defined(ADC_FLASH_DETECT)
+typedef void (OT_ADC_CB_T)(void *cbarg);
+#endif // ADC_FLASH_DETECT
+
+#if defined(BURST_CAPTURE)
+// Features of a burst's waveform on FLASH_SENSE. Times are in samples (see
+// BURST_CAPTURE_PRESCALER) from the TRIGGER_IN edge, levels in ADC counts
+// above the lowest sample (the start of the rise, or the tail of a burst
+// shorter than the capture).
+typedef struct OT_ADC_BURST_S {
+  uint16_t peak;      // Highest level
+  uint16_t energy;    // Sum of the levels
+  uint16_t highest;   // Highest sample (ADC counts, not above the lowest)
+  uint8_t  rise;      // Time to 7/8 of the peak
+  uint8_t  duration;  // Time above half the peak (up to the end of capture)
+  uint8_t  ended;     // Non-zero if it fell below half the peak in the capture
+} OT_ADC_BURST_T;
+#endif // BURST_CAPTURE
 /*==============================================================================
  * GLOBAL (extern) VARIABLES
  *============================================================================*/
+#if defined(ADC_FLASH_DETECT)
+// Ambient level of FLASH_SENSE (ADC counts) the threshold is relative to.
+// Exported so it can be read over SWIM.
+extern volatile uint16_t OT_ADC_flash_baseline;
+#endif // ADC_FLASH_DETECT
 /*==============================================================================
  * EXPORTED (GLOBAL) FUNCTIONS
  *============================================================================*/
 void OT_ADC_init(void);
 uint8_t OT_ADC_read_delay_sense(void);
+#if defined(BATTERY_MONITOR)
+uint16_t OT_ADC_read_vdd_mv(void);
+#endif // BATTERY_MONITOR
+#if defined(ADC_FLASH_DETECT)
+void OT_ADC_flash_init(OT_ADC_CB_T *cb, void *cbarg);
+void OT_ADC_flash_arm(void);
+void OT_ADC_flash_disarm(void);
+void OT_ADC_flash_track(void);
+#endif // ADC_FLASH_DETECT
+#if defined(BURST_CAPTURE)
+void OT_ADC_capture_burst(OT_ADC_BURST_T *burstp);
+#endif // BURST_CAPTURE
+#if defined(_SDCC_)
+  // The SDCC compiler requires the main module to know interrupt prototypes
+  #if defined(ADC_FLASH_DETECT)
+    INTERRUPT_HANDLER(ot_adc_isr, ITC_IRQ_ADC1);
+  #endif // ADC_FLASH_DETECT
+#endif // _SDCC_
 /*============================================================================*/
+#ifdef __cplusplus
+}
+#endif
 
+#endif /* _OT_ADC_H_ */
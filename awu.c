@@ -0,0 +1,101 @@
+/*==============================================================================
+ * MODULE: Auto Wake-Up (AWU)
+ * DESCRIPTION: Periodic wake-up from active-halt, used to 'sniff' for flash
+ * bursts while the trigger is SLEEPING.
+ *============================================================================*/
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include <stm8s.h>
+#include "awu.h"
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+/*==============================================================================
+ * LOCAL FUNCTION PROTOTYPES
+ *============================================================================*/
+/*==============================================================================
+ * LOCAL VARIABLES
+ *============================================================================*/
+static OT_AWU_CB_T *ot_awu_cb    = (void*)0;
+static void        *ot_awu_cbarg = (void*)0;
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+/*==============================================================================
+ * LOCAL FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+void OT_AWU_init(OT_AWU_CB_T *cb, void *cbarg) {
+  ot_awu_cb    = cb;
+  ot_awu_cbarg = cbarg;
+  OT_AWU_stop();
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Arm the AWU so that the next halt() becomes an active-halt that
+ * wakes up every 'period'.
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes - The main regulator is switched off during active-halt so that the
+ *          sleep current stays close to that of a pure halt.
+ *============================================================================*/
+void OT_AWU_start(AWU_Timebase_TypeDef period) {
+  CLK_LSICmd(ENABLE); // AWU is clocked by the LSI
+  CLK_SlowActiveHaltWakeUpConfig(ENABLE); // Main regulator OFF in active-halt
+  AWU_Init(period); // Also sets AWUEN
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+void OT_AWU_stop(void) {
+  AWU_Cmd(DISABLE);
+  CLK_SlowActiveHaltWakeUpConfig(DISABLE);
+  CLK_LSICmd(DISABLE);
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+INTERRUPT_HANDLER(ot_awu_isr, ITC_IRQ_AWU) {
+  // Reading the status register clears the AWU flag
+  if (RESET != AWU_GetFlagStatus()) {
+    // Inform the 'owner' module of this interrupt
+    if ((void*)0 != ot_awu_cb) (*ot_awu_cb)(ot_awu_cbarg);
+  }
+  return;
+}
+/*============================================================================*/
@@ -0,0 +1,47 @@
+/*==============================================================================
+ * MODULE: Auto Wake-Up (AWU)
+ * DESCRIPTION: Prototypes exported by the AWU module
+ *============================================================================*/
+#ifndef _OT_AWU_H_
+#define _OT_AWU_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include <stm8s.h>
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+#if defined(SNIFF_MODE) && !defined(WAKEUP_BUTTON)
+  #error "SNIFF_MODE requires WAKEUP_BUTTON"
+#endif
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+typedef void (OT_AWU_CB_T)(void *cbarg);
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+void OT_AWU_init(OT_AWU_CB_T *cb, void *cbarg);
+void OT_AWU_start(AWU_Timebase_TypeDef period);
+void OT_AWU_stop(void);
+#if defined(_SDCC_)
+  // The SDCC compiler requires the main module to know interrupt prototypes
+  INTERRUPT_HANDLER(ot_awu_isr, ITC_IRQ_AWU);
+#endif // _SDCC_
+/*============================================================================*/
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _OT_AWU_H_ */
@@ -0,0 +1,212 @@
+/*==============================================================================
+ * MODULE: Command
+ * DESCRIPTION: Decodes the commands a wireless master encodes in the positions
+ * of its pre-flash pulses (pulse-position modulation), so the slave fires on
+ * exactly the main burst its group is commanded to fire on.
+ *
+ * A frame is a leader pulse, a sync pulse the protocol's leader gap after it,
+ * then OT_CMD_FRAME_BITS pulses, each a 'zero' or a 'one' gap after the
+ * previous one. The commanded burst (the groups' metering pre-flash or the
+ * main flash) follows the last pulse of the frame after the protocol's burst
+ * gap. The protocol is told by its leader gap.
+ *
+ * This module has no hardware dependencies (timestamps come from the caller).
+ *============================================================================*/
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include "config.h"
+#include "command.h"
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+// CPU cycles (at fMASTER = 2MHz) in a usec
+#define OT_CMD_CYCLES_PER_US    2
+// Entries of ot_cmd_protocols[]
+#define OT_CMD_PROTOCOLS        2
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+#define OT_CMD_US(us)           ((us) * OT_CMD_CYCLES_PER_US)
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+// Gaps (in CPU cycles) between the pulses of a protocol
+typedef struct OT_CMD_PROTOCOL_S {
+  uint16_t leader;  // Leader to sync pulse
+  uint16_t zero;    // Before a 0 bit's pulse
+  uint16_t one;     // Before a 1 bit's pulse
+  uint16_t burst;   // Last pulse of the frame to the commanded burst
+} OT_CMD_PROTOCOL_T;
+
+typedef enum OT_CMD_STATE_E {
+  OT_CMD_STATE_IDLE,    // Waiting for a leader
+  OT_CMD_STATE_BITS,    // Receiving the frame's bits
+  OT_CMD_STATE_BURST    // Waiting for the commanded burst
+} OT_CMD_STATE_T;
+
+typedef struct OT_CMD_DATA_S {
+  const OT_CMD_PROTOCOL_T *protocolp; // Protocol of the current frame
+  uint32_t last;        // Time of the last edge
+  uint8_t  started;     // Non-zero once last is valid
+  uint8_t  state;       // OT_CMD_STATE_T
+  uint8_t  bits;        // Bits received
+  uint8_t  frame;       // The bits so far (MSB first)
+} OT_CMD_DATA_T;
+/*==============================================================================
+ * LOCAL FUNCTION PROTOTYPES
+ *============================================================================*/
+static uint8_t ot_cmd_near(uint32_t gap, uint16_t expected);
+static uint8_t ot_cmd_parity(uint8_t frame);
+static void ot_cmd_leader(uint32_t gap);
+/*==============================================================================
+ * LOCAL VARIABLES
+ *============================================================================*/
+// CAUTION: The timings are nominal (from typical masters) and are to be
+// replaced by scope captures as they are collected (see doc/FlashTraces.md).
+// Leaders must differ by more than twice WIRELESS_TOLERANCE_CYCLES.
+static const OT_CMD_PROTOCOL_T ot_cmd_protocols[OT_CMD_PROTOCOLS] = {
+  // Nikon CLS (nominal)
+  { OT_CMD_US(1000), OT_CMD_US(300), OT_CMD_US(600), OT_CMD_US(1000) },
+  // Canon optical wireless (nominal)
+  { OT_CMD_US(1600), OT_CMD_US(400), OT_CMD_US(800), OT_CMD_US(1500) }
+};
+
+static OT_CMD_DATA_T ot_cmd_data;
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+volatile uint16_t OT_CMD_frames = 0;
+volatile uint8_t  OT_CMD_last_frame = 0;
+/*==============================================================================
+ * LOCAL FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION:
+ * @param gap - time between two edges
+ * @param expected - the gap expected by the protocol
+ * @return non-zero if gap is within WIRELESS_TOLERANCE_CYCLES of expected
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static uint8_t ot_cmd_near(uint32_t gap, uint16_t expected) {
+  uint32_t diff = (gap > expected) ? (gap - expected) : (expected - gap);
+  return diff <= WIRELESS_TOLERANCE_CYCLES;
+}
+/*==============================================================================
+ * DESCRIPTION:
+ * @param frame - a complete frame
+ * @return 0 if the frame has an even number of 1 bits (i.e. is valid)
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static uint8_t ot_cmd_parity(uint8_t frame) {
+  frame ^= frame >> 4;
+  frame ^= frame >> 2;
+  frame ^= frame >> 1;
+  return frame & 0x01;
+}
+/*==============================================================================
+ * DESCRIPTION: Start a frame if gap is a protocol's leader
+ * @param gap - time from the previous edge
+ * @return
+ * @precondition
+ * @postcondition state is OT_CMD_STATE_BITS (or OT_CMD_STATE_IDLE if gap is
+ *                no leader)
+ * @caution
+ * @notes
+ *============================================================================*/
+static void ot_cmd_leader(uint32_t gap) {
+  uint8_t i;
+  ot_cmd_data.state = OT_CMD_STATE_IDLE;
+  for (i = 0; i < OT_CMD_PROTOCOLS; ++i) {
+    if (ot_cmd_near(gap, ot_cmd_protocols[i].leader)) {
+      ot_cmd_data.protocolp = &ot_cmd_protocols[i];
+      ot_cmd_data.state = OT_CMD_STATE_BITS;
+      ot_cmd_data.bits  = 0;
+      ot_cmd_data.frame = 0;
+      break;
+    }
+  }
+  return;
+}
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return
+ * @precondition
+ * @postcondition Forgets any frame in progress
+ * @caution
+ * @notes
+ *============================================================================*/
+void OT_CMD_reset(void) {
+  ot_cmd_data.started = 0;
+  ot_cmd_data.state   = OT_CMD_STATE_IDLE;
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Decode a TRIGGER_IN edge
+ * @param now - time of the edge in CPU cycles (wrapping)
+ * @return non-zero if the edge is the main burst of a FIRE command to one of
+ *         the slave's groups (WIRELESS_GROUP)
+ * @precondition Edges are passed in the order they occurred
+ * @postcondition
+ * @caution
+ * @notes Any other edge (a frame's pulses, a commanded pre-flash, the main
+ *        burst of other groups, or a burst of a master without commands)
+ *        returns 0
+ *============================================================================*/
+uint8_t OT_CMD_is_commanded_burst(uint32_t now) {
+  uint32_t gap = now - ot_cmd_data.last;
+  const OT_CMD_PROTOCOL_T *protocolp = ot_cmd_data.protocolp;
+  uint8_t retval = 0;
+
+  ot_cmd_data.last = now;
+  if (0 == ot_cmd_data.started) {
+    ot_cmd_data.started = 1;
+  }
+  else if (OT_CMD_STATE_BITS == ot_cmd_data.state) {
+    if (ot_cmd_near(gap, protocolp->zero)) {
+      ot_cmd_data.frame <<= 1;
+    }
+    else if (ot_cmd_near(gap, protocolp->one)) {
+      ot_cmd_data.frame = (ot_cmd_data.frame << 1) | 0x01;
+    }
+    else {
+      // Not a frame after all; this edge may be a leader
+      ot_cmd_leader(gap);
+      return 0;
+    }
+    if (OT_CMD_FRAME_BITS == ++ot_cmd_data.bits) {
+      if (0 == ot_cmd_parity(ot_cmd_data.frame)) {
+        OT_CMD_last_frame = ot_cmd_data.frame;
+        if (0xFFFF != OT_CMD_frames) ++OT_CMD_frames;
+        ot_cmd_data.state = OT_CMD_STATE_BURST;
+      }
+      else {
+        ot_cmd_data.state = OT_CMD_STATE_IDLE;
+      }
+    }
+  }
+  else if ((OT_CMD_STATE_BURST == ot_cmd_data.state) &&
+           ot_cmd_near(gap, protocolp->burst)) {
+    // The commanded burst (it can't start a frame)
+    ot_cmd_data.state = OT_CMD_STATE_IDLE;
+    retval = (OT_CMD_CMD_FIRE ==
+              (ot_cmd_data.frame >> OT_CMD_FRAME_CMD_SHIFT)) &&
+             (0 != (((ot_cmd_data.frame & OT_CMD_FRAME_GROUP_MASK) >>
+                     OT_CMD_FRAME_GROUP_SHIFT) & WIRELESS_GROUP));
+  }
+  else {
+    ot_cmd_leader(gap);
+  }
+  return retval;
+}
+/*============================================================================*/
@@ -0,0 +1,51 @@
+/*==============================================================================
+ * MODULE: Command
+ * DESCRIPTION: Prototypes exported by the wireless Command decoder
+ *============================================================================*/
+#ifndef _OT_COMMAND_H_
+#define _OT_COMMAND_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include <stdint.h>
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+// Command frame of OT_CMD_FRAME_BITS bits, sent MSB first:
+// [5:4] command, [3:1] groups commanded (A, B, C), [0] even parity
+#define OT_CMD_FRAME_BITS         6
+#define OT_CMD_FRAME_CMD_SHIFT    4
+#define OT_CMD_FRAME_GROUP_MASK   0x0E
+#define OT_CMD_FRAME_GROUP_SHIFT  1
+// Commands
+#define OT_CMD_CMD_METER          0 // The groups' metering pre-flash follows
+#define OT_CMD_CMD_FIRE           1 // The main flash follows
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+// Number of command frames decoded (saturates at 0xFFFF), and the last one.
+// Exported so they can be read over SWIM.
+extern volatile uint16_t OT_CMD_frames;
+extern volatile uint8_t  OT_CMD_last_frame;
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+void OT_CMD_reset(void);
+uint8_t OT_CMD_is_commanded_burst(uint32_t now);
+/*============================================================================*/
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _OT_COMMAND_H_ */
@@ -29,6 +29,43 @@ extern "C"
 #define TRIGGER_IN_DISABLE_MODE    GPIO_MODE_IN_FL_NO_IT
 #define TRIGGER_IN_EXTI_PORT           EXTI_PORT_GPIOB
 #define TRIGGER_IN_EXTI_SENSITIVITY    EXTI_SENSITIVITY_RISE_ONLY
+#if defined(GLITCH_FILTER)
+  // TRIGGER_IN must still be high on each of GLITCH_FILTER_SAMPLES re-samples
+  // (~3.5usec apart) after the ~6usec interrupt latency: ~20usec by default.
+  // CAUTION: low-power TTL pre-flashes can be a few tens of usec long
+  #define GLITCH_FILTER_SAMPLES          4
+#endif // GLITCH_FILTER
+#if defined(PERIODIC_REJECT)
+  // TRIGGER_IN edges on a period (e.g. 100/120Hz flicker, IR remotes) are
+  // masked once PERIODIC_LOCK_EDGES edges in a row were on it. CAUTION: must
+  // exceed that count for the longest periodic train of a real flash (the 7
+  // Nikon monitor pre-flashes: 4, see doc/FlashTraces.md)
+  #define PERIODIC_LOCK_EDGES            12
+  // An edge is on the period within period/2^PERIODIC_TOLERANCE_SHIFT plus
+  // PERIODIC_JITTER_CYCLES (for the interrupt latency)
+  #define PERIODIC_TOLERANCE_SHIFT       7
+  #define PERIODIC_JITTER_CYCLES         400
+  // The lock is dropped after PERIODIC_MISSED_PERIODS without an edge on it
+  #define PERIODIC_MISSED_PERIODS        3
+#endif // PERIODIC_REJECT
+#if defined(WIRELESS_COMMANDS)
+  // Groups of the slave (a mask: A 0x01, B 0x02, C 0x04). It only fires on
+  // the main burst of a FIRE command to one of them (see command.c).
+  #define WIRELESS_GROUP                 0x01
+  // A pulse is in its position within WIRELESS_TOLERANCE_CYCLES (for the
+  // interrupt latency)
+  #define WIRELESS_TOLERANCE_CYCLES      200
+#endif // WIRELESS_COMMANDS
+#if defined(STORM_PROTECT)
+  // STORM_EDGES interrupts on an EXTI port within STORM_WINDOW_CYCLES (CPU
+  // cycles, at most 32767) mask its pin: by default >2000 edges/sec
+  #define STORM_EDGES                    32
+  #define STORM_WINDOW_CYCLES            32000
+  // The pin is re-armed after a back-off that doubles with each storm in a
+  // row, from STORM_BACKOFF_MIN_MS up to STORM_BACKOFF_MAX_MS
+  #define STORM_BACKOFF_MIN_MS           250
+  #define STORM_BACKOFF_MAX_MS           16000
+#endif // STORM_PROTECT
 
 // TRIGGER_OUT Output Pushpull Low impedance Slow
 #define TRIGGER_OUT_PORT      GPIOA
@@ -54,6 +91,25 @@ extern "C"
   #define BUTTON_DET_EXTI_SENSITIVITY    EXTI_SENSITIVITY_FALL_ONLY
 #endif // WAKEUP_BUTTON
 
+#if defined(FAST_WAKEUP)
+  // TRIGGER_IN is armed SENSOR_SETTLE_MS after INIT powers the sensor (rather
+  // than when INIT ends)
+  #define SENSOR_SETTLE_MS    1
+#endif // FAST_WAKEUP
+
+#if defined(SNIFF_MODE)
+  // While SLEEPING, wake-up every SNIFF_PERIOD (AWU time base) and power the
+  // sensor for SNIFF_WINDOW_MS. TRIGGER_IN is armed after SNIFF_SETTLE_MS.
+  // A burst lands in the armed 16msec with a chance of 16/256: pre-flashes
+  // (62-80msec apart, see doc/traces) are more than a window apart, so a
+  // 5-burst red-eye sequence wakes us ~1 time in 4. A train of bursts
+  // at most 16msec apart for at least SNIFF_PERIOD (e.g. a modelling flash)
+  // always does. The sensor is powered ~7% of the time.
+  #define SNIFF_PERIOD        AWU_TIMEBASE_256MS
+  #define SNIFF_WINDOW_MS     17
+  #define SNIFF_SETTLE_MS     1
+#endif // SNIFF_MODE
+
 // DIP[2:0] switches to set number of pre-flash bursts to ignore (0-6)
 #define DIP0_PORT    GPIOD
 #define DIP0_PIN     GPIO_PIN_2
@@ -78,6 +134,127 @@ extern "C"
 #define DELAY_SENSE_MODE    GPIO_MODE_IN_FL_NO_IT
 #define DELAY_SENSE_ADC_CHANNEL       ADC1_CHANNEL_1
 #define DELAY_SENSE_SCHMTRIG_CHANNEL  ADC1_SCHMITTTRIG_CHANNEL1
+
+#if defined(ISR_PROFILE_PIN)
+  // Spare pin, high while a profiled ISR runs (for a logic analyzer)
+  #define PROFILE_PIN_PORT    GPIOE
+  #define PROFILE_PIN_PIN     GPIO_PIN_5
+#endif // ISR_PROFILE_PIN
+
+#if defined(BATTERY_MONITOR)
+  // Shunt reference (fed from SENSOR_ENABLE) used to measure Vdd
+  #define VREF_SENSE_PORT    GPIOB
+  #define VREF_SENSE_PIN     GPIO_PIN_2
+  #define VREF_SENSE_MODE    GPIO_MODE_IN_FL_NO_IT
+  #define VREF_SENSE_ADC_CHANNEL       ADC1_CHANNEL_2
+  #define VREF_SENSE_SCHMTRIG_CHANNEL  ADC1_SCHMITTTRIG_CHANNEL2
+  #define VREF_SENSE_MV      1225
+#endif // BATTERY_MONITOR
+
+#if defined(ADC_FLASH_DETECT) || defined(BURST_CAPTURE)
+  // Sensor output (ahead of its comparator), sampled by ADC1
+  #define FLASH_SENSE_PORT    GPIOB
+  #define FLASH_SENSE_PIN     GPIO_PIN_0
+  #define FLASH_SENSE_MODE    GPIO_MODE_IN_FL_NO_IT
+  #define FLASH_SENSE_ADC_CHANNEL       ADC1_CHANNEL_0
+  #define FLASH_SENSE_SCHMTRIG_CHANNEL  ADC1_SCHMITTTRIG_CHANNEL0
+#endif // ADC_FLASH_DETECT || BURST_CAPTURE
+#if defined(ADC_FLASH_DETECT)
+  // Flash bursts are detected on FLASH_SENSE (instead of TRIGGER_IN): a rise
+  // of ADC_FLASH_MARGIN counts (of 1023 at Vdd) above the ambient level; it
+  // ends below half that
+  #define ADC_FLASH_MARGIN    64
+  // Time constant (in 1msec READY ticks, as a power of 2) of the ambient
+  // level. At most 6.
+  #define ADC_FLASH_TRACK_SHIFT  4
+#endif // ADC_FLASH_DETECT
+#if defined(LIGHTNING_MODE)
+  // Instead, a burst is a rise of LIGHTNING_SLOPE counts over the level at
+  // the last 1msec tick, i.e. faster than LIGHTNING_SLOPE counts/msec. Must
+  // exceed the steepest ambient change, e.g. 2*pi*f*amplitude for flicker
+  // (31 counts/msec for 50 counts at 100Hz). See doc/Waveforms.md.
+  #define LIGHTNING_SLOPE     48
+#endif // LIGHTNING_MODE
+#if defined(BURST_CAPTURE)
+  // FLASH_SENSE is sampled 10 times (the ADC1 data buffer) from each
+  // TRIGGER_IN edge, one sample every 14 ADC clocks: 28usec and a 280usec
+  // window at fMASTER/4. The window delays the trigger.
+  #define BURST_CAPTURE_PRESCALER  ADC1_PRESSEL_FCPU_D4
+  // CPU cycles per sample at BURST_CAPTURE_PRESCALER (14 ADC clocks)
+  #define BURST_CAPTURE_SAMPLE_CYCLES  56
+  // A burst above half its peak for BURST_MAIN_DURATION samples (224usec;
+  // pre-flashes last ~40-150usec) with at least BURST_MAIN_ENERGY (sum of
+  // the samples above the lowest) is a main burst, whatever the count of
+  // pre-flashes so far
+  #define BURST_MAIN_DURATION      8
+  #define BURST_MAIN_ENERGY        2000
+#endif // BURST_CAPTURE
+#if defined(QUENCH_OUT)
+  // Quench signal of the slave flash, driven by TIM1_CH2 (active high)
+  #define QUENCH_OUT_PORT     GPIOC
+  #define QUENCH_OUT_PIN      GPIO_PIN_2
+  // The slave is quenched after QUENCH_RATIO_16THS/16 of the master's burst
+  // duration (as measured by BURST_CAPTURE), from the trigger. A burst that
+  // outlasts the capture isn't quenched (full power).
+  #define QUENCH_RATIO_16THS  16
+  // The part of the burst before the capture's first sample (the TRIGGER_IN
+  // ISR path, see ISR_PROFILE), in CPU cycles
+  #define QUENCH_LEAD_CYCLES  240
+  // A capture whose highest sample is below QUENCH_MIN_LEVEL (ADC counts)
+  // missed the burst: it was over within QUENCH_LEAD_CYCLES
+  #define QUENCH_MIN_LEVEL    64
+#endif // QUENCH_OUT
+#if defined(OPTICAL_CONFIG)
+  // Holding the button for OPTICAL_CONFIG_HOLD_MS (on a wake-up or in READY)
+  // enters CONFIG, where the settings are programmed by firing the master
+  // manually (see doc/OpticalConfig.md)
+  #define OPTICAL_CONFIG_HOLD_MS        2000
+  // Flashes less than OPTICAL_CONFIG_GROUP_MS apart are a group; the sequence
+  // ends OPTICAL_CONFIG_END_MS after its last flash
+  #define OPTICAL_CONFIG_GROUP_MS       1500
+  #define OPTICAL_CONFIG_END_MS         4000
+  // Per flash of the value group: the delay (DELAY_SENSE mode) and the gap
+  // between the pulses of a multi-pulse sequence
+  #define OPTICAL_CONFIG_DELAY_STEP_MS  10
+  #define OPTICAL_CONFIG_PULSE_STEP_MS  20
+  #define OPTICAL_CONFIG_MAX_PULSES     8
+#endif // OPTICAL_CONFIG
+#if defined(EEPROM_STORE)
+  // Records (32 bytes each) in the wear-leveled ring at the start of the data
+  // EEPROM; each slot is written once every EEPROM_RING_SLOTS sleeps at most
+  // (entries into SLEEPING from READY, not the returns from a sniff)
+  #define EEPROM_RING_SLOTS             16
+#endif // EEPROM_STORE
+#if defined(EVENT_LOG)
+  // Entries (4 bytes each) of the event log, after the ring; the ring and
+  // the log must fit in the 1024 bytes of data EEPROM
+  #define EVENT_LOG_ENTRIES             128
+  // Events staged in RAM between two writes (while SLEEPING)
+  #define EVENT_LOG_STAGED              8
+#endif // EVENT_LOG
+#if defined(SELF_TEST)
+  // Loopback test of the trigger latency at start-up (see OT_ST_run()), with
+  // jumpers from SELF_TEST_PULSE to TRIGGER_IN and from TRIGGER_OUT to
+  // SELF_TEST_CAPTURE (TIM1_CH3, pulled up as the slave's sync input would).
+  // PC3 is also the touch key's TS_GND: see pinout.md before fitting it.
+  #define SELF_TEST_PULSE_PORT          GPIOD
+  #define SELF_TEST_PULSE_PIN           GPIO_PIN_5
+  #define SELF_TEST_CAPTURE_PORT        GPIOC
+  #define SELF_TEST_CAPTURE_PIN         GPIO_PIN_3
+  // Synthetic flash bursts, each of SELF_TEST_PULSE_US (a short pre-flash)
+  #define SELF_TEST_TRIALS              16
+  #define SELF_TEST_PULSE_US            100
+#endif // SELF_TEST
+#if defined(HSI_CALIBRATION)
+  // The timer periods are scaled to the HSI as measured against the LSI at
+  // start-up and in the INIT after each wake-up (not after a trigger). The LSI
+  // is only specified within +/-12.5% of 128kHz: set HSI_CAL_LSI_HZ to this
+  // unit's, i.e. 128000 * 2000000 / OT_TIMER_hsi_hz as read over SWIM at room
+  // temperature (where the factory-trimmed HSI is within 1%) with 128000
+  #define HSI_CAL_LSI_HZ                128000
+  // Windows of ~500usec (interrupts disabled) per measurement: 1 to 8
+  #define HSI_CAL_WINDOWS               8
+#endif // HSI_CALIBRATION
 /*==============================================================================
  * MACROS
  *============================================================================*/
@@ -0,0 +1,529 @@
+/*==============================================================================
+ * MODULE: EEPROM (EE)
+ * DESCRIPTION: Settings and lifetime counters kept in the data EEPROM, as a
+ * wear-leveled ring of EEPROM_RING_SLOTS records.
+ *
+ * Each save writes the next slot of the ring (wrapping around), so every slot
+ * wears at 1/EEPROM_RING_SLOTS of the rate of saves. A record carries a
+ * sequence number: the slots written in the current lap (from slot 0) hold
+ * consecutive numbers following on from slot 0's, the others those of the
+ * lap before. The newest record is the last slot of the current lap, found by
+ * a binary search (log2(EEPROM_RING_SLOTS) reads) at boot.
+ *
+ * A record is written a word (4 bytes) at a time, from the end-of-programming
+ * interrupt, so a save never waits for the EEPROM. The word with the sequence
+ * number is written last: a record cut short (by a reset, or by
+ * OT_EE_hold()) isn't part of the ring, and the previous one stays the newest.
+ *
+ * With EVENT_LOG, the EEPROM after the ring holds a log of the last
+ * EVENT_LOG_ENTRIES events, one word each, found at boot in the same way.
+ * Events are staged in RAM by OT_EE_log() and written after the record.
+ *============================================================================*/
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include "config.h"
+#include "eeprom.h"
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+#define OT_EE_RING_ADDRESS    FLASH_DATA_START_PHYSICAL_ADDRESS
+#define OT_EE_RECORD_SIZE     32
+#define OT_EE_RECORD_WORDS    (OT_EE_RECORD_SIZE / 4)
+// Tells a record from erased (0x00) EEPROM. To be changed with the layout of
+// OT_EE_RECORD_T (or of the settings stored in it).
+#define OT_EE_MAGIC           0xA5
+
+#if defined(EVENT_LOG)
+#define OT_EE_LOG_ADDRESS \
+  (OT_EE_RING_ADDRESS + ((uint16_t)EEPROM_RING_SLOTS * OT_EE_RECORD_SIZE))
+#define OT_EE_ENTRY_SIZE      4
+#endif // EVENT_LOG
+
+// State of the writes
+#define OT_EE_STATE_IDLE      0 // Nothing being written
+#define OT_EE_STATE_RECORD    1 // Writing the record
+#define OT_EE_STATE_HELD      2 // Record cut short (written again by a commit)
+#define OT_EE_STATE_EVENT     3 // Writing the oldest staged event (EVENT_LOG)
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+#define OT_EE_SLOT_ADDRESS(slot) \
+  (OT_EE_RING_ADDRESS + ((uint16_t)(slot) * OT_EE_RECORD_SIZE))
+#if defined(EVENT_LOG)
+#define OT_EE_ENTRY_ADDRESS(entry) \
+  (OT_EE_LOG_ADDRESS + ((uint16_t)(entry) * OT_EE_ENTRY_SIZE))
+#endif // EVENT_LOG
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+typedef union OT_EE_RECORD_U {
+  struct {
+    OT_EE_COUNTERS_T counters;
+    uint8_t settings[OT_EE_SETTINGS_SIZE];
+    // The last word, written last
+    uint8_t magic;
+    uint8_t seq;    // Sequence number
+    uint8_t sum1;   // Fletcher checksum (modulo 256) of the bytes above
+    uint8_t sum2;
+  } r;
+  uint32_t words[OT_EE_RECORD_WORDS];
+  uint8_t  bytes[OT_EE_RECORD_SIZE];
+} OT_EE_RECORD_T;
+
+#if defined(EVENT_LOG)
+// An event staged in RAM
+typedef struct OT_EE_STAGED_S {
+  uint8_t event;  // OT_EE_EVENT_T
+  uint8_t arg;
+} OT_EE_STAGED_T;
+
+// An entry of the log (written in one go)
+typedef union OT_EE_ENTRY_U {
+  struct {
+    uint8_t seq;    // Sequence number
+    uint8_t event;  // OT_EE_EVENT_T
+    uint8_t arg;
+    uint8_t check;  // seq ^ event ^ arg ^ OT_EE_MAGIC
+  } e;
+  uint32_t word;
+} OT_EE_ENTRY_T;
+#endif // EVENT_LOG
+
+typedef struct OT_EE_DATA_S {
+  OT_EE_RECORD_T record;        // Being (or last) written
+  uint8_t settings[OT_EE_SETTINGS_SIZE]; // Saved by the next commit
+  uint8_t loaded;               // Non-zero if a record was loaded at boot
+  uint8_t head;                 // Slot of the next record
+  uint8_t seq;                  // Its sequence number
+  uint8_t word;                 // Word of the record being written
+  uint8_t volatile state;
+  uint8_t volatile hold;        // Stop after the word being programmed
+#if defined(EVENT_LOG)
+  OT_EE_STAGED_T staged[EVENT_LOG_STAGED]; // Events not written yet
+  uint8_t staged_first;         // Oldest of them
+  uint8_t volatile staged_count;
+  uint8_t log_head;             // Entry of the next event
+  uint8_t log_seq;              // Its sequence number
+#endif // EVENT_LOG
+} OT_EE_DATA_T;
+/*==============================================================================
+ * LOCAL FUNCTION PROTOTYPES
+ *============================================================================*/
+static uint8_t ot_ee_find_head(uint32_t seq_address, uint8_t stride,
+                               uint8_t count, uint8_t *seqp);
+static uint16_t ot_ee_checksum(const OT_EE_RECORD_T *recordp);
+static uint8_t ot_ee_read(uint8_t slot);
+static uint8_t ot_ee_unchanged(void);
+static void ot_ee_start(void);
+static void ot_ee_program_word(void);
+#if defined(EVENT_LOG)
+static uint8_t ot_ee_reset_cause(void);
+static uint8_t ot_ee_program_event(void);
+#endif // EVENT_LOG
+/*==============================================================================
+ * LOCAL VARIABLES
+ *============================================================================*/
+static OT_EE_DATA_T ot_ee_data;
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+volatile OT_EE_COUNTERS_T OT_EE_counters;
+#if defined(EVENT_LOG)
+volatile uint16_t OT_EE_events_dropped = 0;
+#endif // EVENT_LOG
+/*==============================================================================
+ * LOCAL FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION: Binary search of a ring for the end of the current lap
+ * @param seq_address - address of the sequence number of entry 0
+ * @param stride - size of an entry
+ * @param count - entries in the ring
+ * @param seqp - where to return the sequence number of the next entry
+ * @return the entry after the newest (1..count)
+ * @precondition count < 256
+ * @postcondition
+ * @caution
+ * @notes Entries 1..n of the current lap have the sequence numbers of entry 0
+ *        plus 1..n; the others (erased, or of the previous lap) don't
+ *============================================================================*/
+static uint8_t ot_ee_find_head(uint32_t seq_address, uint8_t stride,
+                               uint8_t count, uint8_t *seqp) {
+  uint8_t seq0 = FLASH_ReadByte(seq_address);
+  uint8_t lo = 1;
+  uint8_t hi = count;
+  while (lo < hi) {
+    uint8_t mid = (lo + hi) >> 1;
+    uint8_t seq = FLASH_ReadByte(seq_address + ((uint16_t)mid * stride));
+    if ((uint8_t)(seq - seq0) == mid) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  *seqp = seq0 + lo;
+  return lo;
+}
+/*==============================================================================
+ * DESCRIPTION:
+ * @param recordp - the record
+ * @return sum2 << 8 | sum1 over the bytes of the record before sum1
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static uint16_t ot_ee_checksum(const OT_EE_RECORD_T *recordp) {
+  uint8_t sum1 = 0;
+  uint8_t sum2 = 0;
+  uint8_t i;
+  for (i = 0; i < (OT_EE_RECORD_SIZE - 2); ++i) {
+    sum1 += recordp->bytes[i];
+    sum2 += sum1;
+  }
+  return ((uint16_t)sum2 << 8) | sum1;
+}
+/*==============================================================================
+ * DESCRIPTION: Read a slot of the ring into ot_ee_data.record
+ * @param slot - the slot
+ * @return non-zero if it holds a good record
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static uint8_t ot_ee_read(uint8_t slot) {
+  OT_EE_RECORD_T *recordp = &ot_ee_data.record;
+  uint32_t address = OT_EE_SLOT_ADDRESS(slot);
+  uint16_t sum;
+  uint8_t i;
+  for (i = 0; i < OT_EE_RECORD_SIZE; ++i) {
+    recordp->bytes[i] = FLASH_ReadByte(address + i);
+  }
+  sum = ot_ee_checksum(recordp);
+  return (OT_EE_MAGIC == recordp->r.magic) &&
+         ((uint8_t)sum == recordp->r.sum1) &&
+         ((uint8_t)(sum >> 8) == recordp->r.sum2);
+}
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return non-zero if the counters and settings are those of the last record
+ *         written
+ * @precondition ot_ee_data.record is the last record written
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static uint8_t ot_ee_unchanged(void) {
+  const volatile uint8_t *countersp = (const volatile uint8_t *)&OT_EE_counters;
+  uint8_t i;
+  for (i = 0; i < sizeof(OT_EE_COUNTERS_T); ++i) {
+    if (countersp[i] != ot_ee_data.record.bytes[i]) return 0;
+  }
+  for (i = 0; i < OT_EE_SETTINGS_SIZE; ++i) {
+    if (ot_ee_data.settings[i] != ot_ee_data.record.r.settings[i]) return 0;
+  }
+  return 1;
+}
+/*==============================================================================
+ * DESCRIPTION: Unlock the data EEPROM for the writes to come
+ * @param
+ * @return
+ * @precondition
+ * @postcondition The EEPROM interrupt is enabled
+ * @caution
+ * @notes Locked again by ot_ee_isr() once nothing is left to write
+ *============================================================================*/
+static void ot_ee_start(void) {
+  FLASH_Unlock(FLASH_MEMTYPE_DATA);
+  FLASH_ITConfig(ENABLE);
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Start programming the next word of the record
+ * @param
+ * @return
+ * @precondition The data EEPROM is unlocked
+ * @postcondition
+ * @caution Without read-while-write (STM8S903), the CPU stalls until the word
+ *          is programmed (up to ~6msec)
+ * @notes The end of programming raises the EEPROM interrupt
+ *============================================================================*/
+static void ot_ee_program_word(void) {
+  FLASH_ProgramWord(OT_EE_SLOT_ADDRESS(ot_ee_data.head) +
+                    ((uint16_t)ot_ee_data.word << 2),
+                    ot_ee_data.record.words[ot_ee_data.word]);
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Read (and clear) the cause of the last reset
+ * @param
+ * @return the RST_SR flags (RST_FLAG_*); 0 after a power-on or brown-out
+ *         reset, which the STM8S doesn't tell apart
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+#if defined(EVENT_LOG)
+static uint8_t ot_ee_reset_cause(void) {
+  uint8_t flags = 0;
+  uint8_t flag;
+  for (flag = RST_FLAG_WWDGF; flag <= RST_FLAG_EMCF; flag <<= 1) {
+    if (RESET != RST_GetFlagStatus((RST_Flag_TypeDef)flag)) {
+      flags |= flag;
+      RST_ClearFlag((RST_Flag_TypeDef)flag);
+    }
+  }
+  return flags;
+}
+#endif // EVENT_LOG
+/*==============================================================================
+ * DESCRIPTION: Start programming the oldest staged event, if any
+ * @param
+ * @return non-zero if started
+ * @precondition The data EEPROM is unlocked
+ * @postcondition
+ * @caution As ot_ee_program_word()
+ * @notes The event stays staged until it is written
+ *============================================================================*/
+#if defined(EVENT_LOG)
+static uint8_t ot_ee_program_event(void) {
+  OT_EE_ENTRY_T entry;
+  const OT_EE_STAGED_T *stagedp = &ot_ee_data.staged[ot_ee_data.staged_first];
+  if (0 == ot_ee_data.staged_count) return 0;
+  entry.e.seq   = ot_ee_data.log_seq;
+  entry.e.event = stagedp->event;
+  entry.e.arg   = stagedp->arg;
+  entry.e.check = entry.e.seq ^ entry.e.event ^ entry.e.arg ^ OT_EE_MAGIC;
+  ot_ee_data.state = OT_EE_STATE_EVENT;
+  FLASH_ProgramWord(OT_EE_ENTRY_ADDRESS(ot_ee_data.log_head), entry.word);
+  return 1;
+}
+#endif // EVENT_LOG
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION: Load the newest good record
+ * @param
+ * @return non-zero if there was one; otherwise the counters start from 0
+ * @precondition
+ * @postcondition With EVENT_LOG, the cause of the reset is staged
+ * @caution
+ * @notes Reads log2(EEPROM_RING_SLOTS) sequence numbers and at most 2 records,
+ *        whatever the state of the ring. The record before the newest is
+ *        used if the newest is corrupt.
+ *============================================================================*/
+uint8_t OT_EE_init(void) {
+  uint8_t slot;
+  uint8_t i;
+
+  slot = ot_ee_find_head(OT_EE_SLOT_ADDRESS(0) + (OT_EE_RECORD_SIZE - 3),
+                         OT_EE_RECORD_SIZE, EEPROM_RING_SLOTS, &ot_ee_data.seq);
+  ot_ee_data.head = (EEPROM_RING_SLOTS == slot) ? 0 : slot;
+  ot_ee_data.state = OT_EE_STATE_IDLE;
+#if defined(EVENT_LOG)
+  i = ot_ee_find_head(OT_EE_ENTRY_ADDRESS(0), OT_EE_ENTRY_SIZE,
+                      EVENT_LOG_ENTRIES, &ot_ee_data.log_seq);
+  ot_ee_data.log_head = (EVENT_LOG_ENTRIES == i) ? 0 : i;
+  OT_EE_log(OT_EE_EVENT_RESET, ot_ee_reset_cause());
+#endif // EVENT_LOG
+
+  slot = slot - 1;
+  ot_ee_data.loaded = ot_ee_read(slot);
+  if (0 == ot_ee_data.loaded) {
+    ot_ee_data.loaded = ot_ee_read((0 == slot) ? (EEPROM_RING_SLOTS - 1) :
+                                                 (slot - 1));
+  }
+  if (0 == ot_ee_data.loaded) {
+    for (i = 0; i < OT_EE_RECORD_SIZE; ++i) ot_ee_data.record.bytes[i] = 0;
+  }
+  OT_EE_counters = ot_ee_data.record.r.counters;
+  for (i = 0; i < OT_EE_SETTINGS_SIZE; ++i) {
+    ot_ee_data.settings[i] = ot_ee_data.record.r.settings[i];
+  }
+  return ot_ee_data.loaded;
+}
+/*==============================================================================
+ * DESCRIPTION: Get the settings loaded at boot
+ * @param settingsp - where to copy them
+ * @param size - their size
+ * @return non-zero if copied, i.e. a record was loaded
+ * @precondition OT_EE_init() was called
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+uint8_t OT_EE_load_settings(void *settingsp, uint8_t size) {
+  uint8_t *dstp = (uint8_t *)settingsp;
+  uint8_t i;
+  if ((0 == ot_ee_data.loaded) || (size > OT_EE_SETTINGS_SIZE)) return 0;
+  for (i = 0; i < size; ++i) dstp[i] = ot_ee_data.settings[i];
+  return 1;
+}
+/*==============================================================================
+ * DESCRIPTION: Stage the settings for the next OT_EE_commit()
+ * @param settingsp - the settings
+ * @param size - their size (at most OT_EE_SETTINGS_SIZE)
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+void OT_EE_save_settings(const void *settingsp, uint8_t size) {
+  const uint8_t *srcp = (const uint8_t *)settingsp;
+  uint8_t i;
+  if (size > OT_EE_SETTINGS_SIZE) return;
+  for (i = 0; i < size; ++i) ot_ee_data.settings[i] = srcp[i];
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Start writing the counters and settings to the next slot,
+ * then the staged events (EVENT_LOG)
+ * @param
+ * @return
+ * @precondition
+ * @postcondition OT_EE_busy() until everything is written
+ * @caution To be called only when nothing time-critical follows (see
+ *          ot_ee_program_word())
+ * @notes The record is skipped if nothing changed since the last one. A write
+ *        in progress (but held) just carries on.
+ *============================================================================*/
+void OT_EE_commit(void) {
+  uint16_t sum;
+  uint8_t i;
+  ot_ee_data.hold = 0;
+  if (OT_EE_busy()) return;
+  if ((OT_EE_STATE_IDLE == ot_ee_data.state) && ot_ee_unchanged()) {
+#if defined(EVENT_LOG)
+    if (0 != ot_ee_data.staged_count) {
+      ot_ee_start();
+      (void)ot_ee_program_event();
+    }
+#endif // EVENT_LOG
+    return;
+  }
+
+  ot_ee_data.record.r.counters = OT_EE_counters;
+  for (i = 0; i < OT_EE_SETTINGS_SIZE; ++i) {
+    ot_ee_data.record.r.settings[i] = ot_ee_data.settings[i];
+  }
+  ot_ee_data.record.r.magic = OT_EE_MAGIC;
+  ot_ee_data.record.r.seq   = ot_ee_data.seq;
+  sum = ot_ee_checksum(&ot_ee_data.record);
+  ot_ee_data.record.r.sum1  = (uint8_t)sum;
+  ot_ee_data.record.r.sum2  = (uint8_t)(sum >> 8);
+
+  ot_ee_data.word  = 0;
+  ot_ee_data.state = OT_EE_STATE_RECORD;
+  ot_ee_start();
+  ot_ee_program_word();
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Stop writing after the word being programmed
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes A record cut short is written afresh (to the same slot) by the next
+ *        commit
+ *============================================================================*/
+void OT_EE_hold(void) {
+  ot_ee_data.hold = 1;
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return non-zero while a word is being written
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+uint8_t OT_EE_busy(void) {
+  return (OT_EE_STATE_RECORD == ot_ee_data.state) ||
+         (OT_EE_STATE_EVENT == ot_ee_data.state);
+}
+/*==============================================================================
+ * DESCRIPTION: Stage an event for the log
+ * @param event - the event
+ * @param arg - its argument (see OT_EE_EVENT_T)
+ * @return
+ * @precondition Called from an ISR (or with interrupts disabled)
+ * @postcondition
+ * @caution
+ * @notes Written by the next OT_EE_commit(). Dropped (and counted in
+ *        OT_EE_events_dropped) if EVENT_LOG_STAGED events are already staged.
+ *============================================================================*/
+#if defined(EVENT_LOG)
+void OT_EE_log(OT_EE_EVENT_T event, uint8_t arg) {
+  uint8_t i;
+  if (EVENT_LOG_STAGED == ot_ee_data.staged_count) {
+    if (0xFFFF != OT_EE_events_dropped) ++OT_EE_events_dropped;
+    return;
+  }
+  i = ot_ee_data.staged_first + ot_ee_data.staged_count;
+  if (i >= EVENT_LOG_STAGED) i -= EVENT_LOG_STAGED;
+  ot_ee_data.staged[i].event = (uint8_t)event;
+  ot_ee_data.staged[i].arg   = arg;
+  ++ot_ee_data.staged_count;
+  return;
+}
+#endif // EVENT_LOG
+/*==============================================================================
+ * DESCRIPTION: A word was programmed; program the next one
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+INTERRUPT_HANDLER(ot_ee_isr, ITC_IRQ_EEPROM_EEC) {
+  // Reading the status register clears EOP
+  (void)FLASH_GetFlagStatus(FLASH_FLAG_EOP);
+  if (OT_EE_STATE_RECORD == ot_ee_data.state) {
+    if (++ot_ee_data.word < OT_EE_RECORD_WORDS) {
+      if (0 == ot_ee_data.hold) {
+        ot_ee_program_word();
+        return;
+      }
+      ot_ee_data.state = OT_EE_STATE_HELD;
+    }
+    else {
+      // The record is complete (even if held during its last word): the next
+      // goes to the next slot
+      ot_ee_data.state = OT_EE_STATE_IDLE;
+      ++ot_ee_data.seq;
+      if (EEPROM_RING_SLOTS == ++ot_ee_data.head) ot_ee_data.head = 0;
+    }
+  }
+#if defined(EVENT_LOG)
+  else if (OT_EE_STATE_EVENT == ot_ee_data.state) {
+    // The oldest staged event is written
+    ot_ee_data.state = OT_EE_STATE_IDLE;
+    if (EVENT_LOG_STAGED == ++ot_ee_data.staged_first) {
+      ot_ee_data.staged_first = 0;
+    }
+    --ot_ee_data.staged_count;
+    ++ot_ee_data.log_seq;
+    if (EVENT_LOG_ENTRIES == ++ot_ee_data.log_head) ot_ee_data.log_head = 0;
+  }
+  if ((OT_EE_STATE_IDLE == ot_ee_data.state) && (0 == ot_ee_data.hold) &&
+      ot_ee_program_event()) {
+    return;
+  }
+#endif // EVENT_LOG
+  FLASH_ITConfig(DISABLE);
+  FLASH_Lock(FLASH_MEMTYPE_DATA);
+  return;
+}
+/*============================================================================*/
@@ -0,0 +1,76 @@
+/*==============================================================================
+ * MODULE: EEPROM (EE)
+ * DESCRIPTION: Prototypes exported by the EEPROM module
+ *============================================================================*/
+#ifndef _OT_EE_H_
+#define _OT_EE_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include <stm8s.h>
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+#define OT_EE_SETTINGS_SIZE   12 // Bytes of settings a record holds
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+// Count an event towards its lifetime counter (RAM only; saved by the next
+// OT_EE_commit())
+#define OT_EE_COUNT(counter)  (++OT_EE_counters.counter)
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+// Lifetime counters (since the EEPROM was first written)
+typedef struct OT_EE_COUNTERS_S {
+  uint32_t bursts;    // Flash bursts seen
+  uint32_t triggers;  // Sequences fired on (not their OPTICAL_CONFIG pulses)
+  uint32_t glitches;  // TRIGGER_IN pulses dropped by GLITCH_FILTER
+  uint32_t sleeps;    // Entries into SLEEPING from READY
+} OT_EE_COUNTERS_T;
+
+#if defined(EVENT_LOG)
+// Events of the log (see tools/eventlog.py)
+typedef enum OT_EE_EVENT_E {
+  OT_EE_EVENT_RESET = 1,  // arg: RST_SR flags (0: power-on or brown-out)
+  OT_EE_EVENT_TRIGGER,    // arg: bursts seen in the sequence
+  OT_EE_EVENT_MISMATCH,   // arg: phase (high nibble) and bursts in it (low
+                          //      nibble) of a burst that didn't fit the profile
+  OT_EE_EVENT_STORM       // arg: state (OT_SM_STATE_T) the storm hit
+} OT_EE_EVENT_T;
+#endif // EVENT_LOG
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+// Exported so it can be read over SWIM
+extern volatile OT_EE_COUNTERS_T OT_EE_counters;
+#if defined(EVENT_LOG)
+extern volatile uint16_t OT_EE_events_dropped;
+#endif // EVENT_LOG
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+uint8_t OT_EE_init(void);
+uint8_t OT_EE_load_settings(void *settingsp, uint8_t size);
+void OT_EE_save_settings(const void *settingsp, uint8_t size);
+void OT_EE_commit(void);
+void OT_EE_hold(void);
+uint8_t OT_EE_busy(void);
+#if defined(EVENT_LOG)
+void OT_EE_log(OT_EE_EVENT_T event, uint8_t arg);
+#endif // EVENT_LOG
+#if defined(_SDCC_)
+  // The SDCC compiler requires the main module to know interrupt prototypes
+  INTERRUPT_HANDLER(ot_ee_isr, ITC_IRQ_EEPROM_EEC);
+#endif // _SDCC_
+/*============================================================================*/
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _OT_EE_H_ */
@@ -7,29 +7,141 @@
  *============================================================================*/
 #include "main.h"
 #include "gpio.h"
+#include "profile.h"
+#include "timer.h"
+#include "periodic.h"
+#if defined(EEPROM_STORE)
+  #include "eeprom.h"
+#endif // EEPROM_STORE
 /*==============================================================================
  * CONSTANTS
  *============================================================================*/
+#if defined(STORM_PROTECT)
+// Index of an EXTI port in ot_gpio_storm[]
+#define OT_GPIO_STORM_PORTB    0
+#define OT_GPIO_STORM_PORTC    1
+#define OT_GPIO_STORM_PORTS    2
+#endif // STORM_PROTECT
 /*==============================================================================
  * MACROS
  *============================================================================*/
+// Filters that may drop a TRIGGER_IN edge before it reaches the owner
+#if defined(GLITCH_FILTER) || defined(PERIODIC_REJECT)
+  #define OT_GPIO_TRIGGER_IN_FILTER
+#endif
 /*==============================================================================
  * TYPEDEFs and STRUCTs
  *============================================================================*/
+#if defined(STORM_PROTECT)
+// Edge rate of an EXTI port
+typedef struct OT_GPIO_STORM_S {
+  uint16_t window_start;  // Cycle counter at the first edge of the window
+  uint8_t  edges;         // Edges since window_start
+} OT_GPIO_STORM_T;
+#endif // STORM_PROTECT
 /*==============================================================================
  * LOCAL VARIABLES
  *============================================================================*/
 static OT_GPIO_CB_T *ot_gpio_cb    = (void*)0;
 static void         *ot_gpio_cbarg = (void*)0;
+#if defined(STORM_PROTECT)
+static OT_GPIO_STORM_T ot_gpio_storm[OT_GPIO_STORM_PORTS];
+#endif // STORM_PROTECT
 /*==============================================================================
  * GLOBAL (extern) VARIABLES
  *============================================================================*/
+#if defined(GLITCH_FILTER)
+volatile uint16_t OT_GPIO_glitches = 0;
+#endif // GLITCH_FILTER
+#if defined(STORM_PROTECT)
+volatile uint16_t OT_GPIO_storms = 0;
+#endif // STORM_PROTECT
 /*==============================================================================
  * LOCAL FUNCTION PROTOTYPES
  *============================================================================*/
+#if defined(GLITCH_FILTER)
+static uint8_t ot_gpio_trigger_in_glitch(void);
+#endif // GLITCH_FILTER
+#if defined(OT_GPIO_TRIGGER_IN_FILTER)
+static uint8_t ot_gpio_trigger_in_filter(void);
+#endif // OT_GPIO_TRIGGER_IN_FILTER
+#if defined(STORM_PROTECT)
+static uint8_t ot_gpio_storm_check(OT_GPIO_STORM_T *stormp);
+#endif // STORM_PROTECT
 /*==============================================================================
  * LOCAL FUNCTIONS
  *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION: Re-sample TRIGGER_IN after its rising edge
+ * @param
+ * @return non-zero if TRIGGER_IN went low again within GLITCH_FILTER_SAMPLES
+ *         samples, i.e. the pulse was too short to be a flash burst
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes The interrupt latency adds to the minimum width (see config.h)
+ *============================================================================*/
+#if defined(GLITCH_FILTER)
+static uint8_t ot_gpio_trigger_in_glitch(void) {
+  uint8_t samples = GLITCH_FILTER_SAMPLES;
+  do {
+    if (0 == OT_PIN_READ(TRIGGER_IN_PORT, TRIGGER_IN_PIN)) return 1;
+  } while (0 != --samples);
+  return 0;
+}
+#endif // GLITCH_FILTER
+/*==============================================================================
+ * DESCRIPTION: Run the enabled filters on a TRIGGER_IN edge
+ * @param
+ * @return non-zero if the edge is to be dropped
+ * @precondition Called from the TRIGGER_IN ISR
+ * @postcondition
+ * @caution
+ * @notes A glitch isn't passed to the periodic detector: it would break up
+ *        the train the detector is following
+ *============================================================================*/
+#if defined(OT_GPIO_TRIGGER_IN_FILTER)
+static uint8_t ot_gpio_trigger_in_filter(void) {
+#if defined(GLITCH_FILTER)
+  if (ot_gpio_trigger_in_glitch()) {
+    if (0xFFFF != OT_GPIO_glitches) ++OT_GPIO_glitches;
+#if defined(EEPROM_STORE)
+    OT_EE_COUNT(glitches);
+#endif // EEPROM_STORE
+    return 1;
+  }
+#endif // GLITCH_FILTER
+#if defined(PERIODIC_REJECT)
+  if (OT_PERIODIC_is_interference(OT_TIMER_cycles32())) return 1;
+#endif // PERIODIC_REJECT
+  return 0;
+}
+#endif // OT_GPIO_TRIGGER_IN_FILTER
+/*==============================================================================
+ * DESCRIPTION: Count an edge towards the edge rate of its port
+ * @param stormp - the port's edge rate
+ * @return non-zero if this is the STORM_EDGES'th edge within
+ *         STORM_WINDOW_CYCLES, i.e. an interrupt storm
+ * @precondition
+ * @postcondition A new window starts after a storm
+ * @caution Edges exactly a multiple of a TIM1 wrap (32.8msec) apart look
+ *          close together; a storm needs STORM_EDGES of them in a row
+ * @notes Runs before any filter: glitches cost an interrupt as well
+ *============================================================================*/
+#if defined(STORM_PROTECT)
+static uint8_t ot_gpio_storm_check(OT_GPIO_STORM_T *stormp) {
+  uint16_t now = OT_TIMER_cycles();
+  if ((uint16_t)(now - stormp->window_start) > STORM_WINDOW_CYCLES) {
+    stormp->window_start = now;
+    stormp->edges = 0;
+  }
+  if (++stormp->edges < STORM_EDGES) return 0;
+  stormp->edges = 0;
+  stormp->window_start = now;
+  if (0xFFFF != OT_GPIO_storms) ++OT_GPIO_storms;
+  return 1;
+}
+#endif // STORM_PROTECT
 /*==============================================================================
  * EXPORTED (GLOBAL) FUNCTIONS
  *============================================================================*/
@@ -50,6 +162,13 @@ void OT_GPIO_init(OT_GPIO_CB_T *cb, void *cbarg) {
   TRIGGER_IN_DISABLE();
   TRIGGER_OUT_OFF();
 
+  // Set once here (with interrupts still disabled) rather than every time an
+  // interrupt is enabled
+  EXTI_SetExtIntSensitivity(TRIGGER_IN_EXTI_PORT, TRIGGER_IN_EXTI_SENSITIVITY);
+#if defined(WAKEUP_BUTTON)
+  EXTI_SetExtIntSensitivity(BUTTON_DET_EXTI_PORT, BUTTON_DET_EXTI_SENSITIVITY);
+#endif // WAKEUP_BUTTON
+
   GPIO_Init(GREEN_LED_PORT, GREEN_LED_PIN, GPIO_MODE_OUT_PP_LOW_SLOW);
   GREEN_LED_OFF();
 
@@ -60,6 +179,11 @@ void OT_GPIO_init(OT_GPIO_CB_T *cb, void *cbarg) {
   BUTTON_DISABLE();
 #endif // WAKEUP_BUTTON
 
+#if defined(QUENCH_OUT)
+  // Driven by TIM1_CH2 (see OT_TIMER_quench_after()); push-pull
+  GPIO_Init(QUENCH_OUT_PORT, QUENCH_OUT_PIN, GPIO_MODE_OUT_PP_LOW_FAST);
+#endif // QUENCH_OUT
+
   DIP_ENABLE();
   return;
 }
@@ -75,13 +199,13 @@ void OT_GPIO_init(OT_GPIO_CB_T *cb, void *cbarg) {
 uint8_t OT_GPIO_bursts_to_ignore(void) {
   // Interpret DIP2, DIP1, DIP0 as a binary value
   uint8_t retval = 0;
-  if (RESET != GPIO_ReadInputPin(DIP0_PORT, DIP0_PIN)) {
+  if (0 != OT_PIN_READ(DIP0_PORT, DIP0_PIN)) {
     retval |= 0x01;
   }
-  if (RESET != GPIO_ReadInputPin(DIP1_PORT, DIP1_PIN)) {
+  if (0 != OT_PIN_READ(DIP1_PORT, DIP1_PIN)) {
     retval |= 0x02;
   }
-  if (RESET != GPIO_ReadInputPin(DIP2_PORT, DIP2_PIN)) {
+  if (0 != OT_PIN_READ(DIP2_PORT, DIP2_PIN)) {
     retval |= 0x04;
   }
   return retval;
@@ -96,8 +220,26 @@ uint8_t OT_GPIO_bursts_to_ignore(void) {
  * @notes
  *============================================================================*/
 INTERRUPT_HANDLER(ot_gpiob_isr, ITC_IRQ_PORTB) {
+  OT_PROF_ENTER(OT_PROF_SITE_GPIOB_ISR);
+#if defined(STORM_PROTECT)
+  if (ot_gpio_storm_check(&ot_gpio_storm[OT_GPIO_STORM_PORTB])) {
+    // Mask it until the owner re-enables it
+    TRIGGER_IN_DISABLE();
+    if ((void*)0 != ot_gpio_cb) {
+      (*ot_gpio_cb)(GPIOB, OT_GPIO_EVENT_STORM, ot_gpio_cbarg);
+    }
+  }
+  else
+#endif // STORM_PROTECT
+#if defined(OT_GPIO_TRIGGER_IN_FILTER)
+  // Drop edges that aren't flash bursts before they reach the owner
+  if (0 == ot_gpio_trigger_in_filter())
+#endif // OT_GPIO_TRIGGER_IN_FILTER
   // Inform the 'owner' module of this interrupt
-  if ((void*)0 != ot_gpio_cb) (*ot_gpio_cb)(GPIOB, ot_gpio_cbarg);
+  if ((void*)0 != ot_gpio_cb) {
+    (*ot_gpio_cb)(GPIOB, OT_GPIO_EVENT_EDGE, ot_gpio_cbarg);
+  }
+  OT_PROF_EXIT(OT_PROF_SITE_GPIOB_ISR);
   return;
 }
 /*==============================================================================
@@ -111,8 +253,22 @@ INTERRUPT_HANDLER(ot_gpiob_isr, ITC_IRQ_PORTB) {
  *============================================================================*/
 #if defined(WAKEUP_BUTTON)
 INTERRUPT_HANDLER(ot_gpioc_isr, ITC_IRQ_PORTC) {
+  OT_PROF_ENTER(OT_PROF_SITE_GPIOC_ISR);
+#if defined(STORM_PROTECT)
+  if (ot_gpio_storm_check(&ot_gpio_storm[OT_GPIO_STORM_PORTC])) {
+    // Mask it until the owner re-enables it
+    BUTTON_DISABLE();
+    if ((void*)0 != ot_gpio_cb) {
+      (*ot_gpio_cb)(GPIOC, OT_GPIO_EVENT_STORM, ot_gpio_cbarg);
+    }
+  }
+  else
+#endif // STORM_PROTECT
   // Inform the 'owner' module of this interrupt
-  if ((void*)0 != ot_gpio_cb) (*ot_gpio_cb)(GPIOC, ot_gpio_cbarg);
+  if ((void*)0 != ot_gpio_cb) {
+    (*ot_gpio_cb)(GPIOC, OT_GPIO_EVENT_EDGE, ot_gpio_cbarg);
+  }
+  OT_PROF_EXIT(OT_PROF_SITE_GPIOC_ISR);
   return;
 }
 #endif // WAKEUP_BUTTON
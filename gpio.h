@@ -22,10 +22,27 @@ extern "C"
 /*==============================================================================
  * TYPEDEFs and STRUCTs
  *============================================================================*/
-typedef void (OT_GPIO_CB_T)(GPIO_TypeDef *port, void *cbarg);
+typedef enum OT_GPIO_EVENT_E {
+  OT_GPIO_EVENT_EDGE,   // An edge on the port's interrupt pin
+  OT_GPIO_EVENT_STORM,  // Too many edges; the pin's interrupt is now disabled
+  OT_GPIO_EVENT_MAX     // Not a real event
+} OT_GPIO_EVENT_T;
+
+typedef void (OT_GPIO_CB_T)(GPIO_TypeDef *port, OT_GPIO_EVENT_T event,
+                            void *cbarg);
 /*==============================================================================
  * GLOBAL (extern) VARIABLES
  *============================================================================*/
+#if defined(GLITCH_FILTER)
+// Number of TRIGGER_IN pulses rejected as glitches (saturates at 0xFFFF).
+// Exported so it can be read over SWIM.
+extern volatile uint16_t OT_GPIO_glitches;
+#endif // GLITCH_FILTER
+#if defined(STORM_PROTECT)
+// Number of interrupt storms detected (saturates at 0xFFFF). Exported so it
+// can be read over SWIM.
+extern volatile uint16_t OT_GPIO_storms;
+#endif // STORM_PROTECT
 /*==============================================================================
  * EXPORTED (GLOBAL) FUNCTIONS
  *============================================================================*/
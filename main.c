@@ -9,10 +9,30 @@
 #include "gpio.h"
 #include "timer.h"
 #include "adc.h"
+#include "power.h"
+#if defined(SNIFF_MODE)
+  #include "awu.h"
+#endif // SNIFF_MODE
+#if defined(ISR_PROFILE)
+  #include "profile.h"
+#endif // ISR_PROFILE
 #include "state_machine.h"
+#if defined(WIRELESS_COMMANDS)
+  #include "command.h"
+#endif // WIRELESS_COMMANDS
+#if defined(EEPROM_STORE)
+  #include "eeprom.h"
+#endif // EEPROM_STORE
+#if defined(SELF_TEST)
+  #include "selftest.h"
+#endif // SELF_TEST
 /*==============================================================================
  * CONSTANTS
  *============================================================================*/
+#if defined(WIRELESS_COMMANDS) && \
+    (defined(ADC_FLASH_DETECT) || defined(BURST_CAPTURE))
+  #error "WIRELESS_COMMANDS only decodes TRIGGER_IN edges"
+#endif
 /*==============================================================================
  * MACROS
  *============================================================================*/
@@ -25,6 +45,12 @@
 // Callbacks
 static OT_TIMER_CB_T ot_timer_cb;
 static OT_GPIO_CB_T  ot_gpio_cb;
+#if defined(SNIFF_MODE)
+static OT_AWU_CB_T   ot_awu_cb;
+#endif // SNIFF_MODE
+#if defined(ADC_FLASH_DETECT)
+static OT_ADC_CB_T   ot_adc_cb;
+#endif // ADC_FLASH_DETECT
 /*==============================================================================
  * LOCAL VARIABLES
  *============================================================================*/
@@ -60,12 +86,38 @@ static void ot_timer_cb(void *cbarg) {
  * @notes
  *============================================================================*/
 // Called by the GPIO module's interrupt upon detection of a flash burst
-// or wake-up button press
-static void ot_gpio_cb(GPIO_TypeDef *port, void *cbarg) {
+// or wake-up button press (or of an interrupt storm on either)
+static void ot_gpio_cb(GPIO_TypeDef *port, OT_GPIO_EVENT_T event,
+                       void *cbarg) {
   (void)cbarg; // Unused
+#if defined(STORM_PROTECT)
+  if (OT_GPIO_EVENT_STORM == event) {
+    // The GPIO module has already masked the storming pin; back off
+#if defined(WAKEUP_BUTTON)
+    OT_SM_execute((BUTTON_DET_PORT == port) ? OT_SM_EVENT_BUTTON_STORM :
+                                              OT_SM_EVENT_STORM);
+#else
+    OT_SM_execute(OT_SM_EVENT_STORM);
+#endif // WAKEUP_BUTTON
+  }
+  else
+#else
+  (void)event; // Always OT_GPIO_EVENT_EDGE
+#endif // STORM_PROTECT
   if (TRIGGER_IN_PORT == port) {
+#if defined(WIRELESS_COMMANDS)
+    // The State Machine only fires on the burst our group is commanded to
+    OT_SM_execute(OT_CMD_is_commanded_burst(OT_TIMER_cycles32()) ?
+                  OT_SM_EVENT_COMMANDED : OT_SM_EVENT_ACTIVITY);
+#elif defined(BURST_CAPTURE)
+    // Sample the burst's waveform for the State Machine to classify
+    OT_ADC_BURST_T burst;
+    OT_ADC_capture_burst(&burst);
+    OT_SM_execute_burst(&burst);
+#else
     // Send Flash Detected event to State Machine
     OT_SM_execute(OT_SM_EVENT_FLASH_DETECTED);
+#endif // BURST_CAPTURE
   }
 #if defined(WAKEUP_BUTTON)
   else if (BUTTON_DET_PORT == port) {
@@ -75,6 +127,43 @@ static void ot_gpio_cb(GPIO_TypeDef *port, void *cbarg) {
 #endif // WAKEUP_BUTTON
   return;
 }
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+// Called by the AWU module's interrupt upon periodic wake-up from active-halt
+#if defined(SNIFF_MODE)
+static void ot_awu_cb(void *cbarg) {
+  (void)cbarg; // Unused
+  // Send Sniff event to State Machine
+  OT_SM_execute(OT_SM_EVENT_SNIFF);
+  return;
+}
+#endif // SNIFF_MODE
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+// Called by the ADC module's interrupt upon detection of a flash burst (by the
+// analog watchdog)
+#if defined(ADC_FLASH_DETECT)
+static void ot_adc_cb(void *cbarg) {
+  (void)cbarg; // Unused
+  // Send Flash Detected event to State Machine
+  OT_SM_execute(OT_SM_EVENT_FLASH_DETECTED);
+  return;
+}
+#endif // ADC_FLASH_DETECT
 /*==============================================================================
  * EXPORTED (GLOBAL) FUNCTIONS
  *============================================================================*/
@@ -90,16 +179,43 @@ static void ot_gpio_cb(GPIO_TypeDef *port, void *cbarg) {
 /*============================================================================*/
 void main(void) {
   /* Config Clock - N/A (Default is 2MHz) */
+  OT_POWER_init();
   OT_GPIO_init(ot_gpio_cb, (void*)0);
   OT_TIMER_init(ot_timer_cb, (void*)0);
+#if defined(ISR_PROFILE)
+  OT_PROF_init();
+#endif // ISR_PROFILE
   OT_ADC_init();
+#if defined(ADC_FLASH_DETECT)
+  OT_ADC_flash_init(ot_adc_cb, (void*)0);
+#endif // ADC_FLASH_DETECT
+#if defined(SNIFF_MODE)
+  OT_AWU_init(ot_awu_cb, (void*)0);
+#endif // SNIFF_MODE
+#if defined(EEPROM_STORE)
+  OT_EE_init(); // Before the State Machine, which loads its settings
+#endif // EEPROM_STORE
   OT_SM_init();
   enableInterrupts();
+#if defined(SELF_TEST)
+  OT_ST_run(); // Drives the State Machine through the loopback jumpers
+#endif // SELF_TEST
   while (1) {
+#if defined(DEBUG)
+    OT_POWER_update_estimate();
+#endif // DEBUG
+#if defined(HSI_CALIBRATION)
+    OT_TIMER_calibrate(); // If the State Machine asked for it
+#endif // HSI_CALIBRATION
 #if defined(WAKEUP_BUTTON)
     // Deep sleep (halt) when we want to wake up only due to an external
-    // interrupt
-    if (OT_SM_STATE_SLEEPING == OT_SM_get_state()) { halt(); }
+    // interrupt (or the AWU, which makes this an active-halt)
+    if ((OT_SM_STATE_SLEEPING == OT_SM_get_state())
+#if defined(EEPROM_STORE)
+        // Halting would abort the EEPROM write in progress
+        && (0 == OT_EE_busy())
+#endif // EEPROM_STORE
+       ) { halt(); }
     else
 #endif // WAKEUP_BUTTON
     { wfi(); }
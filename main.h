@@ -14,60 +14,88 @@ extern "C"
  *============================================================================*/
 #include <stm8s.h>
 #include "config.h"
+#include "pin.h"
+#if defined(ADC_FLASH_DETECT)
+  #include "adc.h"
+#endif // ADC_FLASH_DETECT
 /*==============================================================================
  * CONSTANTS
  *============================================================================*/
 /*==============================================================================
  * MACROS
  *============================================================================*/
+// Note: each pin toggles between the two modes defined in config.h and starts
+// (out of reset) in the OFF/DISABLE mode, see OT_PIN_MODE()
+
 // SENSOR_ENABLE is ActiveHigh
-#define SENSOR_ON()    \
-  GPIO_Init(SENSOR_ENABLE_PORT, SENSOR_ENABLE_PIN, SENSOR_ENABLE_ON_MODE); \
-  GPIO_WriteHigh(SENSOR_ENABLE_PORT, SENSOR_ENABLE_PIN)
-#define SENSOR_OFF()   \
-  GPIO_WriteLow(SENSOR_ENABLE_PORT, SENSOR_ENABLE_PIN); \
-  GPIO_Init(SENSOR_ENABLE_PORT, SENSOR_ENABLE_PIN, SENSOR_ENABLE_OFF_MODE)
+#define SENSOR_ON()  do {                                        \
+  OT_PIN_HIGH(SENSOR_ENABLE_PORT, SENSOR_ENABLE_PIN);            \
+  OT_PIN_MODE(SENSOR_ENABLE_PORT, SENSOR_ENABLE_PIN,             \
+              SENSOR_ENABLE_OFF_MODE, SENSOR_ENABLE_ON_MODE);    \
+} while (0)
+#define SENSOR_OFF()  do {                                       \
+  OT_PIN_LOW(SENSOR_ENABLE_PORT, SENSOR_ENABLE_PIN);             \
+  OT_PIN_MODE(SENSOR_ENABLE_PORT, SENSOR_ENABLE_PIN,             \
+              SENSOR_ENABLE_ON_MODE, SENSOR_ENABLE_OFF_MODE);    \
+} while (0)
 
+#if defined(ADC_FLASH_DETECT)
+// Flash bursts are detected on FLASH_SENSE by the ADC1 analog watchdog
+// (TRIGGER_IN is left unused)
+#define TRIGGER_IN_ENABLE()   OT_ADC_flash_arm()
+#define TRIGGER_IN_DISABLE()  OT_ADC_flash_disarm()
+#else
+// Note: the EXTI sensitivity is set once by OT_GPIO_init()
 #define TRIGGER_IN_ENABLE()   \
-  GPIO_Init(TRIGGER_IN_PORT, TRIGGER_IN_PIN, TRIGGER_IN_ENABLE_MODE); \
-  EXTI_SetExtIntSensitivity(TRIGGER_IN_EXTI_PORT, TRIGGER_IN_EXTI_SENSITIVITY)
+  OT_PIN_MODE(TRIGGER_IN_PORT, TRIGGER_IN_PIN, \
+              TRIGGER_IN_DISABLE_MODE, TRIGGER_IN_ENABLE_MODE)
 #define TRIGGER_IN_DISABLE()  \
-  GPIO_Init(TRIGGER_IN_PORT, TRIGGER_IN_PIN, TRIGGER_IN_DISABLE_MODE)
+  OT_PIN_MODE(TRIGGER_IN_PORT, TRIGGER_IN_PIN, \
+              TRIGGER_IN_ENABLE_MODE, TRIGGER_IN_DISABLE_MODE)
+#endif // ADC_FLASH_DETECT
 
 // TRIGGER_OUT is ActiveLow
-#define TRIGGER_OUT_ON()      \
-  GPIO_WriteLow(TRIGGER_OUT_PORT, TRIGGER_OUT_PIN); \
-  GPIO_Init(TRIGGER_OUT_PORT, TRIGGER_OUT_PIN, TRIGGER_OUT_ON_MODE)
-#define TRIGGER_OUT_OFF()     \
-  GPIO_WriteHigh(TRIGGER_OUT_PORT, TRIGGER_OUT_PIN); \
-  GPIO_Init(TRIGGER_OUT_PORT, TRIGGER_OUT_PIN, TRIGGER_OUT_OFF_MODE)
+#define TRIGGER_OUT_ON()  do {                                   \
+  OT_PIN_LOW(TRIGGER_OUT_PORT, TRIGGER_OUT_PIN);                 \
+  OT_PIN_MODE(TRIGGER_OUT_PORT, TRIGGER_OUT_PIN,                 \
+              TRIGGER_OUT_OFF_MODE, TRIGGER_OUT_ON_MODE);        \
+} while (0)
+#define TRIGGER_OUT_OFF()  do {                                  \
+  OT_PIN_HIGH(TRIGGER_OUT_PORT, TRIGGER_OUT_PIN);                \
+  OT_PIN_MODE(TRIGGER_OUT_PORT, TRIGGER_OUT_PIN,                 \
+              TRIGGER_OUT_ON_MODE, TRIGGER_OUT_OFF_MODE);        \
+} while (0)
 
 // GREEN_LED is ActiveLow
-#define GREEN_LED_ON()        GPIO_WriteLow(GREEN_LED_PORT, GREEN_LED_PIN)
-#define GREEN_LED_OFF()       GPIO_WriteHigh(GREEN_LED_PORT, GREEN_LED_PIN)
-#define GREEN_LED_TOGGLE()    GPIO_WriteReverse(GREEN_LED_PORT, GREEN_LED_PIN)
+#define GREEN_LED_ON()        OT_PIN_LOW(GREEN_LED_PORT, GREEN_LED_PIN)
+#define GREEN_LED_OFF()       OT_PIN_HIGH(GREEN_LED_PORT, GREEN_LED_PIN)
+#define GREEN_LED_TOGGLE()    OT_PIN_TOGGLE(GREEN_LED_PORT, GREEN_LED_PIN)
 
 // RED_LED is ActiveHigh
-#define RED_LED_ON()          GPIO_WriteHigh(RED_LED_PORT, RED_LED_PIN)
-#define RED_LED_OFF()         GPIO_WriteLow(RED_LED_PORT, RED_LED_PIN)
+#define RED_LED_ON()          OT_PIN_HIGH(RED_LED_PORT, RED_LED_PIN)
+#define RED_LED_OFF()         OT_PIN_LOW(RED_LED_PORT, RED_LED_PIN)
 
 #if defined(WAKEUP_BUTTON)
   #define BUTTON_ENABLE()     \
-    GPIO_Init(BUTTON_DET_PORT, BUTTON_DET_PIN, BUTTON_DET_ENABLE_MODE); \
-    EXTI_SetExtIntSensitivity(BUTTON_DET_EXTI_PORT, BUTTON_DET_EXTI_SENSITIVITY)
+    OT_PIN_MODE(BUTTON_DET_PORT, BUTTON_DET_PIN, \
+                BUTTON_DET_DISABLE_MODE, BUTTON_DET_ENABLE_MODE)
   #define BUTTON_DISABLE()    \
-    GPIO_Init(BUTTON_DET_PORT, BUTTON_DET_PIN, BUTTON_DET_DISABLE_MODE)
+    OT_PIN_MODE(BUTTON_DET_PORT, BUTTON_DET_PIN, \
+                BUTTON_DET_ENABLE_MODE, BUTTON_DET_DISABLE_MODE)
+  // BUTTON_DET is ActiveLow (only pulled up while enabled)
+  #define BUTTON_HELD()       (0 == OT_PIN_READ(BUTTON_DET_PORT, BUTTON_DET_PIN))
 #endif // WAKEUP_BUTTON
 
-#define DIP_ENABLE()    \
-  GPIO_Init(DIP0_PORT, DIP0_PIN, DIP0_ENABLE_MODE); \
-  GPIO_Init(DIP1_PORT, DIP1_PIN, DIP1_ENABLE_MODE); \
-  GPIO_Init(DIP2_PORT, DIP2_PIN, DIP2_ENABLE_MODE)
-
-#define DIP_DISABLE()   \
-  GPIO_Init(DIP0_PORT, DIP0_PIN, DIP0_DISABLE_MODE); \
-  GPIO_Init(DIP1_PORT, DIP1_PIN, DIP1_DISABLE_MODE); \
-  GPIO_Init(DIP2_PORT, DIP2_PIN, DIP2_DISABLE_MODE)
+#define DIP_ENABLE()  do {                                                    \
+  OT_PIN_MODE(DIP0_PORT, DIP0_PIN, DIP0_DISABLE_MODE, DIP0_ENABLE_MODE);      \
+  OT_PIN_MODE(DIP1_PORT, DIP1_PIN, DIP1_DISABLE_MODE, DIP1_ENABLE_MODE);      \
+  OT_PIN_MODE(DIP2_PORT, DIP2_PIN, DIP2_DISABLE_MODE, DIP2_ENABLE_MODE);      \
+} while (0)
+#define DIP_DISABLE()  do {                                                   \
+  OT_PIN_MODE(DIP0_PORT, DIP0_PIN, DIP0_ENABLE_MODE, DIP0_DISABLE_MODE);      \
+  OT_PIN_MODE(DIP1_PORT, DIP1_PIN, DIP1_ENABLE_MODE, DIP1_DISABLE_MODE);      \
+  OT_PIN_MODE(DIP2_PORT, DIP2_PIN, DIP2_ENABLE_MODE, DIP2_DISABLE_MODE);      \
+} while (0)
 /*==============================================================================
  * TYPEDEFs and STRUCTs
  *============================================================================*/
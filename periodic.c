@@ -0,0 +1,178 @@
+/*==============================================================================
+ * MODULE: Periodic
+ * DESCRIPTION: Detects (and masks) strictly periodic TRIGGER_IN edge trains,
+ * such as 100/120Hz fluorescent/LED flicker or the repeat frames of an IR
+ * remote, while letting edges off their period (i.e. flash bursts) through.
+ *
+ * A train is periodic when the time between an edge and the edge two before
+ * it stays the same (within a tolerance) for PERIODIC_LOCK_EDGES edges in a
+ * row. Comparing every other edge also catches trains whose edges alternate
+ * between two spacings (e.g. an IR remote's leader and repeat bursts).
+ *
+ * Once locked, an edge is masked if it falls on the predicted period (up to
+ * PERIODIC_MISSED_PERIODS late). An edge off the period is let through and
+ * doesn't move the prediction. The lock is dropped once no edge has fallen on
+ * the period for PERIODIC_MISSED_PERIODS periods.
+ *
+ * This module has no hardware dependencies (timestamps come from the caller).
+ *============================================================================*/
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include "config.h"
+#include "periodic.h"
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+typedef struct OT_PERIODIC_DATA_S {
+  uint32_t t1;        // Last edge (last edge on the period, when locked)
+  uint32_t t2;        // The edge before t1
+  uint32_t period;    // Time from an edge to the edge two after it
+  uint8_t  edges;     // Edges seen since the last reset (saturates at 3)
+  uint8_t  matches;   // Consecutive edges matching period
+  uint8_t  locked;
+} OT_PERIODIC_DATA_T;
+/*==============================================================================
+ * LOCAL FUNCTION PROTOTYPES
+ *============================================================================*/
+static uint8_t ot_periodic_near(uint32_t t, uint32_t expected);
+static uint8_t ot_periodic_unlocked(uint32_t now);
+static uint8_t ot_periodic_locked(uint32_t now);
+/*==============================================================================
+ * LOCAL VARIABLES
+ *============================================================================*/
+static OT_PERIODIC_DATA_T ot_periodic_data;
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+volatile uint16_t OT_PERIODIC_masked = 0;
+/*==============================================================================
+ * LOCAL FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION:
+ * @param t - time of an edge
+ * @param expected - when the edge was expected
+ * @return non-zero if t is within the tolerance of the current period around
+ *         expected
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static uint8_t ot_periodic_near(uint32_t t, uint32_t expected) {
+  // Signed: t and expected may be either side of the cycle counter's wrap
+  int32_t diff = (int32_t)(t - expected);
+  if (diff < 0) diff = -diff;
+  return (uint32_t)diff <= ((ot_periodic_data.period >>
+                             PERIODIC_TOLERANCE_SHIFT) +
+                            PERIODIC_JITTER_CYCLES);
+}
+/*==============================================================================
+ * DESCRIPTION: Look for a periodic train
+ * @param now - time of the edge
+ * @return non-zero if this edge completes a lock (and is to be masked)
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static uint8_t ot_periodic_unlocked(uint32_t now) {
+  if (ot_periodic_data.edges >= 2) {
+    if (ot_periodic_data.edges >= 3 &&
+        ot_periodic_near(now, ot_periodic_data.t2 + ot_periodic_data.period)) {
+      ++ot_periodic_data.matches;
+    }
+    else {
+      ot_periodic_data.matches = 0;
+    }
+    ot_periodic_data.period = now - ot_periodic_data.t2;
+  }
+  if (ot_periodic_data.edges < 3) ++ot_periodic_data.edges;
+  ot_periodic_data.t2 = ot_periodic_data.t1;
+  ot_periodic_data.t1 = now;
+
+  if (ot_periodic_data.matches >= PERIODIC_LOCK_EDGES) {
+    ot_periodic_data.locked = 1;
+  }
+  return ot_periodic_data.locked;
+}
+/*==============================================================================
+ * DESCRIPTION: Follow a locked periodic train
+ * @param now - time of the edge
+ * @return non-zero if the edge is on the period (and is to be masked)
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static uint8_t ot_periodic_locked(uint32_t now) {
+  uint8_t missed;
+  for (missed = 0; missed < PERIODIC_MISSED_PERIODS; ++missed) {
+    uint32_t expected = ot_periodic_data.t2 + ot_periodic_data.period;
+    if (ot_periodic_near(now, expected)) {
+      // On the period: follow any drift and mask
+      ot_periodic_data.period = now - ot_periodic_data.t2;
+      ot_periodic_data.t2 = ot_periodic_data.t1;
+      ot_periodic_data.t1 = now;
+      return 1;
+    }
+    if ((int32_t)(now - expected) < 0) {
+      return 0; // Off the period (e.g. a flash burst)
+    }
+    // The expected edge is past without being seen; expect the next one
+    ot_periodic_data.t2 = ot_periodic_data.t1;
+    ot_periodic_data.t1 = expected;
+  }
+  // The interference has stopped; this edge starts a new train
+  OT_PERIODIC_reset();
+  return ot_periodic_unlocked(now);
+}
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return
+ * @precondition
+ * @postcondition Forgets any train (locked or not)
+ * @caution
+ * @notes
+ *============================================================================*/
+void OT_PERIODIC_reset(void) {
+  ot_periodic_data.edges   = 0;
+  ot_periodic_data.matches = 0;
+  ot_periodic_data.locked  = 0;
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Classify a TRIGGER_IN edge
+ * @param now - time of the edge in CPU cycles (wrapping)
+ * @return non-zero if the edge belongs to a periodic train and is to be masked
+ * @precondition Edges are passed in the order they occurred
+ * @postcondition
+ * @caution
+ * @notes A train strictly periodic for PERIODIC_LOCK_EDGES edges is
+ *        indistinguishable from interference, so this must exceed the
+ *        longest such train of a real flash sequence (e.g. Nikon monitor
+ *        pre-flashes, see doc/FlashTraces.md).
+ *============================================================================*/
+uint8_t OT_PERIODIC_is_interference(uint32_t now) {
+  uint8_t masked;
+  if (ot_periodic_data.locked) {
+    masked = ot_periodic_locked(now);
+  }
+  else {
+    masked = ot_periodic_unlocked(now);
+  }
+  if (masked && 0xFFFF != OT_PERIODIC_masked) ++OT_PERIODIC_masked;
+  return masked;
+}
+/*============================================================================*/
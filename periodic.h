@@ -0,0 +1,41 @@
+/*==============================================================================
+ * MODULE: Periodic
+ * DESCRIPTION: Prototypes exported by the Periodic Interference detector
+ *============================================================================*/
+#ifndef _OT_PERIODIC_H_
+#define _OT_PERIODIC_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include <stdint.h>
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+// Number of edges masked as periodic interference (saturates at 0xFFFF).
+// Exported so it can be read over SWIM.
+extern volatile uint16_t OT_PERIODIC_masked;
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+void OT_PERIODIC_reset(void);
+uint8_t OT_PERIODIC_is_interference(uint32_t now);
+/*============================================================================*/
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _OT_PERIODIC_H_ */
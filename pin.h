@@ -0,0 +1,73 @@
+/*==============================================================================
+ * MODULE: Pin
+ * DESCRIPTION: Direct register access to the pins defined in config.h
+ *
+ * The port, pin and modes of every use are compile-time constants, so each
+ * operation compiles to bset/bres/bcpl/btjt on the port registers instead of
+ * a call into the StdPeriph GPIO driver.
+ *============================================================================*/
+#ifndef _OT_PIN_H_
+#define _OT_PIN_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include <stm8s.h>
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+// Register bits of a GPIO_Mode_TypeDef (see GPIO_Init())
+#define OT_PIN_MODE_DDR    0x80 // Output
+#define OT_PIN_MODE_CR1    0x40 // Pull-up (input) / Push-pull (output)
+#define OT_PIN_MODE_CR2    0x20 // Interrupt (input) / Fast (output)
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+#define OT_PIN_HIGH(port, pin)     ((port)->ODR |= (uint8_t)(pin))
+#define OT_PIN_LOW(port, pin)      ((port)->ODR &= (uint8_t)~(pin))
+#define OT_PIN_TOGGLE(port, pin)   ((port)->ODR ^= (uint8_t)(pin))
+#define OT_PIN_READ(port, pin)     ((port)->IDR & (uint8_t)(pin))
+
+// Set (or clear) 'pin' in 'reg' when 'bit' differs between the 'from' and
+// 'to' modes; otherwise compiles to nothing
+#define OT_PIN_MODE_BIT(reg, pin, from, to, bit)              \
+  if ((((from) ^ (to)) & (bit)) != 0) {                       \
+    if (((to) & (bit)) != 0) (reg) |= (uint8_t)(pin);         \
+    else                     (reg) &= (uint8_t)~(pin);        \
+  }
+
+// Switch 'pin' from the 'from' mode to the 'to' mode (GPIO_Mode_TypeDef),
+// writing only the register bits that differ between the two.
+// CAUTION: the pin must be in the 'from' (or already in the 'to') mode. The
+// output level (ODR) is not changed; use OT_PIN_HIGH/LOW before switching to
+// an output mode.
+// Note: like GPIO_Init(), an interrupt is disabled first and enabled last.
+#define OT_PIN_MODE(port, pin, from, to)  do {                              \
+  if (((to) & OT_PIN_MODE_CR2) == 0) {                                      \
+    OT_PIN_MODE_BIT((port)->CR2, pin, from, to, OT_PIN_MODE_CR2)            \
+  }                                                                         \
+  OT_PIN_MODE_BIT((port)->DDR, pin, from, to, OT_PIN_MODE_DDR)              \
+  OT_PIN_MODE_BIT((port)->CR1, pin, from, to, OT_PIN_MODE_CR1)              \
+  if (((to) & OT_PIN_MODE_CR2) != 0) {                                      \
+    OT_PIN_MODE_BIT((port)->CR2, pin, from, to, OT_PIN_MODE_CR2)            \
+  }                                                                         \
+} while (0)
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+/*============================================================================*/
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _OT_PIN_H_ */
@@ -0,0 +1,178 @@
+/*==============================================================================
+ * MODULE: Power
+ * DESCRIPTION: Peripheral clock gating. Peripherals this design never uses are
+ * gated once at init; the others are gated by the State Machine according to
+ * what each state needs (see OT_POWER_set()).
+ *============================================================================*/
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include <stm8s.h>
+#include "timer.h"
+#include "power.h"
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+#define OT_POWER_MANAGED \
+  (OT_POWER_TICK | OT_POWER_BUSYWAIT | OT_POWER_ADC | OT_POWER_AWU)
+
+// Always on
+#if defined(OT_TIMER_CYCLE_COUNTER)
+  #define OT_POWER_ALWAYS     OT_POWER_BIT(CLK_PERIPHERAL_TIMER1)
+#else
+  #define OT_POWER_ALWAYS     0
+#endif
+
+// Never used
+#if defined(STM8S105)
+  #define OT_POWER_UNUSED_UART   OT_POWER_BIT(CLK_PERIPHERAL_UART2)
+  #define OT_POWER_UNUSED_TIMERS OT_POWER_BIT(CLK_PERIPHERAL_TIMER2)
+#elif defined(STM8S903)
+  #define OT_POWER_UNUSED_UART   OT_POWER_BIT(CLK_PERIPHERAL_UART1)
+  #define OT_POWER_UNUSED_TIMERS 0
+#endif
+#define OT_POWER_UNUSED \
+  ((OT_POWER_BIT(CLK_PERIPHERAL_I2C) | OT_POWER_BIT(CLK_PERIPHERAL_SPI) | \
+    OT_POWER_UNUSED_UART | OT_POWER_UNUSED_TIMERS |                       \
+    OT_POWER_BIT(CLK_PERIPHERAL_TIMER1)) & ~OT_POWER_ALWAYS)
+
+#if defined(DEBUG)
+// The currents below are at fMASTER = 16MHz; we run at 16MHz >> 3 (HSI/8)
+#define OT_POWER_FMASTER_SHIFT    3
+#endif // DEBUG
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+#if defined(DEBUG)
+typedef struct OT_POWER_CURRENT_S {
+  OT_POWER_MASK_T bit;
+  uint16_t        ua;   // Typical supply current with the clock enabled
+} OT_POWER_CURRENT_T;
+#endif // DEBUG
+/*==============================================================================
+ * LOCAL FUNCTION PROTOTYPES
+ *============================================================================*/
+/*==============================================================================
+ * LOCAL VARIABLES
+ *============================================================================*/
+#if defined(DEBUG)
+// From the 'peripheral current consumption' table of the datasheet
+static const OT_POWER_CURRENT_T ot_power_currents[] = {
+#if defined(STM8S105)
+  { OT_POWER_BIT(CLK_PERIPHERAL_TIMER1),  220 },
+  { OT_POWER_BIT(CLK_PERIPHERAL_TIMER2),  120 },
+  { OT_POWER_BIT(CLK_PERIPHERAL_TIMER3),  100 },
+  { OT_POWER_BIT(CLK_PERIPHERAL_TIMER4),   25 },
+  { OT_POWER_BIT(CLK_PERIPHERAL_UART2),   110 },
+#elif defined(STM8S903)
+  { OT_POWER_BIT(CLK_PERIPHERAL_TIMER1),  210 },
+  { OT_POWER_BIT(CLK_PERIPHERAL_TIMER5),  130 },
+  { OT_POWER_BIT(CLK_PERIPHERAL_TIMER6),   50 },
+  { OT_POWER_BIT(CLK_PERIPHERAL_UART1),   120 },
+#endif
+  { OT_POWER_BIT(CLK_PERIPHERAL_SPI),      45 },
+  { OT_POWER_BIT(CLK_PERIPHERAL_I2C),      65 },
+  { OT_POWER_BIT(CLK_PERIPHERAL_ADC),    1000 },
+};
+#define OT_POWER_NUM_CURRENTS \
+  (sizeof(ot_power_currents) / sizeof(ot_power_currents[0]))
+
+static OT_POWER_MASK_T ot_power_mask = OT_POWER_MANAGED;
+#endif // DEBUG
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+#if defined(DEBUG)
+uint16_t OT_POWER_saved_ua = 0;
+#endif // DEBUG
+/*==============================================================================
+ * LOCAL FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION: Gate the clock of the peripherals we never use (and configure
+ * the wake-up from halt)
+ * @param
+ * @return
+ * @precondition Must be called before the other modules are initialized
+ * @postcondition The managed peripherals are clocked (as out of reset) until
+ *                the first OT_POWER_set()
+ * @caution
+ * @notes
+ *============================================================================*/
+void OT_POWER_init(void) {
+  CLK->PCKENR1 &= (uint8_t)~OT_POWER_UNUSED;
+  CLK->PCKENR2 &= (uint8_t)~(OT_POWER_UNUSED >> 8);
+#if defined(FAST_WAKEUP)
+  // Wake-up from halt on the HSI, and keep the Flash in standby (rather than
+  // powered down) while halted, at the cost of a few uA
+  CLK_FastHaltWakeUpConfig(ENABLE);
+  FLASH_SetLowPowerMode(FLASH_LPMODE_STANDBY);
+#endif // FAST_WAKEUP
+  OT_POWER_set(OT_POWER_MANAGED);
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return The managed peripherals clocked right now
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes E.g. to restore them with OT_POWER_set() after a temporary change
+ *============================================================================*/
+OT_POWER_MASK_T OT_POWER_get(void) {
+  return (OT_POWER_MASK_T)((((uint16_t)CLK->PCKENR2 << 8) | CLK->PCKENR1) &
+                           OT_POWER_MANAGED);
+}
+/*==============================================================================
+ * DESCRIPTION: Clock the managed peripherals in mask, gate the others
+ * @param mask - OR of OT_POWER_TICK, OT_POWER_BUSYWAIT, OT_POWER_ADC and
+ *               OT_POWER_AWU
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution A peripheral must be stopped before its clock is gated; writes to
+ *          its registers are ignored while gated.
+ * @notes Two register read-modify-writes, cheap enough for every transition
+ *============================================================================*/
+void OT_POWER_set(OT_POWER_MASK_T mask) {
+  mask &= OT_POWER_MANAGED;
+  CLK->PCKENR1 = (uint8_t)((CLK->PCKENR1 & (uint8_t)~OT_POWER_MANAGED) | mask);
+  CLK->PCKENR2 = (uint8_t)((CLK->PCKENR2 & (uint8_t)~(OT_POWER_MANAGED >> 8))
+                           | (mask >> 8));
+#if defined(DEBUG)
+  ot_power_mask = mask;
+#endif // DEBUG
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Update OT_POWER_saved_ua for the clocks gated right now
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes Called from the main loop, to keep it off the State Machine's
+ *        transitions
+ *============================================================================*/
+#if defined(DEBUG)
+void OT_POWER_update_estimate(void) {
+  OT_POWER_MASK_T gated = OT_POWER_UNUSED | (OT_POWER_MANAGED & ~ot_power_mask);
+  uint16_t saved_ua = 0;
+  uint8_t i;
+  for (i = 0; i < OT_POWER_NUM_CURRENTS; ++i) {
+    if (0 != (gated & ot_power_currents[i].bit)) {
+      saved_ua += ot_power_currents[i].ua;
+    }
+  }
+  OT_POWER_saved_ua = saved_ua >> OT_POWER_FMASTER_SHIFT;
+  return;
+}
+#endif // DEBUG
+/*============================================================================*/
@@ -0,0 +1,66 @@
+/*==============================================================================
+ * MODULE: Power
+ * DESCRIPTION: Prototypes exported by the Peripheral Power (clock gating)
+ * module
+ *============================================================================*/
+#ifndef _OT_POWER_H_
+#define _OT_POWER_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include <stm8s.h>
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+// Bit of a CLK_Peripheral_TypeDef in an OT_POWER_MASK_T: PCKENR1 is the low
+// byte, PCKENR2 the high byte
+#define OT_POWER_BIT(clk_peripheral) \
+  ((uint16_t)1 << (((clk_peripheral) & 0x0F) + (((clk_peripheral) & 0x10) ? 8 : 0)))
+
+// Peripherals whose clock is managed per state
+#if defined(STM8S105)
+  #define OT_POWER_TICK       OT_POWER_BIT(CLK_PERIPHERAL_TIMER4)
+  #define OT_POWER_BUSYWAIT   OT_POWER_BIT(CLK_PERIPHERAL_TIMER3)
+#elif defined(STM8S903)
+  #define OT_POWER_TICK       OT_POWER_BIT(CLK_PERIPHERAL_TIMER6)
+  #define OT_POWER_BUSYWAIT   OT_POWER_BIT(CLK_PERIPHERAL_TIMER5)
+#else
+  #error "OT_POWER peripherals not defined"
+#endif
+#define OT_POWER_ADC          OT_POWER_BIT(CLK_PERIPHERAL_ADC)
+#define OT_POWER_AWU          OT_POWER_BIT(CLK_PERIPHERAL_AWU)
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+typedef uint16_t OT_POWER_MASK_T;
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+#if defined(DEBUG)
+// Estimated supply current (uA) saved by the clocks gated right now. Exported
+// so it can be read over SWIM.
+extern uint16_t OT_POWER_saved_ua;
+#endif // DEBUG
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+void OT_POWER_init(void);
+void OT_POWER_set(OT_POWER_MASK_T mask);
+OT_POWER_MASK_T OT_POWER_get(void);
+#if defined(DEBUG)
+void OT_POWER_update_estimate(void);
+#endif // DEBUG
+/*============================================================================*/
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _OT_POWER_H_ */
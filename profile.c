@@ -0,0 +1,134 @@
+/*==============================================================================
+ * MODULE: Profile
+ * DESCRIPTION: Cycle statistics of the ISRs and the State Machine, measured
+ * with the Timer module's free-running cycle counter (TIM1). Optionally drives
+ * PROFILE_PIN high while a profiled site runs, for a logic analyzer.
+ *============================================================================*/
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include "config.h"
+#include "pin.h"
+#include "timer.h"
+#include "profile.h"
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+// Running average: avg += (sample - avg) / 2^OT_PROF_AVG_SHIFT
+#define OT_PROF_AVG_SHIFT    3
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+/*==============================================================================
+ * LOCAL FUNCTION PROTOTYPES
+ *============================================================================*/
+/*==============================================================================
+ * LOCAL VARIABLES
+ *============================================================================*/
+#if defined(ISR_PROFILE_PIN)
+// Sites nest (e.g. OT_SM_execute within an ISR); the pin stays high until
+// the outermost one exits
+static uint8_t ot_prof_depth = 0;
+#endif // ISR_PROFILE_PIN
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+volatile OT_PROF_STATS_T OT_PROF_stats[OT_PROF_SITE_MAX];
+/*==============================================================================
+ * LOCAL FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return
+ * @precondition
+ * @postcondition All statistics are cleared
+ * @caution
+ * @notes
+ *============================================================================*/
+void OT_PROF_init(void) {
+  uint8_t site;
+  for (site = 0; site < OT_PROF_SITE_MAX; ++site) {
+    OT_PROF_stats[site].count = 0;
+    OT_PROF_stats[site].min   = 0xFFFF;
+    OT_PROF_stats[site].max   = 0;
+    OT_PROF_stats[site].avg   = 0;
+  }
+#if defined(ISR_PROFILE_PIN)
+  ot_prof_depth = 0;
+  GPIO_Init(PROFILE_PIN_PORT, PROFILE_PIN_PIN, GPIO_MODE_OUT_PP_LOW_FAST);
+#endif // ISR_PROFILE_PIN
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return Cycle counter at the start of the profiled site
+ * @precondition
+ * @postcondition
+ * @caution Use via OT_PROF_ENTER()
+ * @notes
+ *============================================================================*/
+uint16_t OT_PROF_enter(void) {
+#if defined(ISR_PROFILE_PIN)
+  if (0 == ot_prof_depth++) OT_PIN_HIGH(PROFILE_PIN_PORT, PROFILE_PIN_PIN);
+#endif // ISR_PROFILE_PIN
+  return OT_TIMER_cycles();
+}
+/*==============================================================================
+ * DESCRIPTION:
+ * @param site - the profiled site
+ * @param start - value returned by OT_PROF_enter()
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution Use via OT_PROF_EXIT()
+ * @notes The samples include the ~20 cycles of the OT_PROF_enter()/exit()
+ *        calls themselves. A site longer than a TIM1 wrap (32.8msec) reads
+ *        short.
+ *============================================================================*/
+void OT_PROF_exit(OT_PROF_SITE_T site, uint16_t start) {
+  uint16_t cycles = OT_TIMER_cycles() - start;
+  volatile OT_PROF_STATS_T *statsp = &OT_PROF_stats[site];
+
+  if (0 == statsp->count) {
+    statsp->avg = cycles;
+  } else {
+    statsp->avg = statsp->avg - (statsp->avg >> OT_PROF_AVG_SHIFT)
+                + (cycles >> OT_PROF_AVG_SHIFT);
+  }
+  if (0xFFFF != statsp->count) ++statsp->count;
+  if (cycles < statsp->min) statsp->min = cycles;
+  if (cycles > statsp->max) statsp->max = cycles;
+
+#if defined(ISR_PROFILE_PIN)
+  if (0 == --ot_prof_depth) OT_PIN_LOW(PROFILE_PIN_PORT, PROFILE_PIN_PIN);
+#endif // ISR_PROFILE_PIN
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Consistent snapshot of the statistics of a site
+ * @param site - the profiled site
+ * @param statsp - where to copy the statistics
+ * @return
+ * @precondition Not called from an ISR
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+void OT_PROF_get_stats(OT_PROF_SITE_T site, OT_PROF_STATS_T *statsp) {
+  disableInterrupts();
+  statsp->count = OT_PROF_stats[site].count;
+  statsp->min   = OT_PROF_stats[site].min;
+  statsp->max   = OT_PROF_stats[site].max;
+  statsp->avg   = OT_PROF_stats[site].avg;
+  enableInterrupts();
+  return;
+}
+/*============================================================================*/
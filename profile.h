@@ -0,0 +1,75 @@
+/*==============================================================================
+ * MODULE: Profile
+ * DESCRIPTION: Prototypes exported by the ISR Profiling module
+ *============================================================================*/
+#ifndef _OT_PROFILE_H_
+#define _OT_PROFILE_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include <stm8s.h>
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+#if defined(ISR_PROFILE_PIN) && !defined(ISR_PROFILE)
+  #error "ISR_PROFILE_PIN requires ISR_PROFILE"
+#endif
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+// OT_PROF_ENTER() must be the first statement (declaration) in the profiled
+// block and OT_PROF_EXIT() the last. Both compile away without ISR_PROFILE.
+#if defined(ISR_PROFILE)
+  #define OT_PROF_ENTER(site)  uint16_t ot_prof_start = OT_PROF_enter()
+  #define OT_PROF_EXIT(site)   OT_PROF_exit((site), ot_prof_start)
+#else
+  #define OT_PROF_ENTER(site)
+  #define OT_PROF_EXIT(site)
+#endif // ISR_PROFILE
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+#if defined(ISR_PROFILE)
+typedef enum OT_PROF_SITE_S {
+  OT_PROF_SITE_TIMER_ISR,
+  OT_PROF_SITE_GPIOB_ISR,
+  OT_PROF_SITE_GPIOC_ISR,
+  OT_PROF_SITE_SM_EXECUTE,
+  OT_PROF_SITE_MAX    // Not a real site
+} OT_PROF_SITE_T;
+
+// Cycles (at fMASTER) from OT_PROF_ENTER() to OT_PROF_EXIT()
+typedef struct OT_PROF_STATS_S {
+  uint16_t count;  // Saturates at 0xFFFF
+  uint16_t min;
+  uint16_t max;
+  uint16_t avg;    // Running average, each new sample weighs 1/8
+} OT_PROF_STATS_T;
+#endif // ISR_PROFILE
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+#if defined(ISR_PROFILE)
+// Exported so it can be read over SWIM (symbol _OT_PROF_stats in the .map)
+extern volatile OT_PROF_STATS_T OT_PROF_stats[OT_PROF_SITE_MAX];
+#endif // ISR_PROFILE
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+#if defined(ISR_PROFILE)
+void OT_PROF_init(void);
+uint16_t OT_PROF_enter(void);
+void OT_PROF_exit(OT_PROF_SITE_T site, uint16_t start);
+void OT_PROF_get_stats(OT_PROF_SITE_T site, OT_PROF_STATS_T *statsp);
+#endif // ISR_PROFILE
+/*============================================================================*/
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _OT_PROFILE_H_ */
@@ -0,0 +1,242 @@
+/*==============================================================================
+ * MODULE: Self-Test (ST)
+ * DESCRIPTION: Loopback test of the trigger latency. SELF_TEST_PULSE, jumpered
+ * to TRIGGER_IN, stands in for the master's flash bursts; TRIGGER_OUT,
+ * jumpered to SELF_TEST_CAPTURE, has its pulses time-stamped by TIM1 (see
+ * OT_TIMER_captured()). Runs once at start-up, if DIP[2:0] is at 000b (fire on
+ * the first burst).
+ *============================================================================*/
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include "main.h"
+#include "gpio.h"
+#include "timer.h"
+#include "state_machine.h"
+#include "selftest.h"
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+#define OT_ST_CYCLES_PER_MS          2000 // fMASTER is 2MHz
+// Longest wait for the State Machine to be back in READY, e.g. after INIT
+// or the previous trial's CONFIRMED
+#define OT_ST_READY_TIMEOUT_MS       1000
+// Longest wait, from the synthetic edge, for both edges of the trigger pulse
+#define OT_ST_CAPTURE_TIMEOUT_CYCLES 20000
+// Each trial starts that much later after READY than the previous one, so
+// that PERIODIC_REJECT doesn't lock onto the synthetic bursts
+#define OT_ST_SPACING_MS             3
+// LED report: one blink per OT_ST_BLINK_UNIT_CYCLES of average latency
+#define OT_ST_BLINK_UNIT_CYCLES      200 // 100usec
+#define OT_ST_BLINK_MS               250
+#define OT_ST_REPORT_GAP_MS          1000
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+/*==============================================================================
+ * LOCAL FUNCTION PROTOTYPES
+ *============================================================================*/
+/*==============================================================================
+ * LOCAL VARIABLES
+ *============================================================================*/
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+volatile OT_ST_RESULTS_T OT_ST_results;
+/*==============================================================================
+ * LOCAL FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION: Wait for 'cycles' from 'start'
+ * @param start - A cycle count (see OT_TIMER_cycles())
+ * @param cycles - At most 32767
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes Polls TIM1 rather than using OT_TIMER_busywait_ms(): the State
+ *        Machine's ISRs use the same busy-wait timer
+ *============================================================================*/
+static void ot_st_wait_cycles(uint16_t start, uint16_t cycles) {
+  while ((uint16_t)(OT_TIMER_cycles() - start) < cycles) {}
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static void ot_st_wait_ms(uint16_t delay_ms) {
+  while (delay_ms-- > 0) {
+    ot_st_wait_cycles(OT_TIMER_cycles(), OT_ST_CYCLES_PER_MS);
+  }
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return 1 once the State Machine is in READY, 0 if it didn't get there
+ *         within OT_ST_READY_TIMEOUT_MS
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static uint8_t ot_st_wait_ready(void) {
+  uint16_t ms;
+  for (ms = 0; ms < OT_ST_READY_TIMEOUT_MS; ++ms) {
+    if (OT_SM_STATE_READY == OT_SM_get_state()) return 1;
+    ot_st_wait_ms(1);
+  }
+  return 0;
+}
+/*==============================================================================
+ * DESCRIPTION: One synthetic flash burst and the trigger pulse it caused
+ * @param latencyp - From the burst's edge to the start of the trigger pulse
+ * @param widthp - Of the trigger pulse
+ * @return 1 if the trigger pulse was captured
+ * @precondition READY
+ * @postcondition SELF_TEST_PULSE is low
+ * @caution
+ * @notes The TRIGGER_IN ISR (and the trigger pulse, fired from it) preempts
+ *        this as soon as interrupts are re-enabled
+ *============================================================================*/
+static uint8_t ot_st_trial(uint16_t *latencyp, uint16_t *widthp) {
+  uint16_t edge;
+  uint16_t start;
+  uint16_t end;
+  uint8_t captured;
+
+  OT_TIMER_capture_clear();
+  // Time-stamp the edge before its ISR can run
+  disableInterrupts();
+  edge = OT_TIMER_cycles();
+  OT_PIN_HIGH(SELF_TEST_PULSE_PORT, SELF_TEST_PULSE_PIN);
+  enableInterrupts();
+  ot_st_wait_cycles(edge, 2 * SELF_TEST_PULSE_US);
+  OT_PIN_LOW(SELF_TEST_PULSE_PORT, SELF_TEST_PULSE_PIN);
+
+  do {
+    captured = OT_TIMER_captured(&start, &end);
+  } while ((0 == captured) &&
+           ((uint16_t)(OT_TIMER_cycles() - edge) <
+            OT_ST_CAPTURE_TIMEOUT_CYCLES));
+  if (0 == captured) return 0;
+  *latencyp = start - edge;
+  *widthp   = end - start;
+  return 1;
+}
+/*==============================================================================
+ * DESCRIPTION: Blink an LED 'count' times
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static void ot_st_blink(uint8_t red, uint8_t count) {
+  while (count-- > 0) {
+    if (red) RED_LED_ON(); else GREEN_LED_ON();
+    ot_st_wait_ms(OT_ST_BLINK_MS);
+    if (red) RED_LED_OFF(); else GREEN_LED_OFF();
+    ot_st_wait_ms(OT_ST_BLINK_MS);
+  }
+  return;
+}
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION: Run SELF_TEST_TRIALS trials, then report on the LEDs: the
+ * GREEN LED blinks once per 100usec (rounded up) of average latency, then
+ * the RED LED once per missed trial.
+ * @param
+ * @return
+ * @precondition OT_SM_init(), interrupts enabled
+ * @postcondition OT_ST_results is final (done)
+ * @caution Fires TRIGGER_OUT (i.e. the slave, if connected) on every trial.
+ *          Takes a few seconds, during which the trigger also fires on real
+ *          flash bursts (which spoil the figures).
+ * @notes Skipped (every trial missed, nothing fired) unless DIP[2:0] is at
+ *        000b: with any other setting a trial wouldn't fire, or would fire
+ *        on a later trial's burst.
+ *        The results are also in OT_ST_results, to be read over SWIM
+ *============================================================================*/
+void OT_ST_run(void) {
+  uint32_t latency_sum = 0;
+  uint32_t width_sum   = 0;
+  uint16_t latency;
+  uint16_t width;
+  uint8_t captured;
+  uint8_t trial;
+
+  GPIO_Init(SELF_TEST_PULSE_PORT, SELF_TEST_PULSE_PIN,
+            GPIO_MODE_OUT_PP_LOW_FAST);
+  GPIO_Init(SELF_TEST_CAPTURE_PORT, SELF_TEST_CAPTURE_PIN,
+            GPIO_MODE_IN_PU_NO_IT);
+  OT_ST_results.done        = 0;
+  OT_ST_results.trials      = 0;
+  OT_ST_results.missed      = 0;
+  OT_ST_results.latency_min = 0xFFFF;
+  OT_ST_results.latency_max = 0;
+  OT_ST_results.width_min   = 0xFFFF;
+  OT_ST_results.width_max   = 0;
+  // Fires on the first burst only with DIP[2:0] at 000b
+  OT_ST_results.skipped     = (0 != OT_GPIO_bursts_to_ignore());
+
+  for (trial = 0; trial < SELF_TEST_TRIALS; ++trial) {
+    if (OT_ST_results.skipped) {
+      OT_ST_results.missed = SELF_TEST_TRIALS;
+      break;
+    }
+    captured = 0;
+    if (0 != ot_st_wait_ready()) {
+      ot_st_wait_ms(trial * OT_ST_SPACING_MS);
+      captured = ot_st_trial(&latency, &width);
+    }
+    if (0 == captured) {
+      ++OT_ST_results.missed;
+      continue;
+    }
+    ++OT_ST_results.trials;
+    latency_sum += latency;
+    width_sum   += width;
+    if (latency < OT_ST_results.latency_min) {
+      OT_ST_results.latency_min = latency;
+    }
+    if (latency > OT_ST_results.latency_max) {
+      OT_ST_results.latency_max = latency;
+    }
+    if (width < OT_ST_results.width_min) OT_ST_results.width_min = width;
+    if (width > OT_ST_results.width_max) OT_ST_results.width_max = width;
+  }
+  if (0 != OT_ST_results.trials) {
+    OT_ST_results.latency_avg =
+      (uint16_t)(latency_sum / OT_ST_results.trials);
+    OT_ST_results.width_avg = (uint16_t)(width_sum / OT_ST_results.trials);
+  }
+  else {
+    OT_ST_results.latency_min = 0;
+    OT_ST_results.latency_avg = 0;
+    OT_ST_results.width_min   = 0;
+    OT_ST_results.width_avg   = 0;
+  }
+  OT_ST_results.done = 1;
+
+  // Back in READY (from the last trial) before touching the LEDs
+  (void)ot_st_wait_ready();
+  ot_st_blink(0, (uint8_t)((OT_ST_results.latency_avg +
+                            OT_ST_BLINK_UNIT_CYCLES - 1) /
+                           OT_ST_BLINK_UNIT_CYCLES));
+  ot_st_wait_ms(OT_ST_REPORT_GAP_MS);
+  ot_st_blink(1, OT_ST_results.missed);
+  return;
+}
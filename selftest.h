@@ -0,0 +1,57 @@
+/*==============================================================================
+ * MODULE: Self-Test (ST)
+ * DESCRIPTION: Prototypes exported by the ST module
+ *============================================================================*/
+#ifndef _OT_ST_H_
+#define _OT_ST_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include <stm8s.h>
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+#if defined(ADC_FLASH_DETECT) || defined(WIRELESS_COMMANDS)
+  #error "SELF_TEST drives TRIGGER_IN with single pulses"
+#endif
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+// Outcome of the SELF_TEST_TRIALS trials, in CPU cycles (2 per usec). The
+// latency runs from the synthetic TRIGGER_IN edge to the start of the trigger
+// pulse; the width is that of the trigger pulse.
+typedef struct OT_ST_RESULTS_S {
+  uint8_t  done;     // Set once the figures below are final
+  uint8_t  skipped;  // DIP[2:0] wasn't at 000b: no trial was run
+  uint8_t  trials;   // Trials whose trigger pulse was captured
+  uint8_t  missed;   // Trials without (or that never got to READY)
+  uint16_t latency_min;
+  uint16_t latency_avg;
+  uint16_t latency_max;
+  uint16_t width_min;
+  uint16_t width_avg;
+  uint16_t width_max;
+} OT_ST_RESULTS_T;
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+// Exported so it can be read over SWIM (symbol _OT_ST_results in the .map)
+extern volatile OT_ST_RESULTS_T OT_ST_results;
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+void OT_ST_run(void);
+/*============================================================================*/
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _OT_ST_H_ */
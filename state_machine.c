@@ -9,7 +9,15 @@
 #include "gpio.h"
 #include "timer.h"
 #include "adc.h"
+#if defined(SNIFF_MODE)
+  #include "awu.h"
+#endif // SNIFF_MODE
+#include "power.h"
+#include "profile.h"
 #include "state_machine.h"
+#if defined(EEPROM_STORE)
+  #include "eeprom.h"
+#endif // EEPROM_STORE
 /*==============================================================================
  * CONSTANTS
  *============================================================================*/
@@ -22,11 +30,102 @@
 // @todo - What's the minimum duration for flash triggers?
 #define OT_SM_TRIGGER_DURATION_uS       300
 
+#if defined(SNIFF_MODE)
+  #define OT_SM_SNIFF_PERIOD            SNIFF_PERIOD
+#else
+  #define OT_SM_SNIFF_PERIOD            AWU_TIMEBASE_NO_IT // Unused
+#endif // SNIFF_MODE
+#if defined(FLASH_PROFILES)
+  #define OT_SM_MAX_PROFILE_PHASES      3
+#endif // FLASH_PROFILES
+#if defined(LIGHTNING_MODE)
+  // The strokes of a lightning flash come 40-60msec apart: CONFIRMED lasts
+  // this long instead, then re-arms straight to READY (skipping INIT)
+  #define OT_SM_LIGHTNING_REARM_MS      20
+#endif // LIGHTNING_MODE
+#if defined(SM_STATS)
+  // Interrupt mask bits (I1, I0) of the CC register, and their value in the
+  // main program with interrupts enabled (software priority level 0)
+  #define OT_SM_CC_I1I0                 0x28
+  #define OT_SM_CC_MAIN_LEVEL           0x20
+#endif // SM_STATS
+#if defined(BATTERY_MONITOR)
+  // Supply voltage thresholds for the power policy (see ot_sm_power_policy)
+  #define OT_SM_VDD_GOOD_MV             3000
+  #define OT_SM_VDD_FAIR_MV             2700
+  #define OT_SM_VDD_LOW_MV              2400
+  // Readings outside this range can't be Vdd (e.g. VREF_SENSE not fitted)
+  #define OT_SM_VDD_MIN_MV              1800
+  #define OT_SM_VDD_MAX_MV              5500
+#endif // BATTERY_MONITOR
+#if defined(QUENCH_OUT) && !defined(BURST_CAPTURE)
+  #error "QUENCH_OUT needs BURST_CAPTURE (to measure the master's burst)"
+#endif
+#if defined(LIGHTNING_MODE) && !defined(WAKEUP_BUTTON)
+  #error "LIGHTNING_MODE needs WAKEUP_BUTTON (READY's tick follows the ambient light)"
+#endif
+#if defined(LIGHTNING_MODE) && defined(OPTICAL_CONFIG)
+  #error "LIGHTNING_MODE would fire (from ADC1's ISR) on CONFIG's flashes"
+#endif
+#if defined(OPTICAL_CONFIG) && !defined(WAKEUP_BUTTON)
+  #error "OPTICAL_CONFIG needs WAKEUP_BUTTON (a long press enters CONFIG)"
+#endif
+#if defined(OPTICAL_CONFIG) && (OPTICAL_CONFIG_GROUP_MS >= OPTICAL_CONFIG_END_MS)
+  #error "OPTICAL_CONFIG_GROUP_MS must be shorter than OPTICAL_CONFIG_END_MS"
+#endif
+#if defined(EEPROM_STORE) && !defined(WAKEUP_BUTTON)
+  #error "EEPROM_STORE needs WAKEUP_BUTTON (records are written while SLEEPING)"
+#endif
+#if defined(EVENT_LOG) && !defined(EEPROM_STORE)
+  #error "EVENT_LOG needs EEPROM_STORE (the log is written with the records)"
+#endif
+#if defined(ADC_FLASH_DETECT)
+  // Flash bursts are detected by the ADC (see TRIGGER_IN_ENABLE())
+  #define OT_SM_FLASH_DETECT_CLOCK      OT_POWER_ADC
+#elif defined(BURST_CAPTURE)
+  // Flash bursts are sampled by the ADC (see OT_SM_execute_burst())
+  #define OT_SM_FLASH_DETECT_CLOCK      OT_POWER_ADC
+#else
+  #define OT_SM_FLASH_DETECT_CLOCK      0
+#endif // ADC_FLASH_DETECT
+#if defined(STORM_PROTECT)
+  // In FAULT, the RED LED blinks for OT_SM_FAULT_LED_ON_MS every
+  // OT_SM_FAULT_LED_PERIOD_MS (a power of 2)
+  #define OT_SM_FAULT_LED_PERIOD_MS     512
+  #define OT_SM_FAULT_LED_ON_MS         16
+#endif // STORM_PROTECT
+#if defined(OPTICAL_CONFIG)
+  // The setting programmed in CONFIG is selected by the count of flashes in
+  // the first group (see doc/OpticalConfig.md)
+  #define OT_SM_CONFIG_COUNT            1 // Bursts to ignore
+  #define OT_SM_CONFIG_DELAY            2 // DELAY_SENSE mode with a delay
+  #define OT_SM_CONFIG_PROFILE          3 // Camera profile (FLASH_PROFILES)
+  #define OT_SM_CONFIG_PULSES           4 // Multi-pulse count and gap
+  #define OT_SM_CONFIG_CLEAR            5 // Back to DIP[2:0]/DELAY_SENSE
+  #define OT_SM_CONFIG_MAX_GROUPS       3 // Setting and up to 2 values
+  // The RED LED acknowledges each flash for OT_SM_CONFIG_ACK_MS
+  #define OT_SM_CONFIG_ACK_MS           50
+  #define OT_SM_NO_PROFILE              0xFF
+#endif // OPTICAL_CONFIG
+
 /* NOTE: On Canon, we need >75msec to be sure we've completely detected
    pre-flashes. Hence a default PROVISIONAL_TIMEOUT of 100msec is perfect. */
 /*==============================================================================
  * MACROS
  *============================================================================*/
+// Events that are a flash burst
+#if defined(WIRELESS_COMMANDS)
+  #define OT_SM_IS_BURST(event)  ((OT_SM_EVENT_FLASH_DETECTED == (event)) || \
+                                  (OT_SM_EVENT_COMMANDED == (event)) || \
+                                  (OT_SM_EVENT_ACTIVITY == (event)))
+#else
+  #define OT_SM_IS_BURST(event)  (OT_SM_EVENT_FLASH_DETECTED == (event))
+#endif // WIRELESS_COMMANDS
+#if defined(SM_STATS)
+  // Count towards a counter of OT_SM_stats (saturating)
+  #define OT_SM_STATS_COUNT(counter) \
+    do { if (0xFFFF != OT_SM_stats.counter) ++OT_SM_stats.counter; } while (0)
+#endif // SM_STATS
 /*==============================================================================
  * TYPEDEFs and STRUCTs
  *============================================================================*/
@@ -41,18 +140,148 @@ typedef struct OT_SM_HANDLERS_S {
   OT_SM_EXIT_FUNC_T   *exitp;
 } OT_SM_HANDLERS_T;
 
+#if defined(FLASH_PROFILES)
+// A phase is a run of [min_bursts, max_bursts] bursts. The gap (in msec)
+// preceding its first burst must lie in the 'entry' window, and the gaps
+// between its bursts in the 'gap' window (both widened by the profile's
+// tolerance_ms). The gap before the very first burst of a sequence is not
+// checked.
+typedef struct OT_SM_PHASE_S {
+  uint8_t  min_bursts;
+  uint8_t  max_bursts;
+  uint16_t entry_min_ms;
+  uint16_t entry_max_ms;
+  uint16_t gap_min_ms;
+  uint16_t gap_max_ms;
+} OT_SM_PHASE_T;
+
+// The last phase of a profile is the main burst (on which we trigger)
+typedef struct OT_SM_PROFILE_S {
+  uint8_t       num_phases;
+  uint8_t       tolerance_ms;
+  OT_SM_PHASE_T phases[OT_SM_MAX_PROFILE_PHASES];
+} OT_SM_PROFILE_T;
+
+typedef enum OT_SM_MATCH_E {
+  OT_SM_MATCH_PENDING,  // Burst matches; waiting for more bursts
+  OT_SM_MATCH_MAIN,     // Burst is the main burst
+  OT_SM_MATCH_MISMATCH  // Burst does not fit the profile
+} OT_SM_MATCH_T;
+#endif // FLASH_PROFILES
+
 typedef struct OT_SM_DATA_S {
   OT_SM_STATE_T volatile state;
   uint8_t       volatile bursts_to_ignore;
   uint8_t       volatile burst_count;
   uint8_t       volatile provisional_timeout_ms; // User set or default
   uint16_t      volatile state_timeout_ms; // Upto 65.536 sec
+  uint16_t      volatile ready_timeout_ms; // Inactivity period before sleep
+#if defined(SNIFF_MODE)
+  AWU_Timebase_TypeDef volatile sniff_period;
+#endif // SNIFF_MODE
+#if defined(BATTERY_MONITOR)
+  uint8_t       volatile low_battery;
+#endif // BATTERY_MONITOR
+#if defined(FLASH_PROFILES)
+  const OT_SM_PROFILE_T *profilep; // (void*)0 when using DELAY_SENSE
+  uint8_t       volatile phase;        // Current phase of the profile
+  uint8_t       volatile phase_count;  // Bursts detected in the phase
+  uint16_t      volatile burst_gap_ms; // Time since the last burst
+#endif // FLASH_PROFILES
+#if defined(STORM_PROTECT)
+  uint16_t      volatile storm_backoff_ms; // Time the next FAULT lasts
+#if defined(WAKEUP_BUTTON)
+  uint8_t       volatile button_storm; // BUTTON_DET stays masked in FAULT
+#endif // WAKEUP_BUTTON
+#endif // STORM_PROTECT
+#if defined(BURST_CAPTURE)
+  const OT_ADC_BURST_T *burstp; // Waveform of the burst being handled
+#endif // BURST_CAPTURE
+#if defined(OPTICAL_CONFIG)
+  uint16_t      volatile button_held_ms; // In INIT, towards a long press
+  uint8_t       volatile pulses;         // Trigger pulses per sequence
+  uint8_t       volatile pulse_gap_ms;
+  uint8_t       volatile pulses_left;    // In CONFIRMED
+  uint8_t       volatile pulse_timer_ms; // Until the next of pulses_left
+  // Flash groups decoded in CONFIG
+  uint8_t       volatile groups[OT_SM_CONFIG_MAX_GROUPS];
+  uint8_t       volatile num_groups;
+  uint16_t      volatile config_gap_ms;  // Time since the last flash
+#endif // OPTICAL_CONFIG
+#if defined(HSI_CALIBRATION) && defined(WAKEUP_BUTTON)
+  uint8_t       volatile calibrate;    // Woken up; calibrate in next INIT
+#endif // HSI_CALIBRATION && WAKEUP_BUTTON
+#if defined(SM_STATS)
+  uint32_t      volatile burst_cycles; // When the last burst was handled
+  uint32_t      volatile fire_cycles;  // When TRIGGER_OUT was last asserted
+  uint8_t       volatile burst_seen;   // burst_cycles is of this wake-up
+#endif // SM_STATS
 } OT_SM_DATA_T;
+
+#if defined(OPTICAL_CONFIG)
+// Settings programmed in CONFIG. They are in force (instead of DIP[2:0] and
+// DELAY_SENSE) for as long as DIP[2:0] stays as it was when programmed.
+typedef struct OT_SM_SETTINGS_S {
+  uint8_t valid;                  // Non-zero once programmed
+  uint8_t dip;                    // DIP[2:0] when programmed
+  uint8_t bursts_to_ignore;       // OT_SM_MAX_BURSTS_TO_IGNORE: delay mode
+  uint8_t provisional_timeout_ms;
+  uint8_t profile;                // OT_SM_NO_PROFILE to count bursts
+  uint8_t pulses;
+  uint8_t pulse_gap_ms;
+} OT_SM_SETTINGS_T;
+#endif // OPTICAL_CONFIG
+
+#if defined(BATTERY_MONITOR)
+// The policy in force is the first entry whose min_vdd_mv is <= Vdd
+typedef struct OT_SM_POWER_POLICY_S {
+  uint16_t             min_vdd_mv;
+  uint16_t             ready_timeout_ms;
+  AWU_Timebase_TypeDef sniff_period; // Only used with SNIFF_MODE
+  uint8_t              low_battery;  // Non-zero to indicate a low battery
+} OT_SM_POWER_POLICY_T;
+#endif // BATTERY_MONITOR
 /*==============================================================================
  * LOCAL FUNCTION PROTOTYPES
  *============================================================================*/
 // Core state-machine functions
 static void ot_sm_set_state(OT_SM_STATE_T state_in);
+static void ot_sm_first_burst(void);
+static uint8_t ot_sm_timeout_expired(void);
+static uint16_t ot_sm_provisional_timeout(void);
+#if defined(FLASH_PROFILES)
+static uint8_t ot_sm_in_window(uint16_t gap_ms, uint16_t min_ms,
+                               uint16_t max_ms);
+static OT_SM_MATCH_T ot_sm_profile_start(void);
+static OT_SM_MATCH_T ot_sm_profile_burst(void);
+#endif // FLASH_PROFILES
+#if defined(BATTERY_MONITOR)
+static void ot_sm_apply_power_policy(void);
+#endif // BATTERY_MONITOR
+#if defined(WAKEUP_BUTTON)
+static void ot_sm_go_to_sleep(void);
+static void ot_sm_wakeup(void);
+#endif // WAKEUP_BUTTON
+#if defined(BURST_CAPTURE)
+static uint8_t ot_sm_main_burst(void);
+#endif // BURST_CAPTURE
+#if defined(WIRELESS_COMMANDS)
+static void ot_sm_commanded(void);
+#endif // WIRELESS_COMMANDS
+#if defined(QUENCH_OUT)
+static void ot_sm_quench(void);
+#endif // QUENCH_OUT
+static void ot_sm_fire(void);
+#if defined(SM_STATS)
+static uint8_t ot_sm_stats_bucket(uint32_t value);
+static void ot_sm_stats_event(OT_SM_EVENT_T event, uint32_t last_cycles);
+#endif // SM_STATS
+static void ot_sm_read_switches(void);
+#if defined(OPTICAL_CONFIG)
+static uint8_t ot_sm_settings_sane(void);
+static uint8_t ot_sm_settings_in_force(void);
+static uint8_t ot_sm_config_decode(void);
+#endif // OPTICAL_CONFIG
 
 // State-machine's entry/action/exit handlers
 static OT_SM_ENTRY_FUNC_T  ot_sm_init_entry;
@@ -72,11 +301,28 @@ static OT_SM_ENTRY_FUNC_T  ot_sm_sleeping_entry;
 static OT_SM_ACTION_FUNC_T ot_sm_sleeping_action;
 static OT_SM_EXIT_FUNC_T   ot_sm_sleeping_exit;
 #endif // WAKEUP_BUTTON
+#if defined(SNIFF_MODE)
+static OT_SM_ENTRY_FUNC_T  ot_sm_sniffing_entry;
+static OT_SM_ACTION_FUNC_T ot_sm_sniffing_action;
+static OT_SM_EXIT_FUNC_T   ot_sm_sniffing_exit;
+#endif // SNIFF_MODE
+#if defined(STORM_PROTECT)
+static OT_SM_ENTRY_FUNC_T  ot_sm_fault_entry;
+static OT_SM_ACTION_FUNC_T ot_sm_fault_action;
+static OT_SM_EXIT_FUNC_T   ot_sm_fault_exit;
+#endif // STORM_PROTECT
+#if defined(OPTICAL_CONFIG)
+static OT_SM_ENTRY_FUNC_T  ot_sm_config_entry;
+static OT_SM_ACTION_FUNC_T ot_sm_config_action;
+static OT_SM_EXIT_FUNC_T   ot_sm_config_exit;
+#endif // OPTICAL_CONFIG
 /*==============================================================================
  * LOCAL VARIABLES
  *============================================================================*/
 // CAUTION: This array is in the order of the OT_SM_STATE_T enumeration
-static OT_SM_HANDLERS_T ot_sm_handlers[OT_SM_STATE_MAX] = {
+// Note: const so it lives in flash, and so tools/wcet.py can resolve the
+// handler calls from it
+static const OT_SM_HANDLERS_T ot_sm_handlers[OT_SM_STATE_MAX] = {
   // OT_SM_STATE_INIT
   {
     &ot_sm_init_entry,
@@ -110,6 +356,59 @@ static OT_SM_HANDLERS_T ot_sm_handlers[OT_SM_STATE_MAX] = {
     &ot_sm_sleeping_exit
   }
 #endif // WAKEUP_BUTTON
+#if defined(SNIFF_MODE)
+  ,
+  // OT_SM_STATE_SNIFFING
+  {
+    &ot_sm_sniffing_entry,
+    &ot_sm_sniffing_action,
+    &ot_sm_sniffing_exit
+  }
+#endif // SNIFF_MODE
+#if defined(STORM_PROTECT)
+  ,
+  // OT_SM_STATE_FAULT
+  {
+    &ot_sm_fault_entry,
+    &ot_sm_fault_action,
+    &ot_sm_fault_exit
+  }
+#endif // STORM_PROTECT
+#if defined(OPTICAL_CONFIG)
+  ,
+  // OT_SM_STATE_CONFIG
+  {
+    &ot_sm_config_entry,
+    &ot_sm_config_action,
+    &ot_sm_config_exit
+  }
+#endif // OPTICAL_CONFIG
+};
+
+// Peripheral clocks each state needs (in the order of OT_SM_STATE_T). They are
+// switched between the exit of the old state and the entry of the new one.
+static const OT_POWER_MASK_T ot_sm_clocks[OT_SM_STATE_MAX] = {
+  OT_POWER_TICK | OT_POWER_ADC,      // OT_SM_STATE_INIT (DIP/DELAY_SENSE/Vdd)
+  OT_POWER_TICK | OT_SM_FLASH_DETECT_CLOCK, // OT_SM_STATE_READY
+  OT_POWER_TICK | OT_SM_FLASH_DETECT_CLOCK, // OT_SM_STATE_PROVISIONAL
+  OT_POWER_TICK | OT_POWER_BUSYWAIT  // OT_SM_STATE_CONFIRMED (trigger pulse)
+#if defined(WAKEUP_BUTTON)
+  ,
+  // The halt stops every clock anyway
+  OT_POWER_AWU                       // OT_SM_STATE_SLEEPING
+#endif // WAKEUP_BUTTON
+#if defined(SNIFF_MODE)
+  ,
+  OT_POWER_TICK | OT_SM_FLASH_DETECT_CLOCK  // OT_SM_STATE_SNIFFING
+#endif // SNIFF_MODE
+#if defined(STORM_PROTECT)
+  ,
+  OT_POWER_TICK                      // OT_SM_STATE_FAULT
+#endif // STORM_PROTECT
+#if defined(OPTICAL_CONFIG)
+  ,
+  OT_POWER_TICK | OT_SM_FLASH_DETECT_CLOCK  // OT_SM_STATE_CONFIG
+#endif // OPTICAL_CONFIG
 };
 
 static OT_SM_DATA_T ot_sm_data = {
@@ -117,11 +416,107 @@ static OT_SM_DATA_T ot_sm_data = {
   .bursts_to_ignore       = OT_SM_DEFAULT_BURSTS_TO_IGNORE,
   .burst_count            = 0,
   .provisional_timeout_ms = OT_SM_PROVISIONAL_TIMEOUT_MS,
-  .state_timeout_ms       = 0
+  .state_timeout_ms       = 0,
+  .ready_timeout_ms       = OT_SM_READY_TIMEOUT_MS,
+#if defined(SNIFF_MODE)
+  .sniff_period           = OT_SM_SNIFF_PERIOD,
+#endif // SNIFF_MODE
+#if defined(BATTERY_MONITOR)
+  .low_battery            = 0,
+#endif // BATTERY_MONITOR
+#if defined(FLASH_PROFILES)
+  .profilep               = (void*)0,
+  .phase                  = 0,
+  .phase_count            = 0,
+  .burst_gap_ms           = 0,
+#endif // FLASH_PROFILES
+#if defined(STORM_PROTECT)
+  .storm_backoff_ms       = STORM_BACKOFF_MIN_MS,
+#if defined(WAKEUP_BUTTON)
+  .button_storm           = 0,
+#endif // WAKEUP_BUTTON
+#endif // STORM_PROTECT
+#if defined(OPTICAL_CONFIG)
+  .button_held_ms         = 0,
+  .pulses                 = 1,
+  .pulse_gap_ms           = OPTICAL_CONFIG_PULSE_STEP_MS,
+  .pulses_left            = 0,
+  .pulse_timer_ms         = 0,
+  .num_groups             = 0,
+  .config_gap_ms          = 0,
+#endif // OPTICAL_CONFIG
+#if defined(HSI_CALIBRATION) && defined(WAKEUP_BUTTON)
+  .calibrate              = 0, // OT_TIMER_calibrate() runs at start-up anyway
+#endif // HSI_CALIBRATION && WAKEUP_BUTTON
 };
+
+#if defined(OPTICAL_CONFIG)
+// Kept in RAM, so across SLEEPING (but not a power cycle)
+static OT_SM_SETTINGS_T ot_sm_settings = {
+  .valid                  = 0,
+};
+#endif // OPTICAL_CONFIG
+
+#if defined(FLASH_PROFILES)
+// Camera profiles selected by DIP[2:0] (0..6). See doc/FlashTraces.md for the
+// sequences these windows were derived from.
+// CAUTION: This array is indexed by the DIP[2:0] setting
+static const OT_SM_PROFILE_T ot_sm_profiles[OT_SM_MAX_BURSTS_TO_IGNORE] = {
+  // 0: Manual (no pre-flash)
+  { 1, 0, {
+    { 1, 1,    0,    0, 0,  0 }  // Main
+  } },
+  // 1: Canon E-TTL
+  { 2, 5, {
+    { 1, 1,    0,    0, 0,  0 }, // Metering pre-flash
+    { 1, 1,   40,   90, 0,  0 }  // Main
+  } },
+  // 2: Canon E-TTL with red-eye reduction
+  { 3, 5, {
+    { 3, 3,    0,    0, 60, 100 }, // Red-eye bursts
+    { 1, 1,  300,  600, 0,  0 },   // Metering pre-flash
+    { 1, 1,   40,   90, 0,  0 }    // Main
+  } },
+  // 3: Nikon i-TTL
+  { 2, 1, {
+    { 1, 15,   0,    0, 1,  2 }, // Monitor pre-flash train
+    { 1, 1,   50,  110, 0,  0 }  // Main
+  } },
+  // 4: Nikon i-TTL with red-eye reduction
+  { 3, 1, {
+    { 3, 3,    0,    0, 70, 110 }, // Red-eye bursts
+    { 1, 15, 300,  600, 1,  2 },   // Monitor pre-flash train
+    { 1, 1,   50,  110, 0,  0 }    // Main
+  } },
+  // 5: Sony ADI/P-TTL
+  { 2, 5, {
+    { 1, 1,    0,    0, 0,  0 }, // Metering pre-flash
+    { 1, 1,   40,  100, 0,  0 }  // Main
+  } },
+  // 6: Generic single pre-flash
+  { 2, 5, {
+    { 1, 1,    0,    0, 0,  0 }, // Pre-flash
+    { 1, 1,   20,  150, 0,  0 }  // Main
+  } }
+};
+#endif // FLASH_PROFILES
+
+#if defined(BATTERY_MONITOR)
+// CAUTION: This array is in decreasing order of min_vdd_mv and the last
+// entry must have a min_vdd_mv of 0
+static const OT_SM_POWER_POLICY_T ot_sm_power_policy[] = {
+  { OT_SM_VDD_GOOD_MV, OT_SM_READY_TIMEOUT_MS, OT_SM_SNIFF_PERIOD, 0 },
+  { OT_SM_VDD_FAIR_MV, 30000,                  AWU_TIMEBASE_512MS, 0 },
+  { OT_SM_VDD_LOW_MV,  10000,                  AWU_TIMEBASE_1S,    1 },
+  { 0,                 5000,                   AWU_TIMEBASE_2S,    1 }
+};
+#endif // BATTERY_MONITOR
 /*==============================================================================
  * GLOBAL (extern) VARIABLES
  *============================================================================*/
+#if defined(SM_STATS)
+volatile OT_SM_STATS_T OT_SM_stats;
+#endif // SM_STATS
 /*==============================================================================
  * LOCAL FUNCTIONS
  *============================================================================*/
@@ -142,12 +537,16 @@ static void ot_sm_set_state(OT_SM_STATE_T state_in) {
     // First execute the exit function of the current ot_state, if any
     if (ot_sm_data.state < OT_SM_STATE_MAX) {
       OT_SM_EXIT_FUNC_T  *exitp;
+#if defined(SM_STATS)
+      OT_SM_STATS_COUNT(transitions[ot_sm_data.state][state_in]);
+#endif // SM_STATS
       exitp = ot_sm_handlers[ot_sm_data.state].exitp;
       if ((void*)0 != exitp) (*exitp)();
     }
 
     // Update our state
     ot_sm_data.state = state_in;
+    OT_POWER_set(ot_sm_clocks[ot_sm_data.state]);
 
     // Finally execute the entry function of the new ot_state, if any
     entryp = ot_sm_handlers[ot_sm_data.state].entryp;
@@ -155,8 +554,141 @@ static void ot_sm_set_state(OT_SM_STATE_T state_in) {
   }
   return;
 }
+/*==============================================================================
+ * DESCRIPTION: Classify the burst being handled by its waveform
+ * @param
+ * @return Non-zero if it is a main burst, i.e. longer and stronger than any
+ *         pre-flash (see BURST_MAIN_DURATION and BURST_MAIN_ENERGY)
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes Only ever skips the count: a main burst too short to be told apart
+ *        is still confirmed by the count (or profile). In DELAY_SENSE mode
+ *        the count is never reached so the waveform isn't used either.
+ *============================================================================*/
+#if defined(BURST_CAPTURE)
+static uint8_t ot_sm_main_burst(void) {
+  const OT_ADC_BURST_T *burstp = ot_sm_data.burstp;
+  if ((void*)0 == burstp) return 0;
+  if (OT_SM_MAX_BURSTS_TO_IGNORE == ot_sm_data.bursts_to_ignore) return 0;
+  return (burstp->duration >= BURST_MAIN_DURATION) &&
+         (burstp->energy >= BURST_MAIN_ENERGY);
+}
+#endif // BURST_CAPTURE
+/*==============================================================================
+ * DESCRIPTION: Handle the main burst a wireless master commanded our group to
+ * fire on
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes The command decoder has already skipped the pre-flashes, so there is
+ *        nothing to count
+ *============================================================================*/
+#if defined(WIRELESS_COMMANDS)
+static void ot_sm_commanded(void) {
+  ++ot_sm_data.burst_count; // For the EVENT_LOG's trigger entry
+  ot_sm_set_state(OT_SM_STATE_CONFIRMED);
+  return;
+}
+#endif // WIRELESS_COMMANDS
+/*==============================================================================
+ * DESCRIPTION: Time the slave's quench from the master's burst
+ * @param
+ * @return
+ * @precondition TRIGGER_OUT has just been turned on
+ * @postcondition
+ * @caution
+ * @notes The capture ends before the trigger, so a burst that ended within
+ *        it has a known duration; one that didn't is matched at full power.
+ *        The end is taken halfway between the last sample above half the
+ *        peak and the next; a burst over before the first sample, halfway
+ *        through QUENCH_LEAD_CYCLES.
+ *        tools/host/quench_test.c reports the resulting error per master
+ *        power.
+ *============================================================================*/
+#if defined(QUENCH_OUT)
+static void ot_sm_quench(void) {
+  const OT_ADC_BURST_T *burstp = ot_sm_data.burstp;
+  uint32_t delay = QUENCH_LEAD_CYCLES >> 1;
+  if ((void*)0 == burstp) return;
+  if (burstp->highest >= QUENCH_MIN_LEVEL) {
+    if (0 == burstp->ended) return;
+    delay = QUENCH_LEAD_CYCLES - (BURST_CAPTURE_SAMPLE_CYCLES >> 1) +
+            (uint32_t)burstp->duration * BURST_CAPTURE_SAMPLE_CYCLES;
+  }
+  delay = (delay * QUENCH_RATIO_16THS) >> 4;
+  OT_TIMER_quench_after((delay > 0xFFFF) ? 0xFFFF : (uint16_t)delay);
+  return;
+}
+#endif // QUENCH_OUT
+/*==============================================================================
+ * DESCRIPTION: Fire the slave flash (one trigger pulse)
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution Busy-waits for OT_SM_TRIGGER_DURATION_uS
+ * @notes
+ *============================================================================*/
+static void ot_sm_fire(void) {
+  TRIGGER_OUT_ON(); // Trigger the slave flash
+#if defined(SM_STATS)
+  ot_sm_data.fire_cycles = OT_TIMER_cycles32();
+#endif // SM_STATS
+#if defined(QUENCH_OUT)
+  ot_sm_quench();
+#endif // QUENCH_OUT
+  OT_TIMER_busywait_us(OT_SM_TRIGGER_DURATION_uS);
+  TRIGGER_OUT_OFF(); // Release the trigger
+  return;
+}
 /*==============================================================================
  * DESCRIPTION:
+ * @param value - the value to bucket
+ * @return its bucket in a log2 histogram of OT_SM_stats, i.e. its number of
+ *         significant bits (at most OT_SM_STATS_BUCKETS - 1)
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes At most OT_SM_STATS_BUCKETS - 1 iterations
+ *============================================================================*/
+#if defined(SM_STATS)
+static uint8_t ot_sm_stats_bucket(uint32_t value) {
+  uint8_t bucket = 0;
+  while ((0 != value) && (bucket < (OT_SM_STATS_BUCKETS - 1))) {
+    value >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+#endif // SM_STATS
+/*==============================================================================
+ * DESCRIPTION: Count a handled event in OT_SM_stats
+ * @param event - the event
+ * @param last_cycles - ot_sm_data.burst_cycles before the event
+ * @return
+ * @precondition The event was handled
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+#if defined(SM_STATS)
+static void ot_sm_stats_event(OT_SM_EVENT_T event, uint32_t last_cycles) {
+  OT_SM_STATS_COUNT(events[event]);
+  if (OT_SM_IS_BURST(event)) {
+    if (0 != ot_sm_data.burst_seen) {
+      OT_SM_STATS_COUNT(burst_interval[ot_sm_stats_bucket(
+        (ot_sm_data.burst_cycles - last_cycles) >> 10)]);
+    }
+    ot_sm_data.burst_seen = 1;
+  }
+  return;
+}
+#endif // SM_STATS
+/*==============================================================================
+ * DESCRIPTION: Handle the first flash burst of a (possible) sequence.
  * @param
  * @return
  * @precondition
@@ -164,7 +696,209 @@ static void ot_sm_set_state(OT_SM_STATE_T state_in) {
  * @caution
  * @notes
  *============================================================================*/
-static void ot_sm_init_entry(void) {
+static void ot_sm_first_burst(void) {
+  ++ot_sm_data.burst_count;
+#if defined(LIGHTNING_MODE)
+  // Every fast rise is an event of its own: there are no pre-flashes to skip
+  // (and TRIGGER_OUT is already on, see ot_adc_isr)
+  ot_sm_set_state(OT_SM_STATE_CONFIRMED);
+#else
+#if defined(BURST_CAPTURE)
+  if (ot_sm_main_burst()) {
+    ot_sm_set_state(OT_SM_STATE_CONFIRMED);
+    return;
+  }
+#endif // BURST_CAPTURE
+#if defined(FLASH_PROFILES)
+  if ((void*)0 != ot_sm_data.profilep) {
+    if (OT_SM_MATCH_MAIN == ot_sm_profile_start()) {
+      ot_sm_set_state(OT_SM_STATE_CONFIRMED);
+    }
+    else {
+      ot_sm_set_state(OT_SM_STATE_PROVISIONAL);
+    }
+    return;
+  }
+#endif // FLASH_PROFILES
+  // If we've exceeded the number of bursts to ignore we are done here
+  // (which happens when bursts_to_ignore is 0)
+  if (0 == ot_sm_data.bursts_to_ignore) {
+    ot_sm_set_state(OT_SM_STATE_CONFIRMED);
+  }
+  else {
+    // Go to PROVISIONAL; it will set the appropriate timeout
+    ot_sm_set_state(OT_SM_STATE_PROVISIONAL);
+  }
+#endif // LIGHTNING_MODE
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Count down the state timer on a TIMEOUT event
+ * @param
+ * @return Non-zero if the state's waiting period has expired
+ * @precondition
+ * @postcondition - state_timeout_ms never wraps around
+ * @caution
+ * @notes - A TIMEOUT event that arrives once the count has reached 0 (e.g. an
+ *          update that was pending when the timer was stopped) is treated as
+ *          expired rather than wrapping to 65535, which would otherwise keep
+ *          us in the state for another ~65sec.
+ *============================================================================*/
+static uint8_t ot_sm_timeout_expired(void) {
+  if (0 != ot_sm_data.state_timeout_ms) {
+    --ot_sm_data.state_timeout_ms;
+  }
+  return (0 == ot_sm_data.state_timeout_ms);
+}
+/*==============================================================================
+ * DESCRIPTION: Time (msec) to wait in PROVISIONAL for the next flash burst
+ * @param
+ * @return
+ * @precondition
+ * @postcondition - Return value is non-zero
+ * @caution
+ * @notes
+ *============================================================================*/
+static uint16_t ot_sm_provisional_timeout(void) {
+#if defined(FLASH_PROFILES)
+  if ((void*)0 != ot_sm_data.profilep) {
+    const OT_SM_PHASE_T *phasep;
+    uint16_t timeout_ms = 0;
+    phasep = &ot_sm_data.profilep->phases[ot_sm_data.phase];
+    // Either another burst of this phase or the first of the next phase
+    if (ot_sm_data.phase_count < phasep->max_bursts) {
+      timeout_ms = phasep->gap_max_ms;
+    }
+    if ((ot_sm_data.phase_count >= phasep->min_bursts) &&
+        ((ot_sm_data.phase + 1) < ot_sm_data.profilep->num_phases) &&
+        ((phasep + 1)->entry_max_ms > timeout_ms)) {
+      timeout_ms = (phasep + 1)->entry_max_ms;
+    }
+    return (timeout_ms + ot_sm_data.profilep->tolerance_ms + 1);
+  }
+#endif // FLASH_PROFILES
+  // The provisional_timeout_ms has been assigned the right value in INIT state
+  return ot_sm_data.provisional_timeout_ms;
+}
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return Non-zero if gap_ms lies within [min_ms, max_ms] +/- tolerance
+ * @precondition - A profile is selected
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+#if defined(FLASH_PROFILES)
+static uint8_t ot_sm_in_window(uint16_t gap_ms, uint16_t min_ms,
+                               uint16_t max_ms) {
+  uint8_t tolerance_ms = ot_sm_data.profilep->tolerance_ms;
+  if ((min_ms > tolerance_ms) && (gap_ms < (min_ms - tolerance_ms))) return 0;
+  if (gap_ms > (max_ms + tolerance_ms)) return 0;
+  return 1;
+}
+#endif // FLASH_PROFILES
+/*==============================================================================
+ * DESCRIPTION: (Re)start matching the selected profile with a first burst
+ * @param
+ * @return
+ * @precondition - A profile is selected
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+#if defined(FLASH_PROFILES)
+static OT_SM_MATCH_T ot_sm_profile_start(void) {
+  ot_sm_data.phase        = 0;
+  ot_sm_data.phase_count  = 1;
+  ot_sm_data.burst_gap_ms = 0;
+  return (1 == ot_sm_data.profilep->num_phases) ? OT_SM_MATCH_MAIN :
+                                                  OT_SM_MATCH_PENDING;
+}
+#endif // FLASH_PROFILES
+/*==============================================================================
+ * DESCRIPTION: Match a (subsequent) burst against the selected profile
+ * @param
+ * @return
+ * @precondition - A profile is selected and ot_sm_profile_start() was called
+ * @postcondition
+ * @caution
+ * @notes - Moving on to the next phase is preferred as soon as the current
+ *          phase may be complete; this lets the main burst fire the slave
+ *          the moment it arrives.
+ *============================================================================*/
+#if defined(FLASH_PROFILES)
+static OT_SM_MATCH_T ot_sm_profile_burst(void) {
+  const OT_SM_PHASE_T *phasep;
+  uint16_t gap_ms = ot_sm_data.burst_gap_ms;
+
+  ot_sm_data.burst_gap_ms = 0;
+  phasep = &ot_sm_data.profilep->phases[ot_sm_data.phase];
+
+  if ((ot_sm_data.phase_count >= phasep->min_bursts) &&
+      ((ot_sm_data.phase + 1) < ot_sm_data.profilep->num_phases) &&
+      ot_sm_in_window(gap_ms, (phasep + 1)->entry_min_ms,
+                      (phasep + 1)->entry_max_ms)) {
+    ++ot_sm_data.phase;
+    ot_sm_data.phase_count = 1;
+    if ((ot_sm_data.phase + 1) == ot_sm_data.profilep->num_phases) {
+      return OT_SM_MATCH_MAIN;
+    }
+    return OT_SM_MATCH_PENDING;
+  }
+
+  if ((ot_sm_data.phase_count < phasep->max_bursts) &&
+      ot_sm_in_window(gap_ms, phasep->gap_min_ms, phasep->gap_max_ms)) {
+    ++ot_sm_data.phase_count;
+    return OT_SM_MATCH_PENDING;
+  }
+
+  return OT_SM_MATCH_MISMATCH;
+}
+#endif // FLASH_PROFILES
+/*==============================================================================
+ * DESCRIPTION: Measure Vdd and apply the matching entry of the power policy.
+ * @param
+ * @return
+ * @precondition - The sensor (which powers the voltage reference) is ON
+ * @postcondition
+ * @caution
+ * @notes An implausible reading is discarded: the policy in force is kept.
+ *        ADC1 is clocked for the conversion (it is gated in e.g. READY, and
+ *        the conversion would never complete), then the state's clocks are
+ *        restored
+ *============================================================================*/
+#if defined(BATTERY_MONITOR)
+static void ot_sm_apply_power_policy(void) {
+  OT_POWER_MASK_T clocks = OT_POWER_get();
+  const OT_SM_POWER_POLICY_T *policyp = &ot_sm_power_policy[0];
+  uint16_t vdd_mv;
+
+  OT_POWER_set(clocks | OT_POWER_ADC);
+  vdd_mv = OT_ADC_read_vdd_mv();
+  OT_POWER_set(clocks);
+
+  if ((vdd_mv < OT_SM_VDD_MIN_MV) || (vdd_mv > OT_SM_VDD_MAX_MV)) return;
+  while (vdd_mv < policyp->min_vdd_mv) ++policyp;
+
+  ot_sm_data.ready_timeout_ms = policyp->ready_timeout_ms;
+#if defined(SNIFF_MODE)
+  ot_sm_data.sniff_period     = policyp->sniff_period;
+#endif // SNIFF_MODE
+  ot_sm_data.low_battery      = policyp->low_battery;
+  return;
+}
+#endif // BATTERY_MONITOR
+/*==============================================================================
+ * DESCRIPTION: Take the settings from DIP[2:0] (and DELAY_SENSE)
+ * @param
+ * @return
+ * @precondition - The DIP switches are enabled
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static void ot_sm_read_switches(void) {
   ot_sm_data.bursts_to_ignore = OT_GPIO_bursts_to_ignore();
 
   // Check if we should use the DELAY_SENSE analog value to determine the
@@ -180,10 +914,274 @@ static void ot_sm_init_entry(void) {
   else { // Use default value
     ot_sm_data.provisional_timeout_ms = OT_SM_PROVISIONAL_TIMEOUT_MS;
   }
+#if defined(FLASH_PROFILES)
+  // DIP[2:0] (other than 'timeout' mode) select a camera profile
+  if (OT_SM_MAX_BURSTS_TO_IGNORE == ot_sm_data.bursts_to_ignore) {
+    ot_sm_data.profilep = (void*)0;
+  }
+  else {
+    ot_sm_data.profilep = &ot_sm_profiles[ot_sm_data.bursts_to_ignore];
+  }
+#endif // FLASH_PROFILES
+#if defined(OPTICAL_CONFIG)
+  ot_sm_data.pulses       = 1;
+  ot_sm_data.pulse_gap_ms = OPTICAL_CONFIG_PULSE_STEP_MS;
+#endif // OPTICAL_CONFIG
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Range-check the settings programmed in CONFIG
+ * @param
+ * @return Non-zero if every setting is one ot_sm_config_decode() can produce
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes They may come from the EEPROM (EEPROM_STORE), e.g. a record written
+ *        by a build with other limits
+ *============================================================================*/
+#if defined(OPTICAL_CONFIG)
+static uint8_t ot_sm_settings_sane(void) {
+  if ((ot_sm_settings.bursts_to_ignore > OT_SM_MAX_BURSTS_TO_IGNORE) ||
+      (0 == ot_sm_settings.provisional_timeout_ms) ||
+      (0 == ot_sm_settings.pulses) ||
+      (ot_sm_settings.pulses > OPTICAL_CONFIG_MAX_PULSES) ||
+      (0 == ot_sm_settings.pulse_gap_ms)) {
+    return 0;
+  }
+#if defined(FLASH_PROFILES)
+  if ((OT_SM_NO_PROFILE != ot_sm_settings.profile) &&
+      (ot_sm_settings.profile >= OT_SM_MAX_BURSTS_TO_IGNORE)) {
+    return 0;
+  }
+#endif // FLASH_PROFILES
+  return 1;
+}
+#endif // OPTICAL_CONFIG
+/*==============================================================================
+ * DESCRIPTION: Apply the settings programmed in CONFIG, if still in force
+ * @param
+ * @return Non-zero if applied (instead of reading the switches)
+ * @precondition - The DIP switches are enabled
+ * @postcondition The settings are dropped if DIP[2:0] was changed since, or
+ *                if they are out of range
+ * @caution
+ * @notes
+ *============================================================================*/
+#if defined(OPTICAL_CONFIG)
+static uint8_t ot_sm_settings_in_force(void) {
+  if ((0 == ot_sm_settings.valid) ||
+      (ot_sm_settings.dip != OT_GPIO_bursts_to_ignore()) ||
+      (0 == ot_sm_settings_sane())) {
+    ot_sm_settings.valid = 0; // The switches take over again
+    return 0;
+  }
+  ot_sm_data.bursts_to_ignore       = ot_sm_settings.bursts_to_ignore;
+  ot_sm_data.provisional_timeout_ms = ot_sm_settings.provisional_timeout_ms;
+#if defined(FLASH_PROFILES)
+  if (OT_SM_NO_PROFILE == ot_sm_settings.profile) {
+    ot_sm_data.profilep = (void*)0;
+  }
+  else {
+    ot_sm_data.profilep = &ot_sm_profiles[ot_sm_settings.profile];
+  }
+#endif // FLASH_PROFILES
+  ot_sm_data.pulses       = ot_sm_settings.pulses;
+  ot_sm_data.pulse_gap_ms = ot_sm_settings.pulse_gap_ms;
+  return 1;
+}
+#endif // OPTICAL_CONFIG
+/*==============================================================================
+ * DESCRIPTION: Decode the groups of flashes seen in CONFIG into the settings
+ * @param
+ * @return Non-zero if they were a valid sequence (see doc/OpticalConfig.md)
+ * @precondition - In CONFIG, the settings in force are in ot_sm_data
+ * @postcondition ot_sm_settings is updated (only) for a valid sequence
+ * @caution
+ * @notes The settings not programmed keep their value, from the switches if
+ *        nothing was programmed before
+ *============================================================================*/
+#if defined(OPTICAL_CONFIG)
+static uint8_t ot_sm_config_decode(void) {
+  uint8_t num_groups = ot_sm_data.num_groups;
+  uint8_t count      = ot_sm_data.groups[1]; // Flashes in the value group(s)
+  uint8_t count2     = ot_sm_data.groups[2];
+
+  // Check the setting and its value(s) first; num_groups exceeds
+  // OT_SM_CONFIG_MAX_GROUPS if there were too many groups
+  switch (ot_sm_data.groups[0]) {
+    case OT_SM_CONFIG_CLEAR:
+      if (1 != num_groups) return 0;
+      ot_sm_settings.valid = 0;
+      return 1;
+    case OT_SM_CONFIG_COUNT:
+#if defined(FLASH_PROFILES)
+    case OT_SM_CONFIG_PROFILE:
+#endif // FLASH_PROFILES
+      // 1 flash for 0 (i.e. fire on the first burst)
+      if ((2 != num_groups) || (count > OT_SM_MAX_BURSTS_TO_IGNORE)) return 0;
+      break;
+    case OT_SM_CONFIG_DELAY:
+      if ((2 != num_groups) ||
+          (count > (0xFF / OPTICAL_CONFIG_DELAY_STEP_MS))) return 0;
+      break;
+    case OT_SM_CONFIG_PULSES:
+      if ((2 != num_groups) && (3 != num_groups)) return 0;
+      if (count > OPTICAL_CONFIG_MAX_PULSES) return 0;
+      if ((3 == num_groups) &&
+          (count2 > (0xFF / OPTICAL_CONFIG_PULSE_STEP_MS))) return 0;
+      break;
+    default:
+      return 0;
+  }
+
+  if (0 == ot_sm_settings.valid) {
+    // Start from the settings in force (read from the switches)
+    ot_sm_settings.bursts_to_ignore = ot_sm_data.bursts_to_ignore;
+    ot_sm_settings.provisional_timeout_ms = ot_sm_data.provisional_timeout_ms;
+    ot_sm_settings.profile = OT_SM_NO_PROFILE;
+#if defined(FLASH_PROFILES)
+    if ((void*)0 != ot_sm_data.profilep) {
+      ot_sm_settings.profile = ot_sm_data.bursts_to_ignore;
+    }
+#endif // FLASH_PROFILES
+    ot_sm_settings.pulses       = ot_sm_data.pulses;
+    ot_sm_settings.pulse_gap_ms = ot_sm_data.pulse_gap_ms;
+  }
+
+  switch (ot_sm_data.groups[0]) {
+    case OT_SM_CONFIG_COUNT:
+      ot_sm_settings.bursts_to_ignore = count - 1;
+      ot_sm_settings.provisional_timeout_ms = OT_SM_PROVISIONAL_TIMEOUT_MS;
+      ot_sm_settings.profile = OT_SM_NO_PROFILE;
+      break;
+    case OT_SM_CONFIG_DELAY:
+      ot_sm_settings.bursts_to_ignore = OT_SM_MAX_BURSTS_TO_IGNORE;
+      ot_sm_settings.provisional_timeout_ms =
+        count * OPTICAL_CONFIG_DELAY_STEP_MS;
+      ot_sm_settings.profile = OT_SM_NO_PROFILE;
+      break;
+#if defined(FLASH_PROFILES)
+    case OT_SM_CONFIG_PROFILE:
+      // As selected by DIP[2:0]
+      ot_sm_settings.bursts_to_ignore = count - 1;
+      ot_sm_settings.provisional_timeout_ms = OT_SM_PROVISIONAL_TIMEOUT_MS;
+      ot_sm_settings.profile = count - 1;
+      break;
+#endif // FLASH_PROFILES
+    default: // OT_SM_CONFIG_PULSES
+      ot_sm_settings.pulses = count;
+      if (3 == num_groups) {
+        ot_sm_settings.pulse_gap_ms = count2 * OPTICAL_CONFIG_PULSE_STEP_MS;
+      }
+      break;
+  }
+  ot_sm_settings.dip   = OT_GPIO_bursts_to_ignore();
+  ot_sm_settings.valid = 1;
+  return 1;
+}
+#endif // OPTICAL_CONFIG
+/*==============================================================================
+ * DESCRIPTION: Go from READY to SLEEPING, for the first time since waking up.
+ * @param
+ * @return
+ * @precondition - The sensor (which powers the voltage reference) is ON
+ * @postcondition
+ * @caution
+ * @notes SLEEPING is re-entered after every sniff (SNIFF_MODE); what needs
+ *        doing only once per sleep is done here rather than on its entry.
+ *============================================================================*/
+#if defined(WAKEUP_BUTTON)
+static void ot_sm_go_to_sleep(void) {
+#if defined(STORM_PROTECT)
+  // No storm for as long; start backing off afresh
+  ot_sm_data.storm_backoff_ms = STORM_BACKOFF_MIN_MS;
+#endif // STORM_PROTECT
+#if defined(BATTERY_MONITOR)
+  // Re-check the battery (while the sensor is still ON) before sleeping
+  ot_sm_apply_power_policy();
+#endif // BATTERY_MONITOR
+#if defined(EEPROM_STORE)
+  OT_EE_COUNT(sleeps);
+#endif // EEPROM_STORE
+  ot_sm_set_state(OT_SM_STATE_SLEEPING);
+#if defined(EEPROM_STORE)
+#if defined(OPTICAL_CONFIG)
+  OT_EE_save_settings(&ot_sm_settings, sizeof(ot_sm_settings));
+#endif // OPTICAL_CONFIG
+  // Nothing is time-critical until we wake up: save what changed since the
+  // last record. Not after a sniff, or every glitch and burst it counted
+  // would cost a record.
+  OT_EE_commit();
+#endif // EEPROM_STORE
+  return;
+}
+#endif // WAKEUP_BUTTON
+/*==============================================================================
+ * DESCRIPTION: Restore what SLEEPING powered down, before leaving for good.
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+#if defined(WAKEUP_BUTTON)
+static void ot_sm_wakeup(void) {
+  SENSOR_ON(); // Power on the Flash burst sensor
+  DIP_ENABLE(); // Add pull-ups to the DIP switches
+#if defined(HSI_CALIBRATION)
+  // The temperature may have changed while asleep
+  ot_sm_data.calibrate = 1;
+#endif // HSI_CALIBRATION
+  return;
+}
+#endif // WAKEUP_BUTTON
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static void ot_sm_init_entry(void) {
+#if defined(OPTICAL_CONFIG)
+  // The settings programmed in CONFIG take precedence
+  if (0 == ot_sm_settings_in_force())
+#endif // OPTICAL_CONFIG
+  ot_sm_read_switches();
+
+#if defined(BATTERY_MONITOR)
+  ot_sm_apply_power_policy();
+  if (ot_sm_data.low_battery) {
+    RED_LED_ON(); // Together with the GREEN LED, indicates a low battery
+  }
+#endif // BATTERY_MONITOR
 
   GREEN_LED_ON(); // Turn ON GREEN LED to show we're starting
+#if defined(HSI_CALIBRATION) && defined(WAKEUP_BUTTON)
+  // Once per wake-up (and at start-up), not after every trigger: the
+  // windows delay TRIGGER_IN. Measured from the main loop, while INIT
+  // ignores flash bursts (unless FAST_WAKEUP), and applied from the next
+  // state on.
+  if (0 != ot_sm_data.calibrate) {
+    ot_sm_data.calibrate = 0;
+    OT_TIMER_calibrate_request();
+  }
+#endif // HSI_CALIBRATION && WAKEUP_BUTTON
   ot_sm_data.state_timeout_ms = OT_SM_INIT_TIMEOUT_MS;
   OT_TIMER_start(); // sends TIMEOUT events every ~1msec
+#if defined(FAST_WAKEUP)
+  // TRIGGER_IN is armed (while the GREEN LED is still on) once the sensor has
+  // settled (see action)
+  ot_sm_data.burst_count = 0; // Reset our internal counters
+#endif // FAST_WAKEUP
+#if defined(OPTICAL_CONFIG)
+  // Pull BUTTON_DET up to tell a long press (its edges are ignored here)
+  ot_sm_data.button_held_ms = 0;
+  BUTTON_ENABLE();
+#endif // OPTICAL_CONFIG
   return;
 }
 /*==============================================================================
@@ -197,10 +1195,31 @@ static void ot_sm_init_entry(void) {
  *============================================================================*/
 static void ot_sm_init_action(OT_SM_EVENT_T event) {
   if (OT_SM_EVENT_TIMEOUT == event) {
-    if (0 == --ot_sm_data.state_timeout_ms) {
+#if defined(OPTICAL_CONFIG)
+    if (BUTTON_HELD()) {
+      // INIT lasts as long as the button is held; a long press enters CONFIG
+      if (++ot_sm_data.button_held_ms >= OPTICAL_CONFIG_HOLD_MS) {
+        ot_sm_set_state(OT_SM_STATE_CONFIG);
+      }
+    }
+    else
+#endif // OPTICAL_CONFIG
+    if (ot_sm_timeout_expired()) {
       ot_sm_set_state(OT_SM_STATE_READY);
     }
+#if defined(FAST_WAKEUP)
+    else if ((OT_SM_INIT_TIMEOUT_MS - SENSOR_SETTLE_MS) ==
+             ot_sm_data.state_timeout_ms) {
+      TRIGGER_IN_ENABLE(); // Sensor has settled; enable Flash burst interrupt
+    }
+#endif // FAST_WAKEUP
   }
+#if defined(FAST_WAKEUP)
+  else if (OT_SM_EVENT_FLASH_DETECTED == event) {
+    // Handle it as if we were READY
+    ot_sm_first_burst();
+  }
+#endif // FAST_WAKEUP
   // Ignore all other events and stay in the same state
   return;
 }
@@ -214,10 +1233,19 @@ static void ot_sm_init_action(OT_SM_EVENT_T event) {
  * @notes
  *============================================================================*/
 static void ot_sm_init_exit(void) {
+#if defined(FAST_WAKEUP)
+  TRIGGER_IN_DISABLE(); // Disable Flash burst interrupt
+#endif // FAST_WAKEUP
+#if defined(OPTICAL_CONFIG)
+  BUTTON_DISABLE();
+#endif // OPTICAL_CONFIG
   // cancel/stop state timer
   OT_TIMER_stop();
   ot_sm_data.state_timeout_ms = 0;
   GREEN_LED_OFF(); // Turn off GREEN LED to indicate we're moving to READY
+#if defined(BATTERY_MONITOR)
+  RED_LED_OFF(); // Low battery indication (if any)
+#endif // BATTERY_MONITOR
   return;
 }
 /*==============================================================================
@@ -233,8 +1261,8 @@ static void ot_sm_ready_entry(void) {
   ot_sm_data.burst_count = 0; // Reset our internal counters
 #if defined(WAKEUP_BUTTON)
   // Set a timer to enter sleep if there is no flash/user activity
-  ot_sm_data.state_timeout_ms = OT_SM_READY_TIMEOUT_MS;
-  OT_TIMER_start(); // sends TIMEOUT events every ~1msec  return;
+  ot_sm_data.state_timeout_ms = ot_sm_data.ready_timeout_ms;
+  OT_TIMER_start(); // sends TIMEOUT events every ~1msec
   // Enable the Button Interrupt (in case user checks to see if we are awake or
   // requests us to re-read settings)
   BUTTON_ENABLE();
@@ -253,27 +1281,32 @@ static void ot_sm_ready_entry(void) {
  *============================================================================*/
 static void ot_sm_ready_action(OT_SM_EVENT_T event) {
   if (OT_SM_EVENT_FLASH_DETECTED == event) {
-    ++ot_sm_data.burst_count;
-    // If we've exceeded the number of bursts to ignore we are done here
-    // (which happens when bursts_to_ignore is 0)
-    if (0 == ot_sm_data.bursts_to_ignore) {
-      ot_sm_set_state(OT_SM_STATE_CONFIRMED);
-    }
-    else {
-      // Go to PROVISIONAL; it will set the appropriate timeout
-      ot_sm_set_state(OT_SM_STATE_PROVISIONAL);
-    }
+    ot_sm_first_burst();
   }
+#if defined(WIRELESS_COMMANDS)
+  else if (OT_SM_EVENT_COMMANDED == event) {
+    ot_sm_commanded();
+  }
+#if defined(WAKEUP_BUTTON)
+  else if (OT_SM_EVENT_ACTIVITY == event) {
+    // A master is active; don't go to sleep on it
+    ot_sm_data.state_timeout_ms = ot_sm_data.ready_timeout_ms;
+  }
+#endif // WAKEUP_BUTTON
+#endif // WIRELESS_COMMANDS
 #if defined(WAKEUP_BUTTON)
   else if (OT_SM_EVENT_TIMEOUT == event) {
-    if (0 == --ot_sm_data.state_timeout_ms) { // Waiting period has expired
+#if defined(ADC_FLASH_DETECT)
+    OT_ADC_flash_track(); // Follow the ambient light (or its derivative)
+#endif // ADC_FLASH_DETECT
+    if (ot_sm_timeout_expired()) { // Waiting period has expired
       // We waited long enough for flash/user action
-      ot_sm_set_state(OT_SM_STATE_SLEEPING);
+      ot_sm_go_to_sleep();
     }
   }
   else if (OT_SM_EVENT_BUTTON_PRESS == event) {
     // User checking if we are awake (or requesting us to re-read settings).
-    // Go back to INIT to show the GREEN LED.
+    // Go back to INIT to show the GREEN LED (or to enter CONFIG, if held).
     ot_sm_set_state(OT_SM_STATE_INIT);
   }
 #endif // WAKEUP_BUTTON
@@ -310,8 +1343,7 @@ static void ot_sm_ready_exit(void) {
  *============================================================================*/
 static void ot_sm_provisional_entry(void) {
   // If we entered this state we just detected ONE flash burst
-  // The provisional_timeout_ms has been assigned the right value in INIT state
-  ot_sm_data.state_timeout_ms = ot_sm_data.provisional_timeout_ms;
+  ot_sm_data.state_timeout_ms = ot_sm_provisional_timeout();
   OT_TIMER_start(); // sends TIMEOUT events every ~1msec
   TRIGGER_IN_ENABLE(); // Enable Flash burst interrupt
   return;
@@ -330,22 +1362,50 @@ static void ot_sm_provisional_action(OT_SM_EVENT_T event) {
     // Possibly part of the 'red eye' reduction or 'pre-flashes'
     // Increment our count of flash bursts detected
     ++ot_sm_data.burst_count;
+#if defined(BURST_CAPTURE)
+    if (ot_sm_main_burst()) {
+      ot_sm_set_state(OT_SM_STATE_CONFIRMED);
+      return;
+    }
+#endif // BURST_CAPTURE
+#if defined(FLASH_PROFILES)
+    if ((void*)0 != ot_sm_data.profilep) {
+      OT_SM_MATCH_T match = ot_sm_profile_burst();
+      if (OT_SM_MATCH_MISMATCH == match) {
+#if defined(EVENT_LOG)
+        OT_EE_log(OT_EE_EVENT_MISMATCH, (uint8_t)(ot_sm_data.phase << 4) |
+                  ((ot_sm_data.phase_count > 0x0F) ? 0x0F :
+                                                     ot_sm_data.phase_count));
+#endif // EVENT_LOG
+        // Not the expected sequence; this burst may start a new one
+        ot_sm_data.burst_count = 1;
+        match = ot_sm_profile_start();
+      }
+      if (OT_SM_MATCH_MAIN == match) {
+        ot_sm_set_state(OT_SM_STATE_CONFIRMED);
+        return;
+      }
+    }
+    else
+#endif // FLASH_PROFILES
     // If we've exceeded the number of bursts to ignore we are done here
     if ((ot_sm_data.bursts_to_ignore < OT_SM_MAX_BURSTS_TO_IGNORE) &&
         (ot_sm_data.burst_count > ot_sm_data.bursts_to_ignore)) {
       ot_sm_set_state(OT_SM_STATE_CONFIRMED);
+      return;
     }
-    else {
-      // Whether the user has configured a timeout or not, the correct value
-      // has ben assigned to provisional_timeout_ms in INIT state.
-      // reset our state timer
-      ot_sm_data.state_timeout_ms = ot_sm_data.provisional_timeout_ms;
-      OT_TIMER_start(); // sends TIMEOUT events every ~1msec
-      // stay in this state
-    }
+    // Whether the user has configured a timeout or not, the correct value
+    // is returned by ot_sm_provisional_timeout().
+    // reset our state timer
+    ot_sm_data.state_timeout_ms = ot_sm_provisional_timeout();
+    OT_TIMER_start(); // sends TIMEOUT events every ~1msec
+    // stay in this state
   }
   else if (OT_SM_EVENT_TIMEOUT == event) {
-    if (0 == --ot_sm_data.state_timeout_ms) { // Waiting period has expired
+#if defined(FLASH_PROFILES)
+    ++ot_sm_data.burst_gap_ms;
+#endif // FLASH_PROFILES
+    if (ot_sm_timeout_expired()) { // Waiting period has expired
       // No more 'red eye' or 'preflashes' are incoming.
       // Go to CONFIRMED if user had configured a timeout
       // Otherwise go to INIT as the right number of preflashes didn't arrive.
@@ -386,13 +1446,39 @@ static void ot_sm_provisional_exit(void) {
  * @notes
  *============================================================================*/
 static void ot_sm_confirmed_entry(void) {
-  TRIGGER_OUT_ON(); // Trigger the slave flash
-  OT_TIMER_busywait_us(OT_SM_TRIGGER_DURATION_uS);
-  TRIGGER_OUT_OFF(); // Release the trigger
+  ot_sm_fire();
+#if defined(SM_STATS)
+  OT_SM_STATS_COUNT(fire_latency[ot_sm_stats_bucket(
+    ot_sm_data.fire_cycles - ot_sm_data.burst_cycles)]);
+#endif // SM_STATS
+#if defined(EEPROM_STORE)
+  OT_EE_COUNT(triggers); // Once per sequence, however many pulses
+#endif // EEPROM_STORE
+#if defined(EVENT_LOG)
+  OT_EE_log(OT_EE_EVENT_TRIGGER, ot_sm_data.burst_count);
+#endif // EVENT_LOG
+#if defined(OPTICAL_CONFIG)
+  // The other pulses of a multi-pulse sequence follow (see action)
+  ot_sm_data.pulses_left    = ot_sm_data.pulses - 1;
+  ot_sm_data.pulse_timer_ms = ot_sm_data.pulse_gap_ms;
+#endif // OPTICAL_CONFIG
+#if defined(STORM_PROTECT)
+  // TRIGGER_IN is evidently sane again
+  ot_sm_data.storm_backoff_ms = STORM_BACKOFF_MIN_MS;
+#endif // STORM_PROTECT
 
   RED_LED_ON(); // Signal that we triggered
   // set a state timer to turn off the RED LED
+#if defined(LIGHTNING_MODE)
+  ot_sm_data.state_timeout_ms = OT_SM_LIGHTNING_REARM_MS;
+#else
   ot_sm_data.state_timeout_ms = OT_SM_CONFIRMED_TIMEOUT_MS;
+#endif // LIGHTNING_MODE
+#if defined(OPTICAL_CONFIG)
+  // ... after the last pulse
+  ot_sm_data.state_timeout_ms +=
+    (uint16_t)ot_sm_data.pulses_left * ot_sm_data.pulse_gap_ms;
+#endif // OPTICAL_CONFIG
   OT_TIMER_start();
   return;
 }
@@ -407,8 +1493,25 @@ static void ot_sm_confirmed_entry(void) {
  *============================================================================*/
 static void ot_sm_confirmed_action(OT_SM_EVENT_T event) {
   if (OT_SM_EVENT_TIMEOUT == event) {
-    if (0 == --ot_sm_data.state_timeout_ms) { // Waiting period has expired
+#if defined(OPTICAL_CONFIG)
+    if ((0 != ot_sm_data.pulses_left) &&
+        (0 == --ot_sm_data.pulse_timer_ms)) {
+#if defined(QUENCH_OUT)
+      // Only the pulse on the master's burst is quenched
+      OT_TIMER_quench_release();
+#endif // QUENCH_OUT
+      ot_sm_fire(); // Next pulse of a multi-pulse sequence
+      --ot_sm_data.pulses_left;
+      ot_sm_data.pulse_timer_ms = ot_sm_data.pulse_gap_ms;
+    }
+#endif // OPTICAL_CONFIG
+    if (ot_sm_timeout_expired()) { // Waiting period has expired
+#if defined(LIGHTNING_MODE)
+      // Ready for the next stroke of the flash
+      ot_sm_set_state(OT_SM_STATE_READY);
+#else
       ot_sm_set_state(OT_SM_STATE_INIT);
+#endif // LIGHTNING_MODE
     }
   }
   // Ignore all other events and stay in the same state
@@ -424,6 +1527,12 @@ static void ot_sm_confirmed_action(OT_SM_EVENT_T event) {
  * @notes
  *============================================================================*/
 static void ot_sm_confirmed_exit(void) {
+#if defined(QUENCH_OUT)
+  OT_TIMER_quench_release();
+#endif // QUENCH_OUT
+#if defined(OPTICAL_CONFIG)
+  ot_sm_data.pulses_left = 0;
+#endif // OPTICAL_CONFIG
   OT_TIMER_stop();
   ot_sm_data.state_timeout_ms = 0;
   RED_LED_OFF();
@@ -440,9 +1549,16 @@ static void ot_sm_confirmed_exit(void) {
  *============================================================================*/
 #if defined(WAKEUP_BUTTON)
 static void ot_sm_sleeping_entry(void) {
+#if defined(SM_STATS)
+  // The cycle counter stops while halted: the next interval is meaningless
+  ot_sm_data.burst_seen = 0;
+#endif // SM_STATS
   DIP_DISABLE(); // Remove pull-ups from the DIP switches
   SENSOR_OFF(); // Power down the Flash burst sensor
   BUTTON_ENABLE(); // Enable the Button Interrupt
+#if defined(SNIFF_MODE)
+  OT_AWU_start(ot_sm_data.sniff_period); // Periodically wake-up to sniff for flashes
+#endif // SNIFF_MODE
   return;
 }
 #endif // WAKEUP_BUTTON
@@ -459,8 +1575,15 @@ static void ot_sm_sleeping_entry(void) {
 static void ot_sm_sleeping_action(OT_SM_EVENT_T event) {
   if (OT_SM_EVENT_BUTTON_PRESS == event) {
     // User pressed button to wake us up
+    ot_sm_wakeup();
     ot_sm_set_state(OT_SM_STATE_INIT);
   }
+#if defined(SNIFF_MODE)
+  else if (OT_SM_EVENT_SNIFF == event) {
+    // Time to briefly check for flash bursts
+    ot_sm_set_state(OT_SM_STATE_SNIFFING);
+  }
+#endif // SNIFF_MODE
   return;
 }
 #endif // WAKEUP_BUTTON
@@ -475,12 +1598,301 @@ static void ot_sm_sleeping_action(OT_SM_EVENT_T event) {
  *============================================================================*/
 #if defined(WAKEUP_BUTTON)
 static void ot_sm_sleeping_exit(void) {
+#if defined(EEPROM_STORE)
+  // Keep the EEPROM off the trigger path; the record is written afresh the
+  // next time we go to sleep from READY
+  OT_EE_hold();
+#endif // EEPROM_STORE
+#if defined(SNIFF_MODE)
+  OT_AWU_stop();
+#endif // SNIFF_MODE
   BUTTON_DISABLE(); // Disable the Button Interrupt
-  SENSOR_ON(); // Power on the Flash burst sensor
-  DIP_ENABLE(); // Add pull-ups to the DIP switches
+  // NOTE: The sensor and DIP switches are restored by ot_sm_wakeup() only
+  // when we are really waking up (i.e. not just sniffing)
+  return;
+}
+#endif // WAKEUP_BUTTON
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+#if defined(SNIFF_MODE)
+static void ot_sm_sniffing_entry(void) {
+  ot_sm_data.burst_count = 0; // Reset our internal counters
+  SENSOR_ON(); // Power on the Flash burst sensor (DIP switches stay disabled)
+  // TRIGGER_IN is armed only once the sensor has settled (see action)
+  ot_sm_data.state_timeout_ms = SNIFF_WINDOW_MS;
+  OT_TIMER_start(); // sends TIMEOUT events every ~1msec
+  BUTTON_ENABLE(); // Enable the Button Interrupt
+  return;
+}
+#endif // SNIFF_MODE
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+#if defined(SNIFF_MODE)
+static void ot_sm_sniffing_action(OT_SM_EVENT_T event) {
+  if (OT_SM_EVENT_FLASH_DETECTED == event) {
+    // A master flash is active; wake-up and handle it as if we were READY
+    ot_sm_wakeup();
+    ot_sm_first_burst();
+  }
+#if defined(WIRELESS_COMMANDS)
+  else if (OT_SM_EVENT_COMMANDED == event) {
+    ot_sm_wakeup();
+    ot_sm_commanded();
+  }
+  else if (OT_SM_EVENT_ACTIVITY == event) {
+    // A master is active; wake-up for its next commands
+    ot_sm_wakeup();
+    ot_sm_set_state(OT_SM_STATE_READY);
+  }
+#endif // WIRELESS_COMMANDS
+  else if (OT_SM_EVENT_TIMEOUT == event) {
+    if (ot_sm_timeout_expired()) { // Sniff window has expired
+      ot_sm_set_state(OT_SM_STATE_SLEEPING);
+    }
+    else if ((SNIFF_WINDOW_MS - SNIFF_SETTLE_MS) ==
+             ot_sm_data.state_timeout_ms) {
+      TRIGGER_IN_ENABLE(); // Sensor has settled; enable Flash burst interrupt
+    }
+  }
+  else if (OT_SM_EVENT_BUTTON_PRESS == event) {
+    // User pressed button to wake us up
+    ot_sm_wakeup();
+    ot_sm_set_state(OT_SM_STATE_INIT);
+  }
+  // Ignore all other events and stay in the same state
+  return;
+}
+#endif // SNIFF_MODE
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+#if defined(SNIFF_MODE)
+static void ot_sm_sniffing_exit(void) {
+  TRIGGER_IN_DISABLE(); // Disable Flash burst interrupt
+  BUTTON_DISABLE(); // Disable the Button Interrupt
+  // cancel/stop state timer
+  OT_TIMER_stop();
+  ot_sm_data.state_timeout_ms = 0;
+  return;
+}
+#endif // SNIFF_MODE
+/*==============================================================================
+ * DESCRIPTION: An interrupt storm masked TRIGGER_IN (or BUTTON_DET); wait for
+ * a while, with the sensor powered down, before trying again.
+ * @param
+ * @return
+ * @precondition
+ * @postcondition The next FAULT lasts twice as long (up to
+ *                STORM_BACKOFF_MAX_MS)
+ * @caution
+ * @notes Re-entered if BUTTON_DET storms too, which backs off further. Once
+ *        it has stormed, BUTTON_DET stays masked until the back-off expires.
+ *============================================================================*/
+#if defined(STORM_PROTECT)
+static void ot_sm_fault_entry(void) {
+  ot_sm_data.burst_count = 0; // The sequence (if any) is lost
+  SENSOR_OFF(); // Power down the (possibly oscillating) Flash burst sensor
+  ot_sm_data.state_timeout_ms = ot_sm_data.storm_backoff_ms;
+  if (ot_sm_data.storm_backoff_ms < (STORM_BACKOFF_MAX_MS / 2)) {
+    ot_sm_data.storm_backoff_ms <<= 1;
+  }
+  else {
+    ot_sm_data.storm_backoff_ms = STORM_BACKOFF_MAX_MS;
+  }
+  OT_TIMER_start(); // sends TIMEOUT events every ~1msec
+#if defined(WAKEUP_BUTTON)
+  if (0 == ot_sm_data.button_storm) {
+    BUTTON_ENABLE(); // Enable the Button Interrupt
+  }
+#endif // WAKEUP_BUTTON
+  return;
+}
+#endif // STORM_PROTECT
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+#if defined(STORM_PROTECT)
+static void ot_sm_fault_action(OT_SM_EVENT_T event) {
+  if (OT_SM_EVENT_TIMEOUT == event) {
+    if (ot_sm_timeout_expired()) { // Back-off period has expired
+#if defined(WAKEUP_BUTTON)
+      ot_sm_data.button_storm = 0;
+#endif // WAKEUP_BUTTON
+      // Try again (INIT re-arms TRIGGER_IN, and the button where used)
+      ot_sm_set_state(OT_SM_STATE_INIT);
+    }
+    else if ((ot_sm_data.state_timeout_ms & (OT_SM_FAULT_LED_PERIOD_MS - 1)) <
+             OT_SM_FAULT_LED_ON_MS) {
+      RED_LED_ON(); // Blink to signal the fault
+    }
+    else {
+      RED_LED_OFF();
+    }
+  }
+#if defined(WAKEUP_BUTTON)
+  else if (OT_SM_EVENT_BUTTON_PRESS == event) {
+    // User checking on us; try again now (the back-off is kept)
+    ot_sm_set_state(OT_SM_STATE_INIT);
+  }
+#endif // WAKEUP_BUTTON
+  // Ignore all other events and stay in the same state
   return;
 }
+#endif // STORM_PROTECT
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+#if defined(STORM_PROTECT)
+static void ot_sm_fault_exit(void) {
+#if defined(WAKEUP_BUTTON)
+  BUTTON_DISABLE(); // Disable the Button Interrupt
+  ot_sm_wakeup(); // Also restores what SLEEPING powered down
+#else
+  SENSOR_ON(); // Power on the Flash burst sensor
 #endif // WAKEUP_BUTTON
+  // cancel/stop state timer
+  OT_TIMER_stop();
+  ot_sm_data.state_timeout_ms = 0;
+  RED_LED_OFF();
+  return;
+}
+#endif // STORM_PROTECT
+/*==============================================================================
+ * DESCRIPTION: Program the settings by firing the master manually: groups of
+ * flashes, separated by pauses of OPTICAL_CONFIG_GROUP_MS, up to a pause of
+ * OPTICAL_CONFIG_END_MS (see doc/OpticalConfig.md)
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes The GREEN LED is on throughout; the RED LED blinks on each flash
+ *============================================================================*/
+#if defined(OPTICAL_CONFIG)
+static void ot_sm_config_entry(void) {
+  ot_sm_data.burst_count   = 0; // Flashes in the current group
+  ot_sm_data.num_groups    = 0;
+  ot_sm_data.config_gap_ms = 0;
+  ot_sm_data.state_timeout_ms = OPTICAL_CONFIG_END_MS;
+  OT_TIMER_start(); // sends TIMEOUT events every ~1msec
+  GREEN_LED_ON();
+  BUTTON_ENABLE(); // A press cancels
+  TRIGGER_IN_ENABLE(); // Enable Flash burst interrupt
+  return;
+}
+#endif // OPTICAL_CONFIG
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes Every burst is a flash, whatever the detection (and with
+ *        WIRELESS_COMMANDS, whether or not it completed a command)
+ *============================================================================*/
+#if defined(OPTICAL_CONFIG)
+static void ot_sm_config_action(OT_SM_EVENT_T event) {
+  if (OT_SM_EVENT_TIMEOUT == event) {
+    if (OT_SM_CONFIG_ACK_MS == ++ot_sm_data.config_gap_ms) {
+      RED_LED_OFF();
+    }
+    if ((OPTICAL_CONFIG_GROUP_MS == ot_sm_data.config_gap_ms) &&
+        (0 != ot_sm_data.burst_count)) {
+      // The pause ends the group; counts past OT_SM_CONFIG_MAX_GROUPS only
+      // make the sequence invalid
+      if (ot_sm_data.num_groups < OT_SM_CONFIG_MAX_GROUPS) {
+        ot_sm_data.groups[ot_sm_data.num_groups] = ot_sm_data.burst_count;
+      }
+      if (ot_sm_data.num_groups <= OT_SM_CONFIG_MAX_GROUPS) {
+        ++ot_sm_data.num_groups;
+      }
+      ot_sm_data.burst_count = 0;
+    }
+    if (ot_sm_timeout_expired()) { // The sequence is over
+      // Apply valid settings right away; otherwise (or once cleared) INIT
+      // goes on with the switches (or the settings from before)
+      if (ot_sm_config_decode() && ot_sm_settings_in_force()) {
+        ot_sm_set_state(OT_SM_STATE_READY);
+      }
+      else {
+        ot_sm_set_state(OT_SM_STATE_INIT);
+      }
+    }
+  }
+  else if ((OT_SM_EVENT_FLASH_DETECTED == event)
+#if defined(WIRELESS_COMMANDS)
+           || (OT_SM_EVENT_COMMANDED == event)
+           || (OT_SM_EVENT_ACTIVITY == event)
+#endif // WIRELESS_COMMANDS
+          ) {
+    if (0xFF != ot_sm_data.burst_count) ++ot_sm_data.burst_count;
+    ot_sm_data.config_gap_ms = 0;
+    ot_sm_data.state_timeout_ms = OPTICAL_CONFIG_END_MS;
+    RED_LED_ON(); // Acknowledge the flash
+  }
+  else if (OT_SM_EVENT_BUTTON_PRESS == event) {
+    // Cancelled; nothing is changed
+    ot_sm_set_state(OT_SM_STATE_INIT);
+  }
+  // Ignore all other events and stay in the same state
+  return;
+}
+#endif // OPTICAL_CONFIG
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+#if defined(OPTICAL_CONFIG)
+static void ot_sm_config_exit(void) {
+  TRIGGER_IN_DISABLE(); // Disable Flash burst interrupt
+  BUTTON_DISABLE();
+  // cancel/stop state timer
+  OT_TIMER_stop();
+  ot_sm_data.state_timeout_ms = 0;
+  ot_sm_data.burst_count = 0;
+  GREEN_LED_OFF();
+  RED_LED_OFF();
+  return;
+}
+#endif // OPTICAL_CONFIG
 /*==============================================================================
  * EXPORTED (GLOBAL) FUNCTIONS
  *============================================================================*/
@@ -494,6 +1906,13 @@ static void ot_sm_sleeping_exit(void) {
  * @notes
  *============================================================================*/
 void OT_SM_init(void) {
+#if defined(EEPROM_STORE) && defined(OPTICAL_CONFIG)
+  // The settings programmed before the power cycle (if DIP[2:0] wasn't
+  // changed since)
+  if (0 == OT_EE_load_settings(&ot_sm_settings, sizeof(ot_sm_settings))) {
+    ot_sm_settings.valid = 0;
+  }
+#endif // EEPROM_STORE && OPTICAL_CONFIG
   ot_sm_set_state(OT_SM_STATE_INIT);
   return;
 }
@@ -507,13 +1926,64 @@ void OT_SM_init(void) {
  * @notes
  *============================================================================*/
 void OT_SM_execute(OT_SM_EVENT_T event) {
+  OT_PROF_ENTER(OT_PROF_SITE_SM_EXECUTE);
   if (event < OT_SM_EVENT_MAX && ot_sm_data.state < OT_SM_STATE_MAX) {
     OT_SM_ACTION_FUNC_T *actionp;
-    actionp = ot_sm_handlers[ot_sm_data.state].actionp;
-    if ((void*)0 != actionp) (*actionp)(event);
+#if defined(SM_STATS)
+    uint32_t last_cycles = ot_sm_data.burst_cycles;
+    // Only the time stamp ahead of the handler; the counting follows it
+    if (OT_SM_IS_BURST(event)) ot_sm_data.burst_cycles = OT_TIMER_cycles32();
+#endif // SM_STATS
+#if defined(STORM_PROTECT)
+    // Handled alike in every state
+#if defined(WAKEUP_BUTTON)
+    if (OT_SM_EVENT_BUTTON_STORM == event) {
+      // The GPIO module masked BUTTON_DET; keep it so while backing off
+      ot_sm_data.button_storm = 1;
+    }
+    if ((OT_SM_EVENT_STORM == event) || (OT_SM_EVENT_BUTTON_STORM == event)) {
+#else
+    if (OT_SM_EVENT_STORM == event) {
+#endif // WAKEUP_BUTTON
+#if defined(EVENT_LOG)
+      OT_EE_log(OT_EE_EVENT_STORM, (uint8_t)ot_sm_data.state);
+#endif // EVENT_LOG
+      ot_sm_set_state(OT_SM_STATE_FAULT);
+    }
+    else
+#endif // STORM_PROTECT
+    {
+      actionp = ot_sm_handlers[ot_sm_data.state].actionp;
+      if ((void*)0 != actionp) (*actionp)(event);
+    }
+#if defined(EEPROM_STORE)
+    // Counted once handled, so as not to delay the trigger
+    if (OT_SM_IS_BURST(event)) OT_EE_COUNT(bursts);
+#endif // EEPROM_STORE
+#if defined(SM_STATS)
+    ot_sm_stats_event(event, last_cycles);
+#endif // SM_STATS
   }
+  OT_PROF_EXIT(OT_PROF_SITE_SM_EXECUTE);
   return;
 }
+/*==============================================================================
+ * DESCRIPTION: Send a FLASH_DETECTED event along with the burst's waveform
+ * @param burstp - features of the burst
+ * @return
+ * @precondition
+ * @postcondition burstp isn't referenced once this returns
+ * @caution
+ * @notes
+ *============================================================================*/
+#if defined(BURST_CAPTURE)
+void OT_SM_execute_burst(const OT_ADC_BURST_T *burstp) {
+  ot_sm_data.burstp = burstp;
+  OT_SM_execute(OT_SM_EVENT_FLASH_DETECTED);
+  ot_sm_data.burstp = (void*)0;
+  return;
+}
+#endif // BURST_CAPTURE
 /*==============================================================================
  * DESCRIPTION:
  * @param
@@ -526,4 +1996,34 @@ void OT_SM_execute(OT_SM_EVENT_T event) {
 OT_SM_STATE_T OT_SM_get_state(void) {
   return ot_sm_data.state;
 }
+/*==============================================================================
+ * DESCRIPTION: Take a snapshot of OT_SM_stats and reset it
+ * @param statsp - where to copy the snapshot
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes Each counter is read and cleared with interrupts disabled, so no
+ *        count is lost or counted twice; the counters aren't all read at the
+ *        same instant though, which would keep interrupts disabled for the
+ *        whole copy.
+ *        Interrupts are re-enabled only if the caller is the main program
+ *        with interrupts enabled: from an ISR (whose IRET restores CC) or
+ *        with interrupts disabled, they stay disabled.
+ *============================================================================*/
+#if defined(SM_STATS)
+void OT_SM_get_stats(OT_SM_STATS_T *statsp) {
+  volatile uint16_t *srcp = (volatile uint16_t *)&OT_SM_stats;
+  uint16_t *dstp = (uint16_t *)statsp;
+  uint8_t enabled = ((ITC_GetCPUCC() & OT_SM_CC_I1I0) == OT_SM_CC_MAIN_LEVEL);
+  uint8_t i;
+  for (i = 0; i < (sizeof(OT_SM_STATS_T) / sizeof(uint16_t)); ++i) {
+    disableInterrupts();
+    dstp[i] = srcp[i];
+    srcp[i] = 0;
+    if (enabled) enableInterrupts();
+  }
+  return;
+}
+#endif // SM_STATS
 /*============================================================================*/
@@ -12,9 +12,16 @@ extern "C"
 /*==============================================================================
  * INCLUDES
  *============================================================================*/
+#if defined(BURST_CAPTURE)
+  #include "adc.h"
+#endif // BURST_CAPTURE
 /*==============================================================================
  * CONSTANTS
  *============================================================================*/
+#if defined(SM_STATS)
+  // Buckets of the log2 histograms in OT_SM_STATS_T
+  #define OT_SM_STATS_BUCKETS   16
+#endif // SM_STATS
 /*==============================================================================
  * MACROS
  *============================================================================*/
@@ -30,6 +37,15 @@ typedef enum OT_SM_STATE_E {
 #if defined(WAKEUP_BUTTON)
   OT_SM_STATE_SLEEPING,
 #endif // WAKEUP_BUTTON
+#if defined(SNIFF_MODE)
+  OT_SM_STATE_SNIFFING,
+#endif // SNIFF_MODE
+#if defined(STORM_PROTECT)
+  OT_SM_STATE_FAULT,
+#endif // STORM_PROTECT
+#if defined(OPTICAL_CONFIG)
+  OT_SM_STATE_CONFIG,
+#endif // OPTICAL_CONFIG
   OT_SM_STATE_MAX           // Not a real state
 } OT_SM_STATE_T;
 
@@ -40,17 +56,58 @@ typedef enum OT_SM_EVENT_E {
 #if defined(WAKEUP_BUTTON)
   OT_SM_EVENT_BUTTON_PRESS,
 #endif // WAKEUP_BUTTON
+#if defined(SNIFF_MODE)
+  OT_SM_EVENT_SNIFF,
+#endif // SNIFF_MODE
+#if defined(STORM_PROTECT)
+  OT_SM_EVENT_STORM,           // On TRIGGER_IN
+#if defined(WAKEUP_BUTTON)
+  OT_SM_EVENT_BUTTON_STORM,    // On BUTTON_DET
+#endif // WAKEUP_BUTTON
+#endif // STORM_PROTECT
+#if defined(WIRELESS_COMMANDS)
+  OT_SM_EVENT_COMMANDED,       // The main burst our group is to fire on
+  OT_SM_EVENT_ACTIVITY,        // Any other burst (e.g. command pulses)
+#endif // WIRELESS_COMMANDS
   OT_SM_EVENT_MAX              // Not a real event
 } OT_SM_EVENT_T;
+
+#if defined(SM_STATS)
+// Usage of the trigger since the last OT_SM_get_stats(). Every count saturates
+// at 0xFFFF. Bucket b of a histogram counts the values in [2^(b-1), 2^b)
+// units (bucket 0: less than 1 unit; the last bucket: anything above).
+typedef struct OT_SM_STATS_S {
+  uint16_t events[OT_SM_EVENT_MAX];
+  uint16_t transitions[OT_SM_STATE_MAX][OT_SM_STATE_MAX]; // [from][to]
+  // Between two flash bursts (FLASH_DETECTED, COMMANDED, ACTIVITY) handled
+  // while awake, in units of 1024 cycles (512usec)
+  uint16_t burst_interval[OT_SM_STATS_BUCKETS];
+  // From OT_SM_execute() being handed the burst that fires to TRIGGER_OUT
+  // being asserted, in cycles: the State Machine's own latency. The ISR
+  // entry and the filters ahead of it aren't included (see SELF_TEST for
+  // the whole path); nor is LIGHTNING_MODE's fire from the ADC1 interrupt.
+  uint16_t fire_latency[OT_SM_STATS_BUCKETS];
+} OT_SM_STATS_T;
+#endif // SM_STATS
 /*==============================================================================
  * GLOBAL (extern) VARIABLES
  *============================================================================*/
+#if defined(SM_STATS)
+// Exported so it can be read over SWIM (symbol _OT_SM_stats in the .map)
+extern volatile OT_SM_STATS_T OT_SM_stats;
+#endif // SM_STATS
 /*==============================================================================
  * EXPORTED (GLOBAL) FUNCTIONS
  *============================================================================*/
 void OT_SM_init(void);
 void OT_SM_execute(OT_SM_EVENT_T event);
+#if defined(BURST_CAPTURE)
+void OT_SM_execute_burst(const OT_ADC_BURST_T *burstp);
+#endif // BURST_CAPTURE
 OT_SM_STATE_T OT_SM_get_state(void);
+#if defined(SM_STATS)
+void OT_SM_get_stats(OT_SM_STATS_T *statsp);
+#endif // SM_STATS
 /*============================================================================*/
 #ifdef __cplusplus
 }
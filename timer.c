@@ -8,15 +8,77 @@
  *============================================================================*/
 #include <stm8s.h>
 #include "timer.h"
+#include "profile.h"
+#if defined(HSI_CALIBRATION)
+  #include "config.h"
+  #include "power.h"
+#endif // HSI_CALIBRATION
 /*==============================================================================
  * CONSTANTS
  *============================================================================*/
+#if defined(QUENCH_OUT)
+  // Shortest quench delay: reading TIM1 and arming the compare takes less
+  #define OT_TIMER_QUENCH_MIN_CYCLES  100
+#endif // QUENCH_OUT
+// Counts of the timer periods for a 2MHz master clock (see their uses)
+#define OT_TIMER_NOMINAL_TICK   125   // 1msec at prescaler 16 (8usec/count)
+#define OT_TIMER_NOMINAL_256MS  32000 // at prescaler 16
+#define OT_TIMER_NOMINAL_16MS   2000
+#define OT_TIMER_NOMINAL_1MS    125
+#define OT_TIMER_NOMINAL_256US  512   // at prescaler 1 (0.5usec/count)
+#define OT_TIMER_NOMINAL_16US   32
+#if defined(HSI_CALIBRATION)
+  // The HSI is timed over OT_TIMER_CAL_CAPTURES captures of 8 LSI periods
+  // each (the input capture prescaler), per window: ~500usec
+  #define OT_TIMER_CAL_CAPTURES   8
+  #define OT_TIMER_CAL_LSI_PERIODS \
+    ((uint32_t)8 * OT_TIMER_CAL_CAPTURES * HSI_CAL_WINDOWS)
+  // HSI cycles over the HSI_CAL_WINDOWS windows at exactly 2MHz
+  #define OT_TIMER_CAL_NOMINAL \
+    ((uint16_t)(2000000UL * OT_TIMER_CAL_LSI_PERIODS / HSI_CAL_LSI_HZ))
+  // Polls of the capture flag before the LSI is deemed stopped (a capture is
+  // due every ~125 cycles)
+  #define OT_TIMER_CAL_SPINS      100
+  #if defined(STM8S105)
+    // The LSI is measured on TIM3_CH1 (the busy-wait timer)
+    #define OT_TIMER_CAL_CLOCKS   (OT_POWER_AWU | OT_POWER_BUSYWAIT)
+    #define OT_TIMER_CAL_CAPTURED() \
+      (RESET != TIM3_GetFlagStatus(TIM3_FLAG_CC1))
+    #define OT_TIMER_CAL_CAPTURE()  TIM3_GetCapture1()
+  #elif defined(STM8S903)
+    // The LSI is measured on TIM1_CH1 (the cycle counter)
+    #define OT_TIMER_CAL_CLOCKS   OT_POWER_AWU
+    #define OT_TIMER_CAL_CAPTURED() \
+      (RESET != TIM1_GetFlagStatus(TIM1_FLAG_CC1))
+    #define OT_TIMER_CAL_CAPTURE()  TIM1_GetCapture1()
+  #else
+    #error "HSI_CALIBRATION not implemented"
+  #endif
+#endif // HSI_CALIBRATION
 /*==============================================================================
  * MACROS
  *============================================================================*/
+// Count of a timer period, corrected for the measured HSI frequency
+#if defined(HSI_CALIBRATION)
+  #define OT_TIMER_PERIOD(period)  (ot_timer_periods[OT_TIMER_PERIOD_##period])
+#else
+  #define OT_TIMER_PERIOD(period)  (OT_TIMER_NOMINAL_##period)
+#endif // HSI_CALIBRATION
 /*==============================================================================
  * TYPEDEFs and STRUCTs
  *============================================================================*/
+#if defined(HSI_CALIBRATION)
+typedef enum OT_TIMER_PERIOD_E {
+  OT_TIMER_PERIOD_TICK,
+  OT_TIMER_PERIOD_256MS,
+  OT_TIMER_PERIOD_16MS,
+  OT_TIMER_PERIOD_1MS,
+  OT_TIMER_PERIOD_256US,
+  OT_TIMER_PERIOD_16US,
+  OT_TIMER_PERIOD_MAX     // Not a real period
+} OT_TIMER_PERIOD_T;
+#endif // HSI_CALIBRATION
+
 typedef enum OT_TIMER_STATE_S {
   OT_TIMER_STATE_STOP,
   OT_TIMER_STATE_START,
@@ -28,15 +90,45 @@ typedef enum OT_TIMER_STATE_S {
 static void ot_timer_busywait(void);
 static void ot_timer_busywait16(uint16_t period);
 static void ot_timer_busywait1(uint16_t period);
+#if defined(HSI_CALIBRATION)
+static uint16_t ot_timer_cal_window(void);
+#endif // HSI_CALIBRATION
 /*==============================================================================
  * LOCAL VARIABLES
  *============================================================================*/
 static OT_TIMER_STATE_T ot_timer_state  = OT_TIMER_STATE_STOP;
 static OT_TIMER_CB_T    *ot_timer_cb    = (void*)0;
 static void             *ot_timer_cbarg = (void*)0;
+#if defined(OT_TIMER_CYCLE_COUNTER32)
+static volatile uint16_t ot_timer_cycles_hi = 0;
+#endif // OT_TIMER_CYCLE_COUNTER32
+#if defined(HSI_CALIBRATION)
+static const uint16_t ot_timer_nominal[OT_TIMER_PERIOD_MAX] = {
+  OT_TIMER_NOMINAL_TICK,
+  OT_TIMER_NOMINAL_256MS,
+  OT_TIMER_NOMINAL_16MS,
+  OT_TIMER_NOMINAL_1MS,
+  OT_TIMER_NOMINAL_256US,
+  OT_TIMER_NOMINAL_16US
+};
+// Scaled by the last good calibration. Also read by the ISRs (busy-waits).
+static uint16_t ot_timer_periods[OT_TIMER_PERIOD_MAX] = {
+  OT_TIMER_NOMINAL_TICK,
+  OT_TIMER_NOMINAL_256MS,
+  OT_TIMER_NOMINAL_16MS,
+  OT_TIMER_NOMINAL_1MS,
+  OT_TIMER_NOMINAL_256US,
+  OT_TIMER_NOMINAL_16US
+};
+static volatile uint8_t ot_timer_cal_due = 1; // At start-up
+#endif // HSI_CALIBRATION
 /*==============================================================================
  * GLOBAL (extern) VARIABLES
  *============================================================================*/
+#if defined(HSI_CALIBRATION)
+volatile uint32_t OT_TIMER_hsi_hz      = 0;
+volatile uint16_t OT_TIMER_cal_rejects = 0;
+#endif // HSI_CALIBRATION
 /*==============================================================================
  * DESCRIPTION:
  * @param
@@ -72,7 +164,7 @@ static void ot_timer_busywait(void) {
 }
 /*==============================================================================
  * DESCRIPTION: Busywait for msec delays. Sets the TIMx prescaler to 16. Each
- * 'tick' corresponds to ~7.63usec for a master clock of 2MHz
+ * 'tick' corresponds to 8usec for a master clock of 2MHz
  * @param
  * @return
  * @precondition - Assumes TIMx_DeInit() has been done by the caller.
@@ -93,7 +185,7 @@ static void ot_timer_busywait16(uint16_t period) {
 }
 /*==============================================================================
  * DESCRIPTION: Busywait for usec delays (more accurate for 100us and greater).
- * Sets the TIMx prescaler to 1. Each 'tick' corresponds to ~0.47usec for a
+ * Sets the TIMx prescaler to 1. Each 'tick' corresponds to 0.5usec for a
  * master clock of 2MHz.
  * @param
  * @return
@@ -113,6 +205,63 @@ static void ot_timer_busywait1(uint16_t period) {
   ot_timer_busywait();
   return;
 }
+/*==============================================================================
+ * DESCRIPTION: Time OT_TIMER_CAL_CAPTURES captures of the LSI in HSI cycles
+ * @param
+ * @return The HSI cycles, 0 if the LSI didn't run
+ * @precondition The LSI is on
+ * @postcondition The peripheral clocks are back as they were
+ * @caution Interrupts are disabled for the ~500usec it lasts
+ * @notes The AWU's MSR bit routes the LSI to the capture input. With
+ *        interrupts disabled no capture is missed, and no ISR can get at
+ *        the busy-wait timer (STM8S105) or at the peripheral clocks.
+ *============================================================================*/
+#if defined(HSI_CALIBRATION)
+static uint16_t ot_timer_cal_window(void) {
+  OT_POWER_MASK_T clocks;
+  uint16_t first = 0;
+  uint16_t last  = 0;
+  uint8_t spins;
+  uint8_t captures;
+
+  disableInterrupts();
+  clocks = OT_POWER_get();
+  OT_POWER_set(clocks | OT_TIMER_CAL_CLOCKS);
+  AWU->CSR |= AWU_CSR_MSR;
+#if defined(STM8S105)
+  TIM3_DeInit();
+  TIM3_TimeBaseInit(TIM3_PRESCALER_1, 0xFFFF);
+  TIM3_ICInit(TIM3_CHANNEL_1, TIM3_ICPOLARITY_RISING,
+              TIM3_ICSELECTION_DIRECTTI, TIM3_ICPSC_DIV8, 0);
+  TIM3_Cmd(ENABLE);
+#elif defined(STM8S903)
+  TIM1_ICInit(TIM1_CHANNEL_1, TIM1_ICPOLARITY_RISING,
+              TIM1_ICSELECTION_DIRECTTI, TIM1_ICPSC_DIV8, 0);
+  TIM1_ClearFlag(TIM1_FLAG_CC1); // Stale
+#endif
+
+  for (captures = 0; captures <= OT_TIMER_CAL_CAPTURES; ++captures) {
+    spins = OT_TIMER_CAL_SPINS;
+    while (!OT_TIMER_CAL_CAPTURED() && (0 != --spins)) {}
+    if (0 == spins) {
+      last = first;
+      break;
+    }
+    last = OT_TIMER_CAL_CAPTURE(); // Also clears the flag
+    if (0 == captures) first = last;
+  }
+
+#if defined(STM8S105)
+  TIM3_DeInit();
+#elif defined(STM8S903)
+  TIM1_CCxCmd(TIM1_CHANNEL_1, DISABLE);
+#endif
+  AWU->CSR &= (uint8_t)~AWU_CSR_MSR;
+  OT_POWER_set(clocks);
+  enableInterrupts();
+  return last - first;
+}
+#endif // HSI_CALIBRATION
 /*==============================================================================
  * LOCAL FUNCTIONS
  *============================================================================*/
@@ -132,6 +281,33 @@ void OT_TIMER_init(OT_TIMER_CB_T *cb, void* cbarg) {
   ot_timer_cb = cb;
   ot_timer_cbarg = cbarg;
   OT_TIMER_stop();
+#if defined(OT_TIMER_CYCLE_COUNTER)
+  // Free-running at fMASTER: one count per CPU cycle
+  TIM1_DeInit();
+  TIM1_TimeBaseInit(0, TIM1_COUNTERMODE_UP, 0xFFFF, 0);
+#if defined(OT_TIMER_CYCLE_COUNTER32)
+  TIM1_ClearFlag(TIM1_FLAG_UPDATE);
+  TIM1_ITConfig(TIM1_IT_UPDATE, ENABLE);
+#endif // OT_TIMER_CYCLE_COUNTER32
+#if defined(QUENCH_OUT)
+  // QUENCH_OUT is TIM1_CH2's output, held inactive until armed
+  TIM1_OC2Init(TIM1_OCMODE_INACTIVE, TIM1_OUTPUTSTATE_ENABLE,
+               TIM1_OUTPUTNSTATE_DISABLE, 0, TIM1_OCPOLARITY_HIGH,
+               TIM1_OCNPOLARITY_HIGH, TIM1_OCIDLESTATE_RESET,
+               TIM1_OCNIDLESTATE_RESET);
+  TIM1_ForcedOC2Config(TIM1_FORCEDACTION_INACTIVE);
+  TIM1_CtrlPWMOutputs(ENABLE);
+#endif // QUENCH_OUT
+#if defined(SELF_TEST)
+  // SELF_TEST_CAPTURE is TIM1_CH3's input: the trigger pulse (active low) is
+  // time-stamped by CH3 on its falling edge and by CH4 on its rising edge
+  TIM1_ICInit(TIM1_CHANNEL_3, TIM1_ICPOLARITY_FALLING,
+              TIM1_ICSELECTION_DIRECTTI, TIM1_ICPSC_DIV1, 0);
+  TIM1_ICInit(TIM1_CHANNEL_4, TIM1_ICPOLARITY_RISING,
+              TIM1_ICSELECTION_INDIRECTTI, TIM1_ICPSC_DIV1, 0);
+#endif // SELF_TEST
+  TIM1_Cmd(ENABLE);
+#endif // OT_TIMER_CYCLE_COUNTER
   return;
 }
 /*==============================================================================
@@ -148,7 +324,8 @@ void OT_TIMER_start(void) {
   OT_TIMER_stop();
 #if defined(STM8S105)
   // Set period
-  TIM4_TimeBaseInit(TIM4_PRESCALER_16, 131); // 1msec period
+  TIM4_TimeBaseInit(TIM4_PRESCALER_16, // 1msec period
+                    (uint8_t)(OT_TIMER_PERIOD(TICK) - 1)); // ARR: counts - 1
   // Clear interrupts
   TIM4_ClearFlag(TIM4_FLAG_UPDATE);
   TIM4_ITConfig(TIM4_IT_UPDATE, ENABLE);
@@ -156,7 +333,8 @@ void OT_TIMER_start(void) {
   TIM4_Cmd(ENABLE);
 #elif defined(STM8S903)
   // Set period
-  TIM6_TimeBaseInit(TIM6_PRESCALER_16, 131); // 1msec period
+  TIM6_TimeBaseInit(TIM6_PRESCALER_16, // 1msec period
+                    (uint8_t)(OT_TIMER_PERIOD(TICK) - 1)); // ARR: counts - 1
   // Clear interrupts
   TIM6_ClearFlag(TIM6_FLAG_UPDATE);
   TIM6_ITConfig(TIM6_IT_UPDATE, ENABLE);
@@ -215,22 +393,22 @@ void OT_TIMER_busywait_ms(uint16_t delay_ms) {
 
   /* For each 256msec of delay left, execute a 256msec busywait */
   while (delay_256ms-- > 0) {
-    /* Note: with a 2MHz master clock & prescalar of 16, a count of 33554 gives
-       approximately 256msec worth of delay */
-    ot_timer_busywait16(33554);
+    /* Note: with a 2MHz master clock & prescalar of 16, a count of 32000 gives
+       256msec worth of delay */
+    ot_timer_busywait16(OT_TIMER_PERIOD(256MS));
   }
 
   /* For each 16msec of delay left, execute a 16msec busywait */
   while (delay_16ms-- > 0) {
-    /* Note: with a 2MHz master clock & prescalar of 16, a count of 2097 gives
-       approximately 16msec worth of delay */
-    ot_timer_busywait16(2097);
+    /* Note: with a 2MHz master clock & prescalar of 16, a count of 2000 gives
+       16msec worth of delay */
+    ot_timer_busywait16(OT_TIMER_PERIOD(16MS));
   }
 
   /* Execute busywait for the rest of delay_ms (< 16msec) */
-  /* Note: with a 2MHz master clock & prescalar of 16, a count of 131 gives
-     approximately 1msec worth of delay */
-  ot_timer_busywait16(131*delay_ms);
+  /* Note: with a 2MHz master clock & prescalar of 16, a count of 125 gives
+     1msec worth of delay */
+  ot_timer_busywait16(OT_TIMER_PERIOD(1MS)*delay_ms);
 
   return;
 }
@@ -261,25 +439,223 @@ void OT_TIMER_busywait_us(uint16_t delay_us) {
 
   /* For each 256usec of delay left, execute a 256usec busywait */
   while (delay_256us-- > 0) {
-    /* Note: with a 2MHz master clock & prescalar of 1, a count of 537 gives
-       approximately 256usec worth of delay */
-    ot_timer_busywait1(537);
+    /* Note: with a 2MHz master clock & prescalar of 1, a count of 512 gives
+       256usec worth of delay */
+    ot_timer_busywait1(OT_TIMER_PERIOD(256US));
   }
 
   /* For each 16usec of delay left, execute a 16usec busywait */
   while (delay_16us-- > 0) {
-    /* Note: with a 2MHz master clock & prescalar of 1, a count of 34 gives
-       approximately 16usec worth of delay */
-    ot_timer_busywait1(34);
+    /* Note: with a 2MHz master clock & prescalar of 1, a count of 32 gives
+       16usec worth of delay */
+    ot_timer_busywait1(OT_TIMER_PERIOD(16US));
   }
 
   /* Execute busywait for the rest of delay_us (< 16usec) */
   /* Note: with a 2MHz master clock & prescalar of 1, a count of 2 gives
-     approximately 1usec worth of delay */
+     1usec worth of delay (too coarse to be calibrated) */
   ot_timer_busywait1(2*delay_us);
 
   return;
 }
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return CPU cycles (at fMASTER) since an arbitrary origin, wrapping at
+ *         0xFFFF (every 32.8msec at 2MHz)
+ * @precondition OT_TIMER_init()
+ * @postcondition
+ * @caution
+ * @notes Only differences between two readings are meaningful
+ *============================================================================*/
+#if defined(OT_TIMER_CYCLE_COUNTER)
+uint16_t OT_TIMER_cycles(void) {
+  return TIM1_GetCounter();
+}
+#endif // OT_TIMER_CYCLE_COUNTER
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return CPU cycles (at fMASTER) since an arbitrary origin, wrapping every
+ *         ~35 minutes at 2MHz
+ * @precondition OT_TIMER_init(). Interrupts disabled (e.g. called from an ISR)
+ * @postcondition
+ * @caution
+ * @notes A TIM1 wrap whose update ISR is still pending is counted if the
+ *        counter read is in its lower half (i.e. it was read after the wrap)
+ *============================================================================*/
+#if defined(OT_TIMER_CYCLE_COUNTER32)
+uint32_t OT_TIMER_cycles32(void) {
+  uint16_t hi = ot_timer_cycles_hi;
+  uint16_t lo = TIM1_GetCounter();
+  // A wrap not yet counted by ot_tim1_isr_ovf
+  if (RESET != TIM1_GetFlagStatus(TIM1_FLAG_UPDATE) && lo < 0x8000) ++hi;
+  return ((uint32_t)hi << 16) | lo;
+}
+#endif // OT_TIMER_CYCLE_COUNTER32
+/*==============================================================================
+ * DESCRIPTION: Raise QUENCH_OUT delay_cycles from now, on a TIM1 compare
+ * @param delay_cycles - CPU cycles (at fMASTER) from now
+ * @return
+ * @precondition OT_TIMER_init()
+ * @postcondition QUENCH_OUT stays high until OT_TIMER_quench_release()
+ * @caution A delay shorter than OT_TIMER_QUENCH_MIN_CYCLES is lengthened to
+ *          it: a compare already past when armed would only match after the
+ *          counter wraps (32.8msec)
+ * @notes The timing doesn't depend on the CPU (e.g. on interrupts)
+ *============================================================================*/
+#if defined(QUENCH_OUT)
+void OT_TIMER_quench_after(uint16_t delay_cycles) {
+  if (delay_cycles < OT_TIMER_QUENCH_MIN_CYCLES) {
+    delay_cycles = OT_TIMER_QUENCH_MIN_CYCLES;
+  }
+  TIM1_SetCompare2(TIM1_GetCounter() + delay_cycles);
+  TIM1_SelectOCxM(TIM1_CHANNEL_2, TIM1_OCMODE_ACTIVE);
+  return;
+}
+#endif // QUENCH_OUT
+/*==============================================================================
+ * DESCRIPTION: Lower QUENCH_OUT (and cancel a pending quench)
+ * @param
+ * @return
+ * @precondition OT_TIMER_init()
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+#if defined(QUENCH_OUT)
+void OT_TIMER_quench_release(void) {
+  TIM1_ForcedOC2Config(TIM1_FORCEDACTION_INACTIVE);
+  return;
+}
+#endif // QUENCH_OUT
+/*==============================================================================
+ * DESCRIPTION: Forget the last trigger pulse captured on SELF_TEST_CAPTURE
+ * @param
+ * @return
+ * @precondition OT_TIMER_init()
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+#if defined(SELF_TEST)
+void OT_TIMER_capture_clear(void) {
+  TIM1_ClearFlag((TIM1_FLAG_TypeDef)(TIM1_FLAG_CC3 | TIM1_FLAG_CC4));
+  return;
+}
+#endif // SELF_TEST
+/*==============================================================================
+ * DESCRIPTION: Get the trigger pulse captured on SELF_TEST_CAPTURE
+ * @param startp - The cycle count (see OT_TIMER_cycles()) of its start
+ * @param endp - Of its end
+ * @return 1 once both edges were captured since OT_TIMER_capture_clear()
+ * @precondition OT_TIMER_init()
+ * @postcondition
+ * @caution
+ * @notes The time-stamps are latched by TIM1 itself: they don't depend on
+ *        when this is called
+ *============================================================================*/
+#if defined(SELF_TEST)
+uint8_t OT_TIMER_captured(uint16_t *startp, uint16_t *endp) {
+  if ((RESET == TIM1_GetFlagStatus(TIM1_FLAG_CC3)) ||
+      (RESET == TIM1_GetFlagStatus(TIM1_FLAG_CC4))) {
+    return 0;
+  }
+  *startp = TIM1_GetCapture3();
+  *endp   = TIM1_GetCapture4();
+  return 1;
+}
+#endif // SELF_TEST
+/*==============================================================================
+ * DESCRIPTION: Have OT_TIMER_calibrate() measure the HSI again
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes Called from ISRs (e.g. by the State Machine on INIT's entry)
+ *============================================================================*/
+#if defined(HSI_CALIBRATION)
+void OT_TIMER_calibrate_request(void) {
+  ot_timer_cal_due = 1;
+  return;
+}
+#endif // HSI_CALIBRATION
+/*==============================================================================
+ * DESCRIPTION: Measure the HSI against the LSI, if requested, and scale the
+ * timer periods (tick, busy-waits) to it
+ * @param
+ * @return
+ * @precondition OT_TIMER_init(). Main context, interrupts enabled.
+ * @postcondition The periods take effect from the next OT_TIMER_start() or
+ *                busy-wait
+ * @caution Runs HSI_CAL_WINDOWS windows of ~500usec with interrupts disabled
+ * @notes A measurement more than 1/16 off 2MHz (a mis-set HSI_CAL_LSI_HZ or
+ *        a disturbed LSI) is counted in OT_TIMER_cal_rejects and not applied
+ *============================================================================*/
+#if defined(HSI_CALIBRATION)
+void OT_TIMER_calibrate(void) {
+  uint16_t periods[OT_TIMER_PERIOD_MAX];
+  uint32_t cycles = 0;
+  uint16_t window_cycles;
+  uint8_t lsi_was_on;
+  uint8_t i;
+
+  if (0 == ot_timer_cal_due) return;
+  ot_timer_cal_due = 0;
+
+  // Left as found (SNIFF_MODE turns it on and leaves it on)
+  lsi_was_on = (RESET != CLK_GetFlagStatus(CLK_FLAG_LSIRDY));
+  if (0 == lsi_was_on) {
+    CLK_LSICmd(ENABLE);
+    while (RESET == CLK_GetFlagStatus(CLK_FLAG_LSIRDY)) {}
+  }
+  for (i = 0; i < HSI_CAL_WINDOWS; ++i) {
+    window_cycles = ot_timer_cal_window();
+    if (0 == window_cycles) {
+      cycles = 0;
+      break;
+    }
+    cycles += window_cycles;
+  }
+  if (0 == lsi_was_on) CLK_LSICmd(DISABLE);
+
+  if (0 != cycles) {
+    OT_TIMER_hsi_hz = cycles * HSI_CAL_LSI_HZ / OT_TIMER_CAL_LSI_PERIODS;
+  }
+  if ((cycles < OT_TIMER_CAL_NOMINAL - (OT_TIMER_CAL_NOMINAL >> 4)) ||
+      (cycles > OT_TIMER_CAL_NOMINAL + (OT_TIMER_CAL_NOMINAL >> 4))) {
+    if (OT_TIMER_cal_rejects < 0xFFFF) ++OT_TIMER_cal_rejects;
+    return;
+  }
+  for (i = 0; i < OT_TIMER_PERIOD_MAX; ++i) {
+    periods[i] = (uint16_t)(((uint32_t)ot_timer_nominal[i] * cycles +
+                             (OT_TIMER_CAL_NOMINAL >> 1)) /
+                            OT_TIMER_CAL_NOMINAL);
+  }
+  // The busy-waits read them from the ISRs
+  disableInterrupts();
+  for (i = 0; i < OT_TIMER_PERIOD_MAX; ++i) ot_timer_periods[i] = periods[i];
+  enableInterrupts();
+  return;
+}
+#endif // HSI_CALIBRATION
+/*==============================================================================
+ * DESCRIPTION: Extends the cycle counter to 32 bits
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+#if defined(OT_TIMER_CYCLE_COUNTER32)
+INTERRUPT_HANDLER(ot_tim1_isr_ovf, ITC_IRQ_TIM1_OVF) {
+  ++ot_timer_cycles_hi;
+  TIM1_ClearITPendingBit(TIM1_IT_UPDATE);
+  return;
+}
+#endif // OT_TIMER_CYCLE_COUNTER32
 /*==============================================================================
  * DESCRIPTION:
  * @param
@@ -291,22 +667,26 @@ void OT_TIMER_busywait_us(uint16_t delay_us) {
  *============================================================================*/
 #if defined(STM8S105)
 INTERRUPT_HANDLER(tim4_isr_ovf, ITC_IRQ_TIM4_OVF) {
+  OT_PROF_ENTER(OT_PROF_SITE_TIMER_ISR);
   if (TIM4_GetITStatus(TIM4_IT_UPDATE)) {
     if ((void*)0 != ot_timer_cb) {
       (*ot_timer_cb)(ot_timer_cbarg);
     }
     TIM4_ClearITPendingBit(TIM4_IT_UPDATE);
   }
+  OT_PROF_EXIT(OT_PROF_SITE_TIMER_ISR);
   return;
 }
 #elif defined(STM8S903)
 INTERRUPT_HANDLER(tim6_isr_ovf, ITC_IRQ_TIM6_OVFTRI) {
+  OT_PROF_ENTER(OT_PROF_SITE_TIMER_ISR);
   if (TIM6_GetITStatus(TIM6_IT_UPDATE)) {
     if ((void*)0 != ot_timer_cb) {
       (*ot_timer_cb)(ot_timer_cbarg);
     }
     TIM6_ClearITPendingBit(TIM6_IT_UPDATE);
   }
+  OT_PROF_EXIT(OT_PROF_SITE_TIMER_ISR);
   return;
 }
 #else
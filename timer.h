@@ -18,6 +18,20 @@ extern "C"
 /*==============================================================================
  * MACROS
  *============================================================================*/
+// Features that need the free-running cycle counter (TIM1)
+#if defined(ISR_PROFILE) || defined(STORM_PROTECT) || defined(QUENCH_OUT) || \
+    defined(SELF_TEST)
+  #define OT_TIMER_CYCLE_COUNTER
+#endif
+// HSI_CALIBRATION captures the LSI on TIM1 (STM8S903) and needs it running
+#if defined(HSI_CALIBRATION) && defined(STM8S903)
+  #define OT_TIMER_CYCLE_COUNTER
+#endif
+// Features that need it extended to 32 bits (by counting TIM1 updates)
+#if defined(PERIODIC_REJECT) || defined(WIRELESS_COMMANDS) || defined(SM_STATS)
+  #define OT_TIMER_CYCLE_COUNTER
+  #define OT_TIMER_CYCLE_COUNTER32
+#endif
 /*==============================================================================
  * TYPEDEFs and STRUCTs
  *============================================================================*/
@@ -25,6 +39,12 @@ typedef void (OT_TIMER_CB_T)(void* cbarg);
 /*==============================================================================
  * GLOBAL (extern) VARIABLES
  *============================================================================*/
+#if defined(HSI_CALIBRATION)
+// Exported so they can be read over SWIM: the HSI frequency last measured
+// (0 until then), and the measurements too far off to be applied
+extern volatile uint32_t OT_TIMER_hsi_hz;
+extern volatile uint16_t OT_TIMER_cal_rejects;
+#endif // HSI_CALIBRATION
 /*==============================================================================
  * EXPORTED (GLOBAL) FUNCTIONS
  *============================================================================*/
@@ -33,6 +53,24 @@ void OT_TIMER_start(void);
 void OT_TIMER_stop(void);
 void OT_TIMER_busywait_ms(uint16_t delay_ms);
 void OT_TIMER_busywait_us(uint16_t delay_us);
+#if defined(OT_TIMER_CYCLE_COUNTER)
+uint16_t OT_TIMER_cycles(void);
+#endif // OT_TIMER_CYCLE_COUNTER
+#if defined(OT_TIMER_CYCLE_COUNTER32)
+uint32_t OT_TIMER_cycles32(void);
+#endif // OT_TIMER_CYCLE_COUNTER32
+#if defined(QUENCH_OUT)
+void OT_TIMER_quench_after(uint16_t delay_cycles);
+void OT_TIMER_quench_release(void);
+#endif // QUENCH_OUT
+#if defined(SELF_TEST)
+void OT_TIMER_capture_clear(void);
+uint8_t OT_TIMER_captured(uint16_t *startp, uint16_t *endp);
+#endif // SELF_TEST
+#if defined(HSI_CALIBRATION)
+void OT_TIMER_calibrate_request(void);
+void OT_TIMER_calibrate(void);
+#endif // HSI_CALIBRATION
 #if defined(_SDCC_)
   // The SDCC compiler requires the main module to know interrupt prototypes
   #if defined(STM8S105)
@@ -42,6 +80,9 @@ void OT_TIMER_busywait_us(uint16_t delay_us);
   #else
     #error "timx INTERRUPT_HANDLER not implemented"
   #endif
+  #if defined(OT_TIMER_CYCLE_COUNTER32)
+    INTERRUPT_HANDLER(ot_tim1_isr_ovf, ITC_IRQ_TIM1_OVF);
+  #endif
 #endif // _SDCC_
 /*============================================================================*/
 #ifdef __cplusplus
@@ -0,0 +1,148 @@
+#!/usr/bin/env bash
+#===============================================================================
+# Cycle-accurate benchmark of the built trigger.ihx under sdcc's ucsim (sstm8)
+#
+# Usage: tools/bench.sh [<board>[/<rev>] ...]   (default: every configs/*)
+#
+# For each board a private copy of the tree is configured and built, then the
+# resulting trigger.ihx is run under sstm8. Each scenario is measured as the
+# difference of ucsim's clock count ('state' command) between two breakpoints.
+# Results are appended to bench.csv as:
+#   <commit>,<board>,<scenario>,<cycles>
+#===============================================================================
+
+SSTM8=${SSTM8:-sstm8}
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+OUT=${BENCH_OUT:-${TOP}/bench.csv}
+COMMIT=$(git -C "${TOP}" rev-parse --short HEAD 2>/dev/null || echo unknown)
+
+# GPIO port register base addresses (ODR at +0, IDR at +1, CR2 at +4)
+port_base()
+{
+    case $1 in
+      GPIOA) echo 0x5000;; GPIOB) echo 0x5005;; GPIOC) echo 0x500A;;
+      GPIOD) echo 0x500F;; GPIOE) echo 0x5014;; GPIOF) echo 0x5019;;
+      GPIOG) echo 0x501E;;
+      *) echo "Unknown port $1" >&2; exit 2;;
+    esac
+}
+
+# Address of a (global) symbol from the sdld map file
+sym_addr()
+{
+    awk -v sym="$2" '$2 == sym { print "0x" $1; exit }' "$1"
+}
+
+# Address of the first instruction with the given mnemonic in a listing
+# relocated by the linker (.rst)
+insn_addr()
+{
+    awk -v insn="$2" '$1 ~ /^[0-9A-F]+$/ && $NF == insn { print "0x" $1; exit }' "$1"
+}
+
+# Value of a #define from config.h
+config_def()
+{
+    awk -v def="$2" '$1 == "#define" && $2 == def { print $3; exit }' "$1"
+}
+
+# Run sstm8 on the given command file and print the clock counts reported by
+# every 'state' command, one per line
+run_sstm8()
+{
+    "${SSTM8}" -t "$1" -X 2M "$2" < "$3" 2>&1 | \
+        sed -n -e 's/.*(\([0-9][0-9]*\) clks).*/\1/p'
+}
+
+# Print the difference of the first two clock counts on stdin
+clk_delta()
+{
+    awk 'NR == 1 { a = $1 } NR == 2 { print $1 - a; exit }'
+}
+
+bench_board()
+{
+    local board=$1
+    local work=$(mktemp -d)
+    local cmds=${work}/cmds
+
+    cp -r "${TOP}"/. "${work}/" && cd "${work}" || return 1
+    make distclean > /dev/null 2>&1
+    ./configure.sh "${board}" > /dev/null || return 1
+    make > /dev/null || return 1
+
+    local part=$(awk -F= '/^MCUPART *=/ { gsub(/ /, "", $2); print toupper($2) }' Make.defs)
+    local map=trigger.map
+    local gpiob_isr=$(sym_addr ${map} _ot_gpiob_isr)
+    local out_odr=$(port_base $(config_def config.h TRIGGER_OUT_PORT))
+    local dip_idr=$(printf '0x%X' $(( $(port_base $(config_def config.h DIP0_PORT)) + 1 )))
+    local dip_read=$(sym_addr ${map} _OT_GPIO_bursts_to_ignore)
+    local gpioc_isr=$(sym_addr ${map} _ot_gpioc_isr)
+    local halt_at=$(insn_addr main.rst halt)
+    local in_cr2=$(printf '0x%X' $(( $(port_base $(config_def config.h TRIGGER_IN_PORT)) + 4 )))
+
+    # Scenario: flash_to_trigger_out
+    # Ground the DIP inputs when INIT reads them (000b: fire on the first
+    # burst), wait for READY to arm TRIGGER_IN (first write to its CR2),
+    # then enter the TRIGGER_IN ISR and stop at the first write to the
+    # TRIGGER_OUT port.
+    cat > ${cmds} <<EOC
+break ${dip_read}
+run
+delete
+set mem rom ${dip_idr} 0x00
+break rom w ${in_cr2}
+run
+delete
+pc ${gpiob_isr}
+state
+break rom w ${out_odr}
+run
+state
+quit
+EOC
+    echo "${COMMIT},${board},flash_to_trigger_out,$(run_sstm8 ${part} trigger.ihx ${cmds} | clk_delta)" >> "${OUT}"
+
+    # Scenario: button_to_armed
+    # Run READY's timeout out (a minute of simulated time) to the halt() of
+    # SLEEPING, then enter the button's ISR as its edge would: the halt is
+    # replaced by a trap, vectored (0x8004) to the ISR, which stacks the
+    # frame its iret returns through. From the entry of the ISR to the first
+    # write to TRIGGER_IN's CR2, which arms it. This excludes the wake-up
+    # from halt itself, which ucsim doesn't model (see FAST_WAKEUP).
+    if [[ -n ${gpioc_isr} && -n ${halt_at} ]]; then
+        local trap_vector=$(printf '0x82 0x00 0x%02X 0x%02X' \
+                            $(( (gpioc_isr >> 8) & 0xFF )) $(( gpioc_isr & 0xFF )))
+        cat > ${cmds} <<EOC
+break ${halt_at}
+run
+delete
+set mem rom ${halt_at} 0x83
+set mem rom 0x8004 ${trap_vector}
+break ${gpioc_isr}
+run
+delete
+state
+break rom w ${in_cr2}
+run
+state
+quit
+EOC
+        echo "${COMMIT},${board},button_to_armed,$(run_sstm8 ${part} trigger.ihx ${cmds} | clk_delta)" >> "${OUT}"
+    fi
+
+    cd "${TOP}"
+    rm -rf "${work}"
+    return 0
+}
+
+if [[ $# -eq 0 ]]; then
+    set -- $(find "${TOP}/configs" -name config.h -exec dirname {} \; | \
+             sed -e "s,${TOP}/configs/,,g" | sort)
+fi
+
+rc=0
+for board in "$@"; do
+    bench_board "${board}" || { echo "bench: ${board} failed" >&2; rc=1; }
+done
+exit ${rc}
@@ -0,0 +1,178 @@
+#!/usr/bin/env python3
+#===============================================================================
+# Host decoder of a data EEPROM dump (EEPROM_STORE, EVENT_LOG)
+#
+# Usage: tools/eventlog.py <config.h> <dump>
+#
+# The dump is the data EEPROM read from its first byte, as a raw binary or an
+# Intel hex file (.hex or .ihx), e.g. from `make eventlog`. EEPROM_RING_SLOTS
+# and EVENT_LOG_ENTRIES are the #defines of the given config.h.
+#
+# Prints the lifetime counters of the newest good record of the ring, then the
+# event log from the oldest entry to the newest. The layouts follow eeprom.c:
+# - A record is 32 bytes: 4 big-endian uint32 counters (bursts, triggers,
+#   glitches, sleeps), 12 bytes of settings, then magic (0xA5), sequence
+#   number and a Fletcher checksum (modulo 256) of the 30 bytes before it.
+# - An entry of the log is 4 bytes: sequence number, event, argument, and
+#   seq ^ event ^ arg ^ 0xA5.
+# - In both rings the newest entry is the last of the run of consecutive
+#   sequence numbers starting at entry 0.
+#===============================================================================
+import re
+import struct
+import sys
+
+RECORD_SIZE = 32
+ENTRY_SIZE = 4
+MAGIC = 0xA5
+
+RE_DEFINE = re.compile(r'^\s*#define\s+(\w+)\s+(\d+)\b')
+NAMES = ('EEPROM_RING_SLOTS', 'EVENT_LOG_ENTRIES')
+
+# As OT_SM_STATE_T (state_machine.h) with SNIFF_MODE (the default), for the
+# STORM argument
+STATES = ['INIT', 'READY', 'PROVISIONAL', 'CONFIRMED', 'SLEEPING',
+          'SNIFFING', 'FAULT']
+
+# As RST_FLAG_* (stm8s_rst.h), for the RESET argument
+RESET_FLAGS = [(0x01, 'window watchdog'), (0x02, 'independent watchdog'),
+               (0x04, 'illegal opcode'), (0x08, 'SWIM'),
+               (0x10, 'EMC')]
+
+
+class DumpError(Exception):
+    pass
+
+
+def parse_defines(path):
+    defines = {}
+    for line in open(path):
+        m = RE_DEFINE.match(line)
+        if m:
+            defines.setdefault(m.group(1), int(m.group(2)))
+    return defines
+
+
+def read_ihex(path):
+    data = {}
+    base = 0
+    for line in open(path):
+        line = line.strip()
+        if not line.startswith(':'):
+            continue
+        rec = bytes.fromhex(line[1:])
+        if sum(rec) & 0xFF:
+            raise DumpError('bad checksum in %s: %s' % (path, line))
+        count, addr, kind = rec[0], (rec[1] << 8) | rec[2], rec[3]
+        if kind == 0:
+            for i, b in enumerate(rec[4:4 + count]):
+                data[base + addr + i] = b
+        elif kind == 4:
+            base = ((rec[4] << 8) | rec[5]) << 16
+        elif kind == 1:
+            break
+    if not data:
+        return b''
+    start = min(data)
+    return bytes(data.get(a, 0) for a in range(start, max(data) + 1))
+
+
+def read_dump(path):
+    if path.endswith(('.hex', '.ihx')):
+        return read_ihex(path)
+    return open(path, 'rb').read()
+
+
+# As ot_ee_find_head() in eeprom.c, but a linear scan: returns the index of
+# the newest entry
+def newest(seqs):
+    i = 1
+    while i < len(seqs) and ((seqs[i] - seqs[0]) & 0xFF) == i:
+        i += 1
+    return i - 1
+
+
+def fletcher(data):
+    sum1 = sum2 = 0
+    for b in data:
+        sum1 = (sum1 + b) & 0xFF
+        sum2 = (sum2 + sum1) & 0xFF
+    return sum1, sum2
+
+
+def record_ok(rec):
+    return rec[28] == MAGIC and tuple(rec[30:32]) == fletcher(rec[:30])
+
+
+def decode_records(dump, slots):
+    recs = [dump[i * RECORD_SIZE:(i + 1) * RECORD_SIZE] for i in range(slots)]
+    head = newest([r[29] for r in recs])
+    for slot in (head, (head - 1) % slots):
+        if record_ok(recs[slot]):
+            bursts, triggers, glitches, sleeps = struct.unpack('>4I',
+                                                               recs[slot][:16])
+            print('Record %d (slot %d%s)' % (recs[slot][29], slot,
+                  '' if slot == head else ', the newest is corrupt'))
+            print('  bursts %u, triggers %u, glitches %u, sleeps %u' %
+                  (bursts, triggers, glitches, sleeps))
+            return
+    print('No good record')
+
+
+def describe(event, arg):
+    if event == 1:
+        flags = [name for bit, name in RESET_FLAGS if arg & bit]
+        return 'RESET     %s' % (', '.join(flags) if flags else
+                                 'power-on or brown-out')
+    if event == 2:
+        return 'TRIGGER   after %d burst(s)' % arg
+    if event == 3:
+        return 'MISMATCH  phase %d, burst %d of it' % (arg >> 4, arg & 0x0F)
+    if event == 4:
+        state = STATES[arg] if arg < len(STATES) else '?'
+        return 'STORM     in state %d (%s)' % (arg, state)
+    return 'event %d  arg 0x%02X' % (event, arg)
+
+
+def decode_log(dump, offset, entries):
+    ents = [dump[offset + i * ENTRY_SIZE:offset + (i + 1) * ENTRY_SIZE]
+            for i in range(entries)]
+    head = newest([e[0] for e in ents])
+    order = ents[head + 1:] + ents[:head + 1]
+    print('Events (oldest first)')
+    shown = 0
+    for seq, event, arg, check in order:
+        if check != (seq ^ event ^ arg ^ MAGIC):
+            continue  # Erased, or cut short by a reset
+        print('  %3d  %s' % (seq, describe(event, arg)))
+        shown += 1
+    if not shown:
+        print('  (none)')
+
+
+def main(argv):
+    if len(argv) != 3:
+        sys.stderr.write('usage: %s <config.h> <dump>\n' % argv[0])
+        return 2
+    d = parse_defines(argv[1])
+    missing = [n for n in NAMES if n not in d]
+    try:
+        if missing:
+            raise DumpError('%s: no %s (EEPROM_STORE and EVENT_LOG?)' %
+                            (argv[1], ', '.join(missing)))
+        slots, entries = d['EEPROM_RING_SLOTS'], d['EVENT_LOG_ENTRIES']
+        dump = read_dump(argv[2])
+        size = slots * RECORD_SIZE + entries * ENTRY_SIZE
+        if len(dump) < size:
+            raise DumpError('%s: %d bytes, expected at least %d' %
+                            (argv[2], len(dump), size))
+    except (DumpError, OSError, ValueError) as e:
+        sys.stderr.write('%s\n' % e)
+        return 1
+    decode_records(dump, slots)
+    decode_log(dump, slots * RECORD_SIZE, entries)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
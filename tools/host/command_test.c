@@ -0,0 +1,292 @@
+/*==============================================================================
+ * MODULE: Command test (CTEST)
+ * DESCRIPTION: Host test of the wireless Command decoder (command.c), for
+ * each protocol it supports:
+ * - every frame (all OT_CMD_FRAME_BITS-bit values), sent at the protocol's
+ *   nominal timings and with every gap off by +/-WIRELESS_TOLERANCE_CYCLES,
+ *   is decoded as sent (OT_CMD_frames, OT_CMD_last_frame), or dropped if its
+ *   parity is odd, and only the burst after a FIRE frame to one of our groups
+ *   is commanded;
+ * - a frame with one gap off by one cycle more isn't decoded (or, if it is
+ *   the burst's, the burst isn't commanded);
+ * - the @group traces of doc/traces (see doc/FlashTraces.md) meant for our
+ *   groups command exactly burst @expect (none for @expect 0).
+ *
+ * Built with OT_CTEST_GROUP as WIRELESS_GROUP (config.h's by default), so the
+ * traces can be checked for every group.
+ *
+ * Usage: command_test <trace> ...
+ *============================================================================*/
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "config.h"
+#if defined(OT_CTEST_GROUP)
+  #undef WIRELESS_GROUP
+  #define WIRELESS_GROUP  OT_CTEST_GROUP
+#endif // OT_CTEST_GROUP
+// White-box: the protocols' timings
+#include "command.c"
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+// Between frames: no protocol's leader
+#define OT_CTEST_IDLE       40000
+// Start of the frames, so that they wrap the 32-bit cycle counter
+#define OT_CTEST_T0         0xFFF00000UL
+#define OT_CTEST_FRAMES     (1 << OT_CMD_FRAME_BITS)
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+#define OT_CTEST_CHECK(cond, what)  \
+  do { if (!(cond)) ot_ctest_fail(what, __LINE__); } while (0)
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+/*==============================================================================
+ * LOCAL FUNCTION PROTOTYPES
+ *============================================================================*/
+/*==============================================================================
+ * LOCAL VARIABLES
+ *============================================================================*/
+static const char *ot_ctest_names[OT_CMD_PROTOCOLS] = {
+  "Nikon CLS", "Canon optical"
+};
+
+static const char *ot_ctest_case;
+static uint32_t ot_ctest_now;
+static uint32_t ot_ctest_checks   = 0;
+static uint32_t ot_ctest_failures = 0;
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+/*==============================================================================
+ * LOCAL FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION: Report a failed check
+ * @param what
+ * @param line
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static void ot_ctest_fail(const char *what, int line) {
+  printf("FAIL: %s: %s (line %d)\n", ot_ctest_case, what, line);
+  ++ot_ctest_failures;
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: An edge, gap after the last one
+ * @param gap - CPU cycles
+ * @return non-zero if it is a commanded burst
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static uint8_t ot_ctest_edge(uint32_t gap) {
+  ot_ctest_now += gap;
+  return OT_CMD_is_commanded_burst(ot_ctest_now);
+}
+/*==============================================================================
+ * DESCRIPTION: Send a frame and the burst it commands
+ * @param protocolp
+ * @param frame
+ * @param skew - added to every gap
+ * @param gap - the gap (0: leader, 1..OT_CMD_FRAME_BITS: bits, then the
+ *        burst) that off is added to
+ * @param off
+ * @return non-zero if the burst is commanded
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes No pulse but the burst may be commanded
+ *============================================================================*/
+static uint8_t ot_ctest_frame(const OT_CMD_PROTOCOL_T *protocolp,
+                              uint8_t frame, int32_t skew, uint8_t gap,
+                              int32_t off) {
+  uint8_t bit;
+  uint8_t commanded = ot_ctest_edge(OT_CTEST_IDLE);
+  commanded |= ot_ctest_edge(protocolp->leader + skew +
+                             ((0 == gap) ? off : 0));
+  for (bit = 1; bit <= OT_CMD_FRAME_BITS; ++bit) {
+    commanded |= ot_ctest_edge(
+      (((frame >> (OT_CMD_FRAME_BITS - bit)) & 0x01) ? protocolp->one :
+                                                       protocolp->zero) +
+      skew + ((bit == gap) ? off : 0));
+  }
+  OT_CTEST_CHECK(0 == commanded, "a frame's pulse commanded");
+  return ot_ctest_edge(protocolp->burst + skew +
+                       (((OT_CMD_FRAME_BITS + 1) == gap) ? off : 0));
+}
+/*==============================================================================
+ * DESCRIPTION: Every frame of a protocol
+ * @param p - index of the protocol
+ * @param skew - added to every gap
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static void ot_ctest_frames(uint8_t p, int32_t skew) {
+  const OT_CMD_PROTOCOL_T *protocolp = &ot_cmd_protocols[p];
+  uint8_t frame;
+  uint8_t fire;
+  uint8_t commanded;
+  uint16_t frames;
+  static char name[64];
+
+  snprintf(name, sizeof(name), "%s, gaps %+d", ot_ctest_names[p], skew);
+  ot_ctest_case = name;
+  for (frame = 0; frame < OT_CTEST_FRAMES; ++frame) {
+    frames = OT_CMD_frames;
+    commanded = ot_ctest_frame(protocolp, frame, skew, 0, 0);
+    ++ot_ctest_checks;
+    if (__builtin_parity(frame)) { // Not the decoder's own
+      OT_CTEST_CHECK(frames == OT_CMD_frames, "odd parity decoded");
+      OT_CTEST_CHECK(0 == commanded, "odd parity commanded");
+      continue;
+    }
+    fire = (OT_CMD_CMD_FIRE == (frame >> OT_CMD_FRAME_CMD_SHIFT)) &&
+           (0 != (((frame & OT_CMD_FRAME_GROUP_MASK) >>
+                   OT_CMD_FRAME_GROUP_SHIFT) & WIRELESS_GROUP));
+    OT_CTEST_CHECK((frames + 1) == OT_CMD_frames, "frame not decoded");
+    OT_CTEST_CHECK(frame == OT_CMD_last_frame, "frame decoded wrong");
+    OT_CTEST_CHECK(fire == commanded, fire ? "FIRE not commanded" :
+                                             "commanded without a FIRE");
+  }
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Frames with a gap out of the tolerance
+ * @param p - index of the protocol
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes Each gap in turn, early and late, of a FIRE to every group
+ *============================================================================*/
+static void ot_ctest_out_of_tolerance(uint8_t p) {
+  const OT_CMD_PROTOCOL_T *protocolp = &ot_cmd_protocols[p];
+  const uint8_t frame = (OT_CMD_CMD_FIRE << OT_CMD_FRAME_CMD_SHIFT) |
+                        OT_CMD_FRAME_GROUP_MASK; // Even parity
+  uint16_t frames;
+  uint8_t gap;
+  int32_t off;
+
+  ot_ctest_case = ot_ctest_names[p];
+  for (gap = 0; gap <= (OT_CMD_FRAME_BITS + 1); ++gap) {
+    for (off = -(WIRELESS_TOLERANCE_CYCLES + 1);
+         off <= (WIRELESS_TOLERANCE_CYCLES + 1);
+         off += 2 * (WIRELESS_TOLERANCE_CYCLES + 1)) {
+      frames = OT_CMD_frames;
+      ++ot_ctest_checks;
+      OT_CTEST_CHECK(0 == ot_ctest_frame(protocolp, frame, 0, gap, off),
+                     "commanded out of the tolerance");
+      // The burst's gap is after the frame
+      OT_CTEST_CHECK((frames + ((OT_CMD_FRAME_BITS + 1) == gap)) ==
+                     OT_CMD_frames, "decoded out of the tolerance");
+    }
+  }
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Feed a trace's bursts to the decoder
+ * @param path
+ * @return 0 if it commands burst @expect only (or isn't for our groups),
+ *         -1 if it isn't a trace
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static int ot_ctest_trace(const char *path) {
+  char line[160];
+  char name[64] = "";
+  unsigned long t_us;
+  unsigned long width_us;
+  long expect = -1;
+  long group = -1;
+  uint16_t burst = 0;
+  uint16_t commanded = 0;
+  uint16_t first = 0;
+  char *commentp;
+  FILE *fp = fopen(path, "r");
+
+  if ((void*)0 == fp) {
+    perror(path);
+    return -1;
+  }
+  OT_CMD_reset();
+  while ((void*)0 != fgets(line, sizeof(line), fp)) {
+    commentp = strchr(line, '#');
+    if ((void*)0 != commentp) *commentp = '\0';
+    if ((1 == sscanf(line, " @name %63s", name)) ||
+        (1 == sscanf(line, " @expect %ld", &expect)) ||
+        (1 == sscanf(line, " @group %li", &group))) {
+      continue;
+    }
+    if (2 != sscanf(line, " %lu %lu", &t_us, &width_us)) continue;
+    if (group != WIRELESS_GROUP) break; // Not ours (or no commands)
+    ++burst;
+    if (OT_CMD_is_commanded_burst(OT_CTEST_T0 + OT_CMD_US(t_us))) {
+      if (0 == commanded++) first = burst;
+    }
+  }
+  fclose(fp);
+  if (('\0' == name[0]) || (expect < 0)) {
+    fprintf(stderr, "%s: not a trace\n", path);
+    return -1;
+  }
+  if (group != WIRELESS_GROUP) return 0;
+  ot_ctest_case = name;
+  ++ot_ctest_checks;
+  if (0 == expect) {
+    OT_CTEST_CHECK(0 == commanded, "commanded");
+  }
+  else {
+    OT_CTEST_CHECK(1 == commanded, "not commanded once");
+    OT_CTEST_CHECK((0 == commanded) || (expect == first),
+                   "commanded on the wrong burst");
+  }
+  printf("%-24s group 0x%02lx: %u burst(s) commanded, first %u "
+         "(@expect %ld)\n", name, (unsigned long)group, commanded, first,
+         expect);
+  return 0;
+}
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+int main(int argc, char **argv) {
+  int rc = 0;
+  int i;
+  uint8_t p;
+
+  ot_ctest_now = OT_CTEST_T0;
+  OT_CMD_reset();
+  for (p = 0; p < OT_CMD_PROTOCOLS; ++p) {
+    ot_ctest_frames(p, 0);
+    ot_ctest_frames(p, -WIRELESS_TOLERANCE_CYCLES);
+    ot_ctest_frames(p, WIRELESS_TOLERANCE_CYCLES);
+    ot_ctest_out_of_tolerance(p);
+  }
+  for (i = 1; i < argc; ++i) {
+    if (0 != ot_ctest_trace(argv[i])) rc = 2;
+  }
+  if (0 != ot_ctest_failures) {
+    printf("FAIL: %u of %u checks (WIRELESS_GROUP 0x%02x)\n",
+           ot_ctest_failures, ot_ctest_checks, WIRELESS_GROUP);
+    return 1;
+  }
+  printf("%u frames and traces decoded as expected "
+         "(WIRELESS_GROUP 0x%02x)\n", ot_ctest_checks, WIRELESS_GROUP);
+  return rc;
+}
+/*============================================================================*/
@@ -0,0 +1,237 @@
+/*==============================================================================
+ * MODULE: Lightning test (LT)
+ * DESCRIPTION: Runs the firmware (main.c), unmodified and built with
+ * ADC_FLASH_DETECT and LIGHTNING_MODE, in the simulator (sim.c) on the
+ * FLASH_SENSE waveforms of doc/waveforms: adc.c converts each waveform on
+ * ADC1's model, whose analog watchdog raises ot_adc_isr, and the State
+ * Machine re-arms it (OT_ADC_flash_track() on its ticks, and after each
+ * fire). Each fire is matched to the event (@event) it follows within
+ * OT_LT_MATCH_US.
+ *
+ * The latencies are timed as the simulator times them: the conversions
+ * (14usec each at fADC = fMASTER/2) and the interrupt entry. The instructions
+ * aren't (see `make bench` and `make wcet`): those of ot_adc_isr up to
+ * TRIGGER_OUT_ON(), nor those of a tick's OT_ADC_flash_track() the ADC1
+ * interrupt may have to wait for.
+ *
+ * Usage: lightning_test <file.wave> ...
+ * Prints, for each event, the time from its onset to TRIGGER_OUT, and from
+ * the end of the conversion the watchdog tripped on. Fails on a missed event
+ * or on a fire on no event.
+ *============================================================================*/
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "config.h"
+#include "sim.h"
+#include "wave.h"
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+#if !defined(LIGHTNING_MODE)
+  #error "Build with ADC_FLASH_DETECT and LIGHTNING_MODE"
+#endif
+// A waveform starts this long after power-up (in READY by then)
+#define OT_LT_START_MS          1000
+// A fire later than this after an event's onset doesn't count for it
+#define OT_LT_MATCH_US          2000
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+// What a run saw, as reported by its child process
+typedef struct OT_LT_RESULT_S {
+  uint32_t fires;
+  uint64_t fire_at[OT_SIM_FIRES];
+  uint64_t sensed_at[OT_SIM_FIRES];
+} OT_LT_RESULT_T;
+/*==============================================================================
+ * LOCAL FUNCTION PROTOTYPES
+ *============================================================================*/
+static OT_SIM_LEVEL_CB_T ot_lt_level_cb;
+// main() of main.c, built with -Dmain=OT_SIM_firmware_main
+void OT_SIM_firmware_main(void);
+/*==============================================================================
+ * LOCAL VARIABLES
+ *============================================================================*/
+static OT_WAVE_T ot_lt_wave;
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+/*==============================================================================
+ * LOCAL FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION: FLASH_SENSE, for ADC1 to convert
+ * @param at - CPU cycles since power-up
+ * @return ADC counts
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes Before the waveform starts, its first level
+ *============================================================================*/
+static uint16_t ot_lt_level_cb(uint64_t at) {
+  double t_us = ((double)at - (double)OT_SIM_MS(OT_LT_START_MS)) /
+                OT_SIM_CYCLES_PER_US;
+  return OT_WAVE_level(&ot_lt_wave, t_us);
+}
+/*==============================================================================
+ * DESCRIPTION: Run the firmware on the waveform
+ * @param resultp
+ * @return
+ * @precondition A fresh process (the firmware keeps its state in statics)
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static void ot_lt_one(OT_LT_RESULT_T *resultp) {
+  OT_SIM_reset(0, 0);
+  OT_SIM_flash_sense(ot_lt_level_cb);
+  OT_SIM_run_firmware(OT_SIM_firmware_main, OT_SIM_MS(OT_LT_START_MS) +
+                      OT_SIM_US(OT_WAVE_end_us(&ot_lt_wave)));
+  resultp->fires = OT_SIM_trigger.fires;
+  memcpy(resultp->fire_at, OT_SIM_trigger.fire_at, sizeof(resultp->fire_at));
+  memcpy(resultp->sensed_at, OT_SIM_trigger.sensed_at,
+         sizeof(resultp->sensed_at));
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Run the firmware on the waveform, in a child process
+ * @param resultp
+ * @return 0 if the child ran to completion
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static int ot_lt_fork(OT_LT_RESULT_T *resultp) {
+  int fds[2];
+  int status;
+  ssize_t got;
+  pid_t pid;
+
+  fflush(stdout);
+  if ((0 != pipe(fds)) || ((pid = fork()) < 0)) {
+    perror("lightning_test");
+    exit(2);
+  }
+  if (0 == pid) {
+    close(fds[0]);
+    ot_lt_one(resultp);
+    got = write(fds[1], resultp, sizeof(*resultp));
+    _exit((sizeof(*resultp) == got) ? 0 : 1);
+  }
+  close(fds[1]);
+  got = read(fds[0], resultp, sizeof(*resultp));
+  close(fds[0]);
+  waitpid(pid, &status, 0);
+  return ((sizeof(*resultp) == got) && WIFEXITED(status) &&
+          (0 == WEXITSTATUS(status))) ? 0 : -1;
+}
+/*==============================================================================
+ * DESCRIPTION: Match the fires to the events of the waveform
+ * @param resultp
+ * @param worstp - the worst onset-to-fire latency (usec), updated
+ * @param worst_sensedp - the worst conversion-to-fire latency, updated
+ * @return 0 if every event, and only the events, were fired on
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static int ot_lt_check(const OT_LT_RESULT_T *resultp, double *worstp,
+                       double *worst_sensedp) {
+  uint8_t matched[OT_SIM_FIRES];
+  uint32_t fires = resultp->fires;
+  uint32_t i;
+  uint8_t e;
+  int rc = 0;
+
+  if (fires > OT_SIM_FIRES) {
+    printf("FAIL: %s: %u fires\n", ot_lt_wave.name, (unsigned)fires);
+    return -1;
+  }
+  memset(matched, 0, sizeof(matched));
+  for (e = 0; e < ot_lt_wave.events; ++e) {
+    uint64_t onset = OT_SIM_MS(OT_LT_START_MS) +
+                     OT_SIM_US(ot_lt_wave.event_us[e]);
+    double latency;
+    double sensed;
+    for (i = 0; i < fires; ++i) {
+      if (!matched[i] && (onset <= resultp->fire_at[i]) &&
+          (resultp->fire_at[i] <= onset + OT_SIM_US(OT_LT_MATCH_US))) {
+        break;
+      }
+    }
+    if (i == fires) {
+      printf("FAIL: %-22s event %9luus: missed\n", ot_lt_wave.name,
+             (unsigned long)ot_lt_wave.event_us[e]);
+      rc = -1;
+      continue;
+    }
+    matched[i] = 1;
+    latency = (double)(resultp->fire_at[i] - onset) / OT_SIM_CYCLES_PER_US;
+    sensed = (double)(resultp->fire_at[i] - resultp->sensed_at[i]) /
+             OT_SIM_CYCLES_PER_US;
+    printf("%-22s event %9luus: fired after %6.1fus (%4.1fus after the "
+           "conversion)\n", ot_lt_wave.name,
+           (unsigned long)ot_lt_wave.event_us[e], latency, sensed);
+    if (latency > *worstp) *worstp = latency;
+    if (sensed > *worst_sensedp) *worst_sensedp = sensed;
+  }
+  if ((0 == ot_lt_wave.events) && (0 == fires)) {
+    printf("%-22s no event, no fire\n", ot_lt_wave.name);
+  }
+  for (i = 0; i < fires; ++i) {
+    if (!matched[i]) {
+      printf("FAIL: %-22s fire at %9.1fus on no event\n", ot_lt_wave.name,
+             (double)(resultp->fire_at[i] - OT_SIM_MS(OT_LT_START_MS)) /
+             OT_SIM_CYCLES_PER_US);
+      rc = -1;
+    }
+  }
+  return rc;
+}
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+int main(int argc, char *argv[]) {
+  OT_LT_RESULT_T result;
+  double worst = 0;
+  double worst_sensed = 0;
+  int failures = 0;
+  int i;
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <file.wave> ...\n", argv[0]);
+    return 2;
+  }
+  for (i = 1; i < argc; ++i) {
+    if (0 != OT_WAVE_load(argv[i], &ot_lt_wave)) {
+      ++failures;
+      continue;
+    }
+    if (0 != ot_lt_fork(&result)) {
+      printf("FAIL: %s: the firmware didn't run to completion\n",
+             ot_lt_wave.name);
+      ++failures;
+      continue;
+    }
+    if (0 != ot_lt_check(&result, &worst, &worst_sensed)) ++failures;
+  }
+  if (0 != failures) {
+    printf("FAIL: %d of %d waveform(s)\n", failures, argc - 1);
+    return 1;
+  }
+  printf("LIGHTNING_SLOPE %u: worst onset-to-fire %.1fus (conversion-to-fire "
+         "%.1fus)\n", LIGHTNING_SLOPE, worst, worst_sensed);
+  return 0;
+}
+/*============================================================================*/
@@ -0,0 +1,285 @@
+/*==============================================================================
+ * MODULE: Periodic test (PTEST)
+ * DESCRIPTION: Host test of the Periodic Interference detector (periodic.c)
+ * on synthetic TRIGGER_IN edge trains, timed in CPU cycles at 2MHz:
+ * - 100Hz and 120Hz flicker and IR remote repeat codes (alternating
+ *   spacings) lock after exactly PERIODIC_LOCK_EDGES matching edges, and are
+ *   masked from then on, drifting or not;
+ * - a strictly periodic train just short of that (e.g. Nikon monitor
+ *   pre-flashes) is never masked;
+ * - once locked, an edge is masked within (period >> PERIODIC_TOLERANCE_SHIFT)
+ *   + PERIODIC_JITTER_CYCLES of the predicted edge, early or late, and let
+ *   through one cycle further out;
+ * - flash bursts off the period are let through, and don't move the lock;
+ * - the lock outlasts PERIODIC_MISSED_PERIODS - 1 missing edges, not more;
+ * - all of the above across the wrap of the 32-bit cycle counter.
+ *
+ * Usage: periodic_test
+ *============================================================================*/
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include <stdio.h>
+#include "config.h"
+#include "periodic.h"
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+#if !defined(PERIODIC_REJECT)
+  #error "Build with PERIODIC_REJECT"
+#endif
+// Edge spacings, in cycles
+#define OT_PTEST_100HZ      20000      // Rectified 50Hz mains
+#define OT_PTEST_120HZ      16667      // ... 60Hz
+#define OT_PTEST_IR_REPEAT  216000     // NEC repeat code every 108msec...
+#define OT_PTEST_IR_MARK    22500      // ... its mark 11.25msec after leader
+// A flash burst, well off the period
+#define OT_PTEST_FLASH_AT   7000
+// Start times: from 0, and so that the train wraps the cycle counter
+#define OT_PTEST_T0         1000
+#define OT_PTEST_T0_WRAP    0xFFF00000UL
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+#define OT_PTEST_CHECK(cond, what)  \
+  do { if (!(cond)) ot_ptest_fail(what, __LINE__); } while (0)
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+// A train of edges whose spacings alternate between a and b
+typedef struct OT_PTEST_TRAIN_S {
+  const char *name;
+  uint32_t a;
+  uint32_t b;
+} OT_PTEST_TRAIN_T;
+/*==============================================================================
+ * LOCAL FUNCTION PROTOTYPES
+ *============================================================================*/
+/*==============================================================================
+ * LOCAL VARIABLES
+ *============================================================================*/
+static const OT_PTEST_TRAIN_T ot_ptest_trains[] = {
+  { "100Hz flicker", OT_PTEST_100HZ, OT_PTEST_100HZ },
+  { "120Hz flicker", OT_PTEST_120HZ, OT_PTEST_120HZ },
+  { "IR remote",     OT_PTEST_IR_MARK, OT_PTEST_IR_REPEAT - OT_PTEST_IR_MARK }
+};
+#define OT_PTEST_TRAINS  (sizeof(ot_ptest_trains) / sizeof(ot_ptest_trains[0]))
+
+static const OT_PTEST_TRAIN_T *ot_ptest_trainp;
+static uint32_t ot_ptest_t0;
+static uint32_t ot_ptest_checks   = 0;
+static uint32_t ot_ptest_failures = 0;
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+/*==============================================================================
+ * LOCAL FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION: Report a failed check
+ * @param what
+ * @param line
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static void ot_ptest_fail(const char *what, int line) {
+  printf("FAIL: %s, %s from 0x%08x (line %d)\n", ot_ptest_trainp->name, what,
+         ot_ptest_t0, line);
+  ++ot_ptest_failures;
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Classify an edge
+ * @param t
+ * @return non-zero if it is masked
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static uint8_t ot_ptest_edge(uint32_t t) {
+  ++ot_ptest_checks;
+  return OT_PERIODIC_is_interference(t);
+}
+/*==============================================================================
+ * DESCRIPTION:
+ * @param n - 0-based
+ * @return Time of the train's edge n
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static uint32_t ot_ptest_at(uint32_t n) {
+  return ot_ptest_t0 + (n / 2) * (ot_ptest_trainp->a + ot_ptest_trainp->b) +
+         ((n & 1) ? ot_ptest_trainp->a : 0);
+}
+/*==============================================================================
+ * DESCRIPTION: Feed the train from a reset until it is locked
+ * @param
+ * @return The next edge (0-based)
+ * @precondition
+ * @postcondition Locked, if the detector works
+ * @caution
+ * @notes The first two edges set the period up, the third is the first one
+ *        compared
+ *============================================================================*/
+static uint32_t ot_ptest_lock(void) {
+  uint32_t n;
+  OT_PERIODIC_reset();
+  for (n = 0; n < PERIODIC_LOCK_EDGES + 2; ++n) {
+    OT_PTEST_CHECK(0 == ot_ptest_edge(ot_ptest_at(n)), "masked before lock");
+  }
+  OT_PTEST_CHECK(ot_ptest_edge(ot_ptest_at(n)), "not locked");
+  return n + 1;
+}
+/*==============================================================================
+ * DESCRIPTION: An edge off the predicted one by the tolerance, and by one
+ * cycle more
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes Both ways; each probe from a fresh lock, as a masked edge moves
+ *        the prediction
+ *============================================================================*/
+static void ot_ptest_tolerance(void) {
+  // Time from an edge to the edge two after it
+  uint32_t period = ot_ptest_trainp->a + ot_ptest_trainp->b;
+  uint32_t tol = (period >> PERIODIC_TOLERANCE_SHIFT) + PERIODIC_JITTER_CYCLES;
+  uint32_t n;
+
+  n = ot_ptest_lock();
+  OT_PTEST_CHECK(ot_ptest_edge(ot_ptest_at(n) + tol),
+                 "late by tol let through");
+  n = ot_ptest_lock();
+  OT_PTEST_CHECK(0 == ot_ptest_edge(ot_ptest_at(n) + tol + 1),
+                 "late by tol + 1 masked");
+  n = ot_ptest_lock();
+  OT_PTEST_CHECK(ot_ptest_edge(ot_ptest_at(n) - tol),
+                 "early by tol let through");
+  n = ot_ptest_lock();
+  OT_PTEST_CHECK(0 == ot_ptest_edge(ot_ptest_at(n) - tol - 1),
+                 "early by tol + 1 masked");
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Flash bursts within a locked train
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static void ot_ptest_flashes(void) {
+  uint32_t n = ot_ptest_lock();
+  uint32_t i;
+  for (i = 0; i < 4; ++i, ++n) {
+    OT_PTEST_CHECK(0 == ot_ptest_edge(ot_ptest_at(n) - OT_PTEST_FLASH_AT),
+                   "flash masked");
+    OT_PTEST_CHECK(ot_ptest_edge(ot_ptest_at(n)), "lost after a flash");
+  }
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: A train that drifts by a cycle an edge, with jitter
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static void ot_ptest_drift(void) {
+  uint32_t n = ot_ptest_lock();
+  uint32_t i;
+  uint32_t drift = 0;
+  for (i = 0; i < 1000; ++i, ++n) {
+    drift += i;
+    // +/-PERIODIC_JITTER_CYCLES/2 of jitter on every other edge
+    OT_PTEST_CHECK(ot_ptest_edge(ot_ptest_at(n) + drift +
+                                 ((i & 2) ? PERIODIC_JITTER_CYCLES / 2 : 0) -
+                                 ((i & 1) ? PERIODIC_JITTER_CYCLES / 2 : 0)),
+                   "lost while drifting");
+  }
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Edges missing from a locked train
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static void ot_ptest_missed(void) {
+  uint32_t n;
+  uint32_t missed;
+  for (missed = 1; missed < PERIODIC_MISSED_PERIODS; ++missed) {
+    n = ot_ptest_lock() + missed;
+    OT_PTEST_CHECK(ot_ptest_edge(ot_ptest_at(n)), "lost after missed edges");
+  }
+  n = ot_ptest_lock() + PERIODIC_MISSED_PERIODS;
+  OT_PTEST_CHECK(0 == ot_ptest_edge(ot_ptest_at(n)),
+                 "held after PERIODIC_MISSED_PERIODS missed edges");
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: The longest periodic train a real flash may have
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static void ot_ptest_short_train(void) {
+  uint32_t n;
+  OT_PERIODIC_reset();
+  for (n = 0; n < PERIODIC_LOCK_EDGES + 2; ++n) {
+    OT_PTEST_CHECK(0 == ot_ptest_edge(ot_ptest_at(n)), "short train masked");
+  }
+  return;
+}
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+int main(void) {
+  static const uint32_t t0s[] = { OT_PTEST_T0, OT_PTEST_T0_WRAP };
+  uint32_t i;
+  uint32_t t;
+
+  for (i = 0; i < OT_PTEST_TRAINS; ++i) {
+    ot_ptest_trainp = &ot_ptest_trains[i];
+    for (t = 0; t < sizeof(t0s) / sizeof(t0s[0]); ++t) {
+      ot_ptest_t0 = t0s[t];
+      ot_ptest_short_train();
+      ot_ptest_tolerance();
+      ot_ptest_flashes();
+      ot_ptest_drift();
+      ot_ptest_missed();
+    }
+  }
+  // Start right before the wrap, so that the tolerance probes straddle it
+  for (i = 0; i < OT_PTEST_TRAINS; ++i) {
+    ot_ptest_trainp = &ot_ptest_trains[i];
+    ot_ptest_t0 = 0U - (PERIODIC_LOCK_EDGES + 3) / 2 *
+                  (ot_ptest_trainp->a + ot_ptest_trainp->b) -
+                  (((PERIODIC_LOCK_EDGES + 3) & 1) ? ot_ptest_trainp->a : 0);
+    ot_ptest_tolerance();
+  }
+  if (0 != ot_ptest_failures) {
+    printf("FAIL: %u of %u edges misclassified\n", ot_ptest_failures,
+           ot_ptest_checks);
+    return 1;
+  }
+  printf("%u edges classified as expected\n", ot_ptest_checks);
+  return 0;
+}
+/*============================================================================*/
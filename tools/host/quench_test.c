@@ -0,0 +1,338 @@
+/*==============================================================================
+ * MODULE: Quench test (QT)
+ * DESCRIPTION: Runs the firmware (main.c), unmodified and built with
+ * BURST_CAPTURE and QUENCH_OUT, in the simulator (sim.c) on the bursts of a
+ * master at each of its powers (doc/waveforms/master-*.wave): TRIGGER_IN
+ * follows the sensor's comparator on the waveform, and adc.c captures the
+ * waveform itself (FLASH_SENSE) on ADC1's model. Each slave's power is taken
+ * as proportional to the time from its trigger to its quench (or to
+ * OT_QT_FULL_US, unquenched), and compared with the requested power:
+ * QUENCH_RATIO_16THS/16 of the master's burst (its time above half its
+ * peak).
+ *
+ * The capture can only time a burst that ends within it, i.e. between its
+ * first sample (QUENCH_LEAD_CYCLES after the edge) and its last; the others
+ * get the firmware's fallbacks (ot_sm_quench()): a burst over before the
+ * first sample is quenched after QUENCH_LEAD_CYCLES/2, one that outlasts the
+ * capture isn't quenched at all. Each burst must be within OT_QT_TOLERANCE
+ * of what it gets (the requested power, or the fallback); its error against
+ * the requested power is printed either way.
+ *
+ * Usage: quench_test <file.wave> ...
+ * Waveforms without @power are skipped. Prints, for each power, the time
+ * from TRIGGER_IN's edge to TRIGGER_OUT (the capture delays the trigger),
+ * the slave's quench and its error (EV) against the requested power.
+ *============================================================================*/
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "config.h"
+#include "adc.h"
+#include "sim.h"
+#include "wave.h"
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+#if !defined(BURST_CAPTURE) || !defined(QUENCH_OUT)
+  #error "Build with BURST_CAPTURE and QUENCH_OUT"
+#endif
+// A waveform starts this long after power-up (in READY by then)
+#define OT_QT_START_MS          1000
+// And the run ends this long after it (the slave's burst is long over)
+#define OT_QT_TRAIL_MS          100
+// The sensor's comparator (TRIGGER_IN): high while FLASH_SENSE is above
+#define OT_QT_COMPARATOR        200
+// The slave's burst at full power (unquenched), as the master's
+#define OT_QT_FULL_US           4000
+// Accepted error of a slave's power against what it should get (EV)
+#define OT_QT_TOLERANCE         (1.0 / 3)
+// On TRIGGER_OUT's delay past the capture (the interrupt latency, SM_STATS)
+#define OT_QT_FIRE_SLACK_US     10
+#define OT_QT_MAX_PULSES        8
+// What the capture makes of a burst (see above)
+#define OT_QT_MATCHED           0
+#define OT_QT_TOO_SHORT         1
+#define OT_QT_TOO_LONG          2
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+// What a run saw, as reported by its child process
+typedef struct OT_QT_RESULT_S {
+  uint32_t fires;
+  uint32_t quenches;
+  uint64_t fire_at;
+  uint64_t quench_at;
+} OT_QT_RESULT_T;
+/*==============================================================================
+ * LOCAL FUNCTION PROTOTYPES
+ *============================================================================*/
+static OT_SIM_LEVEL_CB_T ot_qt_level_cb;
+// main() of main.c, built with -Dmain=OT_SIM_firmware_main
+void OT_SIM_firmware_main(void);
+/*==============================================================================
+ * LOCAL VARIABLES
+ *============================================================================*/
+static OT_WAVE_T ot_qt_wave;
+static OT_SIM_PULSE_T ot_qt_pulses[OT_QT_MAX_PULSES];
+static uint16_t ot_qt_npulses;
+static const char *ot_qt_cases[] = {
+  "matched", "over before the capture", "outlasts the capture"
+};
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+/*==============================================================================
+ * LOCAL FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION: FLASH_SENSE, for ADC1 to convert
+ * @param at - CPU cycles since power-up
+ * @return ADC counts
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static uint16_t ot_qt_level_cb(uint64_t at) {
+  double t_us = ((double)at - (double)OT_SIM_MS(OT_QT_START_MS)) /
+                OT_SIM_CYCLES_PER_US;
+  return OT_WAVE_level(&ot_qt_wave, t_us);
+}
+/*==============================================================================
+ * DESCRIPTION: Find the comparator's pulses (TRIGGER_IN) and the master's
+ * burst (its time above half its peak) on the waveform
+ * @param startp - where to store the start of the burst (usec)
+ * @param endp - where to store its end (usec)
+ * @return 0 if there is one
+ * @precondition OT_WAVE_load()
+ * @postcondition ot_qt_pulses are in cycles since power-up
+ * @caution
+ * @notes Scanned every 0.5usec (a CPU cycle)
+ *============================================================================*/
+static int ot_qt_scan(double *startp, double *endp) {
+  double end_us = OT_WAVE_end_us(&ot_qt_wave);
+  double t_us;
+  uint16_t lowest = 0xFFFF;
+  uint16_t highest = 0;
+  uint16_t level;
+  uint16_t half;
+  uint8_t high = 0;
+
+  for (t_us = 0; t_us <= end_us; t_us += 0.5) {
+    level = OT_WAVE_level(&ot_qt_wave, t_us);
+    if (level < lowest) lowest = level;
+    if (level > highest) highest = level;
+  }
+  half = lowest + ((highest - lowest) >> 1);
+  *startp = -1;
+  *endp = -1;
+  ot_qt_npulses = 0;
+  for (t_us = 0; t_us <= end_us; t_us += 0.5) {
+    uint64_t at = OT_SIM_MS(OT_QT_START_MS) +
+                  (uint64_t)(t_us * OT_SIM_CYCLES_PER_US);
+    level = OT_WAVE_level(&ot_qt_wave, t_us);
+    if ((level >= half) && (*startp < 0)) *startp = t_us;
+    if ((level < half) && (*startp >= 0) && (*endp < 0)) *endp = t_us;
+    if (!high && (level >= OT_QT_COMPARATOR)) {
+      if (OT_QT_MAX_PULSES == ot_qt_npulses) return -1;
+      high = 1;
+      ot_qt_pulses[ot_qt_npulses].start = at;
+    }
+    else if (high && (level < OT_QT_COMPARATOR)) {
+      high = 0;
+      ot_qt_pulses[ot_qt_npulses].width =
+        at - ot_qt_pulses[ot_qt_npulses].start;
+      ++ot_qt_npulses;
+    }
+  }
+  return ((1 == ot_qt_npulses) && (*endp > *startp)) ? 0 : -1;
+}
+/*==============================================================================
+ * DESCRIPTION: Run the firmware on the waveform
+ * @param resultp
+ * @return
+ * @precondition A fresh process (the firmware keeps its state in statics)
+ * @postcondition
+ * @caution
+ * @notes DIP[2:0] is 0: fire on the first burst
+ *============================================================================*/
+static void ot_qt_one(OT_QT_RESULT_T *resultp) {
+  OT_SIM_reset(0, 0);
+  OT_SIM_trigger_in(ot_qt_pulses, ot_qt_npulses, (void*)0);
+  OT_SIM_flash_sense(ot_qt_level_cb);
+  OT_SIM_capture_lead(QUENCH_LEAD_CYCLES);
+  OT_SIM_run_firmware(OT_SIM_firmware_main, OT_SIM_MS(OT_QT_START_MS) +
+                      OT_SIM_US(OT_WAVE_end_us(&ot_qt_wave)) +
+                      OT_SIM_MS(OT_QT_TRAIL_MS));
+  resultp->fires     = OT_SIM_trigger.fires;
+  resultp->quenches  = OT_SIM_trigger.quenches;
+  resultp->fire_at   = OT_SIM_trigger.fire_at[0];
+  resultp->quench_at = OT_SIM_trigger.last_quench;
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Run the firmware on the waveform, in a child process
+ * @param resultp
+ * @return 0 if the child ran to completion
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static int ot_qt_fork(OT_QT_RESULT_T *resultp) {
+  int fds[2];
+  int status;
+  ssize_t got;
+  pid_t pid;
+
+  fflush(stdout);
+  if ((0 != pipe(fds)) || ((pid = fork()) < 0)) {
+    perror("quench_test");
+    exit(2);
+  }
+  if (0 == pid) {
+    close(fds[0]);
+    ot_qt_one(resultp);
+    got = write(fds[1], resultp, sizeof(*resultp));
+    _exit((sizeof(*resultp) == got) ? 0 : 1);
+  }
+  close(fds[1]);
+  got = read(fds[0], resultp, sizeof(*resultp));
+  close(fds[0]);
+  waitpid(pid, &status, 0);
+  return ((sizeof(*resultp) == got) && WIFEXITED(status) &&
+          (0 == WEXITSTATUS(status))) ? 0 : -1;
+}
+/*==============================================================================
+ * DESCRIPTION: Run the master's burst and check the slave's power
+ * @param
+ * @return What the capture made of the burst (OT_QT_MATCHED...), -1 if the
+ *         slave isn't within OT_QT_TOLERANCE of it, or fired late
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static int ot_qt_power(void) {
+  OT_QT_RESULT_T result;
+  double start_us;
+  double end_us;
+  double first_us;   // The capture's first sample
+  double last_us;    // And last
+  double requested_us;
+  double expected_us;
+  double slave_us;
+  double fired_us;
+  int what = OT_QT_MATCHED;
+
+  if (0 != ot_qt_scan(&start_us, &end_us)) {
+    printf("FAIL: %s: not a single burst\n", ot_qt_wave.name);
+    return -1;
+  }
+  if (0 != ot_qt_fork(&result)) {
+    printf("FAIL: %s: the firmware didn't run to completion\n",
+           ot_qt_wave.name);
+    return -1;
+  }
+  if ((1 != result.fires) || (result.quenches > 1)) {
+    printf("FAIL: %s: %u fire(s), %u quench(es)\n", ot_qt_wave.name,
+           (unsigned)result.fires, (unsigned)result.quenches);
+    return -1;
+  }
+  first_us = (double)(ot_qt_pulses[0].start - OT_SIM_MS(OT_QT_START_MS) +
+                      QUENCH_LEAD_CYCLES) / OT_SIM_CYCLES_PER_US;
+  last_us = first_us + (double)((OT_ADC_BURST_SAMPLES - 1) *
+                                BURST_CAPTURE_SAMPLE_CYCLES) /
+                       OT_SIM_CYCLES_PER_US;
+  requested_us = (end_us - start_us) * QUENCH_RATIO_16THS / 16;
+  expected_us = requested_us;
+  if (end_us <= first_us) {
+    what = OT_QT_TOO_SHORT;
+    expected_us = (double)(((QUENCH_LEAD_CYCLES >> 1) * QUENCH_RATIO_16THS) >>
+                           4) / OT_SIM_CYCLES_PER_US;
+  }
+  else if (end_us > last_us) {
+    what = OT_QT_TOO_LONG;
+    expected_us = OT_QT_FULL_US;
+  }
+  slave_us = (0 == result.quenches) ? OT_QT_FULL_US :
+             (double)(result.quench_at - result.fire_at) /
+             OT_SIM_CYCLES_PER_US;
+  fired_us = (double)(result.fire_at - ot_qt_pulses[0].start) /
+             OT_SIM_CYCLES_PER_US;
+  printf("master 1/%-3u %6.1fus: fired %5.1fus after the edge, ",
+         ot_qt_wave.power, end_us - start_us, fired_us);
+  if (0 == result.quenches) {
+    printf("not quenched (full power)");
+  }
+  else {
+    printf("quenched after %6.1fus", slave_us);
+  }
+  printf(", requested %6.1fus: %+5.2fEV (%s)\n", requested_us,
+         log2(slave_us / requested_us), ot_qt_cases[what]);
+  if (fabs(log2(slave_us / expected_us)) > OT_QT_TOLERANCE) {
+    printf("FAIL: %s: %.1fus, expected %.1fus\n", ot_qt_wave.name, slave_us,
+           expected_us);
+    return -1;
+  }
+  // The capture ends with its last sample's conversion
+  if (fired_us > (last_us - first_us) + OT_QT_FIRE_SLACK_US +
+                 (double)(QUENCH_LEAD_CYCLES + BURST_CAPTURE_SAMPLE_CYCLES) /
+                 OT_SIM_CYCLES_PER_US) {
+    printf("FAIL: %s: fired late\n", ot_qt_wave.name);
+    return -1;
+  }
+  return what;
+}
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+int main(int argc, char *argv[]) {
+  int failures = 0;
+  int powers = 0;
+  int matched = 0;
+  int what;
+  int i;
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <file.wave> ...\n", argv[0]);
+    return 2;
+  }
+  for (i = 1; i < argc; ++i) {
+    if (0 != OT_WAVE_load(argv[i], &ot_qt_wave)) {
+      ++failures;
+      continue;
+    }
+    if (0 == ot_qt_wave.power) continue;
+    ++powers;
+    what = ot_qt_power();
+    if (what < 0) ++failures;
+    if (OT_QT_MATCHED == what) ++matched;
+  }
+  if (0 == powers) {
+    printf("FAIL: no master's burst (@power)\n");
+    return 1;
+  }
+  if (0 != failures) {
+    printf("FAIL: %d of %d power(s)\n", failures, powers);
+    return 1;
+  }
+  if (0 == matched) {
+    printf("FAIL: no power ends within the capture\n");
+    return 1;
+  }
+  printf("QUENCH_RATIO_16THS %u: %d of %d power(s) matched within %.2fEV, "
+         "the others as\nthe capture's fallbacks\n", QUENCH_RATIO_16THS,
+         matched, powers, OT_QT_TOLERANCE);
+  return 0;
+}
+/*============================================================================*/
@@ -0,0 +1,444 @@
+/*==============================================================================
+ * MODULE: Trace replay (RPL)
+ * DESCRIPTION: Replays the flash burst traces (doc/traces/<name>.trace, see
+ * doc/FlashTraces.md) through the firmware on the host: main.c and the
+ * modules it runs on, unmodified, in the simulator (sim.c). Each trace is
+ * played on TRIGGER_IN, OT_RPL_START_MS after power-up, at every DIP[2:0]
+ * setting (and at a few DELAY_SENSE settings for DIP[2:0] = 7), and the
+ * times at which TRIGGER_OUT is asserted are matched to the bursts: a fire
+ * is on the last burst before it that reached the State Machine (wasn't
+ * masked by PERIODIC_REJECT).
+ *
+ * The settings a trace is meant for (@profile with FLASH_PROFILES, @dip
+ * otherwise, every setting for a trace with @expect 0; with
+ * WIRELESS_COMMANDS, only the @group traces for our WIRELESS_GROUP, at every
+ * setting) are checked against @expect: exactly one fire, on burst @expect
+ * (none for @expect 0). On a @source synthetic trace, only the fires on
+ * bursts PERIODIC_REJECT let through while locked onto the interference are
+ * covered by @expect: the edges it lets through before it locks reach the
+ * State Machine like flash bursts. Once the slave has fired on one, no later
+ * fire is covered either (TRIGGER_IN is disabled while it fires, so the
+ * detector only sees part of the train); until it does, the detector must
+ * lock.
+ *
+ * Usage: replay <trace> ...
+ * Prints a table of the trace by the settings; each cell is the burst fired
+ * on and the latency from its rising edge (in usec, as the simulator times
+ * it: the interrupt latency and the waits, see `make bench` for the cycles),
+ * or '-' for no fire; '+<n>' counts the further fires, '(<n>)' the ones not
+ * covered. A checked cell is marked '*' if it is as expected, '!' if not (and
+ * the exit code is 1).
+ *============================================================================*/
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "config.h"
+#if defined(PERIODIC_REJECT)
+  // White-box: whether it is locked onto a train
+  #include "periodic.c"
+#endif // PERIODIC_REJECT
+#include "sim.h"
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+#if defined(SELF_TEST)
+  #error "The self-test would drive TRIGGER_IN (see tools/hosttest.sh)"
+#endif
+// The trace starts once INIT is long done
+#define OT_RPL_START_MS     1000
+// ... and is followed by long enough for any timeout to fire
+#define OT_RPL_TRAIL_MS     1000
+#define OT_RPL_MAX_PULSES   256
+#define OT_RPL_DIP_DELAY    7    // DIP[2:0] of the DELAY_SENSE mode
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+typedef struct OT_RPL_TRACE_S {
+  char     name[64];
+  uint8_t  synthetic;
+  int16_t  expect;      // -1: none
+  uint8_t  dips;        // Bit n: meant for DIP[2:0] = n (@dip)
+  uint8_t  profiles;    // Bit n: meant for DIP[2:0] = n (@profile)
+  int16_t  group;       // -1: none
+  uint16_t pulses;
+  OT_SIM_PULSE_T pulse[OT_RPL_MAX_PULSES];
+} OT_RPL_TRACE_T;
+
+typedef struct OT_RPL_SETTING_S {
+  uint8_t dip;
+  uint8_t delay_sense_ms;
+} OT_RPL_SETTING_T;
+
+// What a replay saw, as reported by its child process
+typedef struct OT_RPL_RESULT_S {
+  uint32_t fires;       // Covered by @expect
+  uint32_t uncovered;   // On bursts let through unlocked (synthetic)
+  uint16_t burst;       // Fired on by the first covered fire (0: before any)
+  uint32_t latency_us;
+  uint16_t masked;      // Edges PERIODIC_REJECT masked
+} OT_RPL_RESULT_T;
+/*==============================================================================
+ * LOCAL FUNCTION PROTOTYPES
+ *============================================================================*/
+static OT_SIM_EDGE_CB_T ot_rpl_edge_cb;
+// main() of main.c, built with -Dmain=OT_SIM_firmware_main
+void OT_SIM_firmware_main(void);
+/*==============================================================================
+ * LOCAL VARIABLES
+ *============================================================================*/
+static const OT_RPL_SETTING_T ot_rpl_settings[] = {
+  { 0, 0 }, { 1, 0 }, { 2, 0 }, { 3, 0 }, { 4, 0 }, { 5, 0 }, { 6, 0 },
+  { OT_RPL_DIP_DELAY,   0 }, { OT_RPL_DIP_DELAY,  50 },
+  { OT_RPL_DIP_DELAY, 100 }, { OT_RPL_DIP_DELAY, 200 }
+};
+#define OT_RPL_SETTINGS \
+  (sizeof(ot_rpl_settings) / sizeof(ot_rpl_settings[0]))
+
+static OT_RPL_TRACE_T ot_rpl_trace;
+// The bursts whose edge interrupted and wasn't masked, and whether
+// PERIODIC_REJECT was locked onto a train when it let it through
+#define OT_RPL_PASSED    0x01
+#define OT_RPL_LOCKED    0x02
+static uint8_t ot_rpl_passed[OT_RPL_MAX_PULSES];
+#if defined(PERIODIC_REJECT)
+static uint16_t ot_rpl_masked;
+#endif // PERIODIC_REJECT
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+/*==============================================================================
+ * LOCAL FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION: Read a trace (see doc/FlashTraces.md)
+ * @param path
+ * @param tracep
+ * @return 0 if it is well-formed
+ * @precondition
+ * @postcondition The pulses are in cycles, from OT_RPL_START_MS
+ * @caution
+ * @notes
+ *============================================================================*/
+static int ot_rpl_load(const char *path, OT_RPL_TRACE_T *tracep) {
+  char line[160];
+  char key[16];
+  char value[64];
+  unsigned long t_us;
+  unsigned long width_us;
+  unsigned long n;
+  char *commentp;
+  FILE *fp = fopen(path, "r");
+
+  if ((void*)0 == fp) {
+    perror(path);
+    return -1;
+  }
+  memset(tracep, 0, sizeof(*tracep));
+  tracep->expect = -1;
+  tracep->group  = -1;
+  while ((void*)0 != fgets(line, sizeof(line), fp)) {
+    commentp = strchr(line, '#');
+    if ((void*)0 != commentp) *commentp = '\0';
+    if (2 == sscanf(line, " @%15s %63s", key, value)) {
+      n = strtoul(value, 0, 0);
+      if (0 == strcmp(key, "name")) {
+        snprintf(tracep->name, sizeof(tracep->name), "%s", value);
+      }
+      else if (0 == strcmp(key, "source")) {
+        tracep->synthetic = (0 == strcmp(value, "synthetic"));
+      }
+      else if (0 == strcmp(key, "expect")) {
+        tracep->expect = (int16_t)n;
+      }
+      else if ((0 == strcmp(key, "dip")) && (n <= OT_RPL_DIP_DELAY)) {
+        tracep->dips |= (uint8_t)(1 << n);
+      }
+      else if ((0 == strcmp(key, "profile")) && (n < OT_RPL_DIP_DELAY)) {
+        tracep->profiles |= (uint8_t)(1 << n);
+      }
+      else if (0 == strcmp(key, "group")) {
+        tracep->group = (int16_t)n;
+      }
+    }
+    else if (2 == sscanf(line, " %lu %lu", &t_us, &width_us)) {
+      if (OT_RPL_MAX_PULSES == tracep->pulses) {
+        fprintf(stderr, "%s: more than %u bursts\n", path, OT_RPL_MAX_PULSES);
+        fclose(fp);
+        return -1;
+      }
+      tracep->pulse[tracep->pulses].start = OT_SIM_MS(OT_RPL_START_MS) +
+                                            OT_SIM_US(t_us);
+      tracep->pulse[tracep->pulses].width = OT_SIM_US(width_us);
+      ++tracep->pulses;
+    }
+  }
+  fclose(fp);
+  if (('\0' == tracep->name[0]) || (0 == tracep->pulses) ||
+      (tracep->expect < 0) || (tracep->expect > tracep->pulses)) {
+    fprintf(stderr, "%s: not a trace\n", path);
+    return -1;
+  }
+  return 0;
+}
+/*==============================================================================
+ * DESCRIPTION: Whether @expect applies to a setting
+ * @param tracep
+ * @param settingp
+ * @return 0: not checked, 1: checked, -1: not replayed at all
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static int ot_rpl_checked(const OT_RPL_TRACE_T *tracep,
+                          const OT_RPL_SETTING_T *settingp) {
+#if defined(WIRELESS_COMMANDS)
+  // Flash bursts that aren't commanded are never fired on
+  (void)settingp;
+  if (tracep->group < 0) return -1;
+  return (WIRELESS_GROUP == tracep->group);
+#else
+  uint8_t meant;
+  if (tracep->group >= 0) return -1; // Command frames, not bursts
+#if !defined(PERIODIC_REJECT)
+  if (tracep->synthetic) return 0;
+#endif // PERIODIC_REJECT
+  if (0 == tracep->expect) return 1;
+#if defined(FLASH_PROFILES)
+  meant = tracep->profiles;
+#else
+  meant = tracep->dips;
+#endif // FLASH_PROFILES
+  return (0 != (meant & (1 << settingp->dip)));
+#endif // WIRELESS_COMMANDS
+}
+/*==============================================================================
+ * DESCRIPTION: Note which edges reach the State Machine
+ * @param pulse - 0-based
+ * @return
+ * @precondition Called after each TRIGGER_IN ISR
+ * @postcondition
+ * @caution
+ * @notes An edge let through leaves the lock as it was
+ *============================================================================*/
+static void ot_rpl_edge_cb(uint16_t pulse) {
+#if defined(PERIODIC_REJECT)
+  if (OT_PERIODIC_masked != ot_rpl_masked) {
+    ot_rpl_masked = OT_PERIODIC_masked;
+    return;
+  }
+  if (ot_periodic_data.locked) ot_rpl_passed[pulse] |= OT_RPL_LOCKED;
+#endif // PERIODIC_REJECT
+  ot_rpl_passed[pulse] |= OT_RPL_PASSED;
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Replay the trace at a setting
+ * @param settingp
+ * @param resultp
+ * @return
+ * @precondition A fresh process (the firmware keeps its state in statics)
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static void ot_rpl_one(const OT_RPL_SETTING_T *settingp,
+                       OT_RPL_RESULT_T *resultp) {
+  const OT_SIM_PULSE_T *lastp = &ot_rpl_trace.pulse[ot_rpl_trace.pulses - 1];
+  uint32_t i;
+  uint16_t burst;
+  uint8_t tainted = 0;
+#if defined(PERIODIC_REJECT)
+  uint8_t periodic = ot_rpl_trace.synthetic;
+#else
+  uint8_t periodic = 0; // Nothing is masked: every fire is covered
+#endif // PERIODIC_REJECT
+
+  memset(resultp, 0, sizeof(*resultp));
+  memset(ot_rpl_passed, 0, sizeof(ot_rpl_passed));
+  OT_SIM_reset(settingp->dip, settingp->delay_sense_ms);
+  OT_SIM_trigger_in(ot_rpl_trace.pulse, ot_rpl_trace.pulses, ot_rpl_edge_cb);
+  OT_SIM_run_firmware(OT_SIM_firmware_main, lastp->start + lastp->width +
+                      OT_SIM_MS(OT_RPL_TRAIL_MS));
+
+  for (i = 0; (i < OT_SIM_trigger.fires) && (i < OT_SIM_FIRES); ++i) {
+    uint64_t at = OT_SIM_trigger.fire_at[i];
+    for (burst = ot_rpl_trace.pulses; burst > 0; --burst) {
+      if ((0 != ot_rpl_passed[burst - 1]) &&
+          (ot_rpl_trace.pulse[burst - 1].start <= at)) {
+        break;
+      }
+    }
+    if (periodic && (0 != burst) &&
+        (tainted || (0 == (ot_rpl_passed[burst - 1] & OT_RPL_LOCKED)))) {
+      tainted = 1;
+      ++resultp->uncovered;
+      continue;
+    }
+    if (0 == resultp->fires++) {
+      resultp->burst = burst;
+      resultp->latency_us = (0 == burst) ? 0 : (uint32_t)
+        ((at - ot_rpl_trace.pulse[burst - 1].start) / OT_SIM_CYCLES_PER_US);
+    }
+  }
+#if defined(PERIODIC_REJECT)
+  resultp->masked = OT_PERIODIC_masked;
+#endif // PERIODIC_REJECT
+  // The fires past OT_SIM_FIRES are taken as the last one recorded
+  if (OT_SIM_trigger.fires > OT_SIM_FIRES) {
+    if (tainted) {
+      resultp->uncovered += OT_SIM_trigger.fires - OT_SIM_FIRES;
+    }
+    else {
+      resultp->fires += OT_SIM_trigger.fires - OT_SIM_FIRES;
+    }
+  }
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Replay the trace at a setting, in a child process
+ * @param settingp
+ * @param resultp
+ * @return 0 if the child ran to completion
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static int ot_rpl_fork(const OT_RPL_SETTING_T *settingp,
+                       OT_RPL_RESULT_T *resultp) {
+  int fds[2];
+  int status;
+  ssize_t got;
+  pid_t pid;
+
+  fflush(stdout);
+  if ((0 != pipe(fds)) || ((pid = fork()) < 0)) {
+    perror("replay");
+    exit(2);
+  }
+  if (0 == pid) {
+    close(fds[0]);
+    ot_rpl_one(settingp, resultp);
+    got = write(fds[1], resultp, sizeof(*resultp));
+    _exit((sizeof(*resultp) == got) ? 0 : 1);
+  }
+  close(fds[1]);
+  got = read(fds[0], resultp, sizeof(*resultp));
+  close(fds[0]);
+  waitpid(pid, &status, 0);
+  if ((sizeof(*resultp) != got) || !WIFEXITED(status) ||
+      (0 != WEXITSTATUS(status))) {
+    return -1;
+  }
+  return 0;
+}
+/*==============================================================================
+ * DESCRIPTION: Replay a trace at every setting and print its row
+ * @param path
+ * @return Number of checked settings that aren't as expected (-1: no trace)
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static int ot_rpl_trace_row(const char *path) {
+  OT_RPL_RESULT_T result;
+  char cell[24];
+  int failures = 0;
+  int checked;
+  uint32_t s;
+
+  if (0 != ot_rpl_load(path, &ot_rpl_trace)) return -1;
+  printf("%-22s %3d", ot_rpl_trace.name, ot_rpl_trace.expect);
+  for (s = 0; s < OT_RPL_SETTINGS; ++s) {
+    checked = ot_rpl_checked(&ot_rpl_trace, &ot_rpl_settings[s]);
+    if (checked < 0) {
+      printf(" %9s", ".");
+      continue;
+    }
+    if (0 != ot_rpl_fork(&ot_rpl_settings[s], &result)) {
+      printf(" %9s", "crash!");
+      ++failures;
+      continue;
+    }
+    if (0 == result.fires) {
+      snprintf(cell, sizeof(cell), "-");
+    }
+    else if (1 == result.fires) {
+      snprintf(cell, sizeof(cell), "%u@%u", result.burst, result.latency_us);
+    }
+    else {
+      snprintf(cell, sizeof(cell), "%u@%u+%u", result.burst,
+               result.latency_us, result.fires - 1);
+    }
+    if (0 != result.uncovered) {
+      snprintf(cell + strlen(cell), sizeof(cell) - strlen(cell), "(%u)",
+               result.uncovered);
+    }
+    if (checked) {
+      uint8_t pass = (0 == ot_rpl_trace.expect) ? (0 == result.fires) :
+                     ((1 == result.fires) &&
+                      (ot_rpl_trace.expect == result.burst));
+#if defined(PERIODIC_REJECT)
+      if (ot_rpl_trace.synthetic && (0 == result.uncovered) &&
+          (0 == result.masked)) {
+        pass = 0;
+      }
+#endif // PERIODIC_REJECT
+      strcat(cell, pass ? "*" : "!");
+      if (!pass) ++failures;
+    }
+    printf(" %9s", cell);
+  }
+  printf("\n");
+  return failures;
+}
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+int main(int argc, char **argv) {
+  int failures = 0;
+  int rc = 0;
+  int i;
+  uint32_t s;
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <trace> ...\n", argv[0]);
+    return 2;
+  }
+  printf("%-22s %3s", "trace", "exp");
+  for (s = 0; s < OT_RPL_SETTINGS; ++s) {
+    if (OT_RPL_DIP_DELAY == ot_rpl_settings[s].dip) {
+      printf("     7/%-3u", ot_rpl_settings[s].delay_sense_ms);
+    }
+    else {
+      printf(" %9u", ot_rpl_settings[s].dip);
+    }
+  }
+  printf("\n");
+  for (i = 1; i < argc; ++i) {
+    int row = ot_rpl_trace_row(argv[i]);
+    if (row < 0) {
+      rc = 2;
+    }
+    else {
+      failures += row;
+    }
+  }
+  if (0 != failures) {
+    printf("FAIL: %d checked setting(s) not as @expect\n", failures);
+    return 1;
+  }
+  printf("%d trace(s) replayed: as expected\n", argc - 1);
+  return rc;
+}
+/*============================================================================*/
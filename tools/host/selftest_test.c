@@ -0,0 +1,176 @@
+/*==============================================================================
+ * MODULE: Self-test test (STT)
+ * DESCRIPTION: Runs the firmware (main.c) built with SELF_TEST, unmodified,
+ * in the simulator (sim.c), which models the loopback jumpers of OT_ST_run():
+ * SELF_TEST_PULSE drives TRIGGER_IN, and TRIGGER_OUT's edges are captured as
+ * TIM1 would. At each DIP[2:0] setting, from power-up:
+ * - at 000b, every one of the SELF_TEST_TRIALS trials is captured, each
+ *   fired from the TRIGGER_IN ISR (the latency is well under a tick) for
+ *   OT_SM_TRIGGER_DURATION_uS, and the slave fired once per trial;
+ * - at any other setting, the self-test is skipped and nothing is fired.
+ * In both cases OT_ST_results must be final (done) within OT_STT_RUN_MS.
+ *
+ * Usage: selftest_test
+ * Prints OT_ST_results at each setting.
+ *============================================================================*/
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "config.h"
+#include "selftest.h"
+#include "sim.h"
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+#if !defined(SELF_TEST)
+  #error "Build with SELF_TEST"
+#endif
+#define OT_STT_DIPS             8
+// From power-up: the trials and the LED report take a few seconds
+#define OT_STT_RUN_MS           10000
+// OT_SM_TRIGGER_DURATION_uS (state_machine.c)
+#define OT_STT_TRIGGER_CYCLES   OT_SIM_US(300)
+// Slack on the trigger pulse's width: the cycle counter's polls around it
+#define OT_STT_WIDTH_SLACK      (2 * OT_SIM_POLL_CYCLES)
+// Fired from the TRIGGER_IN ISR, not from a later tick
+#define OT_STT_LATENCY_MAX      OT_SIM_US(100)
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+#define OT_STT_CHECK(cond, what)  \
+  do { if (!(cond)) ot_stt_fail(dip, what, &failures); } while (0)
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+// What a run reports back from its child process
+typedef struct OT_STT_RESULT_S {
+  OT_ST_RESULTS_T results;
+  uint32_t fires;
+} OT_STT_RESULT_T;
+/*==============================================================================
+ * LOCAL FUNCTION PROTOTYPES
+ *============================================================================*/
+/*==============================================================================
+ * LOCAL VARIABLES
+ *============================================================================*/
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+// main.c's main(), built as -Dmain=OT_SIM_firmware_main
+void OT_SIM_firmware_main(void);
+/*==============================================================================
+ * LOCAL FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION: Report a failed check
+ * @param dip
+ * @param what
+ * @param failuresp - incremented
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static void ot_stt_fail(uint8_t dip, const char *what, int *failuresp) {
+  printf("FAIL: DIP %u: %s\n", dip, what);
+  ++*failuresp;
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Run the firmware from power-up at a setting, in a child
+ * process (the firmware's modules keep their state)
+ * @param dip - DIP[2:0] setting
+ * @param resultp
+ * @return 0 if the child ran to completion
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static int ot_stt_fork(uint8_t dip, OT_STT_RESULT_T *resultp) {
+  int fds[2];
+  int status;
+  ssize_t got;
+  pid_t pid;
+
+  fflush(stdout);
+  if ((0 != pipe(fds)) || ((pid = fork()) < 0)) {
+    perror("selftest_test");
+    exit(2);
+  }
+  if (0 == pid) {
+    close(fds[0]);
+    OT_SIM_reset(dip, 0);
+    OT_SIM_run_firmware(OT_SIM_firmware_main, OT_SIM_MS(OT_STT_RUN_MS));
+    resultp->results = OT_ST_results;
+    resultp->fires   = OT_SIM_trigger.fires;
+    got = write(fds[1], resultp, sizeof(*resultp));
+    _exit((sizeof(*resultp) == got) ? 0 : 1);
+  }
+  close(fds[1]);
+  got = read(fds[0], resultp, sizeof(*resultp));
+  close(fds[0]);
+  waitpid(pid, &status, 0);
+  if ((sizeof(*resultp) != got) || !WIFEXITED(status) ||
+      (0 != WEXITSTATUS(status))) {
+    return -1;
+  }
+  return 0;
+}
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+int main(void) {
+  const OT_ST_RESULTS_T *rp;
+  OT_STT_RESULT_T result;
+  int failures = 0;
+  uint8_t dip;
+
+  for (dip = 0; dip < OT_STT_DIPS; ++dip) {
+    if (0 != ot_stt_fork(dip, &result)) {
+      OT_STT_CHECK(0, "crashed");
+      continue;
+    }
+    rp = &result.results;
+    printf("DIP %u: done %u skipped %u trials %u missed %u "
+           "latency %u/%u/%u width %u/%u/%u (cycles) fires %u\n",
+           dip, rp->done, rp->skipped, rp->trials, rp->missed,
+           rp->latency_min, rp->latency_avg, rp->latency_max,
+           rp->width_min, rp->width_avg, rp->width_max, result.fires);
+    OT_STT_CHECK(rp->done, "not done");
+    if (0 != dip) {
+      OT_STT_CHECK(rp->skipped, "not skipped");
+      OT_STT_CHECK(0 == rp->trials, "trials run");
+      OT_STT_CHECK(SELF_TEST_TRIALS == rp->missed, "not all missed");
+      OT_STT_CHECK(0 == result.fires, "fired");
+      continue;
+    }
+    OT_STT_CHECK(!rp->skipped, "skipped");
+    OT_STT_CHECK(SELF_TEST_TRIALS == rp->trials, "trials not captured");
+    OT_STT_CHECK(0 == rp->missed, "trials missed");
+    OT_STT_CHECK(SELF_TEST_TRIALS == result.fires, "not one fire a trial");
+    OT_STT_CHECK((OT_SIM_ISR_CYCLES <= rp->latency_min) &&
+                 (rp->latency_min <= rp->latency_avg) &&
+                 (rp->latency_avg <= rp->latency_max) &&
+                 (rp->latency_max < OT_STT_LATENCY_MAX),
+                 "latency out of range");
+    OT_STT_CHECK((OT_STT_TRIGGER_CYCLES <= rp->width_min) &&
+                 (rp->width_min <= rp->width_avg) &&
+                 (rp->width_avg <= rp->width_max) &&
+                 (rp->width_max <= (OT_STT_TRIGGER_CYCLES +
+                                    OT_STT_WIDTH_SLACK)),
+                 "width out of range");
+  }
+  if (0 != failures) {
+    printf("FAIL: %d check(s)\n", failures);
+    return 1;
+  }
+  printf("Self-test as expected at every DIP[2:0] setting\n");
+  return 0;
+}
+/*============================================================================*/
@@ -0,0 +1,1261 @@
+/*==============================================================================
+ * MODULE: Simulator (SIM)
+ * DESCRIPTION: Host model of the MCU around the firmware modules built on the
+ * host (state_machine.c and the modules without hardware dependencies). It
+ * keeps time in CPU cycles, holds the GPIO ports, and stands in for the
+ * modules that drive the peripherals (timer, power, ADC, AWU, EEPROM): the
+ * 1msec tick and the AWU interrupts are raised as time advances.
+ *
+ * The whole firmware (main.c) can run in it as well: its wfi()/halt() wait
+ * for the next interrupt, the TRIGGER_IN edges come from a schedule of pulses
+ * and the button's edges from OT_SIM_button() (or a tap that wakes it from
+ * halt(), OT_SIM_wakeup_tap()), both raising the GPIO module's ISRs. With
+ * SELF_TEST, the loopback jumpers of OT_ST_run() are modelled too.
+ *
+ * With BURST_CAPTURE or ADC_FLASH_DETECT, adc.c itself runs on a model of
+ * ADC1, converting the level of FLASH_SENSE the caller provides
+ * (OT_SIM_flash_sense()); with ADC_FLASH_DETECT, a conversion out of the
+ * analog watchdog's thresholds raises the ADC1 interrupt (ot_adc_isr); with
+ * QUENCH_OUT, TIM1's compare raises QUENCH_OUT.
+ *
+ * Only the waits are timed (busy-waits, the cycle counter's polling, the
+ * interrupt latency, the conversions); the instructions themselves take no
+ * time. Their cycles are what `make bench` measures under ucsim.
+ *============================================================================*/
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "main.h"
+#include "timer.h"
+#include "adc.h"
+#include "power.h"
+#if defined(SNIFF_MODE)
+  #include "awu.h"
+#endif // SNIFF_MODE
+#if defined(EEPROM_STORE)
+  #include "eeprom.h"
+#endif // EEPROM_STORE
+#include "sim.h"
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+#if defined(ISR_PROFILE)
+  #error "Not simulated on the host (see tools/hosttest.sh)"
+#endif
+#if defined(BURST_CAPTURE) || defined(ADC_FLASH_DETECT)
+  // adc.c runs on the model of ADC1 (instead of the ADC module's stand-in)
+  #define OT_SIM_ADC1
+#endif // BURST_CAPTURE || ADC_FLASH_DETECT
+// CC register (see ITC_GetCPUCC()): I1I0 of the main program with interrupts
+// enabled, and with them masked (or in an ISR)
+#define OT_SIM_CC_ENABLED       0x20
+#define OT_SIM_CC_MASKED        0x28
+// Default supply voltage (BATTERY_MONITOR)
+#define OT_SIM_VDD_MV           3300
+#if defined(OT_SIM_ADC1)
+  #define OT_SIM_ADC_MAX        0x03FF // 10-bit
+  // A conversion takes 14 ADC clocks
+  #define OT_SIM_ADC_CLOCKS     14
+  #define OT_SIM_ADC_BUFFER     10     // The size of the data buffer
+#endif // OT_SIM_ADC1
+#if defined(QUENCH_OUT)
+  // Shortest delay OT_TIMER_quench_after() arms the compare for (timer.c)
+  #define OT_SIM_QUENCH_MIN_CYCLES  100
+#endif // QUENCH_OUT
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+typedef struct OT_SIM_DATA_S {
+  uint64_t now;             // CPU cycles since the reset
+  uint8_t  interrupts;      // Interrupts enabled (rim/sim)
+  uint8_t  in_isr;          // An ISR is running (they don't nest)
+  uint8_t  trigger_out;     // TRIGGER_OUT as last observed (asserted)
+  uint8_t  delay_sense_ms;  // DELAY_SENSE knob, as OT_ADC_read_delay_sense()
+  OT_POWER_MASK_T clocks;   // Peripheral clocks enabled
+  // 1msec tick (OT_TIMER_start())
+  OT_TIMER_CB_T *timer_cb;
+  void          *timer_cbarg;
+  uint8_t  timer_running;
+  uint8_t  tick_pending;
+  uint64_t next_tick;
+  uint64_t tick_gated;      // When the tick's clock was gated (if it is)
+  // TRIGGER_IN's pulses (OT_SIM_trigger_in())
+  const OT_SIM_PULSE_T *pulsesp;
+  uint16_t pulses;
+  uint16_t pulse;           // The next (or current) pulse
+  uint8_t  pulse_high;      // Within pulse
+  OT_SIM_EDGE_CB_T *edge_cb;
+  // The firmware (OT_SIM_run_firmware())
+  uint8_t  firmware;        // Running: the EXTI interrupts are raised
+  uint8_t  portb_pending;
+  uint8_t  portc_pending;
+  uint64_t until;
+  jmp_buf  done;
+  uint8_t  trigger_in_armed; // TRIGGER_IN's CR2 as last observed
+  uint64_t trigger_in_rose; // When TRIGGER_IN last went high
+#if defined(WAKEUP_BUTTON)
+  // The tap that wakes it up (OT_SIM_wakeup_tap())
+  uint8_t  tap;             // Scheduled, and not released yet
+  uint64_t tap_after;
+  uint64_t tap_width;
+#endif // WAKEUP_BUTTON
+#if defined(SELF_TEST)
+  // Loopback jumpers: SELF_TEST_PULSE to TRIGGER_IN, TRIGGER_OUT to
+  // SELF_TEST_CAPTURE (TIM1_CH3/CH4, see OT_TIMER_captured())
+  uint8_t  loopback_high;   // SELF_TEST_PULSE as last observed
+  uint8_t  captured;        // Edges captured: 0x01 start, 0x02 end
+  uint16_t capture_start;
+  uint16_t capture_end;
+#endif // SELF_TEST
+#if defined(OT_SIM_ADC1)
+  // ADC1: the conversions since the last start are numbered from 0, the
+  // k'th samples its channel at adc_start + k * adc_period
+  OT_SIM_LEVEL_CB_T *flash_sense;
+  uint64_t capture_lead;    // OT_SIM_capture_lead()
+  uint8_t  adc_on;          // ADON (powered up)
+  uint8_t  adc_continuous;
+  uint8_t  adc_buffered;    // Data buffer enabled
+  uint8_t  adc_channel;
+  uint8_t  adc_converting;  // Started, and not stopped since
+  uint16_t adc_cycles;      // CPU cycles per conversion (the prescaler's)
+  uint16_t adc_period;      // Those of the conversions since the last start
+  uint64_t adc_start;
+  uint64_t adc_stop;        // When it was stopped (if it was)
+  uint32_t adc_eoc_from;    // Conversions done when EOC was last cleared
+#endif // OT_SIM_ADC1
+#if defined(ADC_FLASH_DETECT)
+  // The analog watchdog
+  uint16_t adc_high;        // Thresholds
+  uint16_t adc_low;
+  uint8_t  adc_awd_ie;      // Its interrupt enabled
+  uint8_t  adc_awd;         // Its flag
+  uint32_t adc_checked;     // Conversions compared since the last start
+  uint64_t adc_awd_at;      // When the conversion that set the flag ended
+#endif // ADC_FLASH_DETECT
+#if defined(QUENCH_OUT)
+  uint64_t quench_at;       // When TIM1's compare raises QUENCH_OUT (0: not
+                            // armed)
+#endif // QUENCH_OUT
+#if defined(SNIFF_MODE)
+  // Periodic wake-up (OT_AWU_start())
+  OT_AWU_CB_T *awu_cb;
+  void        *awu_cbarg;
+  uint8_t  awu_running;
+  uint8_t  awu_pending;
+  uint64_t awu_period;
+  uint64_t next_awu;
+#endif // SNIFF_MODE
+} OT_SIM_DATA_T;
+/*==============================================================================
+ * LOCAL FUNCTION PROTOTYPES
+ *============================================================================*/
+static uint64_t ot_sim_next_event(uint64_t limit);
+static void ot_sim_raise(void);
+static void ot_sim_dispatch(void);
+static void ot_sim_adc_convert(const char *what);
+#if defined(OT_SIM_ADC1)
+static uint32_t ot_sim_adc_done(void);
+static uint16_t ot_sim_adc_sample(uint32_t conversion);
+#endif // OT_SIM_ADC1
+#if defined(ADC_FLASH_DETECT)
+static uint8_t ot_sim_adc_watching(void);
+static void ot_sim_adc_watch(void);
+#endif // ADC_FLASH_DETECT
+// The GPIO module's ISRs (gpio.c)
+INTERRUPT_HANDLER(ot_gpiob_isr, ITC_IRQ_PORTB);
+#if defined(WAKEUP_BUTTON)
+INTERRUPT_HANDLER(ot_gpioc_isr, ITC_IRQ_PORTC);
+#endif // WAKEUP_BUTTON
+// The ADC module's (adc.c)
+#if defined(ADC_FLASH_DETECT)
+INTERRUPT_HANDLER(ot_adc_isr, ITC_IRQ_ADC1);
+#endif // ADC_FLASH_DETECT
+/*==============================================================================
+ * LOCAL VARIABLES
+ *============================================================================*/
+static OT_SIM_DATA_T ot_sim_data;
+
+#if defined(SNIFF_MODE)
+// Period of each AWU_Timebase_TypeDef, in usec
+static const uint32_t ot_sim_awu_us[] = {
+  0, 250, 500, 1000, 2000, 4000, 8000, 16000, 32000, 64000, 128000, 256000,
+  512000, 1000000, 2000000, 12000000, 30000000
+};
+#endif // SNIFF_MODE
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+GPIO_TypeDef     OT_SIM_ports[7];
+OT_SIM_TRIGGER_T OT_SIM_trigger;
+OT_SIM_WAKEUP_T  OT_SIM_wakeup;
+uint32_t         OT_SIM_blocks = 0;
+#if defined(DEBUG)
+uint16_t OT_POWER_saved_ua = 0;
+#endif // DEBUG
+#if defined(HSI_CALIBRATION)
+volatile uint32_t OT_TIMER_hsi_hz      = 0;
+volatile uint16_t OT_TIMER_cal_rejects = 0;
+#endif // HSI_CALIBRATION
+#if defined(EEPROM_STORE)
+volatile OT_EE_COUNTERS_T OT_EE_counters;
+#if defined(EVENT_LOG)
+volatile uint16_t OT_EE_events_dropped = 0;
+#endif // EVENT_LOG
+#endif // EEPROM_STORE
+/*==============================================================================
+ * LOCAL FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION: When the next interrupt source falls due
+ * @param limit - the latest time of interest
+ * @return CPU cycles since OT_SIM_reset(), no later than limit
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes A TRIGGER_IN edge counts whether or not it raises an interrupt, and
+ *        so does the release of the tap. While the analog watchdog can
+ *        interrupt, so does every conversion.
+ *============================================================================*/
+static uint64_t ot_sim_next_event(uint64_t limit) {
+  uint64_t next = limit;
+  if (ot_sim_data.timer_running &&
+      (0 != (ot_sim_data.clocks & OT_POWER_TICK)) &&
+      (ot_sim_data.next_tick < next)) {
+    next = ot_sim_data.next_tick;
+  }
+#if defined(SNIFF_MODE)
+  if (ot_sim_data.awu_running && (ot_sim_data.next_awu < next)) {
+    next = ot_sim_data.next_awu;
+  }
+#endif // SNIFF_MODE
+  if (ot_sim_data.pulse < ot_sim_data.pulses) {
+    const OT_SIM_PULSE_T *pulsep = &ot_sim_data.pulsesp[ot_sim_data.pulse];
+    uint64_t edge = pulsep->start;
+    if (ot_sim_data.pulse_high) edge += pulsep->width;
+    if (edge < next) next = edge;
+  }
+#if defined(WAKEUP_BUTTON)
+  if (ot_sim_data.tap && (0 != OT_SIM_wakeup.pressed_at) &&
+      ((OT_SIM_wakeup.pressed_at + ot_sim_data.tap_width) < next)) {
+    next = OT_SIM_wakeup.pressed_at + ot_sim_data.tap_width;
+  }
+#endif // WAKEUP_BUTTON
+#if defined(ADC_FLASH_DETECT)
+  if (ot_sim_adc_watching()) {
+    uint64_t end = ot_sim_data.adc_start + (uint64_t)ot_sim_data.adc_period *
+                   (ot_sim_adc_done() + 1);
+    if (end < next) next = end;
+  }
+#endif // ADC_FLASH_DETECT
+  return next;
+}
+/*==============================================================================
+ * DESCRIPTION: Latch the interrupts (and apply the TRIGGER_IN edges) that
+ * have fallen due
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes TRIGGER_IN only goes high while SENSOR_ENABLE powers the sensor, and
+ *        its rising edge only interrupts while it is enabled (CR2)
+ *============================================================================*/
+static void ot_sim_raise(void) {
+  if (ot_sim_data.timer_running &&
+      (0 != (ot_sim_data.clocks & OT_POWER_TICK)) &&
+      (ot_sim_data.next_tick <= ot_sim_data.now)) {
+    ot_sim_data.next_tick += OT_SIM_CYCLES_PER_MS;
+    ot_sim_data.tick_pending = 1;
+  }
+#if defined(SNIFF_MODE)
+  if (ot_sim_data.awu_running && (ot_sim_data.next_awu <= ot_sim_data.now)) {
+    ot_sim_data.next_awu += ot_sim_data.awu_period;
+    ot_sim_data.awu_pending = 1;
+  }
+#endif // SNIFF_MODE
+  while (ot_sim_data.pulse < ot_sim_data.pulses) {
+    const OT_SIM_PULSE_T *pulsep = &ot_sim_data.pulsesp[ot_sim_data.pulse];
+    if (!ot_sim_data.pulse_high && (pulsep->start <= ot_sim_data.now)) {
+      ot_sim_data.pulse_high = 1;
+      ot_sim_data.trigger_in_rose = pulsep->start;
+      if ((0 != (SENSOR_ENABLE_PORT->DDR & SENSOR_ENABLE_PIN)) &&
+          (0 != (SENSOR_ENABLE_PORT->ODR & SENSOR_ENABLE_PIN))) {
+        TRIGGER_IN_PORT->IDR |= TRIGGER_IN_PIN;
+        if (ot_sim_data.firmware &&
+            (0 != (TRIGGER_IN_PORT->CR2 & TRIGGER_IN_PIN))) {
+          ot_sim_data.portb_pending = 1;
+        }
+      }
+    }
+    else if (ot_sim_data.pulse_high &&
+             ((pulsep->start + pulsep->width) <= ot_sim_data.now)) {
+      ot_sim_data.pulse_high = 0;
+      TRIGGER_IN_PORT->IDR &= (uint8_t)~TRIGGER_IN_PIN;
+      ++ot_sim_data.pulse;
+    }
+    else {
+      break;
+    }
+  }
+#if defined(WAKEUP_BUTTON)
+  if (ot_sim_data.tap && (0 != OT_SIM_wakeup.pressed_at) &&
+      ((OT_SIM_wakeup.pressed_at + ot_sim_data.tap_width) <= ot_sim_data.now)) {
+    ot_sim_data.tap = 0;
+    OT_SIM_button(0);
+  }
+#endif // WAKEUP_BUTTON
+#if defined(ADC_FLASH_DETECT)
+  ot_sim_adc_watch();
+#endif // ADC_FLASH_DETECT
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Run the ISRs whose interrupt is pending, if they can run
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes Each ISR is charged OT_SIM_ISR_CYCLES of latency. ADC1's vector
+ *        comes before TIM4's: it is served first.
+ *============================================================================*/
+static void ot_sim_dispatch(void) {
+  while (ot_sim_data.interrupts && !ot_sim_data.in_isr) {
+#if defined(ADC_FLASH_DETECT)
+    if (ot_sim_data.adc_awd && ot_sim_data.adc_awd_ie) {
+      ot_sim_data.in_isr = 1;
+      ot_sim_data.now += OT_SIM_ISR_CYCLES;
+      ot_adc_isr();
+    }
+    else
+#endif // ADC_FLASH_DETECT
+    if (ot_sim_data.tick_pending) {
+      ot_sim_data.tick_pending = 0;
+      ot_sim_data.in_isr = 1;
+      ot_sim_data.now += OT_SIM_ISR_CYCLES;
+      if ((void*)0 != ot_sim_data.timer_cb) {
+        (*ot_sim_data.timer_cb)(ot_sim_data.timer_cbarg);
+      }
+    }
+#if defined(SNIFF_MODE)
+    else if (ot_sim_data.awu_pending) {
+      ot_sim_data.awu_pending = 0;
+      ot_sim_data.in_isr = 1;
+      ot_sim_data.now += OT_SIM_ISR_CYCLES;
+      if ((void*)0 != ot_sim_data.awu_cb) {
+        (*ot_sim_data.awu_cb)(ot_sim_data.awu_cbarg);
+      }
+    }
+#endif // SNIFF_MODE
+    else if (ot_sim_data.portb_pending) {
+      ot_sim_data.portb_pending = 0;
+      ot_sim_data.in_isr = 1;
+      ot_sim_data.now += OT_SIM_ISR_CYCLES;
+      ot_gpiob_isr();
+      if ((void*)0 != ot_sim_data.edge_cb) {
+        (*ot_sim_data.edge_cb)((uint16_t)(ot_sim_data.pulse -
+                                          !ot_sim_data.pulse_high));
+      }
+    }
+#if defined(WAKEUP_BUTTON)
+    else if (ot_sim_data.portc_pending) {
+      ot_sim_data.portc_pending = 0;
+      ot_sim_data.in_isr = 1;
+      ot_sim_data.now += OT_SIM_ISR_CYCLES;
+      ot_gpioc_isr();
+    }
+#endif // WAKEUP_BUTTON
+    else {
+      break;
+    }
+    ot_sim_data.in_isr = 0;
+    OT_SIM_observe();
+  }
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Check that a single ADC1 conversion can complete
+ * @param what - the conversion, for the report
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution Aborts if ADC1 is gated: its registers ignore the writes, so the
+ *          firmware would wait for the end of conversion forever
+ * @notes
+ *============================================================================*/
+static void ot_sim_adc_convert(const char *what) {
+  if (0 == (ot_sim_data.clocks & OT_POWER_ADC)) {
+    fprintf(stderr, "sim: %s with ADC1 gated: would hang\n", what);
+    abort();
+  }
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: The conversions ADC1 has completed since it was last started
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes A single conversion stops after the first
+ *============================================================================*/
+#if defined(OT_SIM_ADC1)
+static uint32_t ot_sim_adc_done(void) {
+  uint64_t end = ot_sim_data.now;
+  uint64_t done;
+  if (0 == ot_sim_data.adc_period) return 0; // Never started
+  if (!ot_sim_data.adc_converting && (ot_sim_data.adc_stop < end)) {
+    end = ot_sim_data.adc_stop;
+  }
+  if (end < ot_sim_data.adc_start) return 0;
+  done = (end - ot_sim_data.adc_start) / ot_sim_data.adc_period;
+  if (!ot_sim_data.adc_continuous && (done > 1)) done = 1;
+  return (uint32_t)done;
+}
+#endif // OT_SIM_ADC1
+/*==============================================================================
+ * DESCRIPTION: The result of a conversion since ADC1 was last started
+ * @param conversion - its number
+ * @return ADC counts
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes FLASH_SENSE is OT_SIM_flash_sense()'s level (0 without it), the
+ *        DELAY_SENSE knob as OT_SIM_reset() set it, VREF_SENSE as read at
+ *        OT_SIM_VDD_MV; any other channel reads 0
+ *============================================================================*/
+#if defined(OT_SIM_ADC1)
+static uint16_t ot_sim_adc_sample(uint32_t conversion) {
+  uint64_t at = ot_sim_data.adc_start +
+                (uint64_t)conversion * ot_sim_data.adc_period;
+  uint32_t level = 0;
+  switch (ot_sim_data.adc_channel) {
+    case FLASH_SENSE_ADC_CHANNEL:
+      if ((void*)0 != ot_sim_data.flash_sense) {
+        level = (*ot_sim_data.flash_sense)(at);
+      }
+      break;
+    case DELAY_SENSE_ADC_CHANNEL:
+      level = (uint32_t)ot_sim_data.delay_sense_ms << 2;
+      break;
+#if defined(BATTERY_MONITOR)
+    case VREF_SENSE_ADC_CHANNEL:
+      level = ((uint32_t)VREF_SENSE_MV * 1023) / OT_SIM_VDD_MV;
+      break;
+#endif // BATTERY_MONITOR
+    default:
+      break;
+  }
+  return (level > OT_SIM_ADC_MAX) ? OT_SIM_ADC_MAX : (uint16_t)level;
+}
+#endif // OT_SIM_ADC1
+/*==============================================================================
+ * DESCRIPTION: Whether the analog watchdog can interrupt
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes Converting continuously, with its interrupt enabled and its flag
+ *        clear
+ *============================================================================*/
+#if defined(ADC_FLASH_DETECT)
+static uint8_t ot_sim_adc_watching(void) {
+  return ot_sim_data.adc_converting && ot_sim_data.adc_continuous &&
+         ot_sim_data.adc_awd_ie && !ot_sim_data.adc_awd;
+}
+#endif // ADC_FLASH_DETECT
+/*==============================================================================
+ * DESCRIPTION: Compare the conversions done since the last call with the
+ * analog watchdog's thresholds
+ * @param
+ * @return
+ * @precondition
+ * @postcondition The first one out of them sets its flag
+ * @caution
+ * @notes Only while it can interrupt: its flag is only ever cleared along
+ *        with arming it (see OT_ADC_flash_arm())
+ *============================================================================*/
+#if defined(ADC_FLASH_DETECT)
+static void ot_sim_adc_watch(void) {
+  uint32_t done = ot_sim_adc_done();
+  uint16_t level;
+  if (!ot_sim_adc_watching()) return;
+  for (; ot_sim_data.adc_checked < done; ++ot_sim_data.adc_checked) {
+    level = ot_sim_adc_sample(ot_sim_data.adc_checked);
+    if ((level > ot_sim_data.adc_high) || (level < ot_sim_data.adc_low)) {
+      ot_sim_data.adc_awd    = 1;
+      ot_sim_data.adc_awd_at = ot_sim_data.adc_start +
+        (uint64_t)ot_sim_data.adc_period * (ot_sim_data.adc_checked + 1);
+      ot_sim_data.adc_checked = done;
+      break;
+    }
+  }
+  return;
+}
+#endif // ADC_FLASH_DETECT
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION: Power-on reset
+ * @param dip - DIP[2:0] setting
+ * @param delay_sense_ms - DELAY_SENSE setting (0: none)
+ * @return
+ * @precondition
+ * @postcondition Time 0, interrupts disabled, every port in reset state
+ * @caution The firmware modules keep their own (static) state
+ * @notes The button is released
+ *============================================================================*/
+void OT_SIM_reset(uint8_t dip, uint8_t delay_sense_ms) {
+  memset(&ot_sim_data, 0, sizeof(ot_sim_data));
+  memset(OT_SIM_ports, 0, sizeof(OT_SIM_ports));
+  memset(&OT_SIM_trigger, 0, sizeof(OT_SIM_trigger));
+  memset(&OT_SIM_wakeup, 0, sizeof(OT_SIM_wakeup));
+  ot_sim_data.delay_sense_ms = delay_sense_ms;
+  if (dip & 0x01) DIP0_PORT->IDR |= DIP0_PIN;
+  if (dip & 0x02) DIP1_PORT->IDR |= DIP1_PIN;
+  if (dip & 0x04) DIP2_PORT->IDR |= DIP2_PIN;
+#if defined(WAKEUP_BUTTON)
+  OT_SIM_button(0);
+#endif // WAKEUP_BUTTON
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return CPU cycles since OT_SIM_reset()
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+uint64_t OT_SIM_now(void) {
+  return ot_sim_data.now;
+}
+/*==============================================================================
+ * DESCRIPTION: Let time pass, raising the interrupts that fall due
+ * @param cycles - CPU cycles
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution The ISRs (and the State Machine) run from here
+ * @notes
+ *============================================================================*/
+void OT_SIM_advance(uint64_t cycles) {
+  uint64_t target = ot_sim_data.now + cycles;
+  while (1) {
+    uint64_t next = ot_sim_next_event(target);
+    if (next > ot_sim_data.now) ot_sim_data.now = next;
+    ot_sim_raise();
+    ot_sim_dispatch();
+    if (ot_sim_data.now >= target) break;
+  }
+  OT_SIM_observe();
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Press or release the button (BUTTON_DET, ActiveLow)
+ * @param pressed
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes While the firmware runs, a press interrupts (if it is enabled) as
+ *        soon as the firmware waits or enables interrupts
+ *============================================================================*/
+#if defined(WAKEUP_BUTTON)
+void OT_SIM_button(uint8_t pressed) {
+  if (pressed) {
+    if (ot_sim_data.firmware &&
+        (0 != (BUTTON_DET_PORT->IDR & BUTTON_DET_PIN)) &&
+        (0 != (BUTTON_DET_PORT->CR2 & BUTTON_DET_PIN))) {
+      ot_sim_data.portc_pending = 1;
+    }
+    BUTTON_DET_PORT->IDR &= (uint8_t)~BUTTON_DET_PIN;
+  }
+  else {
+    BUTTON_DET_PORT->IDR |= BUTTON_DET_PIN;
+  }
+  return;
+}
+#endif // WAKEUP_BUTTON
+/*==============================================================================
+ * DESCRIPTION: Tap the button to wake the firmware up from SLEEPING
+ * @param after - CPU cycles since OT_SIM_reset(): the earliest press
+ * @param width - how long it is held
+ * @return
+ * @precondition After OT_SIM_reset(), before OT_SIM_run_firmware()
+ * @postcondition OT_SIM_wakeup times the press, and the first arming of
+ *                TRIGGER_IN after it
+ * @caution
+ * @notes Pressed at the first halt() (the firmware only halts while
+ *        SLEEPING) from after on: at once if nothing wakes it up before
+ *============================================================================*/
+#if defined(WAKEUP_BUTTON)
+void OT_SIM_wakeup_tap(uint64_t after, uint64_t width) {
+  ot_sim_data.tap       = 1;
+  ot_sim_data.tap_after = after;
+  ot_sim_data.tap_width = width;
+  return;
+}
+#endif // WAKEUP_BUTTON
+/*==============================================================================
+ * DESCRIPTION: Sample the outputs the simulator watches
+ * @param
+ * @return
+ * @precondition
+ * @postcondition OT_SIM_trigger (and OT_SIM_wakeup) is up to date
+ * @caution
+ * @notes Called on every simulator call the firmware makes; call it after
+ *        running firmware code that makes none. QUENCH_OUT is time-stamped
+ *        when the compare was due, not when it is observed.
+ *        With SELF_TEST, also applies the loopback jumpers: SELF_TEST_PULSE
+ *        drives TRIGGER_IN (its rising edge interrupts, if enabled), and
+ *        TRIGGER_OUT's edges are time-stamped as TIM1 would capture them
+ *============================================================================*/
+void OT_SIM_observe(void) {
+  uint8_t asserted = OT_SIM_trigger_out();
+  uint8_t armed = (0 != (TRIGGER_IN_PORT->CR2 & TRIGGER_IN_PIN));
+#if defined(SELF_TEST)
+  uint8_t loopback_high =
+    (0 != (SELF_TEST_PULSE_PORT->DDR & SELF_TEST_PULSE_PIN)) &&
+    (0 != (SELF_TEST_PULSE_PORT->ODR & SELF_TEST_PULSE_PIN));
+  if (loopback_high && !ot_sim_data.loopback_high) {
+    TRIGGER_IN_PORT->IDR |= TRIGGER_IN_PIN;
+    if (ot_sim_data.firmware &&
+        (0 != (TRIGGER_IN_PORT->CR2 & TRIGGER_IN_PIN))) {
+      ot_sim_data.portb_pending = 1;
+    }
+  }
+  else if (!loopback_high && ot_sim_data.loopback_high &&
+           !ot_sim_data.pulse_high) {
+    TRIGGER_IN_PORT->IDR &= (uint8_t)~TRIGGER_IN_PIN;
+  }
+  ot_sim_data.loopback_high = loopback_high;
+#endif // SELF_TEST
+#if defined(QUENCH_OUT)
+  if ((0 != ot_sim_data.quench_at) &&
+      (ot_sim_data.quench_at <= ot_sim_data.now)) {
+    ++OT_SIM_trigger.quenches;
+    OT_SIM_trigger.last_quench = ot_sim_data.quench_at;
+    ot_sim_data.quench_at = 0; // Raised until released
+  }
+#endif // QUENCH_OUT
+  if (asserted && !ot_sim_data.trigger_out) {
+    if (OT_SIM_trigger.fires < OT_SIM_FIRES) {
+      OT_SIM_trigger.fire_at[OT_SIM_trigger.fires] = ot_sim_data.now;
+#if defined(ADC_FLASH_DETECT)
+      OT_SIM_trigger.sensed_at[OT_SIM_trigger.fires] = ot_sim_data.adc_awd_at;
+#endif // ADC_FLASH_DETECT
+    }
+    ++OT_SIM_trigger.fires;
+    OT_SIM_trigger.last_fire = ot_sim_data.now;
+#if defined(SELF_TEST)
+    ot_sim_data.capture_start = (uint16_t)ot_sim_data.now;
+    ot_sim_data.captured |= 0x01;
+#endif // SELF_TEST
+  }
+  else if (!asserted && ot_sim_data.trigger_out) {
+    OT_SIM_trigger.last_end = ot_sim_data.now;
+#if defined(SELF_TEST)
+    ot_sim_data.capture_end = (uint16_t)ot_sim_data.now;
+    ot_sim_data.captured |= 0x02;
+#endif // SELF_TEST
+  }
+  ot_sim_data.trigger_out = asserted;
+  if (armed && !ot_sim_data.trigger_in_armed &&
+      (0 != OT_SIM_wakeup.pressed_at) && (0 == OT_SIM_wakeup.armed_at)) {
+    OT_SIM_wakeup.armed_at = ot_sim_data.now;
+  }
+  ot_sim_data.trigger_in_armed = armed;
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return Non-zero while TRIGGER_OUT (ActiveLow) is driven low
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+uint8_t OT_SIM_trigger_out(void) {
+  return (0 != (TRIGGER_OUT_PORT->DDR & TRIGGER_OUT_PIN)) &&
+         (0 == (TRIGGER_OUT_PORT->ODR & TRIGGER_OUT_PIN));
+}
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return Non-zero while the 1msec tick is started (see OT_TIMER_start())
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+uint8_t OT_SIM_timer_running(void) {
+  return ot_sim_data.timer_running;
+}
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return Non-zero while the AWU is started (see OT_AWU_start())
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+uint8_t OT_SIM_awu_running(void) {
+#if defined(SNIFF_MODE)
+  return ot_sim_data.awu_running;
+#else
+  return 0;
+#endif // SNIFF_MODE
+}
+/*==============================================================================
+ * DESCRIPTION: Schedule the pulses seen on TRIGGER_IN
+ * @param pulsesp - in increasing order of start, not overlapping
+ * @param count
+ * @param cb - called after each TRIGGER_IN ISR (may be null)
+ * @return
+ * @precondition After OT_SIM_reset(); pulsesp outlives the run
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+void OT_SIM_trigger_in(const OT_SIM_PULSE_T *pulsesp, uint16_t count,
+                       OT_SIM_EDGE_CB_T *cb) {
+  ot_sim_data.pulsesp    = pulsesp;
+  ot_sim_data.pulses     = count;
+  ot_sim_data.pulse      = 0;
+  ot_sim_data.pulse_high = 0;
+  ot_sim_data.edge_cb    = cb;
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Set the level of FLASH_SENSE, which ADC1 converts
+ * @param cb - its level (ADC counts) at a time (CPU cycles since
+ *             OT_SIM_reset())
+ * @return
+ * @precondition After OT_SIM_reset()
+ * @postcondition
+ * @caution
+ * @notes Called for each conversion, at the time it samples
+ *============================================================================*/
+#if defined(OT_SIM_ADC1)
+void OT_SIM_flash_sense(OT_SIM_LEVEL_CB_T *cb) {
+  ot_sim_data.flash_sense = cb;
+  return;
+}
+#endif // OT_SIM_ADC1
+/*==============================================================================
+ * DESCRIPTION: Set the time from a TRIGGER_IN edge to the first sample of the
+ * burst's capture (OT_ADC_capture_burst())
+ * @param cycles - CPU cycles (0: only as the simulator times it)
+ * @return
+ * @precondition After OT_SIM_reset()
+ * @postcondition
+ * @caution
+ * @notes Stands for the TRIGGER_IN ISR's instructions up to the capture
+ *        (QUENCH_LEAD_CYCLES), which the simulator doesn't time: the
+ *        capture starts no earlier
+ *============================================================================*/
+#if defined(OT_SIM_ADC1)
+void OT_SIM_capture_lead(uint64_t cycles) {
+  ot_sim_data.capture_lead = cycles;
+  return;
+}
+#endif // OT_SIM_ADC1
+/*==============================================================================
+ * DESCRIPTION: Run the firmware (main.c) from its reset
+ * @param mainp - its main() (built under another name)
+ * @param until - CPU cycles since OT_SIM_reset() to run it for
+ * @return
+ * @precondition After OT_SIM_reset()
+ * @postcondition Time is until
+ * @caution The firmware's modules keep their state: run it once per process
+ * @notes It is stopped at the first wfi()/halt() with nothing to wake it up
+ *        before until
+ *============================================================================*/
+void OT_SIM_run_firmware(void (*mainp)(void), uint64_t until) {
+  ot_sim_data.until    = until;
+  ot_sim_data.firmware = 1;
+  if (0 == setjmp(ot_sim_data.done)) {
+    (*mainp)();
+  }
+  ot_sim_data.firmware = 0;
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Counts the basic blocks of the code built with
+ * -fsanitize-coverage=trace-pc
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution This file must not be built with it
+ * @notes
+ *============================================================================*/
+void __sanitizer_cov_trace_pc(void) {
+  ++OT_SIM_blocks;
+  return;
+}
+/*==============================================================================
+ * stm8s.h
+ *============================================================================*/
+void OT_SIM_interrupts(uint8_t enabled) {
+  OT_SIM_observe();
+  ot_sim_data.interrupts = enabled;
+  ot_sim_dispatch();
+  return;
+}
+
+void OT_SIM_wait(uint8_t halted) {
+  uint64_t next;
+  // The firmware stops the tick before it halts
+  OT_SIM_observe();
+#if defined(WAKEUP_BUTTON)
+  if (halted && ot_sim_data.tap && (0 == OT_SIM_wakeup.pressed_at)) {
+    uint64_t press = (ot_sim_data.tap_after > ot_sim_data.now) ?
+                     ot_sim_data.tap_after : ot_sim_data.now;
+    if (ot_sim_next_event(press) >= press) {
+      ot_sim_data.now = press;
+      OT_SIM_button(1);
+      OT_SIM_wakeup.pressed_at = press;
+      ot_sim_dispatch(); // Its edge wakes the firmware up
+      return;
+    }
+  }
+#else
+  (void)halted;
+#endif // WAKEUP_BUTTON
+  next = ot_sim_next_event(ot_sim_data.until);
+  if (next >= ot_sim_data.until) {
+    ot_sim_data.now = ot_sim_data.until;
+    OT_SIM_observe();
+    longjmp(ot_sim_data.done, 1);
+  }
+  OT_SIM_advance(next - ot_sim_data.now);
+  return;
+}
+
+uint8_t ITC_GetCPUCC(void) {
+  return (ot_sim_data.interrupts && !ot_sim_data.in_isr) ? OT_SIM_CC_ENABLED :
+                                                           OT_SIM_CC_MASKED;
+}
+
+void GPIO_Init(GPIO_TypeDef *port, GPIO_Pin_TypeDef pin,
+               GPIO_Mode_TypeDef mode) {
+  port->CR2 &= (uint8_t)~pin;
+  if (mode & OT_PIN_MODE_DDR) {
+    if (mode & 0x10) port->ODR |= pin; else port->ODR &= (uint8_t)~pin;
+    port->DDR |= pin;
+  }
+  else {
+    port->DDR &= (uint8_t)~pin;
+  }
+  if (mode & OT_PIN_MODE_CR1) port->CR1 |= pin; else port->CR1 &= ~pin;
+  if (mode & OT_PIN_MODE_CR2) port->CR2 |= pin;
+  OT_SIM_observe();
+  return;
+}
+
+void EXTI_SetExtIntSensitivity(EXTI_Port_TypeDef port,
+                               EXTI_Sensitivity_TypeDef sensitivity) {
+  (void)port;
+  (void)sensitivity; // As set in config.h
+  return;
+}
+/*==============================================================================
+ * timer.h
+ *============================================================================*/
+void OT_TIMER_init(OT_TIMER_CB_T *cb, void* cbarg) {
+  ot_sim_data.timer_cb    = cb;
+  ot_sim_data.timer_cbarg = cbarg;
+  return;
+}
+
+void OT_TIMER_start(void) {
+  ot_sim_data.timer_running = 1;
+  ot_sim_data.tick_pending  = 0;
+  ot_sim_data.next_tick     = ot_sim_data.now + OT_SIM_CYCLES_PER_MS;
+  return;
+}
+
+void OT_TIMER_stop(void) {
+  ot_sim_data.timer_running = 0;
+  ot_sim_data.tick_pending  = 0;
+  return;
+}
+
+void OT_TIMER_busywait_ms(uint16_t delay_ms) {
+  OT_SIM_observe();
+  OT_SIM_advance(OT_SIM_MS(delay_ms));
+  return;
+}
+
+void OT_TIMER_busywait_us(uint16_t delay_us) {
+  OT_SIM_observe();
+  OT_SIM_advance(OT_SIM_US(delay_us));
+  return;
+}
+
+#if defined(OT_TIMER_CYCLE_COUNTER)
+uint16_t OT_TIMER_cycles(void) {
+  OT_SIM_observe();
+  OT_SIM_advance(OT_SIM_POLL_CYCLES);
+  return (uint16_t)ot_sim_data.now;
+}
+#endif // OT_TIMER_CYCLE_COUNTER
+
+#if defined(OT_TIMER_CYCLE_COUNTER32)
+uint32_t OT_TIMER_cycles32(void) {
+  OT_SIM_observe();
+  OT_SIM_advance(OT_SIM_POLL_CYCLES);
+  return (uint32_t)ot_sim_data.now;
+}
+#endif // OT_TIMER_CYCLE_COUNTER32
+
+#if defined(SELF_TEST)
+void OT_TIMER_capture_clear(void) {
+  OT_SIM_observe();
+  ot_sim_data.captured = 0;
+  return;
+}
+
+uint8_t OT_TIMER_captured(uint16_t *startp, uint16_t *endp) {
+  OT_SIM_observe();
+  if (0x03 != ot_sim_data.captured) return 0;
+  *startp = ot_sim_data.capture_start;
+  *endp   = ot_sim_data.capture_end;
+  return 1;
+}
+#endif // SELF_TEST
+
+#if defined(QUENCH_OUT)
+void OT_TIMER_quench_after(uint16_t delay_cycles) {
+  OT_SIM_observe();
+  if (delay_cycles < OT_SIM_QUENCH_MIN_CYCLES) {
+    delay_cycles = OT_SIM_QUENCH_MIN_CYCLES;
+  }
+  ot_sim_data.quench_at = ot_sim_data.now + delay_cycles;
+  return;
+}
+
+void OT_TIMER_quench_release(void) {
+  OT_SIM_observe();
+  ot_sim_data.quench_at = 0;
+  return;
+}
+#endif // QUENCH_OUT
+
+#if defined(HSI_CALIBRATION)
+void OT_TIMER_calibrate_request(void) {
+  return; // The simulated HSI is exact
+}
+
+void OT_TIMER_calibrate(void) {
+  return;
+}
+#endif // HSI_CALIBRATION
+/*==============================================================================
+ * power.h
+ *============================================================================*/
+void OT_POWER_init(void) {
+  OT_POWER_set(OT_POWER_TICK | OT_POWER_BUSYWAIT | OT_POWER_ADC |
+               OT_POWER_AWU);
+  return;
+}
+
+void OT_POWER_set(OT_POWER_MASK_T mask) {
+  // A gated timer stops counting
+  if ((ot_sim_data.clocks & OT_POWER_TICK) && !(mask & OT_POWER_TICK)) {
+    ot_sim_data.tick_gated = ot_sim_data.now;
+  }
+  else if (!(ot_sim_data.clocks & OT_POWER_TICK) && (mask & OT_POWER_TICK)) {
+    ot_sim_data.next_tick += ot_sim_data.now - ot_sim_data.tick_gated;
+  }
+  ot_sim_data.clocks = mask;
+  return;
+}
+
+OT_POWER_MASK_T OT_POWER_get(void) {
+  return ot_sim_data.clocks;
+}
+
+#if defined(DEBUG)
+void OT_POWER_update_estimate(void) {
+  return;
+}
+#endif // DEBUG
+/*==============================================================================
+ * adc.h
+ *============================================================================*/
+#if !defined(OT_SIM_ADC1)
+void OT_ADC_init(void) {
+  return;
+}
+
+uint8_t OT_ADC_read_delay_sense(void) {
+  ot_sim_adc_convert("OT_ADC_read_delay_sense()");
+  return ot_sim_data.delay_sense_ms;
+}
+
+#if defined(BATTERY_MONITOR)
+uint16_t OT_ADC_read_vdd_mv(void) {
+  ot_sim_adc_convert("OT_ADC_read_vdd_mv()");
+  return OT_SIM_VDD_MV;
+}
+#endif // BATTERY_MONITOR
+#endif // !OT_SIM_ADC1
+/*==============================================================================
+ * ADC1 (stm8s.h), with OT_SIM_ADC1
+ *============================================================================*/
+#if defined(OT_SIM_ADC1)
+void ADC1_DeInit(void) {
+  ot_sim_data.adc_on         = 0;
+  ot_sim_data.adc_continuous = 0;
+  ot_sim_data.adc_buffered   = 0;
+  ot_sim_data.adc_converting = 0;
+  ot_sim_data.adc_cycles     = ADC1_PRESSEL_FCPU_D2 * OT_SIM_ADC_CLOCKS;
+  ot_sim_data.adc_period     = 0;
+#if defined(ADC_FLASH_DETECT)
+  ot_sim_data.adc_high       = OT_SIM_ADC_MAX;
+  ot_sim_data.adc_low        = 0;
+  ot_sim_data.adc_awd_ie     = 0;
+  ot_sim_data.adc_awd        = 0;
+#endif // ADC_FLASH_DETECT
+  return;
+}
+
+void ADC1_Init(ADC1_ConvMode_TypeDef mode, ADC1_Channel_TypeDef channel,
+               ADC1_PresSel_TypeDef prescaler, ADC1_ExtTrig_TypeDef trig,
+               FunctionalState trig_state, ADC1_Align_TypeDef align,
+               ADC1_SchmittTrigg_TypeDef schmitt,
+               FunctionalState schmitt_state) {
+  (void)trig;
+  (void)trig_state;
+  (void)schmitt;
+  (void)schmitt_state;
+  ADC1_ConversionConfig(mode, channel, align);
+  ADC1_PrescalerConfig(prescaler);
+  ADC1_Cmd(ENABLE);
+  return;
+}
+
+void ADC1_Cmd(FunctionalState state) {
+  if (ENABLE == state) {
+    ot_sim_data.adc_on = 1;
+  }
+  else if (ot_sim_data.adc_on) {
+    ot_sim_data.adc_on = 0;
+    if (ot_sim_data.adc_converting) {
+      ot_sim_data.adc_converting = 0;
+      ot_sim_data.adc_stop = ot_sim_data.now;
+    }
+  }
+  return;
+}
+
+void ADC1_SchmittTriggerConfig(ADC1_SchmittTrigg_TypeDef schmitt,
+                               FunctionalState state) {
+  (void)schmitt;
+  (void)state;
+  return;
+}
+
+void ADC1_PrescalerConfig(ADC1_PresSel_TypeDef prescaler) {
+  ot_sim_data.adc_cycles = (uint16_t)prescaler * OT_SIM_ADC_CLOCKS;
+  return;
+}
+
+void ADC1_ConversionConfig(ADC1_ConvMode_TypeDef mode,
+                           ADC1_Channel_TypeDef channel,
+                           ADC1_Align_TypeDef align) {
+  (void)align; // Right-aligned is all adc.c uses
+  ot_sim_data.adc_continuous = (ADC1_CONVERSIONMODE_CONTINUOUS == mode);
+  ot_sim_data.adc_channel    = (uint8_t)channel;
+  return;
+}
+
+void ADC1_DataBufferCmd(FunctionalState state) {
+  ot_sim_data.adc_buffered = (ENABLE == state);
+  return;
+}
+
+void ADC1_ITConfig(ADC1_IT_TypeDef it, FunctionalState state) {
+#if defined(ADC_FLASH_DETECT)
+  if (ADC1_IT_AWDIE == it) {
+    // Conversions from now on are compared
+    if ((ENABLE == state) && !ot_sim_data.adc_awd_ie) {
+      ot_sim_data.adc_checked = ot_sim_adc_done();
+    }
+    ot_sim_data.adc_awd_ie = (ENABLE == state);
+  }
+#else
+  (void)it;
+  (void)state;
+#endif // ADC_FLASH_DETECT
+  return;
+}
+
+void ADC1_StartConversion(void) {
+  ot_sim_adc_convert("ADC1_StartConversion()");
+  OT_SIM_observe();
+  // A capture starts no earlier than its lead after the TRIGGER_IN edge
+  if (ot_sim_data.adc_buffered && (0 != ot_sim_data.capture_lead) &&
+      ((ot_sim_data.trigger_in_rose + ot_sim_data.capture_lead) >
+       ot_sim_data.now)) {
+    OT_SIM_advance(ot_sim_data.trigger_in_rose + ot_sim_data.capture_lead -
+                   ot_sim_data.now);
+  }
+  ot_sim_data.adc_converting = ot_sim_data.adc_on;
+  ot_sim_data.adc_period     = ot_sim_data.adc_cycles;
+  ot_sim_data.adc_start      = ot_sim_data.now;
+  ot_sim_data.adc_eoc_from   = 0;
+#if defined(ADC_FLASH_DETECT)
+  ot_sim_data.adc_checked    = 0;
+#endif // ADC_FLASH_DETECT
+  return;
+}
+
+uint16_t ADC1_GetConversionValue(void) {
+  uint32_t done = ot_sim_adc_done();
+  return (0 == done) ? 0 : ot_sim_adc_sample(done - 1);
+}
+
+uint16_t ADC1_GetBufferValue(uint8_t buffer) {
+  uint32_t done = ot_sim_adc_done();
+  // The latest conversion that went to this entry
+  if (done <= buffer) return 0;
+  return ot_sim_adc_sample(buffer + ((done - 1 - buffer) / OT_SIM_ADC_BUFFER) *
+                                    OT_SIM_ADC_BUFFER);
+}
+
+void ADC1_SetHighThreshold(uint16_t threshold) {
+#if defined(ADC_FLASH_DETECT)
+  ot_sim_data.adc_high = threshold;
+#else
+  (void)threshold;
+#endif // ADC_FLASH_DETECT
+  return;
+}
+
+void ADC1_SetLowThreshold(uint16_t threshold) {
+#if defined(ADC_FLASH_DETECT)
+  ot_sim_data.adc_low = threshold;
+#else
+  (void)threshold;
+#endif // ADC_FLASH_DETECT
+  return;
+}
+
+// The firmware polls EOC: time passes to the conversion that sets it
+FlagStatus ADC1_GetFlagStatus(ADC1_Flag_TypeDef flag) {
+  uint32_t eoc = ot_sim_data.adc_eoc_from +
+                 ((ot_sim_data.adc_continuous && ot_sim_data.adc_buffered) ?
+                  OT_SIM_ADC_BUFFER : 1);
+  if (ADC1_FLAG_EOC != flag) return RESET;
+  if (ot_sim_adc_done() < eoc) {
+    if (!ot_sim_data.adc_converting ||
+        (!ot_sim_data.adc_continuous && (eoc > 1))) {
+      fprintf(stderr, "sim: EOC polled with ADC1 stopped: would hang\n");
+      abort();
+    }
+    OT_SIM_advance(ot_sim_data.adc_start +
+                   (uint64_t)eoc * ot_sim_data.adc_period - ot_sim_data.now);
+  }
+  return SET;
+}
+
+void ADC1_ClearFlag(ADC1_Flag_TypeDef flag) {
+  if (ADC1_FLAG_EOC == flag) ot_sim_data.adc_eoc_from = ot_sim_adc_done();
+  return;
+}
+
+// ot_adc_isr clears it right after turning TRIGGER_OUT on (LIGHTNING_MODE)
+void ADC1_ClearITPendingBit(ADC1_IT_TypeDef it) {
+  OT_SIM_observe();
+#if defined(ADC_FLASH_DETECT)
+  if (ADC1_IT_AWD == it) {
+    ot_sim_data.adc_awd     = 0;
+    ot_sim_data.adc_checked = ot_sim_adc_done();
+  }
+#else
+  (void)it;
+#endif // ADC_FLASH_DETECT
+  return;
+}
+#endif // OT_SIM_ADC1
+/*==============================================================================
+ * awu.h
+ *============================================================================*/
+#if defined(SNIFF_MODE)
+void OT_AWU_init(OT_AWU_CB_T *cb, void *cbarg) {
+  ot_sim_data.awu_cb    = cb;
+  ot_sim_data.awu_cbarg = cbarg;
+  return;
+}
+
+void OT_AWU_start(AWU_Timebase_TypeDef period) {
+  ot_sim_data.awu_running = (AWU_TIMEBASE_NO_IT != period);
+  ot_sim_data.awu_pending = 0;
+  ot_sim_data.awu_period  = OT_SIM_US(ot_sim_awu_us[period]);
+  ot_sim_data.next_awu    = ot_sim_data.now + ot_sim_data.awu_period;
+  return;
+}
+
+void OT_AWU_stop(void) {
+  ot_sim_data.awu_running = 0;
+  ot_sim_data.awu_pending = 0;
+  return;
+}
+#endif // SNIFF_MODE
+/*==============================================================================
+ * eeprom.h
+ *============================================================================*/
+#if defined(EEPROM_STORE)
+uint8_t OT_EE_init(void) {
+  return 0; // Blank
+}
+
+uint8_t OT_EE_load_settings(void *settingsp, uint8_t size) {
+  (void)settingsp;
+  (void)size;
+  return 0; // None saved
+}
+
+void OT_EE_save_settings(const void *settingsp, uint8_t size) {
+  (void)settingsp;
+  (void)size;
+  return;
+}
+
+void OT_EE_commit(void) {
+  return;
+}
+
+void OT_EE_hold(void) {
+  return;
+}
+
+uint8_t OT_EE_busy(void) {
+  return 0;
+}
+
+#if defined(EVENT_LOG)
+void OT_EE_log(OT_EE_EVENT_T event, uint8_t arg) {
+  (void)event;
+  (void)arg;
+  return;
+}
+#endif // EVENT_LOG
+#endif // EEPROM_STORE
+/*============================================================================*/
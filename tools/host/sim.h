@@ -0,0 +1,98 @@
+/*==============================================================================
+ * MODULE: Simulator (SIM)
+ * DESCRIPTION: Prototypes exported by the SIM module
+ *============================================================================*/
+#ifndef _OT_SIM_H_
+#define _OT_SIM_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include <stm8s.h>
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+#define OT_SIM_CYCLES_PER_US    2    // fMASTER is 2MHz
+#define OT_SIM_CYCLES_PER_MS    2000
+// Interrupt latency charged on every ISR entry (~6usec, see config.h)
+#define OT_SIM_ISR_CYCLES       12
+// Charged on every read of the cycle counter, so that polling loops advance
+#define OT_SIM_POLL_CYCLES      8
+// Times of TRIGGER_OUT's assertions kept in OT_SIM_trigger
+#define OT_SIM_FIRES            16
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+#define OT_SIM_US(us)           ((uint64_t)(us) * OT_SIM_CYCLES_PER_US)
+#define OT_SIM_MS(ms)           ((uint64_t)(ms) * OT_SIM_CYCLES_PER_MS)
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+// What the simulator saw of TRIGGER_OUT since it was reset
+typedef struct OT_SIM_TRIGGER_S {
+  uint32_t fires;      // Times it was asserted
+  uint64_t last_fire;  // When it was last asserted
+  uint64_t last_end;   // When it was last released
+  uint64_t fire_at[OT_SIM_FIRES]; // When it was asserted, the first times
+  uint32_t quenches;   // Times QUENCH_OUT was raised (QUENCH_OUT)
+  uint64_t last_quench; // When it was last raised
+  // When the conversion that raised the ADC1 interrupt before each of the
+  // first assertions ended (ADC_FLASH_DETECT)
+  uint64_t sensed_at[OT_SIM_FIRES];
+} OT_SIM_TRIGGER_T;
+
+// A wake-up by the button (OT_SIM_wakeup_tap()), in cycles since
+// OT_SIM_reset()
+typedef struct OT_SIM_WAKEUP_S {
+  uint64_t pressed_at; // When the button was pressed (0: not yet)
+  uint64_t armed_at;   // When TRIGGER_IN's interrupt was first enabled after
+                       // that (0: not yet)
+} OT_SIM_WAKEUP_T;
+
+// A pulse on TRIGGER_IN, in cycles since OT_SIM_reset()
+typedef struct OT_SIM_PULSE_S {
+  uint64_t start;
+  uint64_t width;
+} OT_SIM_PULSE_T;
+
+// Called once the TRIGGER_IN ISR has run, with the index of the last pulse
+// that started
+typedef void (OT_SIM_EDGE_CB_T)(uint16_t pulse);
+
+// The level of an analog input (ADC counts) at a time (CPU cycles since
+// OT_SIM_reset())
+typedef uint16_t (OT_SIM_LEVEL_CB_T)(uint64_t at);
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+extern OT_SIM_TRIGGER_T OT_SIM_trigger;
+extern OT_SIM_WAKEUP_T OT_SIM_wakeup;
+// Basic blocks run by the code built with -fsanitize-coverage=trace-pc
+extern uint32_t OT_SIM_blocks;
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+void OT_SIM_reset(uint8_t dip, uint8_t delay_sense_ms);
+uint64_t OT_SIM_now(void);
+void OT_SIM_advance(uint64_t cycles);
+void OT_SIM_button(uint8_t pressed);
+void OT_SIM_wakeup_tap(uint64_t after, uint64_t width);
+void OT_SIM_observe(void);
+uint8_t OT_SIM_trigger_out(void);
+uint8_t OT_SIM_timer_running(void);
+uint8_t OT_SIM_awu_running(void);
+void OT_SIM_trigger_in(const OT_SIM_PULSE_T *pulsesp, uint16_t count,
+                       OT_SIM_EDGE_CB_T *cb);
+void OT_SIM_flash_sense(OT_SIM_LEVEL_CB_T *cb);
+void OT_SIM_capture_lead(uint64_t cycles);
+void OT_SIM_run_firmware(void (*mainp)(void), uint64_t until);
+/*============================================================================*/
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _OT_SIM_H_ */
@@ -0,0 +1,487 @@
+/*==============================================================================
+ * MODULE: State Machine fuzz (FUZZ)
+ * DESCRIPTION: Generative fuzz of OT_SM_execute() on the host. Each run
+ * powers up a unit with random DIP[2:0] and DELAY_SENSE settings, sends it a
+ * random stream of events (runs of 1msec ticks, flash bursts, button presses
+ * and holds, sniffs, storms, and stray events of any kind in any state), then
+ * lets it time out back to READY. After every event it checks that:
+ * - TRIGGER_OUT is released, and was asserted at most once per burst
+ *   sequence (plus the OPTICAL_CONFIG multi-pulses), and only after a burst;
+ * - state_timeout_ms counts down by at most 1 per tick, never wrapping;
+ * and, at the end of each run, that READY is reached within OT_FUZZ_READY_MS
+ * with nothing but ticks (and a button press to leave SLEEPING).
+ *
+ * It also counts the basic blocks (-fsanitize-coverage=trace-pc) each
+ * (state, event) path of OT_SM_execute() runs, and fails if the most any run
+ * took exceeds its budget in sm_fuzz.cfg.
+ *
+ * Usage: sm_fuzz <sm_fuzz.cfg> [<seed> [<runs>]]
+ * A failure prints the seed and run that reproduce it.
+ *============================================================================*/
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+// White-box: the invariants are on ot_sm_data
+#include "state_machine.c"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+#define OT_FUZZ_SEED        1
+#define OT_FUZZ_RUNS        1000
+// Events per run, at most
+#define OT_FUZZ_STEPS       200
+// Longest way back to READY: the longest FAULT back-off (16sec), a CONFIG
+// sequence, then INIT
+#define OT_FUZZ_READY_MS    25000
+// Events shown on a failure
+#define OT_FUZZ_TRAIL       12
+#if defined(OPTICAL_CONFIG)
+  #define OT_FUZZ_MAX_PULSES  OPTICAL_CONFIG_MAX_PULSES
+#else
+  #define OT_FUZZ_MAX_PULSES  1
+#endif // OPTICAL_CONFIG
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+#define OT_FUZZ_CHECK(cond, what)  \
+  do { if (!(cond)) ot_fuzz_fail(what); } while (0)
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+// Basic blocks of one (state, event) path
+typedef struct OT_FUZZ_COST_S {
+  uint32_t calls;
+  uint32_t min;
+  uint32_t max;
+  uint64_t sum;
+  uint32_t budget;  // 0: none
+} OT_FUZZ_COST_T;
+
+typedef struct OT_FUZZ_STEP_S {
+  OT_SM_STATE_T state;
+  OT_SM_EVENT_T event;
+} OT_FUZZ_STEP_T;
+/*==============================================================================
+ * LOCAL FUNCTION PROTOTYPES
+ *============================================================================*/
+static void ot_fuzz_fail(const char *what);
+/*==============================================================================
+ * LOCAL VARIABLES
+ *============================================================================*/
+static const char *ot_fuzz_states[OT_SM_STATE_MAX] = {
+  [OT_SM_STATE_INIT]        = "INIT",
+  [OT_SM_STATE_READY]       = "READY",
+  [OT_SM_STATE_PROVISIONAL] = "PROVISIONAL",
+  [OT_SM_STATE_CONFIRMED]   = "CONFIRMED",
+#if defined(WAKEUP_BUTTON)
+  [OT_SM_STATE_SLEEPING]    = "SLEEPING",
+#endif // WAKEUP_BUTTON
+#if defined(SNIFF_MODE)
+  [OT_SM_STATE_SNIFFING]    = "SNIFFING",
+#endif // SNIFF_MODE
+#if defined(STORM_PROTECT)
+  [OT_SM_STATE_FAULT]       = "FAULT",
+#endif // STORM_PROTECT
+#if defined(OPTICAL_CONFIG)
+  [OT_SM_STATE_CONFIG]      = "CONFIG",
+#endif // OPTICAL_CONFIG
+};
+
+static const char *ot_fuzz_events[OT_SM_EVENT_MAX] = {
+  [OT_SM_EVENT_INIT_COMPLETE]  = "INIT_COMPLETE",
+  [OT_SM_EVENT_FLASH_DETECTED] = "FLASH_DETECTED",
+  [OT_SM_EVENT_TIMEOUT]        = "TIMEOUT",
+#if defined(WAKEUP_BUTTON)
+  [OT_SM_EVENT_BUTTON_PRESS]   = "BUTTON_PRESS",
+#endif // WAKEUP_BUTTON
+#if defined(SNIFF_MODE)
+  [OT_SM_EVENT_SNIFF]          = "SNIFF",
+#endif // SNIFF_MODE
+#if defined(STORM_PROTECT)
+  [OT_SM_EVENT_STORM]          = "STORM",
+#if defined(WAKEUP_BUTTON)
+  [OT_SM_EVENT_BUTTON_STORM]   = "BUTTON_STORM",
+#endif // WAKEUP_BUTTON
+#endif // STORM_PROTECT
+#if defined(WIRELESS_COMMANDS)
+  [OT_SM_EVENT_COMMANDED]      = "COMMANDED",
+  [OT_SM_EVENT_ACTIVITY]       = "ACTIVITY",
+#endif // WIRELESS_COMMANDS
+};
+
+static OT_FUZZ_COST_T ot_fuzz_cost[OT_SM_STATE_MAX][OT_SM_EVENT_MAX];
+
+// The State Machine as built, restored before every run
+static OT_SM_DATA_T ot_fuzz_data0;
+#if defined(OPTICAL_CONFIG)
+static OT_SM_SETTINGS_T ot_fuzz_settings0;
+#endif // OPTICAL_CONFIG
+
+static uint32_t ot_fuzz_rng;
+static uint32_t ot_fuzz_seed;
+static uint32_t ot_fuzz_run;
+static uint8_t  ot_fuzz_dip;
+static uint8_t  ot_fuzz_knob;
+
+// The burst sequence in progress: it ends as soon as the State Machine is
+// anywhere but PROVISIONAL and CONFIRMED
+static uint16_t ot_fuzz_seq_bursts;
+static uint8_t  ot_fuzz_seq_fired;
+static uint8_t  ot_fuzz_seq_pulses;
+
+static OT_FUZZ_STEP_T ot_fuzz_trail[OT_FUZZ_TRAIL];
+static uint32_t ot_fuzz_steps;
+/*==============================================================================
+ * LOCAL FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION: xorshift32
+ * @param n
+ * @return A pseudo-random number in [0, n)
+ * @precondition n > 0
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static uint32_t ot_fuzz_below(uint32_t n) {
+  ot_fuzz_rng ^= ot_fuzz_rng << 13;
+  ot_fuzz_rng ^= ot_fuzz_rng >> 17;
+  ot_fuzz_rng ^= ot_fuzz_rng << 5;
+  return ot_fuzz_rng % n;
+}
+/*==============================================================================
+ * DESCRIPTION:
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static const char *ot_fuzz_state_name(OT_SM_STATE_T state) {
+  return (state < OT_SM_STATE_MAX) ? ot_fuzz_states[state] : "?";
+}
+
+static const char *ot_fuzz_event_name(OT_SM_EVENT_T event) {
+  return (event < OT_SM_EVENT_MAX) ? ot_fuzz_events[event] : "(invalid)";
+}
+/*==============================================================================
+ * DESCRIPTION: Report a broken invariant, with the events leading to it
+ * @param what
+ * @return Doesn't
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static void ot_fuzz_fail(const char *what) {
+  uint32_t i = (ot_fuzz_steps > OT_FUZZ_TRAIL) ?
+               (ot_fuzz_steps - OT_FUZZ_TRAIL) : 0;
+  printf("FAIL: %s\n", what);
+  printf("  seed %u run %u (DIP %u, DELAY_SENSE %u), event %u\n",
+         ot_fuzz_seed, ot_fuzz_run, ot_fuzz_dip, ot_fuzz_knob,
+         ot_fuzz_steps);
+  for (; i < ot_fuzz_steps; ++i) {
+    const OT_FUZZ_STEP_T *stepp = &ot_fuzz_trail[i % OT_FUZZ_TRAIL];
+    printf("  %6u %-12s %s\n", i, ot_fuzz_state_name(stepp->state),
+           ot_fuzz_event_name(stepp->event));
+  }
+  printf("  now %s, state_timeout_ms %u\n",
+         ot_fuzz_state_name(ot_sm_data.state), ot_sm_data.state_timeout_ms);
+  exit(1);
+}
+/*==============================================================================
+ * DESCRIPTION: Read the budgets: lines of "budget <state> <event> <blocks>",
+ * where '*' stands for any state or any event
+ * @param path
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes A later line overrides an earlier one for the paths both match
+ *============================================================================*/
+static void ot_fuzz_load_budgets(const char *path) {
+  char line[160];
+  char state[32];
+  char event[32];
+  unsigned blocks;
+  FILE *fp = fopen(path, "r");
+  int s;
+  int e;
+
+  if ((void*)0 == fp) {
+    perror(path);
+    exit(2);
+  }
+  while ((void*)0 != fgets(line, sizeof(line), fp)) {
+    if (3 != sscanf(line, " budget %31s %31s %u", state, event, &blocks)) {
+      continue;
+    }
+    // Paths that aren't built for this configuration are skipped
+    for (s = 0; s < OT_SM_STATE_MAX; ++s) {
+      if ((void*)0 == ot_fuzz_states[s]) continue;
+      if (strcmp(state, "*") && strcmp(state, ot_fuzz_states[s])) continue;
+      for (e = 0; e < OT_SM_EVENT_MAX; ++e) {
+        if ((void*)0 == ot_fuzz_events[e]) continue;
+        if (strcmp(event, "*") && strcmp(event, ot_fuzz_events[e])) continue;
+        ot_fuzz_cost[s][e].budget = blocks;
+      }
+    }
+  }
+  fclose(fp);
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Send an event and check the invariants
+ * @param event
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static void ot_fuzz_execute(OT_SM_EVENT_T event) {
+  OT_SM_STATE_T before = ot_sm_data.state;
+  uint16_t timeout_ms  = ot_sm_data.state_timeout_ms;
+  uint32_t fires       = OT_SIM_trigger.fires;
+  uint32_t blocks      = OT_SIM_blocks;
+  OT_SM_STATE_T after;
+
+  ot_fuzz_trail[ot_fuzz_steps % OT_FUZZ_TRAIL].state = before;
+  ot_fuzz_trail[ot_fuzz_steps % OT_FUZZ_TRAIL].event = event;
+  ++ot_fuzz_steps;
+
+  OT_SM_execute(event);
+
+  OT_SIM_observe();
+  blocks = OT_SIM_blocks - blocks;
+  fires  = OT_SIM_trigger.fires - fires;
+  after  = ot_sm_data.state;
+  if ((before < OT_SM_STATE_MAX) && (event < OT_SM_EVENT_MAX)) {
+    OT_FUZZ_COST_T *costp = &ot_fuzz_cost[before][event];
+    if ((0 == costp->calls) || (blocks < costp->min)) costp->min = blocks;
+    if (blocks > costp->max) costp->max = blocks;
+    costp->sum += blocks;
+    ++costp->calls;
+  }
+
+  OT_FUZZ_CHECK(after < OT_SM_STATE_MAX, "invalid state");
+  OT_FUZZ_CHECK(0 == OT_SIM_trigger_out(), "TRIGGER_OUT left asserted");
+  if (OT_SM_IS_BURST(event)) ++ot_fuzz_seq_bursts;
+  if ((OT_SM_STATE_CONFIRMED != before) &&
+      (OT_SM_STATE_CONFIRMED == after)) {
+    OT_FUZZ_CHECK(1 == fires, "CONFIRMED entered without one trigger pulse");
+    OT_FUZZ_CHECK(0 == ot_fuzz_seq_fired, "fired twice in a burst sequence");
+    OT_FUZZ_CHECK(0 != ot_fuzz_seq_bursts, "fired without a burst");
+    ot_fuzz_seq_fired  = 1;
+    ot_fuzz_seq_pulses = 1;
+  }
+  else if ((OT_SM_STATE_CONFIRMED == before) &&
+           (OT_SM_EVENT_TIMEOUT == event)) {
+    // The other pulses of a multi-pulse sequence (OPTICAL_CONFIG)
+    OT_FUZZ_CHECK(fires <= 1, "more than one pulse per tick");
+    ot_fuzz_seq_pulses += (uint8_t)fires;
+    OT_FUZZ_CHECK(ot_fuzz_seq_pulses <= OT_FUZZ_MAX_PULSES,
+                  "too many pulses in a burst sequence");
+  }
+  else {
+    OT_FUZZ_CHECK(0 == fires, "fired outside CONFIRMED");
+  }
+  if ((OT_SM_EVENT_TIMEOUT == event) && (before == after)) {
+    OT_FUZZ_CHECK((ot_sm_data.state_timeout_ms <= timeout_ms) &&
+                  ((timeout_ms - ot_sm_data.state_timeout_ms) <= 1),
+                  "state_timeout_ms didn't count down by 0 or 1");
+  }
+  if ((OT_SM_STATE_PROVISIONAL != after) && (OT_SM_STATE_CONFIRMED != after)) {
+    ot_fuzz_seq_bursts = 0;
+    ot_fuzz_seq_fired  = 0;
+    ot_fuzz_seq_pulses = 0;
+  }
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Send a random event (or run of ticks)
+ * @param heldp - The button is held
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes The ticks only come while the timer runs, as they would; anything
+ *        else may come in any state
+ *============================================================================*/
+static void ot_fuzz_step(uint8_t *heldp) {
+  uint32_t pick = ot_fuzz_below(100);
+  uint32_t ticks;
+
+  if (pick < 3) {
+    // Nothing happens until the state times out (e.g. READY to SLEEPING)
+    OT_SM_STATE_T state = ot_sm_data.state;
+    while ((state == ot_sm_data.state) && OT_SIM_timer_running()) {
+      ot_fuzz_execute(OT_SM_EVENT_TIMEOUT);
+    }
+  }
+  else if (pick < 40) {
+    // Runs of up to ~4sec, mostly short
+    ticks = 1 + ot_fuzz_below(1u << ot_fuzz_below(13));
+    while ((ticks-- > 0) && OT_SIM_timer_running()) {
+      ot_fuzz_execute(OT_SM_EVENT_TIMEOUT);
+    }
+  }
+  else if (pick < 65) {
+#if defined(WIRELESS_COMMANDS)
+    if (ot_fuzz_below(2)) {
+      ot_fuzz_execute(ot_fuzz_below(2) ? OT_SM_EVENT_COMMANDED :
+                                         OT_SM_EVENT_ACTIVITY);
+      return;
+    }
+#endif // WIRELESS_COMMANDS
+    ot_fuzz_execute(OT_SM_EVENT_FLASH_DETECTED);
+  }
+#if defined(WAKEUP_BUTTON)
+  else if (pick < 75) {
+    // A press, which may be held (OPTICAL_CONFIG), or a release
+    *heldp = !*heldp;
+    OT_SIM_button(*heldp);
+    if (*heldp) ot_fuzz_execute(OT_SM_EVENT_BUTTON_PRESS);
+  }
+#endif // WAKEUP_BUTTON
+#if defined(SNIFF_MODE)
+  else if (pick < 80) {
+    ot_fuzz_execute(OT_SM_EVENT_SNIFF);
+  }
+#endif // SNIFF_MODE
+#if defined(STORM_PROTECT)
+  else if (pick < 83) {
+    ot_fuzz_execute(OT_SM_EVENT_STORM);
+  }
+#if defined(WAKEUP_BUTTON)
+  else if (pick < 85) {
+    ot_fuzz_execute(OT_SM_EVENT_BUTTON_STORM);
+  }
+#endif // WAKEUP_BUTTON
+#endif // STORM_PROTECT
+  else if (pick < 99) {
+    // A stray event (e.g. a tick that was pending as the timer stopped)
+    ot_fuzz_execute((OT_SM_EVENT_T)ot_fuzz_below(OT_SM_EVENT_MAX));
+  }
+  else {
+    ot_fuzz_execute((OT_SM_EVENT_T)(OT_SM_EVENT_MAX + ot_fuzz_below(4)));
+  }
+  (void)heldp;
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: One unit, from power-up back to READY
+ * @param
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static void ot_fuzz_one_run(void) {
+  uint32_t steps;
+  uint32_t ms;
+  uint8_t held = 0;
+
+  ot_fuzz_dip  = (uint8_t)ot_fuzz_below(8);
+  ot_fuzz_knob = ot_fuzz_below(4) ? (uint8_t)ot_fuzz_below(256) : 0;
+  ot_fuzz_steps = 0;
+  ot_fuzz_seq_bursts = 0;
+  ot_fuzz_seq_fired  = 0;
+  ot_fuzz_seq_pulses = 0;
+  memcpy((void*)&ot_sm_data, &ot_fuzz_data0, sizeof(ot_sm_data));
+#if defined(OPTICAL_CONFIG)
+  memcpy((void*)&ot_sm_settings, &ot_fuzz_settings0, sizeof(ot_sm_settings));
+#endif // OPTICAL_CONFIG
+  OT_SIM_reset(ot_fuzz_dip, ot_fuzz_knob);
+  OT_POWER_init();
+  OT_GPIO_init((void*)0, (void*)0);
+  OT_SM_init();
+  OT_SIM_observe();
+  OT_FUZZ_CHECK(0 == OT_SIM_trigger.fires, "fired at power-up");
+
+  for (steps = 1 + ot_fuzz_below(OT_FUZZ_STEPS); steps > 0; --steps) {
+    ot_fuzz_step(&held);
+  }
+
+  // Left alone, the unit gets back to READY
+#if defined(WAKEUP_BUTTON)
+  OT_SIM_button(0);
+#endif // WAKEUP_BUTTON
+  for (ms = 0; OT_SM_STATE_READY != ot_sm_data.state; ++ms) {
+    OT_FUZZ_CHECK(ms < OT_FUZZ_READY_MS, "not back in READY");
+    if (OT_SIM_timer_running()) {
+      ot_fuzz_execute(OT_SM_EVENT_TIMEOUT);
+    }
+#if defined(WAKEUP_BUTTON)
+    else if (OT_SM_STATE_SLEEPING == ot_sm_data.state) {
+      ot_fuzz_execute(OT_SM_EVENT_BUTTON_PRESS);
+    }
+#endif // WAKEUP_BUTTON
+    else {
+      ot_fuzz_fail("stuck: the timer is stopped");
+    }
+  }
+  return;
+}
+/*==============================================================================
+ * DESCRIPTION: Print the cost of every path taken, and check the budgets
+ * @param
+ * @return Non-zero if a path exceeds its budget
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static int ot_fuzz_report(void) {
+  int over = 0;
+  int s;
+  int e;
+
+  printf("%-12s %-15s %8s %6s %6s %6s %6s\n", "state", "event", "calls",
+         "min", "avg", "max", "budget");
+  for (s = 0; s < OT_SM_STATE_MAX; ++s) {
+    for (e = 0; e < OT_SM_EVENT_MAX; ++e) {
+      const OT_FUZZ_COST_T *costp = &ot_fuzz_cost[s][e];
+      uint32_t budget = costp->budget;
+      if (0 == costp->calls) continue;
+      printf("%-12s %-15s %8u %6u %6u %6u %6u%s\n", ot_fuzz_states[s],
+             ot_fuzz_events[e], costp->calls, costp->min,
+             (uint32_t)(costp->sum / costp->calls), costp->max, budget,
+             (budget && (costp->max > budget)) ? "  OVER BUDGET" : "");
+      if (budget && (costp->max > budget)) over = 1;
+    }
+  }
+  return over;
+}
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+int main(int argc, char **argv) {
+  uint32_t runs = OT_FUZZ_RUNS;
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <sm_fuzz.cfg> [<seed> [<runs>]]\n", argv[0]);
+    return 2;
+  }
+  ot_fuzz_load_budgets(argv[1]);
+  ot_fuzz_seed = (argc > 2) ? (uint32_t)strtoul(argv[2], 0, 0) : OT_FUZZ_SEED;
+  if (argc > 3) runs = (uint32_t)strtoul(argv[3], 0, 0);
+  ot_fuzz_rng = ot_fuzz_seed ? ot_fuzz_seed : OT_FUZZ_SEED;
+
+  memcpy(&ot_fuzz_data0, (const void*)&ot_sm_data, sizeof(ot_sm_data));
+#if defined(OPTICAL_CONFIG)
+  memcpy(&ot_fuzz_settings0, &ot_sm_settings, sizeof(ot_sm_settings));
+#endif // OPTICAL_CONFIG
+  for (ot_fuzz_run = 0; ot_fuzz_run < runs; ++ot_fuzz_run) {
+    ot_fuzz_one_run();
+  }
+  printf("%u runs (seed %u): invariants hold\n", runs, ot_fuzz_seed);
+  return ot_fuzz_report();
+}
+/*============================================================================*/
@@ -0,0 +1,182 @@
+/*==============================================================================
+ * MODULE: Host stm8s.h
+ * DESCRIPTION: Stand-in for the StdPeriph stm8s.h in the host builds of
+ * tools/host. Only what the modules built on the host use is declared. The
+ * GPIO ports are plain structs that the simulator (sim.c) drives and watches,
+ * and the interrupt instructions call into it.
+ *============================================================================*/
+#ifndef __STM8S_H
+#define __STM8S_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include <stdint.h>
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+typedef enum {RESET = 0, SET = !RESET} FlagStatus, ITStatus, BitStatus;
+typedef enum {DISABLE = 0, ENABLE = !DISABLE} FunctionalState;
+
+typedef struct GPIO_struct {
+  volatile uint8_t ODR;
+  volatile uint8_t IDR;
+  volatile uint8_t DDR;
+  volatile uint8_t CR1;
+  volatile uint8_t CR2;
+} GPIO_TypeDef;
+
+typedef enum {
+  GPIO_PIN_0 = 0x01, GPIO_PIN_1 = 0x02, GPIO_PIN_2 = 0x04, GPIO_PIN_3 = 0x08,
+  GPIO_PIN_4 = 0x10, GPIO_PIN_5 = 0x20, GPIO_PIN_6 = 0x40, GPIO_PIN_7 = 0x80
+} GPIO_Pin_TypeDef;
+
+// Same encoding as StdPeriph (see OT_PIN_MODE_DDR/CR1/CR2 in pin.h)
+typedef enum {
+  GPIO_MODE_IN_FL_NO_IT      = 0x00,
+  GPIO_MODE_IN_PU_NO_IT      = 0x40,
+  GPIO_MODE_IN_FL_IT         = 0x20,
+  GPIO_MODE_IN_PU_IT         = 0x60,
+  GPIO_MODE_OUT_OD_LOW_FAST  = 0xA0,
+  GPIO_MODE_OUT_PP_LOW_FAST  = 0xE0,
+  GPIO_MODE_OUT_OD_LOW_SLOW  = 0x80,
+  GPIO_MODE_OUT_PP_LOW_SLOW  = 0xC0,
+  GPIO_MODE_OUT_OD_HIZ_FAST  = 0xB0,
+  GPIO_MODE_OUT_PP_HIGH_FAST = 0xF0,
+  GPIO_MODE_OUT_OD_HIZ_SLOW  = 0x90,
+  GPIO_MODE_OUT_PP_HIGH_SLOW = 0xD0
+} GPIO_Mode_TypeDef;
+
+typedef enum {
+  EXTI_PORT_GPIOA, EXTI_PORT_GPIOB, EXTI_PORT_GPIOC, EXTI_PORT_GPIOD,
+  EXTI_PORT_GPIOE
+} EXTI_Port_TypeDef;
+
+typedef enum {
+  EXTI_SENSITIVITY_FALL_LOW, EXTI_SENSITIVITY_RISE_ONLY,
+  EXTI_SENSITIVITY_FALL_ONLY, EXTI_SENSITIVITY_RISE_FALL
+} EXTI_Sensitivity_TypeDef;
+
+typedef enum {
+  AWU_TIMEBASE_NO_IT, AWU_TIMEBASE_250US, AWU_TIMEBASE_500US,
+  AWU_TIMEBASE_1MS, AWU_TIMEBASE_2MS, AWU_TIMEBASE_4MS, AWU_TIMEBASE_8MS,
+  AWU_TIMEBASE_16MS, AWU_TIMEBASE_32MS, AWU_TIMEBASE_64MS,
+  AWU_TIMEBASE_128MS, AWU_TIMEBASE_256MS, AWU_TIMEBASE_512MS,
+  AWU_TIMEBASE_1S, AWU_TIMEBASE_2S, AWU_TIMEBASE_12S, AWU_TIMEBASE_30S
+} AWU_Timebase_TypeDef;
+
+typedef enum {
+  ADC1_CHANNEL_0, ADC1_CHANNEL_1, ADC1_CHANNEL_2, ADC1_CHANNEL_3,
+  ADC1_CHANNEL_4, ADC1_CHANNEL_5, ADC1_CHANNEL_6, ADC1_CHANNEL_7,
+  ADC1_CHANNEL_8, ADC1_CHANNEL_9, ADC1_CHANNEL_12 = 12
+} ADC1_Channel_TypeDef;
+
+typedef enum {
+  ADC1_SCHMITTTRIG_CHANNEL0, ADC1_SCHMITTTRIG_CHANNEL1,
+  ADC1_SCHMITTTRIG_CHANNEL2, ADC1_SCHMITTTRIG_CHANNEL3,
+  ADC1_SCHMITTTRIG_CHANNEL4, ADC1_SCHMITTTRIG_CHANNEL5,
+  ADC1_SCHMITTTRIG_CHANNEL6, ADC1_SCHMITTTRIG_CHANNEL7,
+  ADC1_SCHMITTTRIG_CHANNEL8, ADC1_SCHMITTTRIG_CHANNEL9,
+  ADC1_SCHMITTTRIG_CHANNEL12 = 12, ADC1_SCHMITTTRIG_ALL = 0xFF
+} ADC1_SchmittTrigg_TypeDef;
+
+typedef enum {
+  ADC1_CONVERSIONMODE_SINGLE, ADC1_CONVERSIONMODE_CONTINUOUS
+} ADC1_ConvMode_TypeDef;
+
+// The ADC clock's divider of fMASTER
+typedef enum {
+  ADC1_PRESSEL_FCPU_D2 = 2, ADC1_PRESSEL_FCPU_D3 = 3, ADC1_PRESSEL_FCPU_D4 = 4,
+  ADC1_PRESSEL_FCPU_D6 = 6, ADC1_PRESSEL_FCPU_D8 = 8,
+  ADC1_PRESSEL_FCPU_D10 = 10, ADC1_PRESSEL_FCPU_D12 = 12,
+  ADC1_PRESSEL_FCPU_D18 = 18
+} ADC1_PresSel_TypeDef;
+
+typedef enum {ADC1_EXTTRIG_TIM, ADC1_EXTTRIG_GPIO} ADC1_ExtTrig_TypeDef;
+typedef enum {ADC1_ALIGN_LEFT, ADC1_ALIGN_RIGHT} ADC1_Align_TypeDef;
+typedef enum {ADC1_FLAG_EOC = 0x80, ADC1_FLAG_AWD = 0x40} ADC1_Flag_TypeDef;
+typedef enum {
+  ADC1_IT_AWDIE = 0x10, ADC1_IT_EOCIE = 0x20, ADC1_IT_AWD = 0x140,
+  ADC1_IT_EOC = 0x80
+} ADC1_IT_TypeDef;
+
+typedef enum {
+  CLK_PERIPHERAL_I2C = 0x00, CLK_PERIPHERAL_SPI = 0x01,
+  CLK_PERIPHERAL_UART1 = 0x02, CLK_PERIPHERAL_UART2 = 0x03,
+  CLK_PERIPHERAL_TIMER4 = 0x04, CLK_PERIPHERAL_TIMER6 = 0x04,
+  CLK_PERIPHERAL_TIMER2 = 0x05, CLK_PERIPHERAL_TIMER5 = 0x05,
+  CLK_PERIPHERAL_TIMER3 = 0x06, CLK_PERIPHERAL_TIMER1 = 0x07,
+  CLK_PERIPHERAL_AWU = 0x12, CLK_PERIPHERAL_ADC = 0x13
+} CLK_Peripheral_TypeDef;
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+extern GPIO_TypeDef OT_SIM_ports[7];
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+#define GPIOA  (&OT_SIM_ports[0])
+#define GPIOB  (&OT_SIM_ports[1])
+#define GPIOC  (&OT_SIM_ports[2])
+#define GPIOD  (&OT_SIM_ports[3])
+#define GPIOE  (&OT_SIM_ports[4])
+#define GPIOF  (&OT_SIM_ports[5])
+#define GPIOG  (&OT_SIM_ports[6])
+
+// The ISRs are plain functions, called by the simulator
+#define INTERRUPT_HANDLER(a, b)  void a(void)
+#define ITC_IRQ_PORTB            4
+#define ITC_IRQ_PORTC            5
+#define ITC_IRQ_ADC1             22
+
+#define enableInterrupts()   OT_SIM_interrupts(1)
+#define disableInterrupts()  OT_SIM_interrupts(0)
+#define wfi()                OT_SIM_wait(0)
+#define halt()               OT_SIM_wait(1)
+#define nop()                do {} while (0)
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+void OT_SIM_interrupts(uint8_t enabled);
+void OT_SIM_wait(uint8_t halted);
+uint8_t ITC_GetCPUCC(void);
+void GPIO_Init(GPIO_TypeDef *port, GPIO_Pin_TypeDef pin,
+               GPIO_Mode_TypeDef mode);
+void EXTI_SetExtIntSensitivity(EXTI_Port_TypeDef port,
+                               EXTI_Sensitivity_TypeDef sensitivity);
+void ADC1_DeInit(void);
+void ADC1_Init(ADC1_ConvMode_TypeDef mode, ADC1_Channel_TypeDef channel,
+               ADC1_PresSel_TypeDef prescaler, ADC1_ExtTrig_TypeDef trig,
+               FunctionalState trig_state, ADC1_Align_TypeDef align,
+               ADC1_SchmittTrigg_TypeDef schmitt,
+               FunctionalState schmitt_state);
+void ADC1_Cmd(FunctionalState state);
+void ADC1_SchmittTriggerConfig(ADC1_SchmittTrigg_TypeDef schmitt,
+                               FunctionalState state);
+void ADC1_PrescalerConfig(ADC1_PresSel_TypeDef prescaler);
+void ADC1_ConversionConfig(ADC1_ConvMode_TypeDef mode,
+                           ADC1_Channel_TypeDef channel,
+                           ADC1_Align_TypeDef align);
+void ADC1_DataBufferCmd(FunctionalState state);
+void ADC1_ITConfig(ADC1_IT_TypeDef it, FunctionalState state);
+void ADC1_StartConversion(void);
+uint16_t ADC1_GetConversionValue(void);
+uint16_t ADC1_GetBufferValue(uint8_t buffer);
+void ADC1_SetHighThreshold(uint16_t threshold);
+void ADC1_SetLowThreshold(uint16_t threshold);
+FlagStatus ADC1_GetFlagStatus(ADC1_Flag_TypeDef flag);
+void ADC1_ClearFlag(ADC1_Flag_TypeDef flag);
+void ADC1_ClearITPendingBit(ADC1_IT_TypeDef it);
+/*============================================================================*/
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STM8S_H */
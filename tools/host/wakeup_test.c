@@ -0,0 +1,115 @@
+/*==============================================================================
+ * MODULE: Wake-up test (WKT)
+ * DESCRIPTION: Runs the firmware (main.c), unmodified, in the simulator
+ * (sim.c) from power-up until it goes to SLEEPING, then taps the button
+ * (BUTTON_DET) to wake it up, and times the wake-up: from the button's edge
+ * to the first arming of TRIGGER_IN (its interrupt enabled).
+ * - with FAST_WAKEUP, INIT arms it once the sensor has settled:
+ *   SENSOR_SETTLE_MS (ticks) after the edge;
+ * - without, READY does: OT_WKT_INIT_MS after the edge.
+ * The wake-up from halt itself isn't modelled (see power.c), nor are the
+ * instructions timed (see `make bench`).
+ *
+ * Usage: wakeup_test
+ * Prints the time from the edge to the arming.
+ *============================================================================*/
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include <stdio.h>
+#include "config.h"
+#include "state_machine.h"
+#include "sim.h"
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+#if !defined(WAKEUP_BUTTON)
+  #error "Build with WAKEUP_BUTTON"
+#endif
+// From power-up: READY times out to SLEEPING (OT_SM_READY_TIMEOUT_MS), and
+// then the wake-up
+#define OT_WKT_RUN_MS           90000
+// How long the button is held (INIT lasts as long with OPTICAL_CONFIG)
+#define OT_WKT_TAP_MS           1
+// OT_SM_INIT_TIMEOUT_MS (state_machine.c)
+#define OT_WKT_INIT_MS          100
+#if defined(FAST_WAKEUP)
+  #define OT_WKT_ARMED_MS       SENSOR_SETTLE_MS
+#else
+  #define OT_WKT_ARMED_MS       OT_WKT_INIT_MS
+#endif // FAST_WAKEUP
+// Slack on it: the tap (see above), and the first tick's phase
+#define OT_WKT_SLACK_MS         (OT_WKT_TAP_MS + 1)
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+#define OT_WKT_CHECK(cond, what)  \
+  do { if (!(cond)) ot_wkt_fail(what, &failures); } while (0)
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+/*==============================================================================
+ * LOCAL FUNCTION PROTOTYPES
+ *============================================================================*/
+/*==============================================================================
+ * LOCAL VARIABLES
+ *============================================================================*/
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+// main.c's main(), built as -Dmain=OT_SIM_firmware_main
+void OT_SIM_firmware_main(void);
+/*==============================================================================
+ * LOCAL FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION: Report a failed check
+ * @param what
+ * @param failuresp - incremented
+ * @return
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+static void ot_wkt_fail(const char *what, int *failuresp) {
+  printf("FAIL: %s\n", what);
+  ++*failuresp;
+  return;
+}
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+int main(void) {
+  const OT_SIM_WAKEUP_T *wp = &OT_SIM_wakeup;
+  uint64_t latency;
+  int failures = 0;
+
+  OT_SIM_reset(0, 0);
+  OT_SIM_wakeup_tap(0, OT_SIM_MS(OT_WKT_TAP_MS));
+  OT_SIM_run_firmware(OT_SIM_firmware_main, OT_SIM_MS(OT_WKT_RUN_MS));
+  OT_WKT_CHECK(0 != wp->pressed_at, "never went to SLEEPING");
+  OT_WKT_CHECK(0 != wp->armed_at, "TRIGGER_IN never armed after the tap");
+  OT_WKT_CHECK(OT_SM_STATE_READY == OT_SM_get_state(), "not READY");
+  if (0 != failures) {
+    printf("FAIL: %d check(s)\n", failures);
+    return 1;
+  }
+  latency = wp->armed_at - wp->pressed_at;
+#if defined(FAST_WAKEUP)
+  printf("FAST_WAKEUP: ");
+#endif // FAST_WAKEUP
+  printf("BUTTON_DET edge at %llu us, TRIGGER_IN armed %llu us later\n",
+         (unsigned long long)(wp->pressed_at / OT_SIM_CYCLES_PER_US),
+         (unsigned long long)(latency / OT_SIM_CYCLES_PER_US));
+  OT_WKT_CHECK((OT_SIM_MS(OT_WKT_ARMED_MS) <= latency) &&
+               (latency <= OT_SIM_MS(OT_WKT_ARMED_MS + OT_WKT_SLACK_MS)),
+               "armed out of range");
+  if (0 != failures) {
+    printf("FAIL: %d check(s)\n", failures);
+    return 1;
+  }
+  printf("Armed as expected\n");
+  return 0;
+}
+/*============================================================================*/
@@ -0,0 +1,201 @@
+/*==============================================================================
+ * MODULE: Waveform (WAVE)
+ * DESCRIPTION: Reads the FLASH_SENSE waveforms of doc/waveforms (see
+ * doc/Waveforms.md) and gives their level at any time, for the simulator's
+ * ADC1 to convert (OT_SIM_flash_sense()).
+ *============================================================================*/
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wave.h"
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+#define OT_WAVE_ADC_MAX         0x03FF // 10-bit
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+/*==============================================================================
+ * LOCAL FUNCTION PROTOTYPES
+ *============================================================================*/
+/*==============================================================================
+ * LOCAL VARIABLES
+ *============================================================================*/
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+/*==============================================================================
+ * LOCAL FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION: The noise at a time
+ * @param wavep
+ * @param t_us
+ * @return -noise..+noise counts
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes Deterministic: a function of the time (to 0.5usec, a CPU cycle), so
+ *        the same sample reads the same however often it is read
+ *============================================================================*/
+static int ot_wave_noise(const OT_WAVE_T *wavep, double t_us) {
+  uint32_t x = wavep->seed ^ (uint32_t)(t_us * 2);
+  x = (x * 1103515245u + 12345u) & 0x7FFFFFFF;
+  x = (x * 1103515245u + 12345u) & 0x7FFFFFFF;
+  return (int)((x >> 16) % (2u * wavep->noise + 1)) - (int)wavep->noise;
+}
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+/*==============================================================================
+ * DESCRIPTION: Read a waveform (see doc/Waveforms.md)
+ * @param path
+ * @param wavep
+ * @return 0 if it is well-formed
+ * @precondition
+ * @postcondition
+ * @caution
+ * @notes Prints what is wrong with it otherwise
+ *============================================================================*/
+int OT_WAVE_load(const char *path, OT_WAVE_T *wavep) {
+  char line[160];
+  char key[16];
+  char value[64];
+  unsigned long t_us;
+  double a;
+  double b;
+  unsigned lineno = 0;
+  int bad = 0;
+  const char *c;
+  char *commentp;
+  FILE *fp = fopen(path, "r");
+
+  if ((void*)0 == fp) {
+    perror(path);
+    return -1;
+  }
+  memset(wavep, 0, sizeof(*wavep));
+  snprintf(wavep->name, sizeof(wavep->name), "%s", path);
+  while (!bad && ((void*)0 != fgets(line, sizeof(line), fp))) {
+    ++lineno;
+    commentp = strchr(line, '#');
+    if ((void*)0 != commentp) *commentp = '\0';
+    if (1 == sscanf(line, " @%15s", key)) {
+      if ((0 == strcmp(key, "name")) &&
+          (1 == sscanf(line, " @%*s %63s", value))) {
+        snprintf(wavep->name, sizeof(wavep->name), "%s", value);
+      }
+      else if (0 == strcmp(key, "source")) {
+        // Documentation only
+      }
+      else if ((0 == strcmp(key, "noise")) &&
+               (1 == sscanf(line, " @%*s %lu", &t_us))) {
+        wavep->noise = (uint16_t)t_us;
+      }
+      else if ((0 == strcmp(key, "power")) &&
+               (1 == sscanf(line, " @%*s %lu", &t_us)) && (0 != t_us)) {
+        wavep->power = (uint16_t)t_us;
+      }
+      else if ((0 == strcmp(key, "event")) &&
+               (wavep->events < OT_WAVE_MAX_EVENTS) &&
+               (1 == sscanf(line, " @%*s %lu", &t_us))) {
+        wavep->event_us[wavep->events++] = (uint32_t)t_us;
+      }
+      else if ((0 == strcmp(key, "flicker")) &&
+               (wavep->flickers < OT_WAVE_MAX_FLICKERS) &&
+               (2 == sscanf(line, " @%*s %lf %lf", &a, &b))) {
+        wavep->flicker_hz[wavep->flickers]     = a;
+        wavep->flicker_counts[wavep->flickers] = b;
+        ++wavep->flickers;
+      }
+      else {
+        bad = 1;
+      }
+    }
+    else if (2 == sscanf(line, " %lu %lf", &t_us, &a)) {
+      if ((OT_WAVE_MAX_POINTS == wavep->points) ||
+          ((0 != wavep->points) &&
+           (t_us <= wavep->t_us[wavep->points - 1]))) {
+        bad = 1;
+      }
+      else {
+        wavep->t_us[wavep->points]   = (uint32_t)t_us;
+        wavep->counts[wavep->points] = a;
+        ++wavep->points;
+      }
+    }
+    else if (1 == sscanf(line, " %1s", value)) {
+      bad = 1; // Neither blank nor a point
+    }
+  }
+  fclose(fp);
+  if (bad) {
+    fprintf(stderr, "%s:%u: bad line\n", path, lineno);
+    return -1;
+  }
+  if ((wavep->points < 2) || (0 != wavep->t_us[0])) {
+    fprintf(stderr, "%s: needs 2+ points, from 0 and increasing\n", path);
+    return -1;
+  }
+  for (c = wavep->name; '\0' != *c; ++c) wavep->seed += (uint8_t)*c;
+  return 0;
+}
+/*==============================================================================
+ * DESCRIPTION: The level of a waveform at a time
+ * @param wavep
+ * @param t_us - from its start
+ * @return ADC counts
+ * @precondition OT_WAVE_load()
+ * @postcondition
+ * @caution
+ * @notes Linear between its points, and its last level past its end; plus
+ *        the flicker and the noise
+ *============================================================================*/
+uint16_t OT_WAVE_level(const OT_WAVE_T *wavep, double t_us) {
+  uint16_t lo = 0;
+  uint16_t hi = wavep->points - 1;
+  uint16_t mid;
+  double level;
+  uint8_t i;
+
+  if (t_us < 0) t_us = 0;
+  if (t_us >= wavep->t_us[hi]) {
+    level = wavep->counts[hi];
+  }
+  else {
+    while (hi - lo > 1) { // t_us[lo] <= t_us < t_us[hi]
+      mid = (lo + hi) / 2;
+      if (wavep->t_us[mid] <= t_us) lo = mid; else hi = mid;
+    }
+    level = wavep->counts[lo] + (wavep->counts[hi] - wavep->counts[lo]) *
+            (t_us - wavep->t_us[lo]) / (wavep->t_us[hi] - wavep->t_us[lo]);
+  }
+  for (i = 0; i < wavep->flickers; ++i) {
+    level += wavep->flicker_counts[i] *
+             sin(2 * M_PI * wavep->flicker_hz[i] * t_us / 1e6);
+  }
+  if (0 != wavep->noise) level += ot_wave_noise(wavep, t_us);
+  if (level < 0) return 0;
+  if (level > OT_WAVE_ADC_MAX) return OT_WAVE_ADC_MAX;
+  return (uint16_t)lround(level);
+}
+/*==============================================================================
+ * DESCRIPTION: When a waveform ends
+ * @param wavep
+ * @return Its last point's time (usec)
+ * @precondition OT_WAVE_load()
+ * @postcondition
+ * @caution
+ * @notes
+ *============================================================================*/
+uint32_t OT_WAVE_end_us(const OT_WAVE_T *wavep) {
+  return wavep->t_us[wavep->points - 1];
+}
+/*============================================================================*/
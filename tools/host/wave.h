@@ -0,0 +1,57 @@
+/*==============================================================================
+ * MODULE: Waveform (WAVE)
+ * DESCRIPTION: Prototypes exported by the WAVE module
+ *============================================================================*/
+#ifndef _OT_WAVE_H_
+#define _OT_WAVE_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+/*==============================================================================
+ * INCLUDES
+ *============================================================================*/
+#include <stdint.h>
+/*==============================================================================
+ * CONSTANTS
+ *============================================================================*/
+#define OT_WAVE_MAX_POINTS      64
+#define OT_WAVE_MAX_EVENTS      8
+#define OT_WAVE_MAX_FLICKERS    4
+/*==============================================================================
+ * MACROS
+ *============================================================================*/
+/*==============================================================================
+ * TYPEDEFs and STRUCTs
+ *============================================================================*/
+// A FLASH_SENSE waveform (see doc/Waveforms.md)
+typedef struct OT_WAVE_S {
+  char     name[64];
+  uint16_t noise;       // @noise (+/- counts)
+  uint16_t power;       // @power (1/power of a master's burst; 0: none)
+  uint8_t  events;
+  uint32_t event_us[OT_WAVE_MAX_EVENTS];
+  uint8_t  flickers;
+  double   flicker_hz[OT_WAVE_MAX_FLICKERS];
+  double   flicker_counts[OT_WAVE_MAX_FLICKERS];
+  uint16_t points;
+  uint32_t t_us[OT_WAVE_MAX_POINTS];
+  double   counts[OT_WAVE_MAX_POINTS];
+  uint32_t seed;        // Of the noise (the name's)
+} OT_WAVE_T;
+/*==============================================================================
+ * GLOBAL (extern) VARIABLES
+ *============================================================================*/
+/*==============================================================================
+ * EXPORTED (GLOBAL) FUNCTIONS
+ *============================================================================*/
+int OT_WAVE_load(const char *path, OT_WAVE_T *wavep);
+uint16_t OT_WAVE_level(const OT_WAVE_T *wavep, double t_us);
+uint32_t OT_WAVE_end_us(const OT_WAVE_T *wavep);
+/*============================================================================*/
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _OT_WAVE_H_
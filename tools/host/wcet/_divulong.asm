@@ -0,0 +1,28 @@
+;--------------------------------------------------------
+; File Created by SDCC : free open source ISO C Compiler
+; Version 4.2.0 #13081 (Linux)
+;--------------------------------------------------------
+	.module _divulong
+	.optsdcc -mstm8
+
+;--------------------------------------------------------
+; Public variables in this module
+;--------------------------------------------------------
+	.globl __divulong
+;--------------------------------------------------------
+; code
+;--------------------------------------------------------
+	.area CODE
+;	_divulong.c: 331: _divulong (unsigned long x, unsigned long y)
+;	-----------------------------------------
+;	 function _divulong
+;	-----------------------------------------
+__divulong:
+;	_divulong.c: 333: (replaced by the stm8 runtime's divulong.s)
+	clrw	x
+	clrw	y
+	ret
+	.area CODE
+	.area CONST
+	.area INITIALIZER
+	.area CABS (ABS)
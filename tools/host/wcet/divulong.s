@@ -0,0 +1,15 @@
+; Stand-in for a hand-written routine of sdcc's stm8 runtime: it replaces the
+; generic C version (_divulong.asm), being passed after it
+
+	.module divulong
+	.globl __divulong
+
+	.area CODE
+__divulong::
+	ld	a, #0x20
+0001$:
+	sllw	x
+	rlcw	y
+	dec	a
+	jrne	0001$
+	ret
@@ -0,0 +1,157 @@
+;--------------------------------------------------------
+; File Created by SDCC : free open source ISO C Compiler
+; Version 4.2.0 #13081 (Linux)
+;--------------------------------------------------------
+	.module state_machine
+	.optsdcc -mstm8
+
+;--------------------------------------------------------
+; Public variables in this module
+;--------------------------------------------------------
+	.globl _ot_gpiob_isr
+	.globl _tim4_isr_ovf
+	.globl _EXTI_SetExtIntSensitivity
+	.globl _GPIO_WriteHigh
+;--------------------------------------------------------
+; ram data
+;--------------------------------------------------------
+	.area DATA
+_ot_sm_data:
+	.ds 4
+_ot_sm_count:
+	.ds 1
+;--------------------------------------------------------
+; ram data
+;--------------------------------------------------------
+	.area INITIALIZED
+_ot_sm_cbp:
+	.ds 2
+;--------------------------------------------------------
+; absolute external ram data
+;--------------------------------------------------------
+	.area DABS (ABS)
+
+; default segment ordering for linker
+	.area HOME
+	.area GSINIT
+	.area GSFINAL
+	.area CONST
+	.area INITIALIZER
+	.area CODE
+
+;--------------------------------------------------------
+; global & static initialisations
+;--------------------------------------------------------
+	.area HOME
+	.area GSINIT
+	.area GSFINAL
+	.area GSINIT
+;--------------------------------------------------------
+; Home
+;--------------------------------------------------------
+	.area HOME
+	.area HOME
+;--------------------------------------------------------
+; code
+;--------------------------------------------------------
+	.area CODE
+;	state_machine.c: 10: static void ot_sm_ready_entry(void) {
+;	-----------------------------------------
+;	 function ot_sm_ready_entry
+;	-----------------------------------------
+_ot_sm_ready_entry:
+;	state_machine.c: 11: ot_sm_data.timeout_ms = 0;
+	clrw	x
+	ldw	_ot_sm_data+0, x
+;	state_machine.c: 12: }
+	ret
+;	state_machine.c: 14: static void ot_sm_ready_action(void) {
+;	-----------------------------------------
+;	 function ot_sm_ready_action
+;	-----------------------------------------
+_ot_sm_ready_action:
+;	state_machine.c: 15: if (ot_sm_count < 3) ++ot_sm_count;
+	ld	a, _ot_sm_count+0
+	cp	a, #0x03
+	jrnc	00103$
+	inc	_ot_sm_count+0
+00103$:
+;	state_machine.c: 16: }
+	ret
+;	state_machine.c: 18: static void ot_sm_ready_exit(void) {
+;	-----------------------------------------
+;	 function ot_sm_ready_exit
+;	-----------------------------------------
+_ot_sm_ready_exit:
+;	state_machine.c: 19: GPIO_WriteHigh(GPIOD, GPIO_PIN_3);
+	push	#0x08
+	ldw	x, #0x500f
+	pushw	x
+	call	_GPIO_WriteHigh
+	addw	sp, #3
+;	state_machine.c: 20: }
+	ret
+;	state_machine.c: 22: static void ot_sm_set_state(uint8_t state) {
+;	-----------------------------------------
+;	 function ot_sm_set_state
+;	-----------------------------------------
+_ot_sm_set_state:
+;	state_machine.c: 23: ot_sm_count = state;
+	ld	_ot_sm_count+0, a
+;	state_machine.c: 24: (*ot_sm_handlers[0].exitp)();
+	ldw	x, _ot_sm_handlers+4
+	call	(x)
+;	state_machine.c: 25: ot_sm_data.timeout_ms = ot_sm_timeouts[1];
+	ldw	x, _ot_sm_timeouts+2
+	ldw	_ot_sm_data+0, x
+;	state_machine.c: 26: (*ot_sm_handlers[0].entryp)();
+	ldw	x, _ot_sm_handlers+0
+	call	(x)
+;	state_machine.c: 27: }
+	ret
+;	state_machine.c: 29: INTERRUPT_HANDLER(ot_gpiob_isr, ITC_IRQ_PORTB) {
+;	-----------------------------------------
+;	 function ot_gpiob_isr
+;	-----------------------------------------
+_ot_gpiob_isr:
+	clr	a
+	div	x, a
+;	state_machine.c: 30: ot_sm_set_state(1);
+	ld	a, #0x01
+	call	_ot_sm_set_state
+;	state_machine.c: 31: }
+	iret
+;	state_machine.c: 33: INTERRUPT_HANDLER(tim4_isr_ovf, ITC_IRQ_TIM4_OVF) {
+;	-----------------------------------------
+;	 function tim4_isr_ovf
+;	-----------------------------------------
+_tim4_isr_ovf:
+	clr	a
+	div	x, a
+;	state_machine.c: 34: EXTI_SetExtIntSensitivity(ot_sm_count, 0);
+	ld	a, _ot_sm_count+0
+	push	a
+	call	_EXTI_SetExtIntSensitivity
+	pop	a
+;	state_machine.c: 35: ot_sm_data.timeout_ms = ot_sm_data.cycles / 1000;
+	ldw	x, _ot_sm_data+2
+	pushw	x
+	ldw	x, _ot_sm_data+0
+	pushw	x
+	call	__divulong
+	addw	sp, #4
+;	state_machine.c: 36: }
+	iret
+	.area CODE
+	.area CONST
+_ot_sm_handlers:
+	.dw _ot_sm_ready_entry
+	.dw _ot_sm_ready_action
+	.dw _ot_sm_ready_exit
+_ot_sm_timeouts:
+	.dw #0x03e8
+	.dw #0x07d0
+	.area INITIALIZER
+__xinit__ot_sm_cbp:
+	.dw #0x0000
+	.area CABS (ABS)
@@ -0,0 +1,57 @@
+;--------------------------------------------------------
+; File Created by SDCC : free open source ISO C Compiler
+; Version 4.2.0 #13081 (Linux)
+;--------------------------------------------------------
+	.module stm8s_exti
+	.optsdcc -mstm8
+
+;--------------------------------------------------------
+; Public variables in this module
+;--------------------------------------------------------
+	.globl _EXTI_SetExtIntSensitivity
+;--------------------------------------------------------
+; code
+;--------------------------------------------------------
+	.area CODE
+;	stm8s_exti.c: 70: void EXTI_SetExtIntSensitivity(EXTI_Port_TypeDef Port, EXTI_Sensitivity_TypeDef SensitivityValue)
+;	-----------------------------------------
+;	 function EXTI_SetExtIntSensitivity
+;	-----------------------------------------
+_EXTI_SetExtIntSensitivity:
+;	stm8s_exti.c: 77: switch (Port)
+	ld	a, (0x03, sp)
+	cp	a, #0x02
+	jrugt	00104$
+	clrw	x
+	ld	xl, a
+	sllw	x
+	ldw	x, (#00114$, x)
+	jp	(x)
+00114$:
+	.dw	#00101$
+	.dw	#00102$
+	.dw	#00103$
+;	stm8s_exti.c: 79: case EXTI_PORT_GPIOA:
+00101$:
+;	stm8s_exti.c: 80: EXTI->CR1 &= (uint8_t)(~EXTI_CR1_PAIS);
+	bres	0x50a0, #0
+;	stm8s_exti.c: 82: break;
+	jra	00104$
+;	stm8s_exti.c: 83: case EXTI_PORT_GPIOB:
+00102$:
+;	stm8s_exti.c: 84: EXTI->CR1 &= (uint8_t)(~EXTI_CR1_PBIS);
+	bres	0x50a0, #2
+	bres	0x50a0, #3
+;	stm8s_exti.c: 86: break;
+	jra	00104$
+;	stm8s_exti.c: 87: case EXTI_PORT_GPIOC:
+00103$:
+;	stm8s_exti.c: 88: EXTI->CR1 &= (uint8_t)(~EXTI_CR1_PCIS);
+	bres	0x50a0, #4
+;	stm8s_exti.c: 103: }
+00104$:
+	ret
+	.area CODE
+	.area CONST
+	.area INITIALIZER
+	.area CABS (ABS)
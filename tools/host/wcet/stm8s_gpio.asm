@@ -0,0 +1,31 @@
+;--------------------------------------------------------
+; File Created by SDCC : free open source ISO C Compiler
+; Version 4.2.0 #13081 (Linux)
+;--------------------------------------------------------
+	.module stm8s_gpio
+	.optsdcc -mstm8
+
+;--------------------------------------------------------
+; Public variables in this module
+;--------------------------------------------------------
+	.globl _GPIO_WriteHigh
+;--------------------------------------------------------
+; code
+;--------------------------------------------------------
+	.area CODE
+;	stm8s_gpio.c: 130: void GPIO_WriteHigh(GPIO_TypeDef* GPIOx, GPIO_Pin_TypeDef PortPins)
+;	-----------------------------------------
+;	 function GPIO_WriteHigh
+;	-----------------------------------------
+_GPIO_WriteHigh:
+;	stm8s_gpio.c: 132: GPIOx->ODR |= (uint8_t)PortPins;
+	ldw	y, (0x03, sp)
+	ld	a, (y)
+	or	a, (0x05, sp)
+	ld	(y), a
+;	stm8s_gpio.c: 133: }
+	ret
+	.area CODE
+	.area CONST
+	.area INITIALIZER
+	.area CABS (ABS)
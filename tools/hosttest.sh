@@ -0,0 +1,267 @@
+#!/usr/bin/env bash
+#===============================================================================
+# Host tests of the firmware, built with gcc against the stand-ins in
+# tools/host (stm8s.h and the simulator, sim.c)
+#
+# Usage: tools/hosttest.sh [<board>[/<rev>] ...]   (default: every configs/*)
+#
+# For each board, the sources and the board's config.h are copied to a scratch
+# directory. Every test is then built and run for the features the board's
+# Make.defs enables, and again for each of VARIANTS ('+FLAG' adds a feature,
+# '-FLAG' removes one). The features the simulator doesn't model
+# (HOST_UNSUPPORTED) are always left out. Exits non-zero if any test fails.
+#
+# Tests:
+#   sm_fuzz  - generative fuzz of the State Machine (tools/host/sm_fuzz.c),
+#              with the cost budgets of tools/host/sm_fuzz.cfg
+#              (SM_FUZZ_SEED and SM_FUZZ_RUNS override its seed and runs)
+#   periodic - the Periodic Interference detector on synthetic edge trains
+#              (tools/host/periodic_test.c), with PERIODIC_REJECT
+#   command  - the wireless Command decoder on every frame of each protocol,
+#              and on the group traces for each WIRELESS_GROUP
+#              (tools/host/command_test.c), with WIRELESS_COMMANDS
+#   selftest - the firmware (main.c) built with SELF_TEST, its loopback
+#              jumpers modelled, at every DIP[2:0] setting
+#              (tools/host/selftest_test.c); not with WIRELESS_COMMANDS
+#   replay   - the firmware (main.c) fed doc/traces/*.trace at every DIP[2:0]
+#              setting (tools/host/replay.c); prints the bursts it fired on
+#   wakeup   - the firmware (main.c) woken up from SLEEPING by the button,
+#              without and with FAST_WAKEUP (tools/host/wakeup_test.c);
+#              prints the time from its edge to TRIGGER_IN being armed
+#   quench   - the firmware (main.c) built with BURST_CAPTURE and QUENCH_OUT,
+#              on a master's burst at each power (doc/waveforms/master-*.wave,
+#              tools/host/quench_test.c); prints the slave's error against
+#              the requested power; not with WIRELESS_COMMANDS
+#   lightning - the firmware (main.c) built with ADC_FLASH_DETECT and
+#              LIGHTNING_MODE, on every FLASH_SENSE waveform of doc/waveforms
+#              (tools/host/lightning_test.c); prints the latency of each
+#              event; with WAKEUP_BUTTON, not with WIRELESS_COMMANDS
+#
+# HOST_TESTS selects the tests to run (default: all of the above).
+#
+# Also, once: tools/wcet.py on the sdcc listings checked in as tools/host/wcet,
+# against the bounds in tools/host/wcet/expected.txt.
+#
+# HOST_CC overrides the compiler (gcc: -fsanitize-coverage=trace-pc).
+#===============================================================================
+
+CC=${HOST_CC:-gcc}
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+HOST=${TOP}/tools/host
+CFLAGS="-std=gnu99 -O1 -g -Wall -Wno-unused-function"
+
+HOST_TESTS=${HOST_TESTS:-"sm_fuzz periodic command selftest replay wakeup
+                         quench lightning"}
+HOST_UNSUPPORTED="ISR_PROFILE ISR_PROFILE_PIN WCET"
+VARIANTS=(
+    ""
+    "+OPTICAL_CONFIG +EEPROM_STORE +EVENT_LOG +SM_STATS +HSI_CALIBRATION"
+    "+WIRELESS_COMMANDS"
+    "-FLASH_PROFILES -FAST_WAKEUP +BATTERY_MONITOR"
+    "-WAKEUP_BUTTON -SNIFF_MODE -STORM_PROTECT -PERIODIC_REJECT"
+)
+
+# The features enabled (FLAG=y) in a Make.defs, as modified by a variant
+features()
+{
+    local defs=$1 variant=$2 f
+    local list=$(sed -n -e 's/^\([A-Z_0-9]*\)=y *$/\1/p' "${defs}")
+    for f in ${variant}; do
+        case ${f} in
+          +*) list="${list} ${f#+}";;
+          -*) list=$(echo ${list} | tr ' ' '\n' | grep -v -x "${f#-}");;
+        esac
+    done
+    for f in ${HOST_UNSUPPORTED}; do
+        list=$(echo ${list} | tr ' ' '\n' | grep -v -x "${f}")
+    done
+    echo ${list} | tr ' ' '\n' | sort -u
+}
+
+has()
+{
+    echo "$1" | grep -q -x "$2"
+}
+
+# The firmware modules every test links (the rest are simulated)
+modules()
+{
+    local feats=$1 srcs="gpio.c"
+    has "${feats}" PERIODIC_REJECT && srcs="${srcs} periodic.c"
+    has "${feats}" WIRELESS_COMMANDS && srcs="${srcs} command.c"
+    has "${feats}" BURST_CAPTURE && srcs="${srcs} adc.c"
+    has "${feats}" ADC_FLASH_DETECT && srcs="${srcs} adc.c"
+    echo ${srcs}
+}
+
+test_sm_fuzz()
+{
+    local work=$1 feats=$2 flags=$3
+    ${CC} ${CFLAGS} ${flags} -fsanitize-coverage=trace-pc \
+        -c "${HOST}/sm_fuzz.c" -o "${work}/sm_fuzz.o" || return 1
+    ${CC} ${CFLAGS} ${flags} -o "${work}/sm_fuzz" "${work}/sm_fuzz.o" \
+        "${HOST}/sim.c" $(modules "${feats}") || return 1
+    "${work}/sm_fuzz" "${HOST}/sm_fuzz.cfg" ${SM_FUZZ_SEED:-1} ${SM_FUZZ_RUNS}
+}
+
+test_periodic()
+{
+    local work=$1 feats=$2 flags=$3
+    has "${feats}" PERIODIC_REJECT || { echo "(no PERIODIC_REJECT)"; return 0; }
+    ${CC} ${CFLAGS} ${flags} -o "${work}/periodic_test" \
+        "${HOST}/periodic_test.c" periodic.c || return 1
+    "${work}/periodic_test"
+}
+
+test_command()
+{
+    local work=$1 feats=$2 flags=$3 group
+    has "${feats}" WIRELESS_COMMANDS || \
+        { echo "(no WIRELESS_COMMANDS)"; return 0; }
+    # command_test.c includes command.c
+    for group in 1 2 4; do
+        ${CC} ${CFLAGS} ${flags} -DOT_CTEST_GROUP=${group} \
+            -o "${work}/command_test" "${HOST}/command_test.c" || return 1
+        "${work}/command_test" "${TOP}"/doc/traces/*.trace || return 1
+    done
+}
+
+test_selftest()
+{
+    local work=$1 feats=$2 flags=$3 f srcs="state_machine.c selftest.c"
+    has "${feats}" WIRELESS_COMMANDS && \
+        { echo "(WIRELESS_COMMANDS: no SELF_TEST)"; return 0; }
+    has "${feats}" SELF_TEST || flags="${flags} -DSELF_TEST"
+    ${CC} ${CFLAGS} ${flags} -Dmain=OT_SIM_firmware_main \
+        -c "${work}/main.c" -o "${work}/main.o" || return 1
+    ${CC} ${CFLAGS} ${flags} -o "${work}/selftest_test" \
+        "${HOST}/selftest_test.c" "${work}/main.o" ${srcs} \
+        $(modules "${feats}") "${HOST}/sim.c" || return 1
+    "${work}/selftest_test"
+}
+
+test_replay()
+{
+    local work=$1 feats=$2 flags=$3 f srcs=state_machine.c
+    # The self-test would drive TRIGGER_IN itself
+    flags=$(for f in ${flags}; do [[ ${f} != -DSELF_TEST ]] && echo ${f}; done)
+    # replay.c includes periodic.c
+    for f in $(modules "${feats}"); do
+        [[ ${f} != periodic.c ]] && srcs="${srcs} ${f}"
+    done
+    ${CC} ${CFLAGS} ${flags} -Dmain=OT_SIM_firmware_main \
+        -c "${work}/main.c" -o "${work}/main.o" || return 1
+    ${CC} ${CFLAGS} ${flags} -o "${work}/replay" "${HOST}/replay.c" \
+        "${work}/main.o" ${srcs} "${HOST}/sim.c" || return 1
+    "${work}/replay" "${TOP}"/doc/traces/*.trace
+}
+
+test_wakeup()
+{
+    local work=$1 feats=$2 flags=$3 f fast srcs=state_machine.c
+    has "${feats}" WAKEUP_BUTTON || { echo "(no WAKEUP_BUTTON)"; return 0; }
+    # The self-test would arm TRIGGER_IN itself
+    flags=$(for f in ${flags}; do
+                [[ ${f} != -DSELF_TEST && ${f} != -DFAST_WAKEUP ]] && echo ${f}
+            done)
+    for f in $(modules "${feats}"); do srcs="${srcs} ${f}"; done
+    for fast in "" -DFAST_WAKEUP; do
+        ${CC} ${CFLAGS} ${flags} ${fast} -Dmain=OT_SIM_firmware_main \
+            -c "${work}/main.c" -o "${work}/main.o" || return 1
+        ${CC} ${CFLAGS} ${flags} ${fast} -o "${work}/wakeup_test" \
+            "${HOST}/wakeup_test.c" "${work}/main.o" ${srcs} \
+            "${HOST}/sim.c" || return 1
+        "${work}/wakeup_test" || return 1
+    done
+}
+
+test_quench()
+{
+    local work=$1 feats=$2 flags=$3 f srcs="state_machine.c adc.c"
+    has "${feats}" WIRELESS_COMMANDS && \
+        { echo "(WIRELESS_COMMANDS: no BURST_CAPTURE)"; return 0; }
+    # The self-test would drive TRIGGER_IN itself
+    flags=$(for f in ${flags}; do [[ ${f} != -DSELF_TEST ]] && echo ${f}; done)
+    flags="${flags} -DBURST_CAPTURE -DQUENCH_OUT"
+    for f in $(modules "${feats}"); do
+        [[ ${f} != adc.c ]] && srcs="${srcs} ${f}"
+    done
+    ${CC} ${CFLAGS} ${flags} -Dmain=OT_SIM_firmware_main \
+        -c "${work}/main.c" -o "${work}/main.o" || return 1
+    ${CC} ${CFLAGS} ${flags} -o "${work}/quench_test" \
+        "${HOST}/quench_test.c" "${HOST}/wave.c" "${work}/main.o" ${srcs} \
+        "${HOST}/sim.c" -lm || return 1
+    "${work}/quench_test" $(ls "${TOP}"/doc/waveforms/master-*.wave | sort -V)
+}
+
+test_lightning()
+{
+    local work=$1 feats=$2 flags=$3 f srcs="state_machine.c adc.c"
+    has "${feats}" WAKEUP_BUTTON || { echo "(no WAKEUP_BUTTON)"; return 0; }
+    has "${feats}" WIRELESS_COMMANDS && \
+        { echo "(WIRELESS_COMMANDS: no ADC_FLASH_DETECT)"; return 0; }
+    # The self-test would drive TRIGGER_IN itself, and CONFIG's flashes
+    # would fire
+    flags=$(for f in ${flags}; do
+                case ${f} in
+                    -DSELF_TEST|-DOPTICAL_CONFIG) ;;
+                    *) echo ${f};;
+                esac
+            done)
+    flags="${flags} -DADC_FLASH_DETECT -DLIGHTNING_MODE"
+    for f in $(modules "${feats}"); do
+        [[ ${f} != adc.c ]] && srcs="${srcs} ${f}"
+    done
+    ${CC} ${CFLAGS} ${flags} -Dmain=OT_SIM_firmware_main \
+        -c "${work}/main.c" -o "${work}/main.o" || return 1
+    ${CC} ${CFLAGS} ${flags} -o "${work}/lightning_test" \
+        "${HOST}/lightning_test.c" "${HOST}/wave.c" "${work}/main.o" \
+        ${srcs} "${HOST}/sim.c" -lm || return 1
+    "${work}/lightning_test" "${TOP}"/doc/waveforms/*.wave
+}
+
+# The static WCET analysis (tools/wcet.py) of a checked-in sdcc listing
+wcet_fixture()
+{
+    local dir=${HOST}/wcet
+    echo "== wcet (tools/host/wcet)"
+    python3 "${TOP}/tools/wcet.py" "${dir}/wcet.cfg" "${dir}"/*.asm \
+        "${dir}"/*.s | diff -u "${dir}/expected.txt" - && echo "as expected"
+}
+
+host_board()
+{
+    local board=$1 rc=0 variant feats flags t
+    local work=$(mktemp -d)
+    local part=$(awk -F= '/^MCUPART *=/ { gsub(/ /, "", $2); print toupper($2) }' \
+                 "${TOP}/configs/${board}/Make.defs")
+
+    cp "${TOP}"/*.c "${TOP}"/*.h "${work}/" || return 1
+    cp "${TOP}/configs/${board}/config.h" "${work}/" || return 1
+    cd "${work}" || return 1
+    for variant in "${VARIANTS[@]}"; do
+        feats=$(features "${TOP}/configs/${board}/Make.defs" "${variant}")
+        flags="-D${part} $(echo ${feats} | sed -e 's/\([^ ]*\)/-D\1/g')"
+        flags="${flags} -I${HOST} -I${work}"
+        for t in ${HOST_TESTS}; do
+            echo "== ${board} ${t} ${variant:-(Make.defs)}"
+            test_${t} "${work}" "${feats}" "${flags}" || \
+                { echo "hosttest: ${board} ${t} ${variant} failed" >&2; rc=1; }
+        done
+    done
+    cd "${TOP}"
+    rm -rf "${work}"
+    return ${rc}
+}
+
+if [[ $# -eq 0 ]]; then
+    set -- $(find "${TOP}/configs" -name config.h -exec dirname {} \; | \
+             sed -e "s,${TOP}/configs/,,g" | sort)
+fi
+
+rc=0
+wcet_fixture || { echo "hosttest: wcet failed" >&2; rc=1; }
+for board in "$@"; do
+    host_board "${board}" || rc=1
+done
+exit ${rc}
@@ -0,0 +1,350 @@
+#!/usr/bin/env python3
+#===============================================================================
+# Static worst-case execution time (WCET) analysis of the ISRs
+#
+# Usage: tools/wcet.py <config> <file.asm> [<file.asm> ...]
+#
+# Reads the assembly listings generated by sdcc (the firmware's, and those of
+# the library code it calls: the StdPeriph drivers and sdcc's runtime support,
+# see `make wcet`), builds the call graph (resolving indirect calls through
+# const tables of function pointers, such as the state machine's handler
+# table, and switch jump tables), and computes an upper bound (in CPU cycles)
+# on the execution time of every ISR. Exits with a non-zero status if an ISR
+# exceeds its budget, or if a bound cannot be computed (unknown callee,
+# unbounded loop, recursion, computed jump outside a jump table).
+#
+# Each global label starts a block: a function if instructions follow it, a
+# const table of function pointers if only '.dw _<function>' entries do, data
+# otherwise (e.g. RAM variables: '.ds'). Hand-written sdas sources (e.g.
+# sdcc's stm8 runtime) read the same way. A later definition of a function
+# replaces an earlier one: pass the hand-written runtime after the listings
+# of the generic C versions it overrides.
+#
+# The bound is deliberately pessimistic:
+# - Every instruction is charged its worst-case cycle count (see CYCLES).
+# - The longest path through each function's control flow graph is taken,
+#   and each loop adds its bound times the cost of its whole body.
+# - An indirect call is charged the most expensive of its possible targets.
+#
+# Config file (one directive per line, '#' starts a comment):
+#   budget  <isr> <cycles>          Budget of an ISR (also marks it as an ISR)
+#   extern  <function> <cycles>     WCET of a function with no listing. Also
+#                                   overrides the analysis of a function
+#                                   with a listing.
+#   table   <symbol> <row_bytes>    Const table of function pointers; an
+#                                   access at '<symbol> + k' may call any
+#                                   entry at byte offset k (mod row_bytes).
+#                                   CAUTION: sdcc must fold the field offset
+#                                   into the symbol reference, which it does
+#                                   for 'table[index].field' accesses.
+#   icall   <function> <target>...  Possible targets of the indirect calls
+#                                   in <function> (e.g. registered callbacks)
+#   loop    <function> iter <n>...  Loops in <function> (in address order)
+#                                   iterate at most n times; the last bound
+#                                   given applies to any remaining loops
+#   loop    <function> cycles <n>...  As above, but the loops run for at
+#                                   most n cycles (e.g. waiting on a
+#                                   hardware flag)
+#===============================================================================
+import re
+import sys
+
+# Worst-case cycles per STM8 instruction (PM0044), assuming the slowest
+# addressing mode. Instructions with a memory operand may take one more cycle
+# (see instr_cycles()).
+CYCLES = {
+    'adc': 1, 'add': 1, 'addw': 2, 'and': 1, 'bccm': 1, 'bcp': 1,
+    'bcpl': 1, 'break': 1, 'bres': 1, 'bset': 1, 'btjf': 3, 'btjt': 3,
+    'call': 4, 'callf': 5, 'callr': 4, 'ccf': 1, 'clr': 1, 'clrw': 1,
+    'cp': 1, 'cpw': 2, 'cpl': 1, 'cplw': 2, 'dec': 1, 'decw': 1, 'div': 17,
+    'divw': 17, 'exg': 3, 'exgw': 1, 'halt': 10, 'inc': 1, 'incw': 1,
+    'int': 2, 'iret': 11, 'jp': 1, 'jpf': 2, 'jra': 2, 'jrt': 2, 'ld': 1,
+    'ldf': 1, 'ldw': 2, 'mov': 1, 'mul': 4, 'neg': 1, 'negw': 2, 'nop': 1,
+    'or': 1, 'pop': 1, 'popw': 2, 'push': 1, 'pushw': 2, 'rcf': 1,
+    'ret': 4, 'retf': 5, 'rim': 1, 'rlc': 1, 'rlcw': 2, 'rlwa': 1,
+    'rrc': 1, 'rrcw': 2, 'rrwa': 1, 'rvf': 1, 'sbc': 1, 'scf': 1,
+    'sim': 1, 'sla': 1, 'slaw': 2, 'sll': 1, 'sllw': 2, 'sra': 1,
+    'sraw': 2, 'srl': 1, 'srlw': 2, 'sub': 1, 'subw': 2, 'swap': 1,
+    'swapw': 1, 'tnz': 1, 'tnzw': 2, 'trap': 9, 'wfe': 1, 'wfi': 10,
+    'xor': 1,
+}
+# Conditional relative jumps (taken: 2 cycles)
+for cc in ('c', 'eq', 'f', 'h', 'ih', 'il', 'm', 'mi', 'nc', 'ne', 'nh',
+           'nm', 'nv', 'pl', 'sge', 'sgt', 'sle', 'slt', 'uge', 'ugt',
+           'ule', 'ult', 'v'):
+    CYCLES['jr' + cc] = 2
+
+# Interrupt entry (context save) before the first ISR instruction
+ISR_LATENCY = 9
+
+RE_LABEL = re.compile(r'^(\w+\$?)::?')
+RE_INSTR = re.compile(r'^\s+([a-z]+)\s*(.*?)\s*(;.*)?$')
+RE_DIRECTIVE = re.compile(r'^\s*\.(\w+)\s*(.*?)\s*(;.*)?$')
+RE_DW_ENTRY = re.compile(r'^#?\(?(\w+\$?)\)?$')
+RE_SYMREF = re.compile(r'#?\(?(_\w+)(?:\s*\+\s*(\d+))?\)?')
+
+
+class WcetError(Exception):
+    pass
+
+
+class Function:
+    def __init__(self, name):
+        self.name = name
+        self.instrs = []     # (mnemonic, operands)
+        self.labels = {}     # label -> index of the next instruction
+        self.cases = []      # labels in the function's jump tables
+
+
+def instr_cycles(mnem, ops):
+    if mnem not in CYCLES:
+        raise WcetError('unknown instruction "%s %s"' % (mnem, ops))
+    cycles = CYCLES[mnem]
+    # A memory operand (other than an immediate) may cost an extra cycle
+    if mnem not in ('call', 'callr', 'callf', 'jp', 'jpf', 'btjt', 'btjf') \
+       and ops and '#' not in ops and ('(' in ops or '0x' in ops or '_' in ops):
+        cycles += 1
+    return cycles
+
+
+def parse_asm(paths):
+    funcs = {}
+    tables = {}  # symbol -> list of (byte offset, function)
+    for path in paths:
+        name = None   # Of the block (global label) being read
+        kind = None   # 'func', 'table', 'data' or None (nothing yet)
+        func = None
+        table = None
+        for line in open(path):
+            line = line.rstrip('\n')
+            if line.lstrip().startswith(';'):
+                continue
+            m = RE_LABEL.match(line)
+            if m:
+                label = m.group(1)
+                if label.endswith('$'):
+                    if kind == 'func':
+                        func.labels[label] = len(func.instrs)
+                    continue
+                # sdcc prefixes C names with '_'
+                name = label[1:] if label.startswith('_') else label
+                kind = None
+                func = Function(name)
+                table = []
+                line = line[m.end():]
+            m = RE_DIRECTIVE.match(line)
+            if m:
+                directive, args = m.group(1), m.group(2)
+                entries = [RE_DW_ENTRY.match(a.strip())
+                           for a in args.split(',')]
+                if directive == 'dw' and all(entries):
+                    labels = [e.group(1) for e in entries]
+                    if kind == 'func':
+                        # A switch's jump table, within its function
+                        func.cases.extend(l for l in labels
+                                          if l.endswith('$'))
+                        continue
+                    if kind in (None, 'table') and \
+                       all(l.startswith('_') for l in labels):
+                        kind = 'table'
+                        for l in labels:
+                            table.append((2 * len(table), l[1:]))
+                        tables[name] = table
+                        continue
+                if kind == 'func':
+                    continue  # E.g. '.area' after the function's code
+                if kind is None and name is not None:
+                    kind = 'data'
+                elif kind == 'table' and directive != 'dw':
+                    # Another directive ends the table
+                    kind = 'data'
+                elif kind == 'table':
+                    # Something else than function pointers: not a table
+                    del tables[name]
+                    kind = 'data'
+                continue
+            m = RE_INSTR.match(line)
+            if m and name is not None and kind in (None, 'func'):
+                if kind is None:
+                    kind = 'func'
+                    funcs[name] = func
+                func.instrs.append((m.group(1), m.group(2)))
+    # Only tables of pointers to functions with a listing
+    for name in list(tables):
+        if not all(f in funcs for _, f in tables[name]):
+            del tables[name]
+    return funcs, tables
+
+
+def parse_config(path):
+    cfg = {'budget': {}, 'extern': {}, 'table': {}, 'icall': {}, 'loop': {}}
+    for lineno, line in enumerate(open(path), 1):
+        words = line.split('#', 1)[0].split()
+        if not words:
+            continue
+        try:
+            kind = words[0]
+            if kind in ('budget', 'extern', 'table'):
+                cfg[kind][words[1]] = int(words[2], 0)
+            elif kind == 'icall':
+                cfg['icall'].setdefault(words[1], []).extend(words[2:])
+            elif kind == 'loop' and words[2] in ('iter', 'cycles'):
+                bounds = [int(w, 0) for w in words[3:]]
+                if not bounds:
+                    raise ValueError
+                cfg['loop'][words[1]] = (words[2], bounds)
+            else:
+                raise ValueError
+        except (IndexError, ValueError):
+            raise WcetError('%s:%d: bad directive "%s"' %
+                            (path, lineno, line.strip()))
+    return cfg
+
+
+class Analysis:
+    def __init__(self, funcs, tables, cfg):
+        self.funcs = funcs
+        self.tables = tables
+        self.cfg = cfg
+        self.wcet = {}
+        self.active = []
+
+    def targets(self, func, ops):
+        """Possible targets of an indirect call in func"""
+        targets = set(self.cfg['icall'].get(func.name, []))
+        # Tables referenced anywhere in the function
+        for mnem, operands in func.instrs:
+            for sym, off in RE_SYMREF.findall(operands):
+                name = sym.lstrip('_')
+                if name not in self.tables:
+                    continue
+                row = self.cfg['table'].get(name)
+                if row is None:
+                    raise WcetError('%s: table "%s" has no "table" directive'
+                                    % (func.name, name))
+                off = int(off or 0) % row
+                targets.update(f for o, f in self.tables[name]
+                               if o % row == off)
+        if not targets:
+            raise WcetError('%s: cannot resolve indirect call "%s"; add an '
+                            '"icall" directive' % (func.name, ops))
+        return targets
+
+    def call_cost(self, func, ops):
+        if ops.startswith('_'):
+            return self.of(ops[1:])
+        return max(self.of(t) for t in self.targets(func, ops))
+
+    def of(self, name):
+        if name in self.wcet:
+            return self.wcet[name]
+        if name in self.cfg['extern']:
+            return self.cfg['extern'][name]
+        if name in self.active:
+            raise WcetError('recursion: %s' %
+                            ' -> '.join(self.active + [name]))
+        if name not in self.funcs:
+            raise WcetError('no listing for "%s"; pass it (or add an '
+                            '"extern" directive)' % name)
+        self.active.append(name)
+        self.wcet[name] = self.function_wcet(self.funcs[name])
+        self.active.pop()
+        return self.wcet[name]
+
+    def function_wcet(self, func):
+        n = len(func.instrs)
+        cost = []
+        for mnem, ops in func.instrs:
+            c = instr_cycles(mnem, ops)
+            if mnem in ('call', 'callr', 'callf'):
+                c += self.call_cost(func, ops)
+            elif mnem in ('jp', 'jpf') and ops.startswith('_'):
+                c += self.call_cost(func, ops)  # Tail call
+            cost.append(c)
+
+        # Longest path, ignoring back edges (instructions are in address
+        # order so forward edges always go to a higher index)
+        dist = [None] * (n + 1)
+        dist[0] = 0
+        loops = []
+        worst = 0
+        for i, (mnem, ops) in enumerate(func.instrs):
+            if dist[i] is None:
+                continue  # Unreachable (other than via a back edge)
+            here = dist[i] + cost[i]
+            target = None
+            falls = True
+            if mnem in ('ret', 'retf', 'iret'):
+                falls = False
+            elif mnem in ('jp', 'jpf'):
+                falls = False
+                if not ops.startswith('_'):
+                    # A switch: any case of the function's jump tables
+                    if not func.cases:
+                        raise WcetError('%s: computed jump "%s %s"' %
+                                        (func.name, mnem, ops))
+                    for case in func.cases:
+                        j = func.labels.get(case)
+                        if j is None or j <= i:
+                            raise WcetError('%s: jump table entry "%s" '
+                                            'is not a later label' %
+                                            (func.name, case))
+                        dist[j] = max(dist[j] or 0, here)
+            elif mnem == 'jra':
+                target = ops
+                falls = False
+            elif mnem.startswith('jr') or mnem in ('btjt', 'btjf'):
+                target = ops.split(',')[-1].strip()
+            if target is not None:
+                if target not in func.labels:
+                    raise WcetError('%s: unknown label "%s"' %
+                                    (func.name, target))
+                j = func.labels[target]
+                if j > i:
+                    dist[j] = max(dist[j] or 0, here)
+                else:
+                    loops.append((j, i))
+            if falls:
+                dist[i + 1] = max(dist[i + 1] or 0, here)
+            else:
+                worst = max(worst, here)
+        if dist[n] is not None:
+            worst = max(worst, dist[n])
+
+        if loops:
+            if func.name not in self.cfg['loop']:
+                raise WcetError('%s: unbounded loop; add a "loop" directive'
+                                % func.name)
+            kind, bounds = self.cfg['loop'][func.name]
+            for k, (start, end) in enumerate(loops):
+                bound = bounds[min(k, len(bounds) - 1)]
+                body = sum(cost[start:end + 1])
+                worst += bound * body if kind == 'iter' else bound + body
+        return worst
+
+
+def main(argv):
+    if len(argv) < 3:
+        sys.stderr.write('Usage: %s <config> <file.asm> ...\n' % argv[0])
+        return 2
+    try:
+        cfg = parse_config(argv[1])
+        funcs, tables = parse_asm(argv[2:])
+        analysis = Analysis(funcs, tables, cfg)
+        failed = False
+        for isr, budget in sorted(cfg['budget'].items()):
+            if isr not in funcs:
+                continue  # Not built for this board/configuration
+            wcet = ISR_LATENCY + analysis.of(isr)
+            status = 'OK' if wcet <= budget else 'OVER BUDGET'
+            failed = failed or wcet > budget
+            print('WCET: %-16s %7d cycles (budget %7d) %s' %
+                  (isr, wcet, budget, status))
+    except WcetError as e:
+        sys.stderr.write('WCET: error: %s\n' % e)
+        return 1
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))